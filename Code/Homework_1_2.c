@@ -1,139 +1,175 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include "bmp_io.h"
+#include "point_ops.h"
+#include "palette.h"
+#include "resize.h"
 
-#pragma pack(1)
-
-// BMP文件頭結構
-typedef struct {
-    unsigned short bfType;
-    unsigned int bfSize;
-    unsigned short bfReserved1;
-    unsigned short bfReserved2;
-    unsigned int bfOffBits;
-} BITMAPFILEHEADER;
-
-// BMP資訊頭結構
-typedef struct {
-    unsigned int biSize;
-    int biWidth;
-    int biHeight;
-    unsigned short biPlanes;
-    unsigned short biBitCount;
-    unsigned int biCompression;
-    unsigned int biSizeImage;
-    int biXPelsPerMeter;
-    int biYPelsPerMeter;
-    unsigned int biClrUsed;
-    unsigned int biClrImportant;
-} BITMAPINFOHEADER;
-
-// RGB 像素結構
-typedef struct {
-    unsigned char rgbtBlue;
-    unsigned char rgbtGreen;
-    unsigned char rgbtRed;
-} RGBTRIPLE;
-
-// RGBA 像素結構
-typedef struct {
-    unsigned char rgbtBlue;
-    unsigned char rgbtGreen;
-    unsigned char rgbtRed;
-    unsigned char rgbtAlpha;
-} RGBA;
-
-// 量化 RGB 顏色
-void quantizeColorRGB(RGBTRIPLE *pixel, int bits) {
-    int levels = 1 << bits;  // 計算級別數，例：6 位元有 64 級
-    int step = 256 / levels; // 每個級別的步長
-
-    // 量化每個通道
-    pixel->rgbtBlue = (pixel->rgbtBlue / step) * step;
-    pixel->rgbtGreen = (pixel->rgbtGreen / step) * step;
-    pixel->rgbtRed = (pixel->rgbtRed / step) * step;
-}
-
-// 量化 RGBA 顏色
-void quantizeColorRGBA(RGBA *pixel, int bits) {
-    int levels = 1 << bits;  // 計算級別數
-    int step = 256 / levels; // 每個級別的步長
+#define DEPTH_COUNT 3    // 每通道 6、4、2 位元
+#define STRIP_ROWS 64    // 每次處理的行數：這幾行輸入還在快取中時就寫出所有輸出
 
-    // 量化每個顏色通道和 Alpha 通道
-    pixel->rgbtBlue = (pixel->rgbtBlue / step) * step;
-    pixel->rgbtGreen = (pixel->rgbtGreen / step) * step;
-    pixel->rgbtRed = (pixel->rgbtRed / step) * step;
-    pixel->rgbtAlpha = (pixel->rgbtAlpha / step) * step;
-}
+// 調色盤輸出：8 位元（256 色）與 4 位元（16 色）
+static const int paletteBits[] = { 8, 4 };
+#define PALETTE_COUNT 2
 
 // 量化並輸出 BMP 圖片
-void processBMP(const char* inputFileName, const char* outputFilePrefix) {
-    FILE *fp_in = fopen(inputFileName, "rb");
-    if (!fp_in) {
+// palettized 為 0 時輸出每通道 6、4、2 位元的圖片（與原圖相同的 24/32 位元格式），
+// 否則以 median cut 建立調色盤，輸出 8 位元與 4 位元的調色盤 BMP，dither 為抖動方式
+// 所有輸出在同一次掃描中逐條帶寫出，輸入只讀一次（調色盤輸出另需先統計一次顏色直方圖）
+void processBMP(const char* inputFileName, const char* outputFilePrefix, int palettized, DitherMode dither) {
+    BMPFile in;
+    if (bmpOpen(inputFileName, &in) != 0) {
         printf("Failed to open input BMP file: %s\n", inputFileName);
         return;
     }
 
-    // 讀取文件頭和資訊頭
-    BITMAPFILEHEADER fileHeader;
-    BITMAPINFOHEADER infoHeader;
-    fread(&fileHeader, sizeof(BITMAPFILEHEADER), 1, fp_in);
-    fread(&infoHeader, sizeof(BITMAPINFOHEADER), 1, fp_in);
+    int width = in.view.width;
+    int height = in.view.height;  // bmpOpen 已確保高度為正數
+    int count = palettized ? PALETTE_COUNT : DEPTH_COUNT;
 
-    int width = infoHeader.biWidth;
-    int height = abs(infoHeader.biHeight);  // 確保高度為正數
-    int isRGBA = (infoHeader.biBitCount == 32); // 判斷是 RGB 還是 RGBA
+    BMPFile out[DEPTH_COUNT];
+    PointLUT luts[DEPTH_COUNT];
+    PaletteMap maps[PALETTE_COUNT];
+    PaletteQuantizer quantizers[PALETTE_COUNT];
+    ColorHistogram hist;
+    int opened = 0, ok = 1;
 
-    // 計算每行的位元組數，確保行對齊（每行的位元組數是 4 的倍數）
-    int rowSize = (width * (infoHeader.biBitCount / 8) + 3) & ~3;
-    unsigned char* rowBuffer = (unsigned char*)malloc(rowSize);
+    if (palettized && colorHistogramBuild(&in.view, &hist) != 0) {
+        printf("Failed to build colour histogram for %s\n", inputFileName);
+        bmpClose(&in);
+        return;
+    }
 
-    // 根據不同位元深度生成三個輸出檔案
-    for (int bits = 6; bits >= 2; bits -= 2) {
+    // 根據不同位元深度建立輸出檔案
+    for (; opened < count && ok; opened++) {
         char outputFileName[50];
-        sprintf(outputFileName, "%s_%dbits.bmp", outputFilePrefix, bits);
+        int bits = palettized ? paletteBits[opened] : 6 - 2 * opened;
+        if (palettized) {
+            sprintf(outputFileName, "%s_%dbpp.bmp", outputFilePrefix, bits);
+        } else {
+            sprintf(outputFileName, "%s_%dbits.bmp", outputFilePrefix, bits);
+        }
 
-        FILE *fp_out = fopen(outputFileName, "wb");
-        if (!fp_out) {
+        if (bmpCreate(outputFileName, in.header, width, height, palettized ? bits : in.header->bitCount, &out[opened]) != 0) {
             printf("Failed to open output BMP file: %s\n", outputFileName);
-            free(rowBuffer);
-            fclose(fp_in);
-            return;
+            ok = 0;
+            break;
         }
 
-        // 寫入文件頭和資訊頭
-        fwrite(&fileHeader, sizeof(BITMAPFILEHEADER), 1, fp_out);
-        fwrite(&infoHeader, sizeof(BITMAPINFOHEADER), 1, fp_out);
-
-        // 逐行讀取並處理像素數據
-        for (int i = 0; i < height; i++) {
-            fread(rowBuffer, rowSize, 1, fp_in);  // 讀取一整行數據（包括填充位元組）
+        if (palettized) {
+            // 同一張直方圖建立不同大小的調色盤，像素經由對照表查出索引
+            Palette pal;
+            paletteMedianCut(&hist, 1 << bits, &pal);
+            paletteStore(&pal, out[opened].palette);
+            paletteMapBuild(&pal, &maps[opened]);
+            if (paletteQuantizerInit(&quantizers[opened], &maps[opened], dither, bits, width) != 0) {
+                bmpClose(&out[opened]);
+                ok = 0;
+                break;
+            }
+        } else {
+            // 量化每個通道（RGBA 也量化 Alpha 通道）：預先建立查找表，逐像素不需要整數除法
+            lutIdentity(&luts[opened]);
+            lutQuantize(&luts[opened], bits);
+        }
+    }
 
-            for (int j = 0; j < width; j++) {
-                if (isRGBA) {
-                    RGBA* pixel = (RGBA*)&rowBuffer[j * sizeof(RGBA)];
-                    quantizeColorRGBA(pixel, bits);  // 量化 RGBA 像素
+    // 逐條帶處理：每條帶的輸入讀入快取後依序寫到所有輸出，不需要再 rewind/fseek 重新讀取
+    if (ok) {
+        bmpAdviseSequential(&in);
+        for (int y = 0; y < height; y += STRIP_ROWS) {
+            int rows = height - y < STRIP_ROWS ? height - y : STRIP_ROWS;
+            ImageView strip = imageSubView(&in.view, 0, y, width, rows);
+            for (int i = 0; i < count; i++) {
+                ImageView dst = imageSubView(&out[i].view, 0, y, width, rows);
+                if (palettized) {
+                    paletteQuantizeRows(&quantizers[i], &strip, &dst);
                 } else {
-                    RGBTRIPLE* pixel = (RGBTRIPLE*)&rowBuffer[j * sizeof(RGBTRIPLE)];
-                    quantizeColorRGB(pixel, bits);  // 量化 RGB 像素
+                    lutApply(&luts[i], &strip, &dst);
                 }
             }
-
-            fwrite(rowBuffer, rowSize, 1, fp_out);  // 寫入處理後的一行數據
         }
+    }
+
+    for (int i = 0; i < opened; i++) {
+        if (palettized) paletteQuantizerFree(&quantizers[i]);
+        bmpClose(&out[i]);
+    }
+    if (palettized) colorHistogramFree(&hist);
+    bmpClose(&in);
+    if (ok) printf("Processing completed for %s\n", inputFileName);
+}
 
-        fclose(fp_out);
-        rewind(fp_in);  // 重置 fp_in 以重新讀取檔案
-        fseek(fp_in, sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER), SEEK_SET);  // 跳過文件頭和資訊頭
+// 改變解析度：將輸入縮放成 width x height 後輸出
+void resizeBMP(const char* inputFileName, const char* outputFileName, int width, int height, ResizeFilter filter) {
+    BMPFile in;
+    if (bmpOpen(inputFileName, &in) != 0) {
+        printf("Failed to open input BMP file: %s\n", inputFileName);
+        return;
+    }
+
+    BMPFile out;
+    if (bmpCreate(outputFileName, in.header, width, height, in.header->bitCount, &out) != 0) {
+        printf("Failed to open output BMP file: %s\n", outputFileName);
+        bmpClose(&in);
+        return;
     }
 
-    free(rowBuffer);  // 釋放分配的記憶體
-    fclose(fp_in);
-    printf("Processing completed for %s\n", inputFileName);
+    // 輸入輸出的行都是由下往上存放，縮放與行的順序無關，可以直接對兩個視圖縮放
+    bmpAdviseSequential(&in);
+    int result = resizeImage(&in.view, &out.view, filter);
+
+    bmpClose(&out);
+    bmpClose(&in);
+    if (result != 0) {
+        printf("Failed to resize %s\n", inputFileName);
+        return;
+    }
+    printf("Image resized to %dx%d and saved as %s\n", width, height, outputFileName);
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // --resize WxH：改變解析度而不量化；--filter：nearest、bilinear、area（預設）或 lanczos；
+    // --input FILE / --output FILE：輸入與縮放後的輸出文件
+    // --palette：改為輸出 8 位元與 4 位元的調色盤 BMP；--dither：none（預設）、ordered 或 diffusion
+    const char* inputFileName = "input1.bmp";
+    const char* outputFileName = "output1_resized.bmp";
+    const char* size = NULL;
+    ResizeFilter filter = RESIZE_AREA;
+    DitherMode dither = DITHER_NONE;
+    int palettized = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--palette") == 0) {
+            palettized = 1;
+            continue;
+        }
+        if (i + 1 >= argc) break;
+        if (strcmp(argv[i], "--resize") == 0) {
+            size = argv[++i];
+        } else if (strcmp(argv[i], "--filter") == 0) {
+            if (resizeParseFilter(argv[++i], &filter) != 0) return 1;
+        } else if (strcmp(argv[i], "--dither") == 0) {
+            if (ditherParse(argv[++i], &dither) != 0) return 1;
+        } else if (strcmp(argv[i], "--input") == 0) {
+            inputFileName = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0) {
+            outputFileName = argv[++i];
+        }
+    }
+
+    if (size) {
+        int width, height;
+        if (sscanf(size, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+            printf("Invalid size: %s (expected WIDTHxHEIGHT)\n", size);
+            return 1;
+        }
+        resizeBMP(inputFileName, outputFileName, width, height, filter);
+        return 0;
+    }
+
     // 處理 input1.bmp (RGB 3*8bits)
-    processBMP("input1.bmp", "output1");
+    processBMP(inputFileName, "output1", palettized, dither);
 
     return 0;
 }
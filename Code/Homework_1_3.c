@@ -1,118 +1,187 @@
 #include <stdio.h>
 #include <stdlib.h>
-
-#pragma pack(1)
-
-// BMP文件頭結構
-typedef struct {
-    unsigned short bfType;
-    unsigned int bfSize;
-    unsigned short bfReserved1;
-    unsigned short bfReserved2;
-    unsigned int bfOffBits;
-} BITMAPFILEHEADER;
-
-// BMP資訊頭結構
-typedef struct {
-    unsigned int biSize;
-    int biWidth;
-    int biHeight;
-    unsigned short biPlanes;
-    unsigned short biBitCount;
-    unsigned int biCompression;
-    unsigned int biSizeImage;
-    int biXPelsPerMeter;
-    int biYPelsPerMeter;
-    unsigned int biClrUsed;
-    unsigned int biClrImportant;
-} BITMAPINFOHEADER;
-
-// RGB 像素結構
-typedef struct {
-    unsigned char rgbtBlue;
-    unsigned char rgbtGreen;
-    unsigned char rgbtRed;
-} RGBTRIPLE;
-
-// RGBA 像素結構
-typedef struct {
-    unsigned char rgbtBlue;
-    unsigned char rgbtGreen;
-    unsigned char rgbtRed;
-    unsigned char rgbtAlpha;
-} RGBA;
+#include <string.h>
+#include "bmp_io.h"
 
 // 圖片裁剪函式
 void cropImage(const char* inputFileName, const char* outputFileName, int startX, int startY, int cropWidth, int cropHeight) {
-    FILE *fp_in = fopen(inputFileName, "rb");
-    if (!fp_in) {
+    BMPFile in;
+    if (bmpOpen(inputFileName, &in) != 0) {
         printf("Failed to open input BMP file: %s\n", inputFileName);
         return;
     }
 
-    // 讀取文件頭和資訊頭
-    BITMAPFILEHEADER fileHeader;
-    BITMAPINFOHEADER infoHeader;
-    fread(&fileHeader, sizeof(BITMAPFILEHEADER), 1, fp_in);
-    fread(&infoHeader, sizeof(BITMAPINFOHEADER), 1, fp_in);
-
-    int originalWidth = infoHeader.biWidth;
-    int originalHeight = infoHeader.biHeight;
-    int isRGBA = (infoHeader.biBitCount == 32); // 判斷是否為 RGBA
-
     // 檢查裁剪區域是否有效
-    if (startX < 0 || startY < 0 || startX + cropWidth > originalWidth || startY + cropHeight > originalHeight) {
+    ImageView roi;
+    if (imageRegion(&in.view, startX, startY, cropWidth, cropHeight, &roi) != 0) {
         printf("Invalid cropping region.\n");
-        fclose(fp_in);
+        bmpClose(&in);
         return;
     }
 
-    // 調整文件頭和資訊頭，更新寬度和高度為裁剪後的尺寸
-    infoHeader.biWidth = cropWidth;
-    infoHeader.biHeight = cropHeight;
-    infoHeader.biSizeImage = cropWidth * cropHeight * (infoHeader.biBitCount / 8);
-    fileHeader.bfSize = fileHeader.bfOffBits + infoHeader.biSizeImage;
-
-    FILE *fp_out = fopen(outputFileName, "wb");
-    if (!fp_out) {
+    // 以裁剪後的尺寸建立輸出文件，標頭中的寬度、高度與檔案大小由 bmpCreate 計算
+    BMPFile out;
+    if (bmpCreate(outputFileName, in.header, cropWidth, cropHeight, in.header->bitCount, &out) != 0) {
         printf("Failed to open output BMP file: %s\n", outputFileName);
-        fclose(fp_in);
+        bmpClose(&in);
         return;
     }
 
-    // 將更新後的文件頭和資訊頭寫入輸出文件
-    fwrite(&fileHeader, sizeof(BITMAPFILEHEADER), 1, fp_out);
-    fwrite(&infoHeader, sizeof(BITMAPINFOHEADER), 1, fp_out);
+    // 裁剪區域是指向輸入映射區的視圖（不複製），逐行複製到輸出，輸出行尾的填充位元組已由 bmpCreate 補 0
+    imageCopy(&roi, &out.view);
 
-    // 計算每行像素的位元組數
-    int rowSize = (originalWidth * (infoHeader.biBitCount / 8) + 3) & ~3; // 原始圖片每行像素的位元組數 (4 位元組對齊)
-    int croppedRowSize = (cropWidth * (infoHeader.biBitCount / 8) + 3) & ~3; // 裁剪後每行像素的位元組數
+    bmpClose(&in);
+    bmpClose(&out);
+    printf("Image cropping completed and saved as %s\n", outputFileName);
+}
 
-    // 定位到裁剪起始行
-    fseek(fp_in, fileHeader.bfOffBits + startY * rowSize + startX * (infoHeader.biBitCount / 8), SEEK_SET);
+#define MAX_NAME 256
 
-    // 逐行讀取裁剪區域的像素並寫入輸出文件
-    for (int i = 0; i < cropHeight; i++) {
-        if (isRGBA) {
-            RGBA* row = (RGBA*)malloc(cropWidth * sizeof(RGBA));
-            fread(row, sizeof(RGBA), cropWidth, fp_in);
-            fwrite(row, sizeof(RGBA), cropWidth, fp_out);
-            free(row);  // 釋放記憶體
+// 批次裁剪的一個區域
+typedef struct {
+    int x, y, width, height;
+    char output[MAX_NAME];
+    BMPFile file;           // 掃描到這個區域時才建立的輸出文件
+} CropRegion;
+
+static int compareStartRow(const void* a, const void* b) {
+    const CropRegion* ra = *(const CropRegion* const*)a;
+    const CropRegion* rb = *(const CropRegion* const*)b;
+    return (ra->y > rb->y) - (ra->y < rb->y);
+}
+
+// 讀取區域清單：每行為 "x y width height [輸出檔名]"，空行與 # 開頭的行會被略過，
+// 沒有指定檔名時命名為 output1_crop_<編號>.bmp，編號為區域在清單中的順序（從 0 開始）
+// 成功傳回區域數並設定 *regions（需由呼叫者 free），無法讀取時傳回 -1
+static int readRegions(const char* listFileName, CropRegion** regions) {
+    FILE* list = fopen(listFileName, "r");
+    if (!list) {
+        printf("Failed to open region list: %s\n", listFileName);
+        return -1;
+    }
+    int count = 0, capacity = 64;
+    CropRegion* result = (CropRegion*)malloc(capacity * sizeof(CropRegion));
+    char line[512];
+    while (result && fgets(line, sizeof(line), list)) {
+        char name[MAX_NAME] = "";
+        CropRegion r;
+        if (line[0] == '#' || sscanf(line, "%d %d %d %d %255s", &r.x, &r.y, &r.width, &r.height, name) < 4) continue;
+        if (name[0]) {
+            strcpy(r.output, name);
         } else {
-            RGBTRIPLE* row = (RGBTRIPLE*)malloc(cropWidth * sizeof(RGBTRIPLE));
-            fread(row, sizeof(RGBTRIPLE), cropWidth, fp_in);
-            fwrite(row, sizeof(RGBTRIPLE), cropWidth, fp_out);
-            free(row);  // 釋放記憶體
+            snprintf(r.output, MAX_NAME, "output1_crop_%d.bmp", count);
         }
-        fseek(fp_in, rowSize - cropWidth * (infoHeader.biBitCount / 8), SEEK_CUR); // 跳過行尾的填充位元組
+        if (count == capacity) {
+            CropRegion* grown = (CropRegion*)realloc(result, 2 * capacity * sizeof(CropRegion));
+            if (!grown) {
+                free(result);
+                result = NULL;
+                break;
+            }
+            result = grown;
+            capacity *= 2;
+        }
+        result[count++] = r;
+    }
+    fclose(list);
+    if (!result) {
+        printf("Out of memory while reading region list.\n");
+        return -1;
     }
+    *regions = result;
+    return count;
+}
 
-    fclose(fp_in);
-    fclose(fp_out);
-    printf("Image cropping completed and saved as %s\n", outputFileName);
+// 批次裁剪：輸入只開啟一次，依儲存順序逐行掃過，每一行複製到所有包含這一行的區域
+// 區域在掃到第一行時才建立輸出文件，最後一行複製完就關閉，同時開啟的文件數只有互相重疊的區域數
+// 傳回成功寫出的區域數，無法開啟輸入時傳回 -1
+int cropBatch(const char* inputFileName, CropRegion* regions, int count) {
+    BMPFile in;
+    if (bmpOpen(inputFileName, &in) != 0) {
+        printf("Failed to open input BMP file: %s\n", inputFileName);
+        return -1;
+    }
+    bmpAdviseSequential(&in);
+
+    // 略過無效的區域，其餘依起始行排序
+    CropRegion** order = (CropRegion**)malloc((count + 1) * sizeof(CropRegion*));
+    CropRegion** active = (CropRegion**)malloc((count + 1) * sizeof(CropRegion*));
+    if (!order || !active) {
+        printf("Out of memory.\n");
+        free(order);
+        free(active);
+        bmpClose(&in);
+        return -1;
+    }
+    int valid = 0;
+    for (int i = 0; i < count; i++) {
+        ImageView roi;
+        if (imageRegion(&in.view, regions[i].x, regions[i].y, regions[i].width, regions[i].height, &roi) != 0) {
+            printf("Invalid cropping region for %s, skipped.\n", regions[i].output);
+            continue;
+        }
+        order[valid++] = &regions[i];
+    }
+    qsort(order, valid, sizeof(CropRegion*), compareStartRow);
+
+    int next = 0, activeCount = 0, written = 0;
+    size_t bytesPerPixel = in.view.channels;
+    for (int y = 0; y < in.view.height && (next < valid || activeCount > 0); y++) {
+        // 從這一行開始的區域：建立輸出文件
+        for (; next < valid && order[next]->y == y; next++) {
+            CropRegion* r = order[next];
+            if (bmpCreate(r->output, in.header, r->width, r->height, in.header->bitCount, &r->file) != 0) {
+                printf("Failed to open output BMP file: %s\n", r->output);
+                continue;
+            }
+            active[activeCount++] = r;
+        }
+
+        // 把這一行複製到每個進行中的區域，已完成的區域關閉輸出並移出清單
+        const uint8_t* row = imageRow(&in.view, y);
+        int kept = 0;
+        for (int i = 0; i < activeCount; i++) {
+            CropRegion* r = active[i];
+            memcpy(imageRow(&r->file.view, y - r->y), row + r->x * bytesPerPixel, r->width * bytesPerPixel);
+            if (y == r->y + r->height - 1) {
+                bmpClose(&r->file);
+                written++;
+            } else {
+                active[kept++] = r;
+            }
+        }
+        activeCount = kept;
+    }
+
+    free(order);
+    free(active);
+    bmpClose(&in);
+    return written;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // --batch LIST：依區域清單一次裁剪多個區域；--input FILE：輸入文件（預設 input1.bmp）
+    const char* inputFileName = "input1.bmp";
+    const char* listFileName = NULL;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--batch") == 0) {
+            listFileName = argv[++i];
+        } else if (strcmp(argv[i], "--input") == 0) {
+            inputFileName = argv[++i];
+        }
+    }
+
+    if (listFileName) {
+        CropRegion* regions;
+        int count = readRegions(listFileName, &regions);
+        if (count < 0) return 1;
+        int written = cropBatch(inputFileName, regions, count);
+        free(regions);
+        if (written < 0) return 1;
+        printf("Batch cropping completed: %d of %d regions saved.\n", written, count);
+        return written == count ? 0 : 1;
+    }
+
     int startX, startY, cropWidth, cropHeight;
 
     // 輸入裁剪區域
@@ -120,7 +189,7 @@ int main() {
     scanf("%d %d %d %d", &startX, &startY, &cropWidth, &cropHeight);
 
     // 處理 input1.bmp (RGB 或 RGBA)，根據需求裁剪
-    cropImage("input1.bmp", "output1_cropped.bmp", startX, startY, cropWidth, cropHeight);
+    cropImage(inputFileName, "output1_cropped.bmp", startX, startY, cropWidth, cropHeight);
 
     return 0;
 }
@@ -1,81 +1,93 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
-#include <math.h> // 用於 pow 函數
+#include "bmp_io.h"
+#include "strip_stream.h"
+#include "point_ops.h"
+#include "thread_pool.h"
 
-// 定義 BMP 標頭的結構，並使用 #pragma pack 來防止編譯器對齊，確保正確讀取 BMP 標頭
-#pragma pack(push, 1)
-typedef struct {
-    uint16_t fileType;          // 檔案類型（應為 "BM" 表示 BMP 檔）
-    uint32_t fileSize;          // 檔案大小（包含標頭和圖像資料）
-    uint16_t reserved1;         // 保留欄位
-    uint16_t reserved2;         // 保留欄位
-    uint32_t offsetData;        // 圖像資料的偏移量
-    uint32_t size;              // DIB 標頭的大小
-    int32_t width;              // 圖像的寬度（以像素為單位）
-    int32_t height;             // 圖像的高度（以像素為單位）
-    uint16_t planes;            // 平面數（應為 1）
-    uint16_t bitCount;          // 每像素位元數（通常為 24 或 32）
-    uint32_t compression;       // 壓縮類型（0 表示不壓縮）
-    uint32_t sizeImage;         // 圖像資料大小
-    int32_t xPixelsPerMeter;    // X 方向解析度
-    int32_t yPixelsPerMeter;    // Y 方向解析度
-    uint32_t colorsUsed;        // 使用的顏色數
-    uint32_t colorsImportant;   // 重要的顏色數
-} BMPHeader;
-#pragma pack(pop)
+#define GAMMA_COUNT 2 // 同一張輸入產生的 gamma 校正結果數
 
 // gammaCorrection 函數，用於進行 gamma 校正
+// 輸入檔案只開啟一次，每一行讀入後依序以各 gamma 值的查找表寫入對應的輸出
 // inputFile：輸入 BMP 檔案的名稱
-// outputFile：輸出 BMP 檔案的名稱
-// gamma：gamma 值，控制亮度增強效果
-void gammaCorrection(const char* inputFile, const char* outputFile, float gamma) {
-    FILE *input = fopen(inputFile, "rb"); // 以二進位方式讀取輸入檔案
-    FILE *output = fopen(outputFile, "wb"); // 以二進位方式寫入輸出檔案
-
-    if (!input || !output) { // 確認檔案是否成功打開
+// outputFiles：輸出 BMP 檔案的名稱，與 gammas 一一對應
+// gammas：gamma 值，控制亮度增強效果
+// 成功傳回 0，失敗傳回 -1
+int gammaCorrection(const char* inputFile, const char* const* outputFiles, const float* gammas, int count) {
+    BMPFile input, outputs[GAMMA_COUNT];
+    ImageView views[GAMMA_COUNT];
+    PointLUT luts[GAMMA_COUNT];
+    if (bmpOpen(inputFile, &input) != 0) { // 以記憶體映射方式開啟輸入檔案
         fprintf(stderr, "無法開啟文件。\n");
-        return;
+        return -1;
     }
+    // 預先建立相同大小的輸出檔案並映射，BMP 標頭由 bmpCreate 寫入
+    for (int k = 0; k < count; k++) {
+        if (bmpCreate(outputFiles[k], input.header, input.view.width, input.view.height, input.header->bitCount, &outputs[k]) != 0) {
+            fprintf(stderr, "無法開啟文件。\n");
+            while (k-- > 0) bmpClose(&outputs[k]);
+            bmpClose(&input);
+            return -1;
+        }
+        views[k] = outputs[k].view;
 
-    BMPHeader header; // 建立 BMP 標頭結構實例
-    fread(&header, sizeof(BMPHeader), 1, input); // 從輸入檔案讀取 BMP 標頭
-    fwrite(&header, sizeof(BMPHeader), 1, output); // 將 BMP 標頭寫入輸出檔案
+        // gamma 曲線只有 256 種輸入，預先建立查找表，逐像素只需查表而不必呼叫 pow
+        lutIdentity(&luts[k]);
+        lutGamma(&luts[k], gammas[k]);
+    }
 
-    int rowPadded = (header.width * 3 + 3) & (~3); // 計算每行的填充位元數，以符合 BMP 的格式要求
-    uint8_t *pixelData = (uint8_t*)malloc(rowPadded); // 分配記憶體以儲存每行的像素資料
+    // 逐行處理影像像素資料，直接讀取輸入映射並寫入各輸出映射
+    lutApplyFanOut(luts, count, &input.view, views);
 
-    if (!pixelData) { // 檢查記憶體是否分配成功
-        fprintf(stderr, "記憶體分配失敗。\n");
-        fclose(input);
-        fclose(output);
-        return;
-    }
+    bmpClose(&input); // 關閉輸入檔案
+    for (int k = 0; k < count; k++) bmpClose(&outputs[k]); // 關閉輸出檔案
+    return 0;
+}
 
-    // 逐行處理影像像素資料
-    for (int i = 0; i < header.height; i++) {
-        fread(pixelData, 1, rowPadded, input); // 從輸入檔案讀取每行像素資料
+// 條帶模式的 gamma 校正核心（點運算不需要鄰域行）
+// 整行連同填充位元組一起處理，24/32 位元都適用（填充位元組的內容不影響影像）
+void gammaStrip(uint8_t* input, uint8_t* output, int width, int rows, int rowPadded, int channels, void* ctx) {
+    (void)width;
+    (void)channels;
+    lutApplyRow((const PointLUT*)ctx, input, output, rows * rowPadded, 1); // B、G、R 使用同一張表
+}
 
-        for (int j = 0; j < header.width * 3; j++) { // 對每個像素的 R、G、B 分量進行處理
-            float normalized = pixelData[j] / 255.0; // 將像素值標準化到 [0,1] 範圍
-            pixelData[j] = (uint8_t)(255 * pow(normalized, gamma)); // 根據 gamma 值調整亮度，並重新映射到 [0,255]
+// 依照 --strip-rows 選擇整張映射或條帶串流的方式進行 gamma 校正，兩者都只讀取輸入一次
+// 成功傳回 0，失敗傳回 -1
+int runGamma(const char* inputFile, const char* const* outputFiles, const float* gammas, int count, int stripRows) {
+    if (stripRows > 0) {
+        StripOptions options = { stripRows, 0 };
+        PointLUT luts[GAMMA_COUNT];
+        StripOutput outputs[GAMMA_COUNT];
+        for (int k = 0; k < count; k++) {
+            lutIdentity(&luts[k]);
+            lutGamma(&luts[k], gammas[k]);
+            outputs[k] = (StripOutput){ outputFiles[k], gammaStrip, &luts[k] };
         }
-
-        fwrite(pixelData, 1, rowPadded, output); // 將處理後的像素資料寫入輸出檔案
+        return streamBMPFanOut(inputFile, &options, outputs, count);
     }
-
-    free(pixelData); // 釋放記憶體
-    fclose(input); // 關閉輸入檔案
-    fclose(output); // 關閉輸出檔案
+    return gammaCorrection(inputFile, outputFiles, gammas, count);
 }
 
-int main() {
-    // 對 input1.bmp 進行 gamma 校正，gamma = 0.5 使影像變亮
-    gammaCorrection("input1.bmp", "output1_1.bmp", 0.5);
-    printf("Gamma 校正完成，輸出為 output1_1.bmp\n");
+int main(int argc, char* argv[]) {
+    // --strip-rows N：以每次 N 行的條帶處理影像，記憶體用量與圖像大小無關
+    // --threads N（或 -t N）：平行處理的執行緒數（預設為環境變數 DIP_THREADS，未設定時為 CPU 核心數）
+    threadPoolParseArgs(argc, argv);
+    int stripRows = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--strip-rows") == 0 && i + 1 < argc) {
+            stripRows = atoi(argv[++i]);
+        }
+    }
 
-    // 對 input1.bmp 再次進行 gamma 校正，gamma = 0.3 進一步增亮影像
-    gammaCorrection("input1.bmp", "output1_2.bmp", 0.3);
+    // 對 input1.bmp 進行 gamma 校正：gamma = 0.5 使影像變亮，gamma = 0.3 進一步增亮影像
+    // 兩個結果在同一次走訪中產生
+    const char* outputFiles[GAMMA_COUNT] = { "output1_1.bmp", "output1_2.bmp" };
+    const float gammas[GAMMA_COUNT] = { 0.5f, 0.3f };
+    if (runGamma("input1.bmp", outputFiles, gammas, GAMMA_COUNT, stripRows) != 0) return 1;
+    printf("Gamma 校正完成，輸出為 output1_1.bmp\n");
     printf("Gamma 校正完成，輸出為 output1_2.bmp\n");
 
     return 0;
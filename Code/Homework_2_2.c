@@ -1,28 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
-
-// BMP標頭結構
-#pragma pack(push, 1)
-typedef struct {
-    uint16_t fileType;          // 檔案類型（應為 "BM" 表示 BMP 檔案）
-    uint32_t fileSize;          // 檔案大小（包括標頭和圖像資料）
-    uint16_t reserved1;         // 保留欄位
-    uint16_t reserved2;         // 保留欄位
-    uint32_t offsetData;        // 圖像資料的偏移量
-    uint32_t size;              // DIB 標頭的大小
-    int32_t width;              // 圖像的寬度（以像素為單位）
-    int32_t height;             // 圖像的高度（以像素為單位）
-    uint16_t planes;            // 顏色平面數（應為 1）
-    uint16_t bitCount;          // 每像素位元數（通常為 24 或 32）
-    uint32_t compression;       // 壓縮類型（0 表示不壓縮）
-    uint32_t sizeImage;         // 圖像資料的大小
-    int32_t xPixelsPerMeter;    // X 方向解析度
-    int32_t yPixelsPerMeter;    // Y 方向解析度
-    uint32_t colorsUsed;        // 使用的顏色數
-    uint32_t colorsImportant;   // 重要的顏色數
-} BMPHeader;
-#pragma pack(pop)
+#include "bmp_io.h"
+#include "strip_stream.h"
+#include "convolution.h"
+#include "gaussian.h"
+#include "thread_pool.h"
 
 // 銳化濾波器（拉普拉斯濾波器），用於強化圖像邊緣
 int laplacianKernel[3][3] = {
@@ -31,100 +15,238 @@ int laplacianKernel[3][3] = {
     { 0, -1,  0 }
 };
 
+// 建立銳化核心
+// 銳化後的值為 原始值 + strength * 拉普拉斯響應，相當於以 (中心為 1 的單位核 + strength * 拉普拉斯核) 卷積
+// strength 為整數時結果與逐項計算完全相同
+void sharpenKernel(ConvKernel* kernel, float strength) {
+    float weights[9];
+    for (int ky = 0; ky < 3; ky++) {
+        for (int kx = 0; kx < 3; kx++) {
+            weights[ky * 3 + kx] = (ky == 1 && kx == 1) + strength * laplacianKernel[ky][kx];
+        }
+    }
+    convKernelInit(kernel, 3, 3, weights, 1.0f);
+}
+
 // 應用拉普拉斯濾波器進行影像銳化
 // imageData: 輸入圖像數據
 // outputData: 銳化後的輸出圖像數據
 // width: 圖像寬度
 // height: 圖像高度
 // rowPadded: 每行的實際位元組數（包含填充）
+// channels: 每像素的位元組數
 // strength: 銳化強度
-void applySharpening(uint8_t* imageData, uint8_t* outputData, int width, int height, int rowPadded, float strength) {
-    for (int y = 1; y < height - 1; y++) { // 跳過圖像邊界
-        for (int x = 1; x < width - 1; x++) {
-            for (int c = 0; c < 3; c++) { // 處理每個顏色通道 (B, G, R)
-                int sum = 0;
-                // 使用拉普拉斯核計算當前像素的銳化值
-                for (int ky = -1; ky <= 1; ky++) {
-                    for (int kx = -1; kx <= 1; kx++) {
-                        int pixelVal = imageData[(y + ky) * rowPadded + (x + kx) * 3 + c];
-                        sum += pixelVal * laplacianKernel[ky + 1][kx + 1];
-                    }
-                }
-                // 原始像素值
-                int originalVal = imageData[y * rowPadded + x * 3 + c];
-                // 銳化後的像素值，使用指定的銳化強度
-                int newVal = (int)(originalVal + strength * sum);
-                // 確保像素值在 [0, 255] 範圍內
-                outputData[y * rowPadded + x * 3 + c] = (newVal > 255) ? 255 : (newVal < 0) ? 0 : newVal;
-            }
-        }
-    }
+void applySharpening(uint8_t* imageData, uint8_t* outputData, int width, int height, int rowPadded, int channels, float strength) {
+    ConvKernel kernel;
+    sharpenKernel(&kernel, strength);
+
+    ImageView src = { imageData, width, height, channels, rowPadded };
+    ImageView dst = { outputData, width, height, channels, rowPadded };
+    convolve(&kernel, &src, &dst); // 跳過圖像邊界
 }
 
 // 主函數，用於讀取 BMP 圖像、應用銳化並輸出結果
 // inputFile: 輸入 BMP 檔案名稱
 // outputFile1: 第一組輸出的 BMP 檔案名稱
 // outputFile2: 第二組輸出的 BMP 檔案名稱
-void sharpenImage(const char* inputFile, const char* outputFile1, const char* outputFile2) {
-    FILE *input = fopen(inputFile, "rb"); // 以二進位方式打開輸入檔案
-    if (!input) {
+// border: 邊界方式，BORDER_NONE 時與作業 2 相同保留 1 像素的邊框不處理
+// 成功傳回 0，失敗傳回 -1
+int sharpenImage(const char* inputFile, const char* outputFile1, const char* outputFile2, const ImageBorder* border) {
+    BMPFile input;
+    if (bmpOpen(inputFile, &input) != 0) { // 以記憶體映射方式開啟輸入檔案
         fprintf(stderr, "無法開啟輸入文件。\n");
-        return;
+        return -1;
+    }
+    if (input.view.channels != 3) {
+        fprintf(stderr, "僅支持 24 位的 BMP 文件。\n");
+        bmpClose(&input);
+        return -1;
     }
 
-    BMPHeader header;
-    fread(&header, sizeof(BMPHeader), 1, input); // 讀取 BMP 標頭
-
-    int rowPadded = (header.width * 3 + 3) & (~3); // 計算行填充（4字節對齊）
-    uint8_t* imageData = (uint8_t*)malloc(rowPadded * header.height); // 分配記憶體存放輸入影像
-    uint8_t* outputData1 = (uint8_t*)malloc(rowPadded * header.height); // 用於存放第一組輸出影像
-    uint8_t* outputData2 = (uint8_t*)malloc(rowPadded * header.height); // 用於存放第二組輸出影像
+    int width = input.view.width;
+    int height = input.view.height;
+    int bitCount = input.header->bitCount;
 
-    if (!imageData || !outputData1 || !outputData2) { // 確認記憶體分配是否成功
-        fprintf(stderr, "記憶體分配失敗。\n");
-        fclose(input);
-        return;
+    // 預先建立兩個輸出檔案並映射，銳化結果直接寫入輸出檔案的像素陣列
+    BMPFile output1, output2;
+    if (bmpCreate(outputFile1, input.header, width, height, bitCount, &output1) != 0) {
+        fprintf(stderr, "無法開啟輸出文件。\n");
+        bmpClose(&input);
+        return -1;
+    }
+    if (bmpCreate(outputFile2, input.header, width, height, bitCount, &output2) != 0) {
+        fprintf(stderr, "無法開啟輸出文件。\n");
+        bmpClose(&output1);
+        bmpClose(&input);
+        return -1;
     }
 
-    fseek(input, header.offsetData, SEEK_SET); // 將指標移至圖像資料的起始位置
-    fread(imageData, 1, rowPadded * header.height, input); // 讀取圖像資料
-    fclose(input);
+    ConvKernel kernels[2];
+    sharpenKernel(&kernels[0], 1.0f);
+    sharpenKernel(&kernels[1], 2.0f);
+    int result;
+    if (border->mode != BORDER_NONE) {
+        // 補上影像外的鄰域後連同邊框一起銳化，所有像素都由卷積寫入
+        result = convolveBorder(&kernels[0], &input.view, &output1.view, border);
+        if (result == 0) result = convolveBorder(&kernels[1], &input.view, &output2.view, border);
+    } else {
+        // 只複製卷積不會寫入的 1 像素邊框，內部像素由銳化結果覆蓋
+        imageCopyBorder(&input.view, &output1.view, 1, 1);
+        imageCopyBorder(&input.view, &output2.view, 1, 1);
 
-    // 複製原始影像數據
-    for (int i = 0; i < rowPadded * header.height; i++) {
-        outputData1[i] = imageData[i];
-        outputData2[i] = imageData[i];
+        // 銳化強度 1.0 與 2.0 在同一次走訪中計算，每個鄰居只讀取一次
+        ImageView outputs[2] = { output1.view, output2.view };
+        result = convolveFanOut(kernels, 2, &input.view, outputs);
     }
 
-    // 應用不同強度的銳化濾波
-    applySharpening(imageData, outputData1, header.width, header.height, rowPadded, 1.0f); // 銳化強度為 1.0
-    applySharpening(imageData, outputData2, header.width, header.height, rowPadded, 2.0f); // 銳化強度為 2.0
+    // 解除映射並關閉檔案
+    bmpClose(&input);
+    bmpClose(&output1);
+    bmpClose(&output2);
+    return result;
+}
 
-    // 輸出影像
-    FILE *output1 = fopen(outputFile1, "wb"); // 開啟第一組輸出檔案
-    FILE *output2 = fopen(outputFile2, "wb"); // 開啟第二組輸出檔案
+// 條帶模式的銳化核心：3x3 拉普拉斯核上下各需要 1 行鄰域
+void sharpenStrip(uint8_t* input, uint8_t* output, int width, int rows, int rowPadded, int channels, void* ctx) {
+    applySharpening(input, output, width, rows, rowPadded, channels, *(float*)ctx);
+}
 
-    if (output1 && output2) { // 檢查輸出檔案是否成功打開
-        fwrite(&header, sizeof(BMPHeader), 1, output1); // 寫入 BMP 標頭到第一個檔案
-        fwrite(outputData1, 1, rowPadded * header.height, output1); // 寫入銳化後的數據
+// 條帶模式的卷積核心：上下各需要核心高度一半的鄰域
+void convolutionStrip(uint8_t* input, uint8_t* output, int width, int rows, int rowPadded, int channels, void* ctx) {
+    ImageView src = { input, width, rows, channels, rowPadded };
+    ImageView dst = { output, width, rows, channels, rowPadded };
+    convolve((const ConvKernel*)ctx, &src, &dst);
+}
 
-        fwrite(&header, sizeof(BMPHeader), 1, output2); // 寫入 BMP 標頭到第二個檔案
-        fwrite(outputData2, 1, rowPadded * header.height, output2); // 寫入銳化後的數據
-    } else {
+// 以任意卷積核心處理影像
+// inputFile: 輸入 BMP 檔案名稱
+// outputFile: 輸出 BMP 檔案名稱
+// kernel: 卷積核心
+// stripRows: 大於 0 時以條帶串流處理
+// border: 邊界方式（只用於整張映射）
+int convolveImage(const char* inputFile, const char* outputFile, const ConvKernel* kernel, int stripRows, const ImageBorder* border) {
+    if (stripRows > 0) {
+        StripOptions options = { stripRows, kernel->height / 2 };
+        return streamBMP(inputFile, outputFile, &options, convolutionStrip, (void*)kernel);
+    }
+
+    BMPFile input, output;
+    if (bmpOpen(inputFile, &input) != 0) {
+        fprintf(stderr, "無法開啟輸入文件。\n");
+        return -1;
+    }
+    if (bmpCreate(outputFile, input.header, input.view.width, input.view.height, input.header->bitCount, &output) != 0) {
         fprintf(stderr, "無法開啟輸出文件。\n");
+        bmpClose(&input);
+        return -1;
     }
+    if (border->mode == BORDER_NONE) {
+        imageCopyBorder(&input.view, &output.view, kernel->width / 2, kernel->height / 2); // 保留未處理的邊界像素
+    }
+    int result = convolveBorder(kernel, &input.view, &output.view, border);
+    bmpClose(&input);
+    bmpClose(&output);
+    return result;
+}
+
+// 以反銳化遮罩處理影像，遞迴高斯需要整欄的資料，只支援整張映射
+// inputFile: 輸入 BMP 檔案名稱
+// outputFile: 輸出 BMP 檔案名稱
+// params: 半徑、強度與門檻
+int unsharpImage(const char* inputFile, const char* outputFile, const UnsharpParams* params) {
+    BMPFile input, output;
+    if (bmpOpen(inputFile, &input) != 0) {
+        fprintf(stderr, "無法開啟輸入文件。\n");
+        return -1;
+    }
+    if (bmpCreate(outputFile, input.header, input.view.width, input.view.height, input.header->bitCount, &output) != 0) {
+        fprintf(stderr, "無法開啟輸出文件。\n");
+        bmpClose(&input);
+        return -1;
+    }
+    int result = unsharpMask(&input.view, &output.view, params); // 包含邊界的所有像素都會寫入
+    bmpClose(&input);
+    bmpClose(&output);
+    if (result != 0) remove(outputFile); // 參數不合法或記憶體不足時不留下未寫入的輸出檔
+    return result;
+}
 
-    // 釋放記憶體並關閉輸出檔案
-    free(imageData);
-    free(outputData1);
-    free(outputData2);
-    fclose(output1);
-    fclose(output2);
+// 解析 --unsharp 的參數 "RADIUS[,AMOUNT[,THRESHOLD]]"，強度預設 1.0、門檻預設 0
+// 成功傳回 0，格式錯誤時傳回 -1
+int parseUnsharp(const char* text, UnsharpParams* params) {
+    params->amount = 1.0;
+    params->threshold = 0;
+    if (sscanf(text, "%lf,%lf,%d", &params->radius, &params->amount, &params->threshold) < 1) {
+        fprintf(stderr, "無效的反銳化遮罩參數 %s（格式為 RADIUS[,AMOUNT[,THRESHOLD]]）。\n", text);
+        return -1;
+    }
+    return 0;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // --strip-rows N：以每次 N 行的條帶處理影像，記憶體用量與圖像大小無關
+    // --kernel SPEC：改以指定的卷積核心處理 input2.bmp，輸出為 output2_conv.bmp
+    //                SPEC 可為 box3、gauss5、sobel-x 等預設名稱，或 "3x3:1,2,1,2,4,2,1,2,1/16" 的形式
+    // --unsharp R[,A[,T]]：改以半徑 R、強度 A（預設 1.0）、門檻 T（預設 0）的反銳化遮罩處理 input2.bmp，
+    //                     輸出為 output2_unsharp.bmp；以遞迴高斯模糊，計算量與半徑無關
+    // --border MODE：邊界像素的處理方式，none（預設，與作業相同保留邊框）、replicate、reflect 或 constant[:V]
+    // --threads N（或 -t N）：平行處理的執行緒數（預設為環境變數 DIP_THREADS，未設定時為 CPU 核心數）
+    threadPoolParseArgs(argc, argv);
+    int stripRows = 0;
+    const char* kernelSpec = NULL;
+    ImageBorder border = { BORDER_NONE, 0 };
+    const char* unsharpSpec = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--strip-rows") == 0 && i + 1 < argc) {
+            stripRows = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            kernelSpec = argv[++i];
+        } else if (strcmp(argv[i], "--unsharp") == 0 && i + 1 < argc) {
+            unsharpSpec = argv[++i];
+        } else if (strcmp(argv[i], "--border") == 0 && i + 1 < argc) {
+            if (imageParseBorder(argv[++i], &border) != 0) return 1;
+        }
+    }
+    if (stripRows > 0 && border.mode != BORDER_NONE) {
+        fprintf(stderr, "條帶模式不支援 --border。\n");
+        return 1;
+    }
+
+    if (unsharpSpec) {
+        UnsharpParams params;
+        if (stripRows > 0) {
+            fprintf(stderr, "條帶模式不支援 --unsharp。\n");
+            return 1;
+        }
+        if (parseUnsharp(unsharpSpec, &params) != 0 || unsharpImage("input2.bmp", "output2_unsharp.bmp", &params) != 0) {
+            return 1;
+        }
+        printf("反銳化遮罩完成，輸出為 output2_unsharp.bmp\n");
+        return 0;
+    }
+
+    if (kernelSpec) {
+        ConvKernel kernel;
+        if (convKernelParse(&kernel, kernelSpec) != 0 ||
+            convolveImage("input2.bmp", "output2_conv.bmp", &kernel, stripRows, &border) != 0) {
+            return 1;
+        }
+        printf("卷積完成，輸出為 output2_conv.bmp\n");
+        return 0;
+    }
+
     // 使用不同的銳化強度來生成兩組輸出
-    sharpenImage("input2.bmp", "output2_1.bmp", "output2_2.bmp");
+    if (stripRows > 0) {
+        StripOptions options = { stripRows, 1 };
+        float strength1 = 1.0f, strength2 = 2.0f;
+        StripOutput outputs[2] = {
+            { "output2_1.bmp", sharpenStrip, &strength1 },
+            { "output2_2.bmp", sharpenStrip, &strength2 }
+        };
+        if (streamBMPFanOut("input2.bmp", &options, outputs, 2) != 0) return 1;
+    } else if (sharpenImage("input2.bmp", "output2_1.bmp", "output2_2.bmp", &border) != 0) {
+        return 1;
+    }
     printf("銳化增強完成，輸出為 output2_1.bmp 和 output2_2.bmp\n");
     return 0;
 }
@@ -1,68 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
-#include <math.h> // 用於 exp 函數
+#include "bmp_io.h"
+#include "strip_stream.h"
+#include "median_filter.h"
+#include "bilateral_filter.h"
+#include "guided_filter.h"
+#include "nlm_filter.h"
+#include "thread_pool.h"
 
-// BMP 標頭結構，用於讀取和寫入 BMP 圖片的頭部資訊
-#pragma pack(push, 1)
-typedef struct {
-    uint16_t fileType;          // 檔案類型（應為 "BM" 表示 BMP 檔案）
-    uint32_t fileSize;          // 檔案大小（包括標頭和圖像資料）
-    uint16_t reserved1;         // 保留欄位
-    uint16_t reserved2;         // 保留欄位
-    uint32_t offsetData;        // 圖像資料的偏移量
-    uint32_t size;              // DIB 標頭的大小
-    int32_t width;              // 圖像的寬度（以像素為單位）
-    int32_t height;             // 圖像的高度（以像素為單位）
-    uint16_t planes;            // 顏色平面數（應為 1）
-    uint16_t bitCount;          // 每像素位元數（通常為 24 或 32）
-    uint32_t compression;       // 壓縮類型（0 表示不壓縮）
-    uint32_t sizeImage;         // 圖像資料的大小
-    int32_t xPixelsPerMeter;    // X 方向解析度
-    int32_t yPixelsPerMeter;    // Y 方向解析度
-    uint32_t colorsUsed;        // 使用的顏色數
-    uint32_t colorsImportant;   // 重要的顏色數
-} BMPHeader;
-#pragma pack(pop)
-
-// 讀取 BMP 檔案並返回圖像數據
-// filename: 要讀取的 BMP 檔案名稱
-// header: 存儲 BMP 標頭信息的指標
-// rowPadded: 用於存儲每行的實際位元組數（包含填充）
-uint8_t* readBMP(const char* filename, BMPHeader* header, int* rowPadded) {
-    FILE* file = fopen(filename, "rb"); // 以二進位方式打開輸入檔案
-    if (!file) {
-        fprintf(stderr, "無法開啟輸入文件 %s。\n", filename);
-        exit(1);
-    }
-
-    fread(header, sizeof(BMPHeader), 1, file); // 讀取 BMP 標頭
-    *rowPadded = (header->width * 3 + 3) & (~3); // 計算每行填充位元數，以符合 BMP 格式要求（4字節對齊）
-
-    uint8_t* imageData = (uint8_t*)malloc(*rowPadded * header->height); // 分配記憶體來存放圖像數據
-    fseek(file, header->offsetData, SEEK_SET); // 將檔案指標移到圖像數據的起始位置
-    fread(imageData, 1, *rowPadded * header->height, file); // 讀取圖像數據
-    fclose(file); // 關閉檔案
-
-    return imageData;
-}
-
-// 寫入 BMP 檔案
-// filename: 要寫入的 BMP 檔案名稱
-// header: BMP 標頭信息
-// imageData: 要寫入的圖像數據
-// rowPadded: 每行的實際位元組數（包含填充）
-void writeBMP(const char* filename, BMPHeader* header, uint8_t* imageData, int rowPadded) {
-    FILE* file = fopen(filename, "wb"); // 以二進位方式打開輸出檔案
-    if (!file) {
-        fprintf(stderr, "無法開啟輸出文件 %s。\n", filename);
-        exit(1);
-    }
-
-    fwrite(header, sizeof(BMPHeader), 1, file); // 寫入 BMP 標頭
-    fwrite(imageData, 1, rowPadded * header->height, file); // 寫入圖像數據
-    fclose(file); // 關閉檔案
-}
+#define BILATERAL_RADIUS 3 // 雙邊濾波的窗口半徑 (7x7 窗口)
 
 // 中值濾波器，用於去除椒鹽雜訊
 // input: 原始圖像數據
@@ -70,31 +18,12 @@ void writeBMP(const char* filename, BMPHeader* header, uint8_t* imageData, int r
 // width: 圖像寬度
 // height: 圖像高度
 // rowPadded: 每行的實際位元組數（包含填充）
-void applyMedianFilter(uint8_t* input, uint8_t* output, int width, int height, int rowPadded) {
-    int window[9]; // 定義 3x3 窗口
-    for (int y = 1; y < height - 1; y++) { // 跳過圖像邊界
-        for (int x = 1; x < width - 1; x++) {
-            for (int c = 0; c < 3; c++) { // 對每個顏色通道 (B, G, R) 應用濾波
-                int k = 0;
-                for (int ky = -1; ky <= 1; ky++) {
-                    for (int kx = -1; kx <= 1; kx++) {
-                        window[k++] = input[(y + ky) * rowPadded + (x + kx) * 3 + c]; // 將像素值添加到窗口
-                    }
-                }
-                // 排序窗口中的值以獲得中位數
-                for (int i = 0; i < 9; i++) {
-                    for (int j = i + 1; j < 9; j++) {
-                        if (window[i] > window[j]) { // 交換順序
-                            int temp = window[i];
-                            window[i] = window[j];
-                            window[j] = temp;
-                        }
-                    }
-                }
-                output[y * rowPadded + x * 3 + c] = window[4]; // 使用中位數替換中心像素
-            }
-        }
-    }
+// channels: 每像素的位元組數
+// radius: 窗口半徑（1 為 3x3 窗口，2 為 5x5 窗口，依此類推）
+void applyMedianFilter(uint8_t* input, uint8_t* output, int width, int height, int rowPadded, int channels, int radius) {
+    ImageView src = { input, width, height, channels, rowPadded };
+    ImageView dst = { output, width, height, channels, rowPadded };
+    medianFilter(&src, &dst, radius); // 跳過圖像邊界，每像素的計算量與半徑無關
 }
 
 // 雙邊濾波器，用於平滑影像同時保護邊緣
@@ -103,67 +32,298 @@ void applyMedianFilter(uint8_t* input, uint8_t* output, int width, int height, i
 // width: 圖像寬度
 // height: 圖像高度
 // rowPadded: 每行的實際位元組數（包含填充）
+// channels: 每像素的位元組數
 // sigma_s: 控制空間距離的權重
 // sigma_r: 控制像素亮度差異的權重
-void applyBilateralFilter(uint8_t* input, uint8_t* output, int width, int height, int rowPadded, double sigma_s, double sigma_r) {
-    int kernelRadius = 3; // 定義窗口半徑為 3 (7x7 窗口)
-
-    for (int y = kernelRadius; y < height - kernelRadius; y++) {
-        for (int x = kernelRadius; x < width - kernelRadius; x++) {
-            for (int c = 0; c < 3; c++) { // 處理每個顏色通道
-                double filteredValue = 0.0;
-                double normalizationFactor = 0.0;
-
-                for (int ky = -kernelRadius; ky <= kernelRadius; ky++) {
-                    for (int kx = -kernelRadius; kx <= kernelRadius; kx++) {
-                        int neighborY = y + ky;
-                        int neighborX = x + kx;
-
-                        double spatialWeight = exp(-(kx * kx + ky * ky) / (2 * sigma_s * sigma_s)); // 空間距離的權重
-                        int posCenter = y * rowPadded + x * 3 + c;
-                        int posNeighbor = neighborY * rowPadded + neighborX * 3 + c;
-                        double intensityDifference = input[posCenter] - input[posNeighbor];
-                        double rangeWeight = exp(-(intensityDifference * intensityDifference) / (2 * sigma_r * sigma_r)); // 亮度差異的權重
-
-                        double weight = spatialWeight * rangeWeight; // 總權重
-                        filteredValue += input[posNeighbor] * weight; // 加權後的像素值
-                        normalizationFactor += weight; // 正規化因子
-                    }
-                }
-
-                filteredValue /= normalizationFactor; // 正規化結果
-                output[y * rowPadded + x * 3 + c] = (uint8_t)filteredValue; // 設定濾波後的像素值
+// mode: BILATERAL_EXACT 使用 7x7 窗口；BILATERAL_GRID 以雙邊網格近似，不受窗口大小限制
+void applyBilateralFilter(uint8_t* input, uint8_t* output, int width, int height, int rowPadded, int channels, double sigma_s, double sigma_r, BilateralMode mode) {
+    ImageView src = { input, width, height, channels, rowPadded };
+    ImageView dst = { output, width, height, channels, rowPadded };
+    if (mode == BILATERAL_GRID) {
+        bilateralGrid(&src, &dst, sigma_s, sigma_r);
+    } else {
+        bilateralFilter(&src, &dst, BILATERAL_RADIUS, sigma_s, sigma_r); // 定義窗口半徑為 3 (7x7 窗口)
+    }
+}
+
+// 雙邊濾波的參數
+typedef struct {
+    double sigma_s;
+    double sigma_r;
+    BilateralMode mode;
+} BilateralParams;
+
+// 條帶模式的中值濾波核心：上下各需要 radius 行鄰域
+void medianStrip(uint8_t* input, uint8_t* output, int width, int rows, int rowPadded, int channels, void* ctx) {
+    applyMedianFilter(input, output, width, rows, rowPadded, channels, *(int*)ctx);
+}
+
+// 條帶模式的雙邊濾波核心：上下各需要 BILATERAL_RADIUS 行（網格模式為 bilateralGridHalo）鄰域
+void bilateralStrip(uint8_t* input, uint8_t* output, int width, int rows, int rowPadded, int channels, void* ctx) {
+    BilateralParams* params = (BilateralParams*)ctx;
+    applyBilateralFilter(input, output, width, rows, rowPadded, channels, params->sigma_s, params->sigma_r, params->mode);
+}
+
+// 以導引濾波處理影像，每個條帶需要上下多算 r 行的係數，只支援整張映射
+// inputFile: 輸入 BMP 檔案名稱
+// guideFile: 導引影像的 BMP 檔案名稱（NULL 時以輸入影像本身導引）
+// outputFile: 輸出 BMP 檔案名稱
+// params: 半徑、epsilon 與快速版的縮小倍率
+int guidedImage(const char* inputFile, const char* guideFile, const char* outputFile, const GuidedParams* params) {
+    BMPFile input, guide, output;
+    if (bmpOpen(inputFile, &input) != 0) {
+        fprintf(stderr, "無法開啟輸入文件。\n");
+        return -1;
+    }
+    if (guideFile && bmpOpen(guideFile, &guide) != 0) {
+        fprintf(stderr, "無法開啟導引影像。\n");
+        bmpClose(&input);
+        return -1;
+    }
+    int result = -1;
+    if (bmpCreate(outputFile, input.header, input.view.width, input.view.height, input.header->bitCount, &output) != 0) {
+        fprintf(stderr, "無法開啟輸出文件。\n");
+    } else {
+        result = guidedFilter(guideFile ? &guide.view : NULL, &input.view, &output.view, params); // 包含邊界的所有像素都會寫入
+        bmpClose(&output);
+        if (result != 0) remove(outputFile); // 參數不合法或記憶體不足時不留下未寫入的輸出檔
+    }
+    if (guideFile) bmpClose(&guide);
+    bmpClose(&input);
+    return result;
+}
+
+// 解析 --guided 的參數 "RADIUS[,E[,S]]"：E 為要保留的邊緣亮度差（epsilon = E^2，預設 25），S 為快速版的縮小倍率（預設 1）
+// 成功傳回 0，格式錯誤時傳回 -1
+int parseGuided(const char* text, GuidedParams* params) {
+    double edge = 25.0;
+    params->subsample = 1;
+    if (sscanf(text, "%d,%lf,%d", &params->radius, &edge, &params->subsample) < 1) {
+        fprintf(stderr, "無效的導引濾波參數 %s（格式為 RADIUS[,E[,S]]）。\n", text);
+        return -1;
+    }
+    params->epsilon = edge * edge;
+    return 0;
+}
+
+// 以非局部平均去除雜訊，只支援整張映射（每個像素需要上下 S + f 行的鄰域）
+// inputFile: 輸入 BMP 檔案名稱
+// outputFile: 輸出 BMP 檔案名稱
+// params: 雜訊標準差、濾波強度、區塊與搜尋窗口半徑及是否只處理亮度
+int nlmImage(const char* inputFile, const char* outputFile, const NlmParams* params) {
+    BMPFile input, output;
+    if (bmpOpen(inputFile, &input) != 0) {
+        fprintf(stderr, "無法開啟輸入文件。\n");
+        return -1;
+    }
+    int result = -1;
+    if (bmpCreate(outputFile, input.header, input.view.width, input.view.height, input.header->bitCount, &output) != 0) {
+        fprintf(stderr, "無法開啟輸出文件。\n");
+    } else {
+        result = nlmFilter(&input.view, &output.view, params); // 包含邊界的所有像素都會寫入
+        bmpClose(&output);
+        if (result != 0) remove(outputFile); // 參數不合法或記憶體不足時不留下未寫入的輸出檔
+    }
+    bmpClose(&input);
+    return result;
+}
+
+// 解析 --nlm 的參數 "SIGMA[,F[,S]]"：F 為區塊半徑（預設 2），S 為搜尋窗口半徑（預設 7），濾波強度 h = 0.4 * SIGMA
+// 成功傳回 0，格式錯誤時傳回 -1
+int parseNlm(const char* text, NlmParams* params) {
+    params->patchRadius = 2;
+    params->searchRadius = 7;
+    if (sscanf(text, "%lf,%d,%d", &params->sigma, &params->patchRadius, &params->searchRadius) < 1 ||
+        !(params->sigma > 0.0 && params->sigma <= NLM_MAX_STRENGTH)) {
+        fprintf(stderr, "無效的非局部平均參數 %s（格式為 SIGMA[,F[,S]]，SIGMA 須介於 0 與 %g 之間）。\n", text, NLM_MAX_STRENGTH);
+        return -1;
+    }
+    params->h = 0.4 * params->sigma;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    // --strip-rows N：以每次 N 行的條帶處理影像，記憶體用量與圖像大小無關
+    // --median-radius R：中值濾波的窗口半徑（預設 1，即 3x3 窗口）
+    // --bilateral exact|grid：雙邊濾波使用 7x7 窗口的精確版（預設）或雙邊網格近似
+    // --border MODE：中值與精確版雙邊濾波的邊界處理方式，none（預設，與作業相同保留邊框）、replicate、reflect 或 constant[:V]
+    // --guided R[,E[,S]]：改以半徑 R 的導引濾波處理 input3.bmp，輸出為 output3_guided.bmp；亮度差遠小於 E（預設 25）的區域被平滑，
+    //                     S > 1 時在縮小 S 倍的影像上計算係數（快速版）；每像素的計算量與半徑無關
+    // --guide FILE：導引濾波改以 FILE（與 input3.bmp 大小相同）導引，例如以清晰的影像導引有雜訊的影像
+    // --nlm SIGMA[,F[,S]]：改以非局部平均去除標準差約 SIGMA 的雜訊，輸出為 output3_nlm.bmp；
+    //                      區塊半徑 F（預設 2）、搜尋窗口半徑 S（預設 7），每像素的計算量與區塊大小無關
+    // --nlm-luma：非局部平均只以亮度計算並平滑亮度，色度不變，計算量較少
+    // --threads N（或 -t N）：平行處理的執行緒數（預設為環境變數 DIP_THREADS，未設定時為 CPU 核心數）
+    threadPoolParseArgs(argc, argv);
+    int stripRows = 0;
+    int medianRadius = 1;
+    BilateralMode bilateralMode = BILATERAL_EXACT;
+    ImageBorder border = { BORDER_NONE, 0 };
+    const char* guidedSpec = NULL;
+    const char* guideFile = NULL;
+    const char* nlmSpec = NULL;
+    int nlmLuma = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--strip-rows") == 0 && i + 1 < argc) {
+            stripRows = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--median-radius") == 0 && i + 1 < argc) {
+            medianRadius = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bilateral") == 0 && i + 1 < argc) {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "grid") == 0) {
+                bilateralMode = BILATERAL_GRID;
+            } else if (strcmp(mode, "exact") == 0) {
+                bilateralMode = BILATERAL_EXACT;
+            } else {
+                fprintf(stderr, "未知的雙邊濾波模式 %s（可用 exact 或 grid）。\n", mode);
+                return 1;
             }
+        } else if (strcmp(argv[i], "--border") == 0 && i + 1 < argc) {
+            if (imageParseBorder(argv[++i], &border) != 0) return 1;
+        } else if (strcmp(argv[i], "--guided") == 0 && i + 1 < argc) {
+            guidedSpec = argv[++i];
+        } else if (strcmp(argv[i], "--guide") == 0 && i + 1 < argc) {
+            guideFile = argv[++i];
+        } else if (strcmp(argv[i], "--nlm") == 0 && i + 1 < argc) {
+            nlmSpec = argv[++i];
+        } else if (strcmp(argv[i], "--nlm-luma") == 0) {
+            nlmLuma = 1;
         }
     }
-}
+    if (medianRadius < 1 || medianRadius > MEDIAN_MAX_RADIUS) {
+        fprintf(stderr, "中值濾波半徑須介於 1 與 %d 之間。\n", MEDIAN_MAX_RADIUS);
+        return 1;
+    }
 
-int main() {
-    BMPHeader header;
-    int rowPadded;
-    uint8_t* inputImage = readBMP("input3.bmp", &header, &rowPadded);
+    if (stripRows > 0 && border.mode != BORDER_NONE) {
+        fprintf(stderr, "條帶模式不支援 --border。\n");
+        return 1;
+    }
 
-    uint8_t* outputImage1 = (uint8_t*)malloc(rowPadded * header.height); // 儲存中值濾波結果
-    uint8_t* outputImage2 = (uint8_t*)malloc(rowPadded * header.height); // 儲存雙邊濾波結果
-    
-    // 複製原始影像數據
-    for (int i = 0; i < rowPadded * header.height; i++) {
-        outputImage1[i] = inputImage[i];
-        outputImage2[i] = inputImage[i];
+    if (guidedSpec) {
+        GuidedParams params;
+        if (stripRows > 0) {
+            fprintf(stderr, "條帶模式不支援 --guided。\n");
+            return 1;
+        }
+        if (parseGuided(guidedSpec, &params) != 0 || guidedImage("input3.bmp", guideFile, "output3_guided.bmp", &params) != 0) {
+            return 1;
+        }
+        printf("導引濾波完成，輸出為 output3_guided.bmp\n");
+        return 0;
+    }
+    if (guideFile) {
+        fprintf(stderr, "--guide 須與 --guided 一起使用。\n");
+        return 1;
     }
 
-    // 應用中值濾波和雙邊濾波
-    applyMedianFilter(inputImage, outputImage1, header.width, header.height, rowPadded); // 中值濾波
-    applyBilateralFilter(inputImage, outputImage2, header.width, header.height, rowPadded, 45, 55); // 雙邊濾波
+    if (nlmSpec) {
+        NlmParams params;
+        if (stripRows > 0) {
+            fprintf(stderr, "條帶模式不支援 --nlm。\n");
+            return 1;
+        }
+        if (parseNlm(nlmSpec, &params) != 0) return 1;
+        params.lumaOnly = nlmLuma;
+        if (nlmImage("input3.bmp", "output3_nlm.bmp", &params) != 0) return 1;
+        printf("非局部平均去雜訊完成，輸出為 output3_nlm.bmp\n");
+        return 0;
+    }
+    if (nlmLuma) {
+        fprintf(stderr, "--nlm-luma 須與 --nlm 一起使用。\n");
+        return 1;
+    }
 
-    // 寫入結果影像
-    writeBMP("output3_1.bmp", &header, outputImage1, rowPadded);
-    writeBMP("output3_2.bmp", &header, outputImage2, rowPadded);
+    if (stripRows > 0) {
+        BilateralParams params = { 45, 55, bilateralMode };
+        StripOutput outputs[2] = {
+            { "output3_1.bmp", medianStrip, &medianRadius },    // 中值濾波
+            { "output3_2.bmp", bilateralStrip, &params }        // 雙邊濾波
+        };
+        if (bilateralMode == BILATERAL_EXACT) {
+            // 兩個濾波器都只處理視窗內部，以較大的鄰域讀入條帶後依序計算兩個輸出，輸入只讀取一次
+            StripOptions options = { stripRows, medianRadius > BILATERAL_RADIUS ? medianRadius : BILATERAL_RADIUS };
+            return streamBMPFanOut("input3.bmp", &options, outputs, 2) != 0;
+        }
+        // 雙邊網格的取樣格線從視窗的第一行開始，鄰域行數不同結果就會改變，因此分開串流
+        StripOptions medianOptions = { stripRows, medianRadius };
+        StripOptions bilateralOptions = { stripRows, bilateralGridHalo(params.sigma_s) };
+        if (streamBMPFanOut("input3.bmp", &medianOptions, &outputs[0], 1) != 0 ||
+            streamBMPFanOut("input3.bmp", &bilateralOptions, &outputs[1], 1) != 0) {
+            return 1;
+        }
+        return 0;
+    }
+
+    BMPFile input;
+    if (bmpOpen("input3.bmp", &input) != 0) { // 以記憶體映射方式讀取輸入影像
+        return 1;
+    }
+    if (input.view.channels != 3) {
+        fprintf(stderr, "僅支持 24 位的 BMP 文件。\n");
+        bmpClose(&input);
+        return 1;
+    }
+
+    int width = input.view.width;
+    int height = input.view.height;
+    int bitCount = input.header->bitCount;
+
+    // 預先建立輸出檔案並映射，濾波結果直接寫入輸出檔案
+    BMPFile output1, output2;
+    if (bmpCreate("output3_1.bmp", input.header, width, height, bitCount, &output1) != 0) { // 儲存中值濾波結果
+        bmpClose(&input);
+        return 1;
+    }
+    if (bmpCreate("output3_2.bmp", input.header, width, height, bitCount, &output2) != 0) { // 儲存雙邊濾波結果
+        bmpClose(&output1);
+        bmpClose(&input);
+        return 1;
+    }
+
+    if (border.mode != BORDER_NONE) {
+        // 補上影像外的鄰域後處理所有像素，不需要先複製邊框
+        medianFilterBorder(&input.view, &output1.view, medianRadius, &border); // 中值濾波
+        if (bilateralMode == BILATERAL_GRID) {
+            bilateralGrid(&input.view, &output2.view, 45, 55); // 雙邊網格本身就會處理邊界像素
+        } else {
+            bilateralFilterBorder(&input.view, &output2.view, BILATERAL_RADIUS, 45, 55, &border);
+        }
+        bmpClose(&input);
+        bmpClose(&output1);
+        bmpClose(&output2);
+        return 0;
+    }
+
+    // 只複製濾波器不會寫入的邊框，內部像素由濾波結果覆蓋
+    imageCopyBorder(&input.view, &output1.view, medianRadius, medianRadius);
+
+    if (bilateralMode == BILATERAL_GRID) {
+        // 雙邊網格會寫入所有像素，取樣本身就是一次完整的走訪，分開處理
+        medianFilter(&input.view, &output1.view, medianRadius); // 中值濾波
+        bilateralGrid(&input.view, &output2.view, 45, 55);      // 雙邊濾波
+    } else {
+        // 中值濾波與雙邊濾波在同一次走訪中計算：每個區塊載入快取後依序交給兩個濾波器
+        BilateralKernel bilateral;
+        if (bilateralKernelInit(&bilateral, BILATERAL_RADIUS, 45, 55) != 0) {
+            bmpClose(&input);
+            bmpClose(&output1);
+            bmpClose(&output2);
+            return 1;
+        }
+        imageCopyBorder(&input.view, &output2.view, BILATERAL_RADIUS, BILATERAL_RADIUS);
+        TileOutput outputs[2] = {
+            medianFilterOutput(&medianRadius, &output1.view),   // 中值濾波
+            bilateralFilterOutput(&bilateral, &output2.view)    // 雙邊濾波
+        };
+        parallelTilesFanOut(&input.view, outputs, 2);
+        bilateralKernelFree(&bilateral);
+    }
 
-    // 釋放記憶體
-    free(inputImage);
-    free(outputImage1);
-    free(outputImage2);
+    // 解除映射並關閉檔案
+    bmpClose(&input);
+    bmpClose(&output1);
+    bmpClose(&output2);
 
     return 0;
 }
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bmp_io.h"
+#include "color_ops.h"
+#include "thread_pool.h"
+
+// 將記憶體中的影像寫成 BMP 文件（僅在需要中間結果時使用）
+int saveBMP(const char* filename, const BMPHeader* templ, const ImageView* img) {
+    BMPFile output;
+    if (bmpCreate(filename, templ, img->width, img->height, 24, &output) != 0) {
+        printf("無法打開輸出文件 %s。\n", filename);
+        return -1;
+    }
+    imageCopy(img, &output.view);
+    bmpClose(&output);
+    return 0;
+}
+
+// 作業 3 的完整色彩處理流程：Grey World -> 飽和度 -> 伽瑪 -> 暖色 / 冷色
+// 原本由 Homework_3_1_Grey_world、Homework_3_2、Homework_3_3 三個程式透過 output1_1.bmp、output1_2.bmp 串接，
+// 這裡只解碼一次，所有步驟都在同一塊記憶體上就地處理，中間結果只在 --save-intermediate 時寫出
+int main(int argc, char* argv[]) {
+    // --threads N（或 -t N）：平行處理的執行緒數（預設為環境變數 DIP_THREADS，未設定時為 CPU 核心數）
+    threadPoolParseArgs(argc, argv);
+    const char* inputFile = "input1.bmp";
+    int saveIntermediate = 0;
+    int sampleStep = 1; // --wb-step N：白平衡估計平均值時每 N 行、N 個像素取樣一次
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            inputFile = argv[++i];
+        } else if (strcmp(argv[i], "--save-intermediate") == 0) {
+            saveIntermediate = 1;
+        } else if (strcmp(argv[i], "--wb-step") == 0 && i + 1 < argc) {
+            sampleStep = atoi(argv[++i]);
+            if (sampleStep < 1) sampleStep = 1;
+        }
+    }
+
+    // 私有映射：就地處理只會修改這個行程的副本，不會寫回輸入文件
+    BMPFile input;
+    if (bmpOpen(inputFile, &input) != 0) {
+        printf("無法打開輸入文件。\n");
+        return 1;
+    }
+    if (input.header->bitCount != 24) {
+        printf("僅支持 24 位的 BMP 文件。\n");
+        bmpClose(&input);
+        return 1;
+    }
+
+    ImageView* img = &input.view;
+    int width = img->width;
+    int height = img->height;
+
+    // 1. 色溫調整（Grey World）
+    applyGreyWorld(img, img, sampleStep);
+    if (saveIntermediate && saveBMP("output1_1.bmp", input.header, img) != 0) {
+        bmpClose(&input);
+        return 1;
+    }
+
+    // 2. 影像增強：提高飽和度（增加 1.5 倍）並應用伽瑪校正（gamma < 1 使影像變亮）
+    increaseSaturation(img, 1.5);
+    applyGammaCorrection(img, 0.6);
+    if (saveIntermediate && saveBMP("output1_2.bmp", input.header, img) != 0) {
+        bmpClose(&input);
+        return 1;
+    }
+
+    // 3. 暖色與冷色調整：直接由記憶體中的影像寫入輸出文件
+    BMPFile warmOutput, coolOutput;
+    if (bmpCreate("output1_3.bmp", input.header, width, height, 24, &warmOutput) != 0) {
+        printf("無法打開暖色輸出文件。\n");
+        bmpClose(&input);
+        return 1;
+    }
+    applyWarmEffect(img, &warmOutput.view, 30);
+    bmpClose(&warmOutput);
+
+    if (bmpCreate("output1_4.bmp", input.header, width, height, 24, &coolOutput) != 0) {
+        printf("無法打開冷色輸出文件。\n");
+        bmpClose(&input);
+        return 1;
+    }
+    applyCoolEffect(img, &coolOutput.view, 30);
+    bmpClose(&coolOutput);
+
+    bmpClose(&input);
+    printf("色彩處理流程完成，已保存輸出文件。\n");
+    return 0;
+}
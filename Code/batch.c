@@ -0,0 +1,591 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#endif
+#include "batch.h"
+#include "frame_pool.h"
+#include "trace.h"
+
+#define MAX_READ_CHUNK (1u << 30)   // 單一讀取要求的最大長度
+
+// ======= 記憶體內的 BMP =======
+
+int batchImageCreate(BatchImage* img, const BMPHeader* templ, int width, int height, int bitCount) {
+    memset(img, 0, sizeof(*img));
+    BMPHeader header;
+    bmpInitHeader(&header, templ, width, height, bitCount);
+    // 輸出緩衝區由共用的緩衝區池配置，批次中相同大小的影像重複使用；重複使用的內容要先清為 0
+    img->data = (uint8_t*)framePoolAcquire(framePoolShared(), header.fileSize, 64);
+    if (!img->data) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        return -1;
+    }
+    memset(img->data, 0, header.fileSize);
+    img->size = header.fileSize;
+    memcpy(img->data, &header, sizeof(BMPHeader));
+    if (bmpParse(img->data, img->size, &img->header, &img->view) != 0) {
+        batchImageFree(img);
+        return -1;
+    }
+    return 0;
+}
+
+void batchImageFree(BatchImage* img) {
+    framePoolRelease(framePoolShared(), img->data);
+    memset(img, 0, sizeof(*img));
+}
+
+// ======= 輸入清單 =======
+
+static int compareNames(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// 把路徑加入清單，容量不足時加倍
+static int appendPath(char*** files, int* count, int* capacity, const char* dir, const char* name) {
+    if (*count == *capacity) {
+        int grown = *capacity ? *capacity * 2 : 64;
+        char** list = (char**)realloc(*files, grown * sizeof(char*));
+        if (!list) return -1;
+        *files = list;
+        *capacity = grown;
+    }
+    size_t length = (dir ? strlen(dir) + 1 : 0) + strlen(name) + 1;
+    char* path = (char*)malloc(length);
+    if (!path) return -1;
+    if (dir) {
+        snprintf(path, length, "%s/%s", dir, name);
+    } else {
+        snprintf(path, length, "%s", name);
+    }
+    (*files)[(*count)++] = path;
+    return 0;
+}
+
+int batchListInputs(const char* path, char*** files) {
+    char** list = NULL;
+    int count = 0, capacity = 0, ok = 1;
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "無法開啟輸入 %s。\n", path);
+        return -1;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        DIR* dir = opendir(path);
+        if (!dir) {
+            fprintf(stderr, "無法開啟輸入目錄 %s。\n", path);
+            return -1;
+        }
+        struct dirent* entry;
+        while (ok && (entry = readdir(dir)) != NULL) {
+            size_t length = strlen(entry->d_name);
+            if (length > 4 && strcasecmp(entry->d_name + length - 4, ".bmp") == 0) {
+                ok = appendPath(&list, &count, &capacity, path, entry->d_name) == 0;
+            }
+        }
+        closedir(dir);
+        if (count > 1) qsort(list, count, sizeof(char*), compareNames);
+    } else {
+        FILE* file = fopen(path, "r");
+        if (!file) {
+            fprintf(stderr, "無法開啟輸入清單 %s。\n", path);
+            return -1;
+        }
+        char line[4096];
+        while (ok && fgets(line, sizeof(line), file)) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '\0' || line[0] == '#') continue;
+            ok = appendPath(&list, &count, &capacity, NULL, line) == 0;
+        }
+        fclose(file);
+    }
+
+    if (!ok) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        batchFreeInputs(list, count);
+        return -1;
+    }
+    *files = list;
+    return count;
+}
+
+void batchFreeInputs(char** files, int count) {
+    for (int i = 0; i < count; i++) free(files[i]);
+    free(files);
+}
+
+// ======= 有界佇列 =======
+
+// 讀取執行緒、處理執行緒、寫入執行緒之間傳遞工作的佇列，滿了時 push 等待、空了時 pop 等待
+typedef struct {
+    void** items;
+    int capacity, head, count;
+    int closed;             // 不會再有新項目，pop 在佇列清空後傳回 NULL
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty, notFull;
+} Queue;
+
+static int queueInit(Queue* q, int capacity) {
+    memset(q, 0, sizeof(*q));
+    q->items = (void**)malloc(capacity * sizeof(void*));
+    if (!q->items) return -1;
+    q->capacity = capacity;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->notEmpty, NULL);
+    pthread_cond_init(&q->notFull, NULL);
+    return 0;
+}
+
+static void queueDestroy(Queue* q) {
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->notEmpty);
+    pthread_cond_destroy(&q->notFull);
+    free(q->items);
+}
+
+static void queuePush(Queue* q, void* item) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->capacity) pthread_cond_wait(&q->notFull, &q->lock);
+    q->items[(q->head + q->count++) % q->capacity] = item;
+    pthread_cond_signal(&q->notEmpty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static void* queuePop(Queue* q) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed) pthread_cond_wait(&q->notEmpty, &q->lock);
+    void* item = NULL;
+    if (q->count > 0) {
+        item = q->items[q->head];
+        q->head = (q->head + 1) % q->capacity;
+        q->count--;
+        pthread_cond_signal(&q->notFull);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return item;
+}
+
+static void queueClose(Queue* q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = 1;
+    pthread_cond_broadcast(&q->notEmpty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+// ======= io_uring =======
+//
+// 沒有 liburing 時直接以系統呼叫使用 io_uring：送出佇列（SQ）與完成佇列（CQ）都是與核心共用的環形緩衝區，
+// 填好 SQE 後移動 SQ 的尾端並呼叫 io_uring_enter，核心完成後把結果放進 CQ
+// 核心不支援（或被安全政策禁止）時 ringInit 失敗，改用 pread
+
+typedef struct {
+    int fd;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+#endif
+    void* sqMap;
+    size_t sqMapSize;
+    void* cqMap;
+    size_t cqMapSize;
+    size_t sqesSize;
+} Ring;
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+static int ringInit(Ring* ring, unsigned entries) {
+    struct io_uring_params p;
+    memset(ring, 0, sizeof(*ring));
+    memset(&p, 0, sizeof(p));
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (ring->fd < 0) return -1;
+
+    ring->sqMapSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cqMapSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    int single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && ring->cqMapSize > ring->sqMapSize) ring->sqMapSize = ring->cqMapSize;
+    ring->sqMap = mmap(NULL, ring->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->cqMap = single ? ring->sqMap
+                         : mmap(NULL, ring->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqMap == MAP_FAILED || ring->cqMap == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        if (ring->sqMap != MAP_FAILED) munmap(ring->sqMap, ring->sqMapSize);
+        if (!single && ring->cqMap != MAP_FAILED) munmap(ring->cqMap, ring->cqMapSize);
+        if (ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqesSize);
+        close(ring->fd);
+        memset(ring, 0, sizeof(*ring));
+        return -1;
+    }
+
+    uint8_t* sq = (uint8_t*)ring->sqMap;
+    uint8_t* cq = (uint8_t*)ring->cqMap;
+    ring->sqTail = (unsigned*)(sq + p.sq_off.tail);
+    ring->sqMask = (unsigned*)(sq + p.sq_off.ring_mask);
+    ring->sqArray = (unsigned*)(sq + p.sq_off.array);
+    ring->cqHead = (unsigned*)(cq + p.cq_off.head);
+    ring->cqTail = (unsigned*)(cq + p.cq_off.tail);
+    ring->cqMask = (unsigned*)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+static void ringFree(Ring* ring) {
+    munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqMap != ring->sqMap) munmap(ring->cqMap, ring->cqMapSize);
+    munmap(ring->sqMap, ring->sqMapSize);
+    close(ring->fd);
+}
+
+// 送出一個讀取要求，完成時以 userData 識別
+static int ringRead(Ring* ring, int fd, void* buf, unsigned length, uint64_t offset, void* userData) {
+    unsigned tail = *ring->sqTail;
+    unsigned index = tail & *ring->sqMask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->user_data = (uint64_t)(uintptr_t)userData;
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    return syscall(__NR_io_uring_enter, ring->fd, 1, 0, 0, NULL, 0) == 1 ? 0 : -1;
+}
+
+// 等待一個完成的要求，傳回其 userData 並將結果存入 *result
+static void* ringWait(Ring* ring, int* result) {
+    for (;;) {
+        unsigned head = *ring->cqHead;
+        if (head != __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cqMask];
+            void* userData = (void*)(uintptr_t)cqe->user_data;
+            *result = cqe->res;
+            __atomic_store_n(ring->cqHead, head + 1, __ATOMIC_RELEASE);
+            return userData;
+        }
+        if (syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR) {
+            *result = -errno;
+            return NULL;
+        }
+    }
+}
+#else
+static int ringInit(Ring* ring, unsigned entries) {
+    (void)entries;
+    memset(ring, 0, sizeof(*ring));
+    return -1;
+}
+
+static void ringFree(Ring* ring) {
+    (void)ring;
+}
+
+static int ringRead(Ring* ring, int fd, void* buf, unsigned length, uint64_t offset, void* userData) {
+    (void)ring; (void)fd; (void)buf; (void)length; (void)offset; (void)userData;
+    return -1;
+}
+
+static void* ringWait(Ring* ring, int* result) {
+    (void)ring;
+    *result = -1;
+    return NULL;
+}
+#endif
+
+// ======= 讀取執行緒 =======
+
+// 預先讀入的一個檔案
+typedef struct {
+    int index;              // 在清單中的位置
+    int fd;
+    BatchImage image;       // 讀入的檔案內容（標頭與視圖由處理執行緒解析）
+    size_t done;            // 已讀入的位元組數
+    int complete;           // 讀取結束（成功或失敗）
+    int error;
+} LoadItem;
+
+typedef struct {
+    char** files;
+    int count;
+    int prefetch;
+    Queue* loaded;          // 依清單順序交給處理執行緒
+    Ring ring;
+    int useRing;
+} Loader;
+
+static int readFully(int fd, uint8_t* buf, size_t n, off_t offset) {
+    while (n > 0) {
+        ssize_t got = pread(fd, buf, n, offset);
+        if (got <= 0) return -1;
+        buf += got;
+        n -= (size_t)got;
+        offset += got;
+    }
+    return 0;
+}
+
+static void finishLoad(LoadItem* item, int error) {
+    if (error) {
+        fprintf(stderr, "無法讀取輸入文件。\n");
+        item->error = -1;
+    }
+    if (item->fd >= 0) close(item->fd);
+    item->fd = -1;
+    item->complete = 1;
+}
+
+// 送出檔案尚未讀入部分的讀取要求
+static void submitRead(Loader* loader, LoadItem* item) {
+    size_t left = item->image.size - item->done;
+    unsigned length = left > MAX_READ_CHUNK ? MAX_READ_CHUNK : (unsigned)left;
+    if (ringRead(&loader->ring, item->fd, item->image.data + item->done, length, item->done, item) != 0) {
+        finishLoad(item, readFully(item->fd, item->image.data + item->done, left, (off_t)item->done));
+    }
+}
+
+// 開啟檔案並開始讀取；沒有 io_uring 時直接讀完
+static LoadItem* startLoad(Loader* loader, int index) {
+    LoadItem* item = (LoadItem*)calloc(1, sizeof(LoadItem));
+    if (!item) return NULL;
+    item->index = index;
+    item->fd = open(loader->files[index], O_RDONLY);
+    struct stat st;
+    if (item->fd < 0 || fstat(item->fd, &st) != 0 || st.st_size < (off_t)sizeof(BMPHeader) ||
+        !(item->image.data = (uint8_t*)framePoolAcquire(framePoolShared(), (size_t)st.st_size, 64))) {
+        fprintf(stderr, "無法開啟輸入文件 %s。\n", loader->files[index]);
+        item->error = -1;
+        finishLoad(item, 0);
+        return item;
+    }
+    item->image.size = (size_t)st.st_size;
+    posix_fadvise(item->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    if (loader->useRing) {
+        submitRead(loader, item);
+    } else {
+        finishLoad(item, readFully(item->fd, item->image.data, item->image.size, 0));
+    }
+    return item;
+}
+
+// 等待任一個讀取要求完成；讀到一部分時接著送出剩下的部分
+static void reapOne(Loader* loader) {
+    int result;
+    LoadItem* item = (LoadItem*)ringWait(&loader->ring, &result);
+    if (!item) {
+        // io_uring_enter 失敗：之後都改用 pread
+        loader->useRing = 0;
+        return;
+    }
+    if (result == -EINVAL && item->done == 0) {
+        // 核心太舊，不支援 IORING_OP_READ：之後都改用 pread
+        loader->useRing = 0;
+        finishLoad(item, readFully(item->fd, item->image.data, item->image.size, 0));
+    } else if (result <= 0) {
+        finishLoad(item, 1);
+    } else {
+        item->done += (size_t)result;
+        if (item->done < item->image.size) {
+            submitRead(loader, item);
+        } else {
+            finishLoad(item, 0);
+        }
+    }
+}
+
+// 讀取執行緒：同時保持最多 prefetch 個檔案在讀取中，依清單順序交給處理執行緒
+static void* loaderMain(void* arg) {
+    Loader* loader = (Loader*)arg;
+    LoadItem** pending = (LoadItem**)calloc(loader->prefetch, sizeof(LoadItem*));
+    int next = 0, head = 0, inflight = 0;
+    while (pending) {
+        while (inflight < loader->prefetch && next < loader->count) {
+            LoadItem* item = startLoad(loader, next++);
+            if (!item) break;
+            pending[(head + inflight++) % loader->prefetch] = item;
+        }
+        if (inflight == 0) break;
+
+        LoadItem* item = pending[head];
+        TRACE_BEGIN(span, "batch.read");
+        while (!item->complete) {
+            if (loader->useRing) {
+                reapOne(loader);
+            } else {
+                finishLoad(item, readFully(item->fd, item->image.data, item->image.size, 0));
+            }
+        }
+        TRACE_END(span, item->image.size, 0);
+        queuePush(loader->loaded, item);
+        head = (head + 1) % loader->prefetch;
+        inflight--;
+    }
+    free(pending);
+    queueClose(loader->loaded);
+    return NULL;
+}
+
+// ======= 寫入執行緒 =======
+
+typedef struct {
+    char* path;
+    BatchImage image;
+} WriteItem;
+
+typedef struct {
+    Queue* written;
+    int processed;
+    int failed;
+    uint64_t bytesWritten;
+} Writer;
+
+static void* writerMain(void* arg) {
+    Writer* writer = (Writer*)arg;
+    WriteItem* item;
+    while ((item = (WriteItem*)queuePop(writer->written)) != NULL) {
+        TRACE_BEGIN(span, "batch.write");
+        int fd = open(item->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        const uint8_t* p = item->image.data;
+        size_t left = item->image.size;
+        while (fd >= 0 && left > 0) {
+            ssize_t put = write(fd, p, left);
+            if (put <= 0) break;
+            p += put;
+            left -= (size_t)put;
+        }
+        if (fd < 0 || left > 0 || close(fd) != 0) {
+            fprintf(stderr, "無法寫入輸出文件 %s。\n", item->path);
+            writer->failed++;
+        } else {
+            writer->processed++;
+            writer->bytesWritten += item->image.size;
+        }
+        TRACE_END(span, item->image.size, 0);
+        batchImageFree(&item->image);
+        free(item->path);
+        free(item);
+    }
+    return NULL;
+}
+
+// ======= 批次處理 =======
+
+// 輸出路徑：輸出目錄加上輸入的檔名
+static char* outputPath(const char* outputDir, const char* input) {
+    const char* name = strrchr(input, '/');
+    name = name ? name + 1 : input;
+    size_t length = strlen(outputDir) + strlen(name) + 2;
+    char* path = (char*)malloc(length);
+    if (path) snprintf(path, length, "%s/%s", outputDir, name);
+    return path;
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int batchRun(char** files, int count, const char* outputDir, int prefetch, BatchKernel kernel, void* ctx, BatchStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    double start = now();
+    if (mkdir(outputDir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "無法建立輸出目錄 %s。\n", outputDir);
+        return -1;
+    }
+    if (prefetch < 1) prefetch = 1;
+
+    Queue loaded, written;
+    Loader loader = { files, count, prefetch, &loaded, { 0 }, 0 };
+    Writer writer = { &written, 0, 0, 0 };
+    if (queueInit(&loaded, 1) != 0) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        return -1;
+    }
+    if (queueInit(&written, prefetch) != 0) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        queueDestroy(&loaded);
+        return -1;
+    }
+    loader.useRing = ringInit(&loader.ring, (unsigned)prefetch) == 0;
+    stats->asyncIO = loader.useRing;
+
+    pthread_t loaderThread, writerThread;
+    if (pthread_create(&loaderThread, NULL, loaderMain, &loader) != 0) {
+        fprintf(stderr, "無法建立讀取執行緒。\n");
+        if (stats->asyncIO) ringFree(&loader.ring);
+        queueDestroy(&loaded);
+        queueDestroy(&written);
+        return -1;
+    }
+    if (pthread_create(&writerThread, NULL, writerMain, &writer) != 0) {
+        fprintf(stderr, "無法建立寫入執行緒。\n");
+        // 讀取執行緒仍會把所有檔案讀完，取出並丟棄後才能結束
+        LoadItem* item;
+        while ((item = (LoadItem*)queuePop(&loaded)) != NULL) {
+            batchImageFree(&item->image);
+            free(item);
+        }
+        pthread_join(loaderThread, NULL);
+        if (stats->asyncIO) ringFree(&loader.ring);
+        queueDestroy(&loaded);
+        queueDestroy(&written);
+        return -1;
+    }
+
+    // 呼叫者的執行緒處理影像：讀入下一個檔案與寫出上一個結果的同時處理目前這張
+    LoadItem* item;
+    while ((item = (LoadItem*)queuePop(&loaded)) != NULL) {
+        BatchImage* in = &item->image;
+        BatchImage out = { 0 };
+        WriteItem* w = NULL;
+        stats->bytesRead += in->size;
+        TRACE_BEGIN(span, "batch.kernel");
+        if (item->error == 0 && bmpParse(in->data, in->size, &in->header, &in->view) == 0 &&
+            kernel(in, &out, ctx) == 0 && (w = (WriteItem*)malloc(sizeof(WriteItem))) != NULL &&
+            (w->path = outputPath(outputDir, files[item->index])) != NULL) {
+            w->image = out;
+            TRACE_END(span, in->size + out.size, (uint64_t)in->view.width * in->view.height);
+            queuePush(&written, w);
+        } else {
+            fprintf(stderr, "略過 %s。\n", files[item->index]);
+            stats->failed++;
+            batchImageFree(&out);
+            free(w);
+        }
+        batchImageFree(in);
+        free(item);
+    }
+
+    queueClose(&written);
+    pthread_join(writerThread, NULL);
+    pthread_join(loaderThread, NULL);
+    if (stats->asyncIO) ringFree(&loader.ring);
+    queueDestroy(&loaded);
+    queueDestroy(&written);
+
+    stats->processed = writer.processed;
+    stats->failed += writer.failed;
+    stats->bytesWritten = writer.bytesWritten;
+    stats->seconds = now() - start;
+    return 0;
+}
@@ -0,0 +1,54 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bmp_io.h"
+
+#define BATCH_DEFAULT_PREFETCH 8    // 預設最多預先讀入的檔案數
+
+// 批次處理中的一張記憶體內 BMP（標頭與像素在同一塊緩衝區，與檔案內容相同）
+typedef struct {
+    uint8_t* data;          // 檔案內容
+    size_t size;            // 檔案大小
+    BMPHeader* header;      // 指向 data 內的標頭
+    ImageView view;         // 指向 data 內的像素陣列
+} BatchImage;
+
+// 配置一張 24/32 位元的輸出影像，填好標頭，像素內容（含每行的填充位元組）為 0
+// 緩衝區取自共用的緩衝區池（framePoolShared），讀入的影像也是，批次中相同大小的影像重複使用同一塊記憶體
+// templ: 用來複製解析度等欄位的範本標頭，可為 NULL
+// 成功傳回 0，記憶體不足時傳回 -1
+int batchImageCreate(BatchImage* img, const BMPHeader* templ, int width, int height, int bitCount);
+
+// 釋放影像
+void batchImageFree(BatchImage* img);
+
+// 處理一張影像：in 是讀入的影像（可以就地修改），以 batchImageCreate 建立 out 並寫入結果
+// 成功傳回 0，失敗時傳回 -1（這張影像不會輸出，批次繼續處理下一張）
+typedef int (*BatchKernel)(BatchImage* in, BatchImage* out, void* ctx);
+
+// 批次處理的統計
+typedef struct {
+    int processed;          // 成功輸出的影像數
+    int failed;             // 讀取、處理或寫入失敗的影像數
+    uint64_t bytesRead;     // 讀入的位元組數
+    uint64_t bytesWritten;  // 寫出的位元組數
+    double seconds;         // 總耗時
+    int asyncIO;            // 1 表示以 io_uring 讀取，0 表示在讀取執行緒中以 pread 讀取
+} BatchStats;
+
+// 取得輸入檔案清單：path 為目錄時取其中所有 .bmp 檔（依檔名排序），否則視為每行一個路徑的清單檔
+// （空行與 # 開頭的行會被略過）；成功傳回檔案數並設定 *files（以 batchFreeInputs 釋放），失敗時傳回 -1
+int batchListInputs(const char* path, char*** files);
+
+// 釋放 batchListInputs 取得的清單
+void batchFreeInputs(char** files, int count);
+
+// 依序處理 files 中的每張影像，輸出到 outputDir（不存在時自動建立），檔名與輸入相同
+// 讀取、處理、寫入三個階段重疊進行：讀取執行緒最多預先讀入 prefetch 個檔案（有 io_uring 時同時送出這些讀取要求，
+// 否則依序以 pread 讀取），呼叫者的執行緒處理影像（核心可以使用執行緒池平行處理），寫入執行緒把結果寫回磁碟
+// 成功傳回 0（個別影像失敗時記在 stats->failed 中），無法建立輸出目錄、執行緒或記憶體不足時傳回 -1
+int batchRun(char** files, int count, const char* outputDir, int prefetch, BatchKernel kernel, void* ctx, BatchStats* stats);
+
+#endif
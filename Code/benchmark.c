@@ -0,0 +1,505 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "bmp_io.h"
+#include "image.h"
+#include "thread_pool.h"
+#include "point_ops.h"
+#include "convolution.h"
+#include "gaussian.h"
+#include "median_filter.h"
+#include "bilateral_filter.h"
+#include "guided_filter.h"
+#include "nlm_filter.h"
+#include "color_ops.h"
+#include "geometry.h"
+#include "cpu_dispatch.h"
+
+#define MAX_SIZES 16
+#define MAX_BASELINE 1024
+
+// 各核心共用的參數（查找表、卷積核心等只建立一次，不計入時間）
+typedef struct {
+    PointLUT quantize;      // 量化為 4 位元（作業 1）
+    PointLUT gamma;         // gamma = 0.5（作業 2）
+    ConvKernel sharpen;     // 強度 1.0 的拉普拉斯銳化（作業 2）
+} BenchParams;
+
+// 受測的核心：讀取 src 寫入 dst（大小與 src 相同）
+typedef void (*BenchKernel)(const ImageView* src, ImageView* dst, const BenchParams* params);
+
+static void benchFlip(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    (void)params;
+    flipHorizontal(src, dst);
+}
+
+static void benchQuantize(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    lutApply(&params->quantize, src, dst);
+}
+
+// 裁剪中央四分之一的區域並逐行複製（與 Homework_1_3 相同）
+static void benchCrop(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    (void)params;
+    ImageView roi;
+    int width = src->width / 2, height = src->height / 2;
+    if (imageRegion(src, width / 2, height / 2, width, height, &roi) != 0) return;
+    ImageView out = imageSubView(dst, 0, 0, width, height);
+    imageCopy(&roi, &out);
+}
+
+static void benchGamma(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    lutApply(&params->gamma, src, dst);
+}
+
+static void benchSharpen(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    convolve(&params->sharpen, src, dst);
+}
+
+// 半徑 5 的反銳化遮罩（遞迴高斯，計算量與半徑無關）
+static void benchUnsharp(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    (void)params;
+    UnsharpParams unsharp = { 5.0, 1.0, 0 };
+    unsharpMask(src, dst, &unsharp);
+}
+
+static void benchMedian(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    (void)params;
+    medianFilter(src, dst, 1);
+}
+
+static void benchBilateral(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    (void)params;
+    bilateralFilter(src, dst, 3, 45, 55);
+}
+
+// 半徑 8 的自我導引濾波（累加總和的方框濾波，計算量與半徑無關），以及縮小 4 倍計算係數的快速版
+static void benchGuided(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    (void)params;
+    GuidedParams guided = { 8, 400.0, 1 };
+    guidedFilter(NULL, src, dst, &guided);
+}
+
+static void benchGuidedFast(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    (void)params;
+    GuidedParams guided = { 8, 400.0, 4 };
+    guidedFilter(NULL, src, dst, &guided);
+}
+
+static void benchNlm(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    (void)params;
+    NlmParams nlm = { 10.0, 4.0, 2, 7, 0 };
+    nlmFilter(src, dst, &nlm);
+}
+
+static void benchNlmLuma(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    (void)params;
+    NlmParams nlm = { 10.0, 4.0, 2, 7, 1 };
+    nlmFilter(src, dst, &nlm);
+}
+
+static void benchGreyWorld(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    (void)params;
+    applyGreyWorld(src, dst, 1);
+}
+
+static void benchMaxRGB(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    (void)params;
+    applyMaxRGB(src, dst, 1);
+}
+
+// 飽和度調整是就地處理，直接在 dst 上反覆執行（內容為上一個核心的輸出）
+static void benchSaturation(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    (void)src;
+    (void)params;
+    increaseSaturation(dst, 1.5);
+}
+
+static void benchWarm(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    (void)params;
+    applyWarmEffect(src, dst, 30);
+}
+
+static void benchCool(const ImageView* src, ImageView* dst, const BenchParams* params) {
+    (void)params;
+    applyCoolEffect(src, dst, 30);
+}
+
+typedef struct {
+    const char* name;
+    BenchKernel run;
+} BenchEntry;
+
+static const BenchEntry benchKernels[] = {
+    { "flip", benchFlip },
+    { "quantize", benchQuantize },
+    { "crop", benchCrop },
+    { "gamma", benchGamma },
+    { "sharpen", benchSharpen },
+    { "unsharp", benchUnsharp },
+    { "median", benchMedian },
+    { "bilateral", benchBilateral },
+    { "guided", benchGuided },
+    { "guided-fast", benchGuidedFast },
+    { "nlm", benchNlm },
+    { "nlm-luma", benchNlmLuma },
+    { "grey-world", benchGreyWorld },
+    { "max-rgb", benchMaxRGB },
+    { "saturation", benchSaturation },
+    { "warm", benchWarm },
+    { "cool", benchCool },
+};
+#define KERNEL_COUNT ((int)(sizeof(benchKernels) / sizeof(benchKernels[0])))
+
+// 基準檔中的一筆結果
+typedef struct {
+    char kernel[32];
+    int bitCount;
+    double megapixels;
+    double rate;            // MP/s
+} BaselineEntry;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// 時脈計數器（x86 的 TSC 以固定頻率計數，與渦輪加速無關）；其他平台傳回 0，不顯示每像素週期數
+static uint64_t cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// 產生合成影像：平滑的漸層加上雜訊，讓濾波器與色彩處理走到與真實照片相近的分支
+// 以固定的種子產生，每次執行的內容都相同
+typedef struct {
+    const ImageView* img;
+    int rowsPerTask;
+} FillContext;
+
+static void fillRows(int index, void* ctx) {
+    const FillContext* fill = (const FillContext*)ctx;
+    const ImageView* img = fill->img;
+    int y0 = index * fill->rowsPerTask;
+    int y1 = y0 + fill->rowsPerTask < img->height ? y0 + fill->rowsPerTask : img->height;
+    for (int y = y0; y < y1; y++) {
+        uint32_t state = 0x9E3779B9u * (uint32_t)(y + 1);
+        uint8_t* row = imageRow(img, y);
+        for (int x = 0; x < img->width; x++) {
+            for (int c = 0; c < img->channels; c++) {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                int v = (x * 255 / img->width + y * 255 / img->height) / 2 + c * 40 + (int)(state & 31) - 16;
+                row[x * img->channels + c] = (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+            }
+        }
+    }
+}
+
+static void fillSynthetic(const ImageView* img) {
+    FillContext fill = { img, 64 };
+    parallelFor((img->height + fill.rowsPerTask - 1) / fill.rowsPerTask, fillRows, &fill);
+}
+
+// 解析以逗號分隔的數字清單，傳回數量
+static int parseList(const char* text, double* values, int maxCount) {
+    int count = 0;
+    while (*text && count < maxCount) {
+        char* end;
+        double v = strtod(text, &end);
+        if (end == text || v <= 0) return -1;
+        values[count++] = v;
+        text = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') return -1;
+    }
+    return count;
+}
+
+// 名稱是否出現在以逗號分隔的清單中（清單為 NULL 時視為全部）
+static int nameSelected(const char* list, const char* name) {
+    if (!list) return 1;
+    size_t length = strlen(name);
+    for (const char* p = list; *p; ) {
+        const char* end = strchr(p, ',');
+        size_t n = end ? (size_t)(end - p) : strlen(p);
+        if (n == length && strncmp(p, name, n) == 0) return 1;
+        if (!end) break;
+        p = end + 1;
+    }
+    return 0;
+}
+
+// 讀取基準檔，每行為「核心 位元深度 百萬像素 MP/s」，# 開頭的行為註解
+static int loadBaseline(const char* path, BaselineEntry* entries, int maxCount) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "無法開啟基準檔 %s。\n", path);
+        return -1;
+    }
+    char line[256];
+    int count = 0;
+    while (count < maxCount && fgets(line, sizeof(line), file)) {
+        BaselineEntry* e = &entries[count];
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%31s %d %lf %lf", e->kernel, &e->bitCount, &e->megapixels, &e->rate) == 4) count++;
+    }
+    fclose(file);
+    return count;
+}
+
+static const BaselineEntry* findBaseline(const BaselineEntry* entries, int count, const char* kernel, int bitCount, double megapixels) {
+    for (int i = 0; i < count; i++) {
+        if (entries[i].bitCount == bitCount && fabs(entries[i].megapixels - megapixels) < 1e-6 &&
+            strcmp(entries[i].kernel, kernel) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+// 遞迴高斯模糊與直接卷積（影像外重複邊緣像素）的最大誤差，分成距邊界 3 sigma 以內與內部兩區
+// 遞迴只是近似高斯，內部本來就有誤差；邊界的初始值正確時邊界附近的誤差與內部相當
+// 傳回邊界誤差明顯大於內部的 sigma 個數
+static int checkGaussianBorders(void) {
+    static const double sigmas[] = { 2.0, 5.0, 12.0 };
+    int width = 333, height = 251, ch = 3, failures = 0;
+    Image src, dst;
+    if (imageCreate(&src, width, height, ch, IMAGE_INTERLEAVED) != 0) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        return 1;
+    }
+    if (imageCreate(&dst, width, height, ch, IMAGE_INTERLEAVED) != 0) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        imageFree(&src);
+        return 1;
+    }
+    ImageView srcView = imageView(&src), dstView = imageView(&dst);
+    fillSynthetic(&srcView);
+    double* rows = (double*)malloc((size_t)width * height * ch * sizeof(double));
+    double* kernel = (double*)malloc((size_t)(2 * (int)ceil(5 * sigmas[2]) + 1) * sizeof(double));
+    if (!rows || !kernel) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        free(rows);
+        free(kernel);
+        imageFree(&src);
+        imageFree(&dst);
+        return 1;
+    }
+    for (int k = 0; k < (int)(sizeof(sigmas) / sizeof(sigmas[0])); k++) {
+        double sigma = sigmas[k];
+        int radius = (int)ceil(5 * sigma);
+        double sum = 0;
+        for (int i = -radius; i <= radius; i++) sum += kernel[i + radius] = exp(-i * i / (2 * sigma * sigma));
+        for (int i = 0; i <= 2 * radius; i++) kernel[i] /= sum;
+        if (gaussianBlur(&srcView, &dstView, sigma) != 0) {
+            failures++;
+            continue;
+        }
+        // 先水平再垂直的直接卷積，座標超出影像時取最邊緣的像素
+        for (int y = 0; y < height; y++) {
+            const uint8_t* in = imageRow(&srcView, y);
+            for (int x = 0; x < width; x++) {
+                for (int c = 0; c < ch; c++) {
+                    double v = 0;
+                    for (int i = -radius; i <= radius; i++) {
+                        int xi = x + i < 0 ? 0 : (x + i >= width ? width - 1 : x + i);
+                        v += kernel[i + radius] * in[xi * ch + c];
+                    }
+                    rows[((size_t)y * width + x) * ch + c] = v;
+                }
+            }
+        }
+        double borderError = 0, interiorError = 0;
+        for (int y = 0; y < height; y++) {
+            const uint8_t* out = imageRow(&dstView, y);
+            for (int x = 0; x < width; x++) {
+                int border = x < 3 * sigma || y < 3 * sigma || x >= width - 3 * sigma || y >= height - 3 * sigma;
+                for (int c = 0; c < ch; c++) {
+                    double v = 0;
+                    for (int i = -radius; i <= radius; i++) {
+                        int yi = y + i < 0 ? 0 : (y + i >= height ? height - 1 : y + i);
+                        v += kernel[i + radius] * rows[((size_t)yi * width + x) * ch + c];
+                    }
+                    double error = fabs(v - out[x * ch + c]);
+                    if (border && error > borderError) borderError = error;
+                    if (!border && error > interiorError) interiorError = error;
+                }
+            }
+        }
+        int failed = borderError > 2 * interiorError + 1.0;
+        failures += failed;
+        printf("gaussian sigma %4.1f: max error %.2f near borders, %.2f interior%s\n", sigma, borderError, interiorError,
+               failed ? "  BORDER ERROR" : "");
+    }
+    free(rows);
+    free(kernel);
+    imageFree(&src);
+    imageFree(&dst);
+    return failures;
+}
+
+int main(int argc, char* argv[]) {
+    // --sizes LIST：合成影像的大小（百萬像素，預設 1,12,50,100）
+    // --formats LIST：位元深度（預設 24,32）
+    // --kernels LIST：只測試指定的核心（預設全部）
+    // --min-time S：每個核心至少反覆執行 S 秒，取最快的一次（預設 0.5）
+    // --save FILE：將結果存為基準檔
+    // --baseline FILE：與基準檔比較，MP/s 下降超過 --tolerance（百分比，預設 10）時標示為退步並傳回 1
+    // --check-borders：先檢查遞迴高斯模糊在影像邊界附近的誤差，邊界明顯比內部差時傳回 1
+    // --threads N（或 -t N）：執行緒數
+    threadPoolParseArgs(argc, argv);
+    double sizes[MAX_SIZES] = { 1, 12, 50, 100 };
+    double formats[MAX_SIZES] = { 24, 32 };
+    int sizeCount = 4, formatCount = 2;
+    const char* kernels = NULL;
+    const char* savePath = NULL;
+    const char* baselinePath = NULL;
+    double minTime = 0.5, tolerance = 10;
+    int checkBorders = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--check-borders") == 0) checkBorders = 1;
+    }
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--sizes") == 0) {
+            sizeCount = parseList(argv[++i], sizes, MAX_SIZES);
+        } else if (strcmp(argv[i], "--formats") == 0) {
+            formatCount = parseList(argv[++i], formats, MAX_SIZES);
+        } else if (strcmp(argv[i], "--kernels") == 0) {
+            kernels = argv[++i];
+        } else if (strcmp(argv[i], "--min-time") == 0) {
+            minTime = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--save") == 0) {
+            savePath = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0) {
+            baselinePath = argv[++i];
+        } else if (strcmp(argv[i], "--tolerance") == 0) {
+            tolerance = atof(argv[++i]);
+        }
+    }
+    if (sizeCount <= 0 || formatCount <= 0) {
+        fprintf(stderr, "無效的大小或位元深度清單。\n");
+        return 1;
+    }
+    int selected = 0;
+    for (int k = 0; k < KERNEL_COUNT; k++) selected += nameSelected(kernels, benchKernels[k].name);
+    if (!selected) {
+        fprintf(stderr, "沒有符合 %s 的核心。\n", kernels);
+        return 1;
+    }
+
+    static BaselineEntry baseline[MAX_BASELINE];
+    int baselineCount = 0;
+    if (baselinePath && (baselineCount = loadBaseline(baselinePath, baseline, MAX_BASELINE)) < 0) return 1;
+    FILE* save = NULL;
+    if (savePath) {
+        save = fopen(savePath, "w");
+        if (!save) {
+            fprintf(stderr, "無法寫入基準檔 %s。\n", savePath);
+            return 1;
+        }
+        fprintf(save, "# kernel bpp MP MP/s (%d threads, %s)\n", threadPoolThreads(), cpuLevelName(cpuLevel()));
+    }
+
+    BenchParams params;
+    lutIdentity(&params.quantize);
+    lutQuantize(&params.quantize, 4);
+    lutIdentity(&params.gamma);
+    lutGamma(&params.gamma, 0.5f);
+    convKernelParse(&params.sharpen, "sharpen");
+
+    int borderFailures = checkBorders ? checkGaussianBorders() : 0;
+    printf("%d threads, %s kernels, best of >= %.2f s per kernel; MP/s counts input pixels\n", threadPoolThreads(),
+           cpuLevelName(cpuLevel()), minTime);
+    printf("%-12s %4s %7s %10s %10s %8s  %s\n", "kernel", "bpp", "MP", "ms", "MP/s", "cyc/px", baselinePath ? "vs baseline" : "");
+    int regressions = 0;
+    for (int s = 0; s < sizeCount; s++) {
+        for (int f = 0; f < formatCount; f++) {
+            int bitCount = (int)formats[f];
+            if (bitCount != 24 && bitCount != 32) {
+                fprintf(stderr, "僅支持 24 或 32 位元。\n");
+                continue;
+            }
+            // 4:3 的影像，寬度不是 4 的倍數時 24 位元的行尾有填充（與一般的 BMP 相同）
+            double pixels = sizes[s] * 1e6;
+            int width = (int)lround(sqrt(pixels * 4 / 3));
+            int height = (int)lround(pixels / width);
+            Image src, dst;
+            if (imageCreate(&src, width, height, bitCount / 8, IMAGE_INTERLEAVED) != 0) {
+                fprintf(stderr, "記憶體分配失敗。\n");
+                continue;
+            }
+            if (imageCreate(&dst, width, height, bitCount / 8, IMAGE_INTERLEAVED) != 0) {
+                fprintf(stderr, "記憶體分配失敗。\n");
+                imageFree(&src);
+                continue;
+            }
+            ImageView srcView = imageView(&src), dstView = imageView(&dst);
+            fillSynthetic(&srcView);
+            imageCopy(&srcView, &dstView);
+
+            for (int k = 0; k < KERNEL_COUNT; k++) {
+                const BenchEntry* entry = &benchKernels[k];
+                if (!nameSelected(kernels, entry->name)) continue;
+
+                // 先執行一次（分頁、快取與查找表的預熱），再反覆執行取最快的一次
+                entry->run(&srcView, &dstView, &params);
+                double best = 1e30, total = 0;
+                uint64_t bestCycles = 0;
+                for (int rep = 0; rep == 0 || total < minTime; rep++) {
+                    double t0 = now();
+                    uint64_t c0 = cycles();
+                    entry->run(&srcView, &dstView, &params);
+                    uint64_t c1 = cycles();
+                    double t = now() - t0;
+                    total += t;
+                    if (t < best) {
+                        best = t;
+                        bestCycles = c1 - c0;
+                    }
+                }
+
+                double megapixels = (double)width * height / 1e6;
+                double rate = megapixels / best;
+                printf("%-12s %4d %7.2f %10.3f %10.1f ", entry->name, bitCount, megapixels, best * 1e3, rate);
+                if (bestCycles) {
+                    printf("%8.2f", (double)bestCycles / ((double)width * height));
+                } else {
+                    printf("%8s", "-");
+                }
+                const BaselineEntry* base = findBaseline(baseline, baselineCount, entry->name, bitCount, sizes[s]);
+                if (base) {
+                    double change = (rate / base->rate - 1) * 100;
+                    int regressed = change < -tolerance;
+                    regressions += regressed;
+                    printf("  %+6.1f%%%s", change, regressed ? "  REGRESSION" : "");
+                }
+                printf("\n");
+                fflush(stdout);
+                if (save) fprintf(save, "%s %d %g %.3f\n", entry->name, bitCount, sizes[s], rate);
+            }
+            imageFree(&src);
+            imageFree(&dst);
+        }
+    }
+
+    if (save) fclose(save);
+    if (borderFailures) {
+        printf("gaussian blur is inaccurate near the borders for %d sigma(s)\n", borderFailures);
+        return 1;
+    }
+    if (regressions) {
+        printf("%d kernel(s) regressed by more than %.0f%%\n", regressions, tolerance);
+        return 1;
+    }
+    return 0;
+}
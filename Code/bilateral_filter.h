@@ -0,0 +1,55 @@
+#ifndef BILATERAL_FILTER_H
+#define BILATERAL_FILTER_H
+
+#include "bmp_io.h"
+#include "image.h"
+
+// 雙邊濾波的兩種實作
+typedef enum {
+    BILATERAL_EXACT,    // 逐一計算窗口內每個鄰居的權重
+    BILATERAL_GRID      // 雙邊網格近似，計算量與窗口大小無關
+} BilateralMode;
+
+// 精確的雙邊濾波，窗口大小為 (2 * radius + 1) x (2 * radius + 1)，每個通道分別處理
+// 空間權重事先算成一張 (2r+1)^2 的表，亮度權重只與 8 位元差值有關，事先算成 511 項的表，
+// 每個鄰居只需兩次查表，結果與逐一呼叫 exp 的作業 2 版本完全相同
+// 與作業 2 相同，只處理距離邊界至少 radius 的像素；src 與 dst 不可指向同一塊記憶體
+// 影像切成區塊後以多執行緒處理，結果與單執行緒相同
+// sigmaS: 控制空間距離的權重
+// sigmaR: 控制像素亮度差異的權重
+// 成功傳回 0，記憶體不足時傳回 -1
+int bilateralFilter(const ImageView* src, ImageView* dst, int radius, double sigmaS, double sigmaR);
+
+// 與 bilateralFilter 相同，但依 border 補上影像外的鄰域後處理所有像素（包含邊界），見 imageApplyBorder
+// border 為 NULL 或 BORDER_NONE 時等同 bilateralFilter
+int bilateralFilterBorder(const ImageView* src, ImageView* dst, int radius, double sigmaS, double sigmaR, const ImageBorder* border);
+
+// 精確版雙邊濾波事先算好的權重表，可在多次濾波之間共用
+typedef struct {
+    int radius;
+    double* spatial;    // (2r+1)^2 項的空間權重
+    double* range;      // range[d]，d 介於 -255 與 255
+} BilateralKernel;
+
+// 建立權重表，成功傳回 0，記憶體不足時傳回 -1
+int bilateralKernelInit(BilateralKernel* kernel, int radius, double sigmaS, double sigmaR);
+
+// 釋放權重表
+void bilateralKernelFree(BilateralKernel* kernel);
+
+// 多輸出處理（parallelTilesFanOut）中的一個精確版雙邊濾波輸出，結果與 bilateralFilter 相同
+// kernel 在處理完成前須保持有效
+TileOutput bilateralFilterOutput(const BilateralKernel* kernel, ImageView* dst);
+
+// 以雙邊網格（Paris & Durand）近似的雙邊濾波，每個通道分別處理
+// 將像素依 (x / sigmaS, y / sigmaS, 亮度 / sigmaR) 累加到低解析度的三維網格，
+// 在網格上做高斯模糊後再以三線性內插取回每個像素，計算量與 sigmaS 無關
+// 空間權重涵蓋完整的高斯分佈（不截斷在固定窗口），因此 sigmaS 很大時與精確版的結果不同
+// 會處理所有像素（包含邊界）；src 與 dst 可以相同。取樣依序進行，模糊後的內插以多執行緒處理
+// 成功傳回 0，記憶體不足時傳回 -1
+int bilateralGrid(const ImageView* src, ImageView* dst, double sigmaS, double sigmaR);
+
+// 雙邊網格在條帶模式下上下需要的鄰域行數（網格模糊與內插涵蓋的範圍）
+int bilateralGridHalo(double sigmaS);
+
+#endif
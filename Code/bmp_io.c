@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bmp_io.h"
+#include "trace.h"
+
+// 計算每行的位元組數，確保行對齊（每行的位元組數是 4 的倍數）
+int bmpRowSize(int width, int bitCount) {
+    return (int)(((int64_t)width * bitCount + 31) / 32 * 4);
+}
+
+// 檢查 BMP 標頭是否為支援的格式，且像素資料完整
+int bmpCheckHeader(const BMPHeader* h, uint64_t fileSize) {
+    if (fileSize < sizeof(BMPHeader)) {
+        fprintf(stderr, "檔案太小，不是有效的 BMP 文件。\n");
+        return -1;
+    }
+    if (h->fileType != 0x4D42) { // 'BM'
+        fprintf(stderr, "輸入文件不是有效的 BMP 文件。\n");
+        return -1;
+    }
+    if (h->bitCount != 24 && h->bitCount != 32) {
+        fprintf(stderr, "不支援的位元深度：%d\n", h->bitCount);
+        return -1;
+    }
+    // 32 位元檔案可能使用 BI_BITFIELDS（3），像素排列仍為 BGRA
+    if (h->compression != 0 && !(h->compression == 3 && h->bitCount == 32)) {
+        fprintf(stderr, "不支援壓縮的 BMP 文件。\n");
+        return -1;
+    }
+    if (h->width <= 0 || h->height == 0 || h->height == INT32_MIN) {
+        fprintf(stderr, "無效的圖像尺寸。\n");
+        return -1;
+    }
+
+    int height = h->height < 0 ? -h->height : h->height;
+    int rowSize = bmpRowSize(h->width, h->bitCount);
+    if (h->offsetData < sizeof(BMPHeader) || h->offsetData > fileSize ||
+        (uint64_t)rowSize * height > fileSize - h->offsetData) {
+        fprintf(stderr, "BMP 文件的像素資料不完整。\n");
+        return -1;
+    }
+    return 0;
+}
+
+// 建立指向像素陣列的視圖；調色盤格式時每個位元組為一個（8 位元）或兩個（4 位元）索引
+static void setView(uint8_t* data, const BMPHeader* h, ImageView* view) {
+    view->data = data + h->offsetData;
+    view->width = h->width;
+    view->height = h->height < 0 ? -h->height : h->height;
+    view->channels = h->bitCount >= 8 ? h->bitCount / 8 : 1;
+    view->stride = bmpRowSize(h->width, h->bitCount);
+}
+
+// 檢查 BMP 標頭並建立指向像素陣列的視圖
+int bmpParse(uint8_t* data, size_t size, BMPHeader** header, ImageView* view) {
+    BMPHeader* h = (BMPHeader*)data;
+    if (bmpCheckHeader(h, size) != 0) {
+        return -1;
+    }
+
+    *header = h;
+    setView(data, h, view);
+    return 0;
+}
+
+// 建立新的標頭，並從範本複製解析度欄位
+// 範本為 Top-down 時輸出也使用 Top-down，使行的儲存順序保持一致
+// 4、8 位元的調色盤格式在標頭之後放置 2^bitCount 項的調色盤
+void bmpInitHeader(BMPHeader* header, const BMPHeader* templ, int width, int height, int bitCount) {
+    uint32_t imageSize = (uint32_t)bmpRowSize(width, bitCount) * height;
+    uint32_t colors = bitCount <= 8 ? 1u << bitCount : 0;
+
+    memset(header, 0, sizeof(BMPHeader));
+    header->fileType = 0x4D42;
+    header->offsetData = sizeof(BMPHeader) + colors * 4;
+    header->fileSize = header->offsetData + imageSize;
+    header->size = 40;
+    header->width = width;
+    header->height = height;
+    header->planes = 1;
+    header->bitCount = bitCount;
+    header->sizeImage = imageSize;
+    header->colorsUsed = colors;
+    if (templ) {
+        header->xPixelsPerMeter = templ->xPixelsPerMeter;
+        header->yPixelsPerMeter = templ->yPixelsPerMeter;
+        if (templ->height < 0) header->height = -height;
+    }
+}
+
+// 以私有映射開啟輸入檔案，像素資料直接由分頁快取提供
+int bmpOpen(const char* filename, BMPFile* bmp) {
+    memset(bmp, 0, sizeof(BMPFile));
+    bmp->fd = -1;
+    TRACE_BEGIN(span, "bmp.open");
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "無法開啟輸入文件 %s。\n", filename);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(BMPHeader)) {
+        fprintf(stderr, "輸入文件 %s 不是有效的 BMP 文件。\n", filename);
+        close(fd);
+        return -1;
+    }
+
+    // MAP_PRIVATE 搭配可寫入權限：核心可以就地處理像素，修改不會寫回輸入檔案
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "無法映射輸入文件 %s。\n", filename);
+        close(fd);
+        return -1;
+    }
+
+    if (bmpParse((uint8_t*)map, (size_t)st.st_size, &bmp->header, &bmp->view) != 0) {
+        munmap(map, (size_t)st.st_size);
+        close(fd);
+        return -1;
+    }
+
+    bmp->map = map;
+    bmp->mapSize = (size_t)st.st_size;
+    bmp->fd = fd;
+    TRACE_END(span, sizeof(BMPHeader), 0); // 映射本身不讀取像素，像素在核心第一次存取時才由分頁錯誤載入
+    return 0;
+}
+
+// 預先設定輸出檔案大小後映射，核心直接寫入檔案的像素陣列
+int bmpCreate(const char* filename, const BMPHeader* templ, int width, int height, int bitCount, BMPFile* bmp) {
+    memset(bmp, 0, sizeof(BMPFile));
+    bmp->fd = -1;
+
+    TRACE_BEGIN(span, "bmp.create");
+    BMPHeader header;
+    bmpInitHeader(&header, templ, width, height, bitCount);
+
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "無法開啟輸出文件 %s。\n", filename);
+        return -1;
+    }
+
+    // ftruncate 會以 0 填滿檔案，因此每行的填充位元組不需要另外寫入
+    size_t size = header.fileSize;
+    if (ftruncate(fd, (off_t)size) != 0) {
+        fprintf(stderr, "無法設定輸出文件 %s 的大小。\n", filename);
+        close(fd);
+        return -1;
+    }
+
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "無法映射輸出文件 %s。\n", filename);
+        close(fd);
+        return -1;
+    }
+
+    memcpy(map, &header, sizeof(BMPHeader));
+    bmp->header = (BMPHeader*)map;
+    setView((uint8_t*)map, bmp->header, &bmp->view);
+    if (bitCount <= 8) bmp->palette = (uint8_t*)map + sizeof(BMPHeader);
+    bmp->map = map;
+    bmp->mapSize = size;
+    bmp->fd = fd;
+    TRACE_END(span, sizeof(BMPHeader), 0);
+    return 0;
+}
+
+// 解除映射並關閉檔案（輸出映射中的資料由核心寫回磁碟）
+void bmpClose(BMPFile* bmp) {
+    TRACE_BEGIN(span, "bmp.close");
+    if (bmp->map) munmap(bmp->map, bmp->mapSize);
+    if (bmp->fd >= 0) close(bmp->fd);
+    TRACE_END(span, bmp->mapSize, 0);
+    memset(bmp, 0, sizeof(BMPFile));
+    bmp->fd = -1;
+}
+
+void bmpAdviseSequential(const BMPFile* bmp) {
+    if (bmp->map) posix_madvise(bmp->map, bmp->mapSize, POSIX_MADV_SEQUENTIAL);
+}
+
+int imageRegion(const ImageView* img, int x, int y, int width, int height, ImageView* roi) {
+    if (x < 0 || y < 0 || width <= 0 || height <= 0 || width > img->width - x || height > img->height - y) {
+        return -1;
+    }
+    *roi = imageSubView(img, x, y, width, height);
+    return 0;
+}
+
+// 逐行複製像素（不含填充位元組）
+void imageCopy(const ImageView* src, ImageView* dst) {
+    size_t rowBytes = (size_t)src->width * src->channels;
+    for (int y = 0; y < src->height; y++) {
+        memcpy(imageRow(dst, y), imageRow(src, y), rowBytes);
+    }
+}
+
+// 上下 borderY 行整行複製，中間各行只複製左右各 borderX 個像素
+void imageCopyBorder(const ImageView* src, ImageView* dst, int borderX, int borderY) {
+    if (2 * borderX >= src->width || 2 * borderY >= src->height) {
+        imageCopy(src, dst);
+        return;
+    }
+    size_t rowBytes = (size_t)src->width * src->channels;
+    size_t sideBytes = (size_t)borderX * src->channels;
+    for (int y = 0; y < src->height; y++) {
+        if (y < borderY || y >= src->height - borderY) {
+            memcpy(imageRow(dst, y), imageRow(src, y), rowBytes);
+        } else if (sideBytes > 0) {
+            memcpy(imageRow(dst, y), imageRow(src, y), sideBytes);
+            memcpy(imageRow(dst, y) + rowBytes - sideBytes, imageRow(src, y) + rowBytes - sideBytes, sideBytes);
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef BMP_IO_H
+#define BMP_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// BMP 標頭結構（檔案標頭 14 位元組 + 資訊標頭 40 位元組），使用 #pragma pack 防止編譯器對齊
+#pragma pack(push, 1)
+typedef struct {
+    uint16_t fileType;          // 檔案類型（應為 "BM" 表示 BMP 檔案）
+    uint32_t fileSize;          // 檔案大小（包括標頭和圖像資料）
+    uint16_t reserved1;         // 保留欄位
+    uint16_t reserved2;         // 保留欄位
+    uint32_t offsetData;        // 圖像資料的偏移量
+    uint32_t size;              // DIB 標頭的大小
+    int32_t width;              // 圖像的寬度（以像素為單位）
+    int32_t height;             // 圖像的高度（以像素為單位，負數表示 Top-down）
+    uint16_t planes;            // 顏色平面數（應為 1）
+    uint16_t bitCount;          // 每像素位元數（支援 24 或 32）
+    uint32_t compression;       // 壓縮類型（0 表示不壓縮）
+    uint32_t sizeImage;         // 圖像資料的大小
+    int32_t xPixelsPerMeter;    // X 方向解析度
+    int32_t yPixelsPerMeter;    // Y 方向解析度
+    uint32_t colorsUsed;        // 使用的顏色數
+    uint32_t colorsImportant;   // 重要的顏色數
+} BMPHeader;
+#pragma pack(pop)
+
+// 影像視圖：直接指向像素陣列，不複製資料
+// 行的順序與檔案儲存順序相同（一般 BMP 的第 0 行為影像最下方一行）
+typedef struct {
+    uint8_t* data;              // 第 0 行第一個像素的位址
+    int width;                  // 圖像寬度（像素）
+    int height;                 // 圖像高度（像素，恆為正數）
+    int channels;               // 每像素位元組數（3 = BGR，4 = BGRA）
+    ptrdiff_t stride;           // 相鄰兩行之間的位元組距離（含 4 位元組對齊的填充）
+} ImageView;
+
+// 以記憶體映射方式開啟的 BMP 檔案
+typedef struct {
+    BMPHeader* header;          // 指向映射區內的 BMP 標頭
+    ImageView view;             // 指向映射區內的像素陣列
+    uint8_t* palette;           // 調色盤格式（4、8 位元）輸出的調色盤，每項為 B、G、R、0；其他格式為 NULL
+    void* map;                  // 映射區起始位址
+    size_t mapSize;             // 映射區長度
+    int fd;                     // 檔案描述符
+} BMPFile;
+
+// 取得第 y 行的起始位址
+static inline uint8_t* imageRow(const ImageView* img, int y) {
+    return img->data + (ptrdiff_t)y * img->stride;
+}
+
+// 取得 (x, y) 起、大小為 width x height 的子視圖，不複製像素，與原視圖共用同一塊記憶體（不檢查範圍）
+static inline ImageView imageSubView(const ImageView* img, int x, int y, int width, int height) {
+    ImageView view = { imageRow(img, y) + (ptrdiff_t)x * img->channels, width, height, img->channels, img->stride };
+    return view;
+}
+
+// 建立指向影像中一塊矩形區域（ROI）的視圖，y 依儲存順序計算（與 imageRow 相同）
+// 成功傳回 0，區域大小不為正或超出影像範圍時傳回 -1
+int imageRegion(const ImageView* img, int x, int y, int width, int height, ImageView* roi);
+
+// 計算每行的位元組數（4 位元組對齊）
+int bmpRowSize(int width, int bitCount);
+
+// 檢查 BMP 標頭是否為支援的格式（24/32 位元、不壓縮），且檔案大小足以容納像素資料
+// 成功傳回 0，否則印出錯誤訊息並傳回 -1
+int bmpCheckHeader(const BMPHeader* header, uint64_t fileSize);
+
+// 檢查記憶體中的 BMP 檔案內容並建立指向像素陣列的視圖
+// data: BMP 檔案內容（從檔案標頭開始）
+// size: 內容長度
+// 成功傳回 0，格式錯誤傳回 -1
+int bmpParse(uint8_t* data, size_t size, BMPHeader** header, ImageView* view);
+
+// 依照範本標頭建立新的標頭，範本可為 NULL
+// bitCount 為 24/32，或 4/8（調色盤格式，調色盤緊接在標頭之後，共 2^bitCount 項）
+void bmpInitHeader(BMPHeader* header, const BMPHeader* templ, int width, int height, int bitCount);
+
+// 以記憶體映射方式開啟輸入 BMP 檔案（私有映射，就地修改不會寫回檔案）
+int bmpOpen(const char* filename, BMPFile* bmp);
+
+// 預先設定輸出檔案大小並以記憶體映射方式建立輸出 BMP 檔案
+// templ: 用來複製解析度等欄位的範本標頭，可為 NULL
+// bitCount 為 4 或 8 時建立調色盤格式，像素為調色盤索引（4 位元時每位元組兩個像素，左邊的像素在高 4 位元），
+// 視圖的 channels 為 1，調色盤由 bmp->palette 填入
+int bmpCreate(const char* filename, const BMPHeader* templ, int width, int height, int bitCount, BMPFile* bmp);
+
+// 解除映射並關閉檔案
+void bmpClose(BMPFile* bmp);
+
+// 提示系統將依序讀取映射區，讓後續的頁面提前讀入
+void bmpAdviseSequential(const BMPFile* bmp);
+
+// 將 src 的像素逐行複製到 dst（兩者尺寸與通道數須相同）
+void imageCopy(const ImageView* src, ImageView* dst);
+
+// 只複製距離邊界不到 borderX 個像素 / borderY 行的部分，即鄰域為 borderX / borderY 的濾波器不會寫入的像素
+// 濾波器寫入內部像素之前呼叫，可以省去整張影像的複製
+void imageCopyBorder(const ImageView* src, ImageView* dst, int borderX, int borderY);
+
+#endif
@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "color_ops.h"
+#include "point_ops.h"
+#include "thread_pool.h"
+#include "image_stats.h"
+#include "cpu_dispatch.h"
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
+#include "trace.h"
+
+// 調整白平衡的 Grey World 方法
+void applyGreyWorld(const ImageView *src, ImageView *dst, int sampleStep) {
+    // 計算 R, G, B 的平均值
+    TRACE_BEGIN(span, "grey-world");
+    ImageStats stats;
+    if (imageStats(src, sampleStep, STATS_SUM, &stats) != 0) return;
+    double bAvg = imageStatsMean(&stats, 0);
+    double gAvg = imageStatsMean(&stats, 1);
+    double rAvg = imageStatsMean(&stats, 2);
+
+    // 調整因子
+    double rFactor = (rAvg + gAvg + bAvg) / (3 * rAvg);
+    double gFactor = (rAvg + gAvg + bAvg) / (3 * gAvg);
+    double bFactor = (rAvg + gAvg + bAvg) / (3 * bAvg);
+
+    // 每個通道的調整都是 8 位元到 8 位元的映射，建立查找表後逐像素只需查表（src 與 dst 可以相同）
+    PointLUT lut;
+    lutIdentity(&lut);
+    lutScale(&lut, bFactor, gFactor, rFactor);
+    lutApply(&lut, src, dst);
+    TRACE_END(span, 2 * (uint64_t)src->width * src->height * src->channels, (uint64_t)src->width * src->height);
+}
+
+// 使用 Max-RGB 方法進行白平衡調整
+void applyMaxRGB(const ImageView *src, ImageView *dst, int sampleStep) {
+    // 找出 R, G, B 的最大值
+    TRACE_BEGIN(span, "max-rgb");
+    ImageStats stats;
+    if (imageStats(src, sampleStep, STATS_MINMAX, &stats) != 0) return;
+    unsigned char bMax = stats.max[0], gMax = stats.max[1], rMax = stats.max[2];
+
+    // 計算最大的 RGB 值
+    unsigned char mMax = (rMax > gMax) ? ((rMax > bMax) ? rMax : bMax) : ((gMax > bMax) ? gMax : bMax);
+
+    // 計算調整因子
+    double rFactor = (double)mMax / rMax;
+    double gFactor = (double)mMax / gMax;
+    double bFactor = (double)mMax / bMax;
+
+    // 每個通道的調整都是 8 位元到 8 位元的映射，建立查找表後逐像素只需查表（src 與 dst 可以相同）
+    PointLUT lut;
+    lutIdentity(&lut);
+    lutScale(&lut, bFactor, gFactor, rFactor);
+    lutApply(&lut, src, dst);
+    TRACE_END(span, 2 * (uint64_t)src->width * src->height * src->channels, (uint64_t)src->width * src->height);
+}
+
+// 伽瑪校正：以查找表取代逐像素的 pow 計算
+void applyGammaCorrection(ImageView *img, float gamma) {
+    PointLUT lut;
+    lutIdentity(&lut);
+    lutGamma(&lut, gamma);
+    lutApply(&lut, img, img);
+}
+
+// ======= 色相與飽和度 =======
+//
+// 保持 V（最大值）不變時，HSV 的色相與飽和度只決定三個通道離最大值多遠：
+// 以 delta = max - min 為單位，色相是六角錐上的位置 h ∈ [0, 6 * delta)，
+// 通道 n（B = 1、G = 3、R = 5）的 max - c = w = clamp(min(k, 4 * delta - k), 0, delta)，k = (n * delta + h) mod 6 * delta
+// 飽和度乘上 f 等於把每個 w 乘上 f（超過 max / delta 時飽和度達到 1，改為乘上 max / delta），
+// 因此不必換算成角度，也不需要 fmod 與依色相區間的分支
+// 色相位移後 h 不一定是整數，因此 h 與 w 都以 delta / HUE_STEPS 為單位
+// 不旋轉色相時，結果為 c = max - ceil(w * 倍率)，等於以精確的有理數運算做 HSV 來回轉換後再截斷為整數；
+// 原本的浮點版本因捨入誤差，約 5% 的通道值會小 1
+
+#define HUE_STEPS 16        // 色相位置的細分數
+#define MAX_SATURATION 16   // 飽和度倍率的上限，使 w * 倍率在向量版本中不超過 2^24
+
+typedef struct {
+    int factorQ8;   // 飽和度倍率 * 256，介於 0 ~ MAX_SATURATION * 256
+    int hueQ12;     // 色相位移（以 60 度為 1）* 4096，介於 0 ~ 6 * 4096
+} HueSatParams;
+
+// 以整數運算調整一個像素
+static inline void hueSatPixel(uint8_t *p, const HueSatParams *params) {
+    int b = p[0], g = p[1], r = p[2];
+    int max = r > g ? (r > b ? r : b) : (g > b ? g : b);
+    int min = r < g ? (r < b ? r : b) : (g < b ? g : b);
+    int delta = max - min;
+
+    int unit = HUE_STEPS * delta;
+
+    // 色相位置（最大值相同時依 R、G、B 的順序決定區段），加上位移後取餘數
+    int h = HUE_STEPS * (r == max ? g - b : g == max ? b - r + 2 * delta : r - g + 4 * delta);
+    if (h < 0) h += 6 * unit;
+    h += (delta * params->hueQ12 + 128) >> 8;
+    if (h >= 6 * unit) h -= 6 * unit;
+
+    // w 的倍率 num / den
+    int clip = delta > 0 && delta * params->factorQ8 >= max * 256;
+    int num = clip ? max : params->factorQ8;
+    int den = clip ? unit : HUE_STEPS * 256;
+
+    for (int c = 0; c < 3; c++) {
+        int k = (2 * c + 1) * unit + h;
+        if (k >= 6 * unit) k -= 6 * unit;
+        int w = k < 4 * unit - k ? k : 4 * unit - k;
+        if (w > unit) w = unit;
+        if (w < 0) w = 0;
+        p[c] = (uint8_t)(max - (w * num + den - 1) / den);
+    }
+}
+
+#if defined(CPU_X86)
+#define HUESAT_AVX2
+#include "hue_sat_lanes.h"
+#undef HUESAT_AVX2
+#include "hue_sat_lanes.h"
+#endif
+
+// 調整一個行區段（或整張影像）的色相與飽和度
+static void hueSatTile(const ImageView *src, ImageView *dst, void *ctx) {
+    (void)src;
+    const HueSatParams *params = (const HueSatParams *)ctx;
+    for (int y = 0; y < dst->height; y++) {
+        uint8_t *row = imageRow(dst, y);
+        int i = 0;
+#if defined(CPU_X86)
+        CpuLevel level = cpuLevel();
+        if (level >= CPU_AVX2) {
+            i = hueSatRowAVX2(row, dst->width, params);
+        } else if (level >= CPU_SSE2) {
+            i = hueSatRowSSE2(row, dst->width, params);
+        }
+#endif
+        for (; i < dst->width; i++) hueSatPixel(row + 3 * i, params);
+    }
+}
+
+// 調整色相與飽和度，各行區段以多執行緒處理
+void adjustHueSaturation(ImageView *img, float hueShift, float saturationFactor) {
+    float turns = fmodf(hueShift / 60.0f, 6.0f);
+    if (turns < 0) turns += 6.0f;
+    float factor = saturationFactor * 256.0f + 0.5f;
+    HueSatParams params = {
+        factor < 0.0f ? 0 : factor > MAX_SATURATION * 256.0f ? MAX_SATURATION * 256 : (int)factor,
+        (int)(turns * 4096.0f + 0.5f)
+    };
+    TRACE_BEGIN(span, "hue-saturation");
+    parallelRows(img, img, hueSatTile, &params);
+    TRACE_END(span, 2 * (uint64_t)img->width * img->height * img->channels, (uint64_t)img->width * img->height);
+}
+
+// 提高飽和度，色相不變
+void increaseSaturation(ImageView *img, float saturationFactor) {
+    adjustHueSaturation(img, 0.0f, saturationFactor);
+}
+
+// 暖色調整（偏黃）
+void applyWarmEffect(const ImageView *src, ImageView *dst, int warmIntensity) {
+    PointLUT lut;
+    lutIdentity(&lut);
+    lutOffset(&lut, -warmIntensity/2, // 減少少量藍色
+                    warmIntensity/2,  // 增加綠色（稍弱於紅色）
+                    warmIntensity);   // 增加紅色
+    lutApply(&lut, src, dst);
+}
+
+// 冷色調整（偏藍）
+void applyCoolEffect(const ImageView *src, ImageView *dst, int coolIntensity) {
+    PointLUT lut;
+    lutIdentity(&lut);
+    lutOffset(&lut, coolIntensity,     // 增加藍色
+                    -coolIntensity/2,  // 減少綠色
+                    -coolIntensity/2); // 減少紅色
+    lutApply(&lut, src, dst);
+}
@@ -0,0 +1,39 @@
+#ifndef COLOR_OPS_H
+#define COLOR_OPS_H
+
+#include "bmp_io.h"
+
+// 定義像素結構（BMP 格式是 BGR 而不是 RGB）
+typedef struct {
+    unsigned char b, g, r;
+} Pixel;
+
+// 色彩處理核心（作業 3），影像須為 24 位元
+// 輸入與輸出分開的核心允許 src 與 dst 指向同一塊記憶體，以便就地處理
+
+// 調整白平衡的 Grey World 方法
+// sampleStep: 估計平均值時的取樣間隔（見 imageStats），1 表示使用所有像素
+void applyGreyWorld(const ImageView *src, ImageView *dst, int sampleStep);
+
+// 使用 Max-RGB 方法進行白平衡調整
+// sampleStep: 估計最大值時的取樣間隔，1 表示使用所有像素
+void applyMaxRGB(const ImageView *src, ImageView *dst, int sampleStep);
+
+// 伽瑪校正（就地處理）
+void applyGammaCorrection(ImageView *img, float gamma);
+
+// 調整色相與飽和度（就地處理），保持 V 不變
+// 以整數運算直接由 RGB 計算結果（不經過色相角度），向量化處理多個像素；
+// 與以浮點數轉成 HSV 再轉回 RGB 的結果相差最多 1
+// hueShift: 色相旋轉的角度（度）
+// saturationFactor: 飽和度的倍率（以 1/256 為單位，上限為 16），結果超過 1 時截斷為 1
+void adjustHueSaturation(ImageView *img, float hueShift, float saturationFactor);
+
+// 提高飽和度（就地處理），等於色相位移為 0 的 adjustHueSaturation
+void increaseSaturation(ImageView *img, float saturationFactor);
+
+// 暖色調整（偏黃）與冷色調整（偏藍）
+void applyWarmEffect(const ImageView *src, ImageView *dst, int warmIntensity);
+void applyCoolEffect(const ImageView *src, ImageView *dst, int coolIntensity);
+
+#endif
@@ -0,0 +1,661 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include "convolution.h"
+#include "image.h"
+#include "cpu_dispatch.h"
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
+#include "trace.h"
+
+#define EXACT_LIMIT 16777216.0f // 2^24：絕對值小於此值的整數都能以 float 精確表示
+
+// ======= 建立核心 =======
+
+static int isIntegral(float v) {
+    return v == floorf(v) && fabsf(v) < EXACT_LIMIT;
+}
+
+static int gcd(int a, int b) {
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// 判斷核心是否為秩 1（某一欄向量乘上某一列向量），是的話填入 colWeights 與 rowWeights
+// 整數核心的欄向量先除以最大公因數，此時列向量也一定是整數，兩次一維卷積的中間結果仍然精確
+static int findSeparable(ConvKernel* kernel, int integral) {
+    int w = kernel->width, h = kernel->height;
+    const float* k = kernel->weights;
+
+    // 以絕對值最大的項作為基準
+    int p = 0, q = 0;
+    float maxAbs = 0.0f;
+    for (int i = 0; i < h; i++) {
+        for (int j = 0; j < w; j++) {
+            if (fabsf(k[i * w + j]) > maxAbs) {
+                maxAbs = fabsf(k[i * w + j]);
+                p = i;
+                q = j;
+            }
+        }
+    }
+    if (maxAbs == 0.0f) return 0;
+
+    if (integral) {
+        int g = 0;
+        for (int i = 0; i < h; i++) g = gcd(g, abs((int)k[i * w + q]));
+        if (k[p * w + q] < 0) g = -g;
+        for (int i = 0; i < h; i++) kernel->colWeights[i] = k[i * w + q] / g;
+        for (int j = 0; j < w; j++) {
+            kernel->rowWeights[j] = k[p * w + j] / kernel->colWeights[p];
+            if (!isIntegral(kernel->rowWeights[j])) return 0;
+        }
+    } else {
+        for (int i = 0; i < h; i++) kernel->colWeights[i] = k[i * w + q];
+        for (int j = 0; j < w; j++) kernel->rowWeights[j] = k[p * w + j] / k[p * w + q];
+    }
+
+    // 驗證每一項都等於欄向量與列向量的乘積
+    float tolerance = integral ? 0.0f : maxAbs * 1e-6f;
+    for (int i = 0; i < h; i++) {
+        for (int j = 0; j < w; j++) {
+            if (fabsf(kernel->colWeights[i] * kernel->rowWeights[j] - k[i * w + j]) > tolerance) return 0;
+        }
+    }
+    return 1;
+}
+
+int convKernelInit(ConvKernel* kernel, int width, int height, const float* weights, float divisor) {
+    if (width < 1 || height < 1 || width > CONV_MAX_SIZE || height > CONV_MAX_SIZE || width % 2 == 0 || height % 2 == 0) {
+        fprintf(stderr, "卷積核心的寬高須為 1 ~ %d 之間的奇數。\n", CONV_MAX_SIZE);
+        return -1;
+    }
+    if (divisor == 0.0f) {
+        fprintf(stderr, "卷積核心的除數不可為 0。\n");
+        return -1;
+    }
+
+    kernel->width = width;
+    kernel->height = height;
+    kernel->divisor = divisor;
+    memcpy(kernel->weights, weights, (size_t)width * height * sizeof(float));
+
+    int integral = isIntegral(divisor);
+    float absSum = 0.0f;
+    kernel->tapCount = 0;
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < width; j++) {
+            float v = weights[i * width + j];
+            integral = integral && isIntegral(v);
+            absSum += fabsf(v);
+            if (v != 0.0f) {
+                ConvTap* tap = &kernel->taps[kernel->tapCount++];
+                tap->dy = i - height / 2;
+                tap->dx = j - width / 2;
+                tap->weight = v;
+            }
+        }
+    }
+    integral = integral && absSum * 255 < EXACT_LIMIT;
+
+    // 可分離而且兩次一維卷積的項數較少時才使用
+    kernel->separable = width > 1 && height > 1 && width + height < kernel->tapCount && findSeparable(kernel, integral);
+    return 0;
+}
+
+// 預設核心
+typedef struct {
+    const char* name;
+    int size;
+    float divisor;
+    float weights[25];
+} ConvPreset;
+
+static const ConvPreset presets[] = {
+    { "box3", 3, 9, { 1, 1, 1, 1, 1, 1, 1, 1, 1 } },
+    { "box5", 5, 25, { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 } },
+    { "gauss3", 3, 16, { 1, 2, 1, 2, 4, 2, 1, 2, 1 } },
+    { "gauss5", 5, 256, { 1, 4, 6, 4, 1, 4, 16, 24, 16, 4, 6, 24, 36, 24, 6, 4, 16, 24, 16, 4, 1, 4, 6, 4, 1 } },
+    { "sharpen", 3, 1, { 0, -1, 0, -1, 5, -1, 0, -1, 0 } },
+    { "laplacian", 3, 1, { 0, -1, 0, -1, 4, -1, 0, -1, 0 } },
+    { "sobel-x", 3, 1, { -1, 0, 1, -2, 0, 2, -1, 0, 1 } },
+    { "sobel-y", 3, 1, { -1, -2, -1, 0, 0, 0, 1, 2, 1 } },
+    { "emboss", 3, 1, { -2, -1, 0, -1, 1, 1, 0, 1, 2 } },
+};
+
+int convKernelParse(ConvKernel* kernel, const char* spec) {
+    for (size_t i = 0; i < sizeof(presets) / sizeof(presets[0]); i++) {
+        if (strcmp(spec, presets[i].name) == 0) {
+            return convKernelInit(kernel, presets[i].size, presets[i].size, presets[i].weights, presets[i].divisor);
+        }
+    }
+
+    // "WxH:w1,w2,...[/divisor]"
+    int width, height, consumed;
+    if (sscanf(spec, "%dx%d:%n", &width, &height, &consumed) != 2) {
+        fprintf(stderr, "無法解析卷積核心 %s。\n", spec);
+        return -1;
+    }
+    if (width < 1 || height < 1 || width > CONV_MAX_SIZE || height > CONV_MAX_SIZE || width % 2 == 0 || height % 2 == 0) {
+        fprintf(stderr, "卷積核心的寬高須為 1 ~ %d 之間的奇數。\n", CONV_MAX_SIZE);
+        return -1;
+    }
+    float weights[CONV_MAX_SIZE * CONV_MAX_SIZE];
+    float divisor = 1.0f;
+    const char* p = spec + consumed;
+    for (int i = 0; i < width * height; i++) {
+        char* end;
+        weights[i] = strtof(p, &end);
+        if (end == p || (i + 1 < width * height && *end != ',')) {
+            fprintf(stderr, "卷積核心 %s 需要 %d 個以逗號分隔的權重。\n", spec, width * height);
+            return -1;
+        }
+        p = (i + 1 < width * height) ? end + 1 : end;
+    }
+    if (*p == '/') {
+        char* end;
+        divisor = strtof(p + 1, &end);
+        p = end;
+    }
+    if (*p != '\0') {
+        fprintf(stderr, "無法解析卷積核心 %s。\n", spec);
+        return -1;
+    }
+    return convKernelInit(kernel, width, height, weights, divisor);
+}
+
+// ======= 逐行卷積 =======
+// 同一行中相鄰像素的同一通道相差 channels 個位元組，把整行當成位元組串處理時，
+// 每個項只是一個固定的位元組偏移，因此各通道不需要拆開即可一次處理 8 個位元組
+
+// 將結果除以除數、截斷為整數並限制在 [0, 255]
+static inline uint8_t finishScalar(float acc, float divisor) {
+    if (divisor != 1.0f) acc /= divisor;
+    return (acc > 255.0f) ? 255 : (acc < 0.0f) ? 0 : (uint8_t)acc;
+}
+
+#if defined(CPU_X86)
+// 各指令集的版本每次處理一個向量寬度的位元組，傳回處理到的位置，剩下不足一個向量的部分由呼叫者處理
+// 乘法與加法分開計算（不使用 FMA），每個位元組的結果與純量版本相同
+
+TARGET_AVX512 static inline __m512 loadBytes16AVX512(const uint8_t* p) {
+    return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)p)));
+}
+
+TARGET_AVX512 static inline void finish16AVX512(__m512 acc, float divisor, uint8_t* out) {
+    if (divisor != 1.0f) acc = _mm512_div_ps(acc, _mm512_set1_ps(divisor));
+    acc = _mm512_min_ps(_mm512_max_ps(acc, _mm512_setzero_ps()), _mm512_set1_ps(255.0f));
+    _mm_storeu_si128((__m128i*)out, _mm512_cvtepi32_epi8(_mm512_cvttps_epi32(acc)));
+}
+
+TARGET_AVX2 static inline __m256 loadBytes8AVX2(const uint8_t* p) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p)));
+}
+
+TARGET_AVX2 static inline void finish8AVX2(__m256 acc, float divisor, uint8_t* out) {
+    if (divisor != 1.0f) acc = _mm256_div_ps(acc, _mm256_set1_ps(divisor));
+    acc = _mm256_min_ps(_mm256_max_ps(acc, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+    __m256i v = _mm256_cvttps_epi32(acc);
+    __m128i v16 = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storel_epi64((__m128i*)out, _mm_packus_epi16(v16, v16));
+}
+
+// 8 個位元組轉為兩個 4 個 float 的向量
+TARGET_SSE2 static inline void loadBytes8SSE2(const uint8_t* p, __m128* lo, __m128* hi) {
+    __m128i v16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128());
+    *lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v16, _mm_setzero_si128()));
+    *hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v16, _mm_setzero_si128()));
+}
+
+TARGET_SSE2 static inline void finish8SSE2(__m128 lo, __m128 hi, float divisor, uint8_t* out) {
+    if (divisor != 1.0f) {
+        lo = _mm_div_ps(lo, _mm_set1_ps(divisor));
+        hi = _mm_div_ps(hi, _mm_set1_ps(divisor));
+    }
+    lo = _mm_min_ps(_mm_max_ps(lo, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+    hi = _mm_min_ps(_mm_max_ps(hi, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+    __m128i v16 = _mm_packs_epi32(_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi));
+    _mm_storel_epi64((__m128i*)out, _mm_packus_epi16(v16, v16));
+}
+
+TARGET_AVX512 static int bytesToBytesAVX512(const uint8_t* const* src, const float* weights, int count, int i, int end, float divisor, uint8_t* out) {
+    for (; i + 16 <= end; i += 16) {
+        __m512 acc = _mm512_setzero_ps();
+        for (int t = 0; t < count; t++) {
+            acc = _mm512_add_ps(acc, _mm512_mul_ps(_mm512_set1_ps(weights[t]), loadBytes16AVX512(src[t] + i)));
+        }
+        finish16AVX512(acc, divisor, out + i);
+    }
+    return i;
+}
+
+TARGET_AVX2 static int bytesToBytesAVX2(const uint8_t* const* src, const float* weights, int count, int i, int end, float divisor, uint8_t* out) {
+    for (; i + 8 <= end; i += 8) {
+        __m256 acc = _mm256_setzero_ps();
+        for (int t = 0; t < count; t++) {
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(weights[t]), loadBytes8AVX2(src[t] + i)));
+        }
+        finish8AVX2(acc, divisor, out + i);
+    }
+    return i;
+}
+
+TARGET_SSE2 static int bytesToBytesSSE2(const uint8_t* const* src, const float* weights, int count, int i, int end, float divisor, uint8_t* out) {
+    for (; i + 8 <= end; i += 8) {
+        __m128 accLo = _mm_setzero_ps(), accHi = _mm_setzero_ps();
+        for (int t = 0; t < count; t++) {
+            __m128 w = _mm_set1_ps(weights[t]), lo, hi;
+            loadBytes8SSE2(src[t] + i, &lo, &hi);
+            accLo = _mm_add_ps(accLo, _mm_mul_ps(w, lo));
+            accHi = _mm_add_ps(accHi, _mm_mul_ps(w, hi));
+        }
+        finish8SSE2(accLo, accHi, divisor, out + i);
+    }
+    return i;
+}
+
+TARGET_AVX512 static int bytesToFloatsAVX512(const uint8_t* const* src, const float* weights, int count, int i, int end, float* out) {
+    for (; i + 16 <= end; i += 16) {
+        __m512 acc = _mm512_setzero_ps();
+        for (int t = 0; t < count; t++) {
+            acc = _mm512_add_ps(acc, _mm512_mul_ps(_mm512_set1_ps(weights[t]), loadBytes16AVX512(src[t] + i)));
+        }
+        _mm512_storeu_ps(out + i, acc);
+    }
+    return i;
+}
+
+TARGET_AVX2 static int bytesToFloatsAVX2(const uint8_t* const* src, const float* weights, int count, int i, int end, float* out) {
+    for (; i + 8 <= end; i += 8) {
+        __m256 acc = _mm256_setzero_ps();
+        for (int t = 0; t < count; t++) {
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(weights[t]), loadBytes8AVX2(src[t] + i)));
+        }
+        _mm256_storeu_ps(out + i, acc);
+    }
+    return i;
+}
+
+TARGET_SSE2 static int bytesToFloatsSSE2(const uint8_t* const* src, const float* weights, int count, int i, int end, float* out) {
+    for (; i + 8 <= end; i += 8) {
+        __m128 accLo = _mm_setzero_ps(), accHi = _mm_setzero_ps();
+        for (int t = 0; t < count; t++) {
+            __m128 w = _mm_set1_ps(weights[t]), lo, hi;
+            loadBytes8SSE2(src[t] + i, &lo, &hi);
+            accLo = _mm_add_ps(accLo, _mm_mul_ps(w, lo));
+            accHi = _mm_add_ps(accHi, _mm_mul_ps(w, hi));
+        }
+        _mm_storeu_ps(out + i, accLo);
+        _mm_storeu_ps(out + i + 4, accHi);
+    }
+    return i;
+}
+
+TARGET_AVX512 static int floatsToBytesAVX512(const float* const* src, const float* weights, int count, int i, int end, float divisor, uint8_t* out) {
+    for (; i + 16 <= end; i += 16) {
+        __m512 acc = _mm512_setzero_ps();
+        for (int t = 0; t < count; t++) {
+            acc = _mm512_add_ps(acc, _mm512_mul_ps(_mm512_set1_ps(weights[t]), _mm512_loadu_ps(src[t] + i)));
+        }
+        finish16AVX512(acc, divisor, out + i);
+    }
+    return i;
+}
+
+TARGET_AVX2 static int floatsToBytesAVX2(const float* const* src, const float* weights, int count, int i, int end, float divisor, uint8_t* out) {
+    for (; i + 8 <= end; i += 8) {
+        __m256 acc = _mm256_setzero_ps();
+        for (int t = 0; t < count; t++) {
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(weights[t]), _mm256_loadu_ps(src[t] + i)));
+        }
+        finish8AVX2(acc, divisor, out + i);
+    }
+    return i;
+}
+
+TARGET_SSE2 static int floatsToBytesSSE2(const float* const* src, const float* weights, int count, int i, int end, float divisor, uint8_t* out) {
+    for (; i + 8 <= end; i += 8) {
+        __m128 accLo = _mm_setzero_ps(), accHi = _mm_setzero_ps();
+        for (int t = 0; t < count; t++) {
+            __m128 w = _mm_set1_ps(weights[t]);
+            accLo = _mm_add_ps(accLo, _mm_mul_ps(w, _mm_loadu_ps(src[t] + i)));
+            accHi = _mm_add_ps(accHi, _mm_mul_ps(w, _mm_loadu_ps(src[t] + i + 4)));
+        }
+        finish8SSE2(accLo, accHi, divisor, out + i);
+    }
+    return i;
+}
+#endif
+
+// out[i] = finish(sum(weights[t] * src[t][i]))，i 介於 begin 與 end 之間
+static void rowBytesToBytes(const uint8_t* const* src, const float* weights, int count, int begin, int end, float divisor, uint8_t* out) {
+    int i = begin;
+#if defined(CPU_X86)
+    CpuLevel level = cpuLevel();
+    if (level >= CPU_AVX512) {
+        i = bytesToBytesAVX512(src, weights, count, i, end, divisor, out);
+    } else if (level >= CPU_AVX2) {
+        i = bytesToBytesAVX2(src, weights, count, i, end, divisor, out);
+    } else if (level >= CPU_SSE2) {
+        i = bytesToBytesSSE2(src, weights, count, i, end, divisor, out);
+    }
+#endif
+    for (; i < end; i++) {
+        float acc = 0.0f;
+        for (int t = 0; t < count; t++) acc += weights[t] * src[t][i];
+        out[i] = finishScalar(acc, divisor);
+    }
+}
+
+// out[i] = sum(weights[t] * src[t][i])，可分離核心的垂直方向
+static void rowBytesToFloats(const uint8_t* const* src, const float* weights, int count, int begin, int end, float* out) {
+    int i = begin;
+#if defined(CPU_X86)
+    CpuLevel level = cpuLevel();
+    if (level >= CPU_AVX512) {
+        i = bytesToFloatsAVX512(src, weights, count, i, end, out);
+    } else if (level >= CPU_AVX2) {
+        i = bytesToFloatsAVX2(src, weights, count, i, end, out);
+    } else if (level >= CPU_SSE2) {
+        i = bytesToFloatsSSE2(src, weights, count, i, end, out);
+    }
+#endif
+    for (; i < end; i++) {
+        float acc = 0.0f;
+        for (int t = 0; t < count; t++) acc += weights[t] * src[t][i];
+        out[i] = acc;
+    }
+}
+
+// out[i] = finish(sum(weights[t] * src[t][i]))，可分離核心的水平方向
+static void rowFloatsToBytes(const float* const* src, const float* weights, int count, int begin, int end, float divisor, uint8_t* out) {
+    int i = begin;
+#if defined(CPU_X86)
+    CpuLevel level = cpuLevel();
+    if (level >= CPU_AVX512) {
+        i = floatsToBytesAVX512(src, weights, count, i, end, divisor, out);
+    } else if (level >= CPU_AVX2) {
+        i = floatsToBytesAVX2(src, weights, count, i, end, divisor, out);
+    } else if (level >= CPU_SSE2) {
+        i = floatsToBytesSSE2(src, weights, count, i, end, divisor, out);
+    }
+#endif
+    for (; i < end; i++) {
+        float acc = 0.0f;
+        for (int t = 0; t < count; t++) acc += weights[t] * src[t][i];
+        out[i] = finishScalar(acc, divisor);
+    }
+}
+
+// 平行處理時各區塊共用的參數
+typedef struct {
+    const ConvKernel* kernel;
+    atomic_int failed;      // 任一區塊記憶體分配失敗時設為 1
+} ConvJob;
+
+// 處理一個區塊（或整張影像）的內部像素
+static void convolveTile(const ImageView* src, ImageView* dst, void* ctx) {
+    ConvJob* job = (ConvJob*)ctx;
+    const ConvKernel* kernel = job->kernel;
+    int ch = src->channels;
+    int rx = kernel->width / 2;
+    int ry = kernel->height / 2;
+    if (src->width <= 2 * rx || src->height <= 2 * ry) return; // 沒有可處理的內部像素
+    int begin = rx * ch;                    // 每行第一個處理的位元組
+    int end = (src->width - rx) * ch;       // 每行最後一個處理的位元組之後
+
+    if (!kernel->separable) {
+        const uint8_t* rows[CONV_MAX_SIZE * CONV_MAX_SIZE];
+        float weights[CONV_MAX_SIZE * CONV_MAX_SIZE];
+        for (int t = 0; t < kernel->tapCount; t++) weights[t] = kernel->taps[t].weight;
+        for (int y = ry; y < src->height - ry; y++) {
+            for (int t = 0; t < kernel->tapCount; t++) {
+                rows[t] = imageRow(src, y + kernel->taps[t].dy) + kernel->taps[t].dx * ch;
+            }
+            rowBytesToBytes(rows, weights, kernel->tapCount, begin, end, kernel->divisor, imageRow(dst, y));
+        }
+        return;
+    }
+
+    // 可分離：先對整行做垂直方向的一維卷積，結果存成 float，再做水平方向
+    int rowBytes = src->width * ch;
+    float* column = (float*)malloc((size_t)rowBytes * sizeof(float));
+    if (!column) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        atomic_store(&job->failed, 1);
+        return;
+    }
+    const uint8_t* rows[CONV_MAX_SIZE];
+    const float* shifted[CONV_MAX_SIZE];
+    for (int kx = 0; kx < kernel->width; kx++) shifted[kx] = column + (kx - rx) * ch;
+    for (int y = ry; y < src->height - ry; y++) {
+        for (int ky = 0; ky < kernel->height; ky++) rows[ky] = imageRow(src, y + ky - ry);
+        rowBytesToFloats(rows, kernel->colWeights, kernel->height, 0, rowBytes, column);
+        rowFloatsToBytes(shifted, kernel->rowWeights, kernel->width, begin, end, kernel->divisor, imageRow(dst, y));
+    }
+    free(column);
+}
+
+int convolveBorder(const ConvKernel* kernel, const ImageView* src, ImageView* dst, const ImageBorder* border) {
+    // 整行當成位元組串處理，鄰居位於相差 channels 個位元組的位置，交錯排列就能用滿向量寬度
+    TRACE_BEGIN(span, "convolve");
+    ConvJob job = { kernel, 0 };
+    ImageKernel imageKernel = { IMAGE_INTERLEAVED, convolveTile, kernel->width / 2, kernel->height / 2 };
+    int result = imageApplyBorder(&imageKernel, src, dst, border, &job);
+    TRACE_END(span, 2 * (uint64_t)src->width * src->height * src->channels, (uint64_t)src->width * src->height);
+    if (result != 0) return -1;
+    return atomic_load(&job.failed) ? -1 : 0;
+}
+
+int convolve(const ConvKernel* kernel, const ImageView* src, ImageView* dst) {
+    return convolveBorder(kernel, src, dst, NULL);
+}
+
+// ======= 多輸出 =======
+// 大小相同的多個核心在同一次走訪中計算：每個位置的鄰居只讀取並轉換為 float 一次，
+// 再以各核心的權重分別累加。各核心的非零項取聯集，缺少的項權重為 0（加上 0 不改變累加值），
+// 累加順序與 convolve 的逐項累加相同，因此結果逐位元相同
+
+#define FANOUT_GROUP 4  // 一次累加的輸出數，累加器都能放在暫存器中
+
+#if defined(CPU_X86)
+// weights[k * taps + t] 為第 k 個輸出在第 t 項的權重；outputs 為常數時迴圈完全展開
+TARGET_AVX512 static inline __attribute__((always_inline)) int fanOutGroupAVX512(const uint8_t* const* src, const float* weights, int taps, int i, int end,
+                                                                                 const float* divisors, uint8_t* const* out, int outputs) {
+    for (; i + 16 <= end; i += 16) {
+        __m512 acc[FANOUT_GROUP];
+        for (int k = 0; k < outputs; k++) acc[k] = _mm512_setzero_ps();
+        for (int t = 0; t < taps; t++) {
+            __m512 v = loadBytes16AVX512(src[t] + i);
+            for (int k = 0; k < outputs; k++) acc[k] = _mm512_add_ps(acc[k], _mm512_mul_ps(_mm512_set1_ps(weights[k * taps + t]), v));
+        }
+        for (int k = 0; k < outputs; k++) finish16AVX512(acc[k], divisors[k], out[k] + i);
+    }
+    return i;
+}
+
+TARGET_AVX2 static inline __attribute__((always_inline)) int fanOutGroupAVX2(const uint8_t* const* src, const float* weights, int taps, int i, int end,
+                                                                             const float* divisors, uint8_t* const* out, int outputs) {
+    for (; i + 8 <= end; i += 8) {
+        __m256 acc[FANOUT_GROUP];
+        for (int k = 0; k < outputs; k++) acc[k] = _mm256_setzero_ps();
+        for (int t = 0; t < taps; t++) {
+            __m256 v = loadBytes8AVX2(src[t] + i);
+            for (int k = 0; k < outputs; k++) acc[k] = _mm256_add_ps(acc[k], _mm256_mul_ps(_mm256_set1_ps(weights[k * taps + t]), v));
+        }
+        for (int k = 0; k < outputs; k++) finish8AVX2(acc[k], divisors[k], out[k] + i);
+    }
+    return i;
+}
+
+TARGET_SSE2 static inline __attribute__((always_inline)) int fanOutGroupSSE2(const uint8_t* const* src, const float* weights, int taps, int i, int end,
+                                                                             const float* divisors, uint8_t* const* out, int outputs) {
+    for (; i + 8 <= end; i += 8) {
+        __m128 accLo[FANOUT_GROUP], accHi[FANOUT_GROUP];
+        for (int k = 0; k < outputs; k++) accLo[k] = accHi[k] = _mm_setzero_ps();
+        for (int t = 0; t < taps; t++) {
+            __m128 lo, hi;
+            loadBytes8SSE2(src[t] + i, &lo, &hi);
+            for (int k = 0; k < outputs; k++) {
+                __m128 w = _mm_set1_ps(weights[k * taps + t]);
+                accLo[k] = _mm_add_ps(accLo[k], _mm_mul_ps(w, lo));
+                accHi[k] = _mm_add_ps(accHi[k], _mm_mul_ps(w, hi));
+            }
+        }
+        for (int k = 0; k < outputs; k++) finish8SSE2(accLo[k], accHi[k], divisors[k], out[k] + i);
+    }
+    return i;
+}
+
+TARGET_AVX512 static int fanOutAVX512(const uint8_t* const* src, const float* weights, int taps, int i, int end,
+                                      const float* divisors, uint8_t* const* out, int outputs) {
+    switch (outputs) {
+    case 1: return fanOutGroupAVX512(src, weights, taps, i, end, divisors, out, 1);
+    case 2: return fanOutGroupAVX512(src, weights, taps, i, end, divisors, out, 2);
+    case 3: return fanOutGroupAVX512(src, weights, taps, i, end, divisors, out, 3);
+    default: return fanOutGroupAVX512(src, weights, taps, i, end, divisors, out, 4);
+    }
+}
+
+TARGET_AVX2 static int fanOutAVX2(const uint8_t* const* src, const float* weights, int taps, int i, int end,
+                                  const float* divisors, uint8_t* const* out, int outputs) {
+    switch (outputs) {
+    case 1: return fanOutGroupAVX2(src, weights, taps, i, end, divisors, out, 1);
+    case 2: return fanOutGroupAVX2(src, weights, taps, i, end, divisors, out, 2);
+    case 3: return fanOutGroupAVX2(src, weights, taps, i, end, divisors, out, 3);
+    default: return fanOutGroupAVX2(src, weights, taps, i, end, divisors, out, 4);
+    }
+}
+
+TARGET_SSE2 static int fanOutSSE2(const uint8_t* const* src, const float* weights, int taps, int i, int end,
+                                  const float* divisors, uint8_t* const* out, int outputs) {
+    switch (outputs) {
+    case 1: return fanOutGroupSSE2(src, weights, taps, i, end, divisors, out, 1);
+    case 2: return fanOutGroupSSE2(src, weights, taps, i, end, divisors, out, 2);
+    case 3: return fanOutGroupSSE2(src, weights, taps, i, end, divisors, out, 3);
+    default: return fanOutGroupSSE2(src, weights, taps, i, end, divisors, out, 4);
+    }
+}
+#endif
+
+// 計算一行中最多 FANOUT_GROUP 個輸出：out[k][i] = finish(sum(weights[k * taps + t] * src[t][i]))
+static void rowFanOut(const uint8_t* const* src, const float* weights, int taps, int begin, int end,
+                      const float* divisors, uint8_t* const* out, int outputs) {
+    int i = begin;
+#if defined(CPU_X86)
+    CpuLevel level = cpuLevel();
+    if (level >= CPU_AVX512) {
+        i = fanOutAVX512(src, weights, taps, i, end, divisors, out, outputs);
+    } else if (level >= CPU_AVX2) {
+        i = fanOutAVX2(src, weights, taps, i, end, divisors, out, outputs);
+    } else if (level >= CPU_SSE2) {
+        i = fanOutSSE2(src, weights, taps, i, end, divisors, out, outputs);
+    }
+#endif
+    for (; i < end; i++) {
+        for (int k = 0; k < outputs; k++) {
+            float acc = 0.0f;
+            for (int t = 0; t < taps; t++) acc += weights[k * taps + t] * src[t][i];
+            out[k][i] = finishScalar(acc, divisors[k]);
+        }
+    }
+}
+
+typedef struct {
+    const ImageView* src;
+    ImageView* dsts;
+    int count;
+    int radiusX, radiusY;
+    int taps;                                       // 各核心非零項的聯集
+    int dy[CONV_MAX_SIZE * CONV_MAX_SIZE];
+    int dx[CONV_MAX_SIZE * CONV_MAX_SIZE];
+    float* weights;                                 // count * taps 個權重
+    float* divisors;
+    int bandHeight;
+} FanOutJob;
+
+static void fanOutTask(int band, void* ctx) {
+    FanOutJob* job = (FanOutJob*)ctx;
+    const ImageView* src = job->src;
+    int ch = src->channels;
+    int yBegin = job->radiusY + band * job->bandHeight;
+    int yEnd = yBegin + job->bandHeight < src->height - job->radiusY ? yBegin + job->bandHeight : src->height - job->radiusY;
+    int begin = job->radiusX * ch;
+    int end = (src->width - job->radiusX) * ch;
+    for (int y = yBegin; y < yEnd; y++) {
+        const uint8_t* rows[CONV_MAX_SIZE * CONV_MAX_SIZE];
+        for (int t = 0; t < job->taps; t++) rows[t] = imageRow(src, y + job->dy[t]) + job->dx[t] * ch;
+        for (int k = 0; k < job->count; k += FANOUT_GROUP) {
+            int outputs = job->count - k < FANOUT_GROUP ? job->count - k : FANOUT_GROUP;
+            uint8_t* out[FANOUT_GROUP];
+            for (int j = 0; j < outputs; j++) out[j] = imageRow(&job->dsts[k + j], y);
+            rowFanOut(rows, job->weights + (size_t)k * job->taps, job->taps, begin, end, job->divisors + k, out, outputs);
+        }
+    }
+}
+
+int convolveFanOut(const ConvKernel* kernels, int count, const ImageView* src, ImageView* dsts) {
+    if (count <= 0) return 0;
+    int width = kernels[0].width, height = kernels[0].height;
+    for (int k = 1; k < count; k++) {
+        if (kernels[k].width != width || kernels[k].height != height) {
+            fprintf(stderr, "多輸出卷積的核心大小須相同。\n");
+            return -1;
+        }
+    }
+    if (src->width <= width / 2 * 2 || src->height <= height / 2 * 2) return 0; // 沒有可處理的內部像素
+
+    TRACE_BEGIN(span, "convolve.fan-out");
+    FanOutJob* job = (FanOutJob*)calloc(1, sizeof(FanOutJob));
+    float* weights = (float*)malloc((size_t)count * width * height * sizeof(float));
+    float* divisors = (float*)malloc((size_t)count * sizeof(float));
+    if (!job || !weights || !divisors) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        free(job);
+        free(weights);
+        free(divisors);
+        return -1;
+    }
+
+    // 依行排列的順序取出任一核心不為 0 的位置
+    int index[CONV_MAX_SIZE * CONV_MAX_SIZE];
+    for (int i = 0; i < width * height; i++) {
+        int used = 0;
+        for (int k = 0; k < count; k++) used = used || kernels[k].weights[i] != 0.0f;
+        if (!used) continue;
+        index[job->taps] = i;
+        job->dy[job->taps] = i / width - height / 2;
+        job->dx[job->taps] = i % width - width / 2;
+        job->taps++;
+    }
+    for (int k = 0; k < count; k++) {
+        for (int t = 0; t < job->taps; t++) weights[k * job->taps + t] = kernels[k].weights[index[t]];
+        divisors[k] = kernels[k].divisor;
+    }
+
+    job->src = src;
+    job->dsts = dsts;
+    job->count = count;
+    job->radiusX = width / 2;
+    job->radiusY = height / 2;
+    job->weights = weights;
+    job->divisors = divisors;
+    int rows = src->height - 2 * job->radiusY;
+    int bands = threadPoolThreads() * 4;
+    job->bandHeight = (rows + bands - 1) / bands;
+    if (job->bandHeight < 1) job->bandHeight = 1;
+    parallelFor((rows + job->bandHeight - 1) / job->bandHeight, fanOutTask, job);
+
+    free(job);
+    free(weights);
+    free(divisors);
+    TRACE_END(span, (uint64_t)(count + 1) * src->width * src->height * src->channels, (uint64_t)src->width * src->height);
+    return 0;
+}
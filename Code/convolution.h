@@ -0,0 +1,62 @@
+#ifndef CONVOLUTION_H
+#define CONVOLUTION_H
+
+#include "bmp_io.h"
+#include "image.h"
+
+#define CONV_MAX_SIZE 15 // 核心的最大寬度與高度
+
+// 卷積核心中的一個非零項
+typedef struct {
+    int dy;         // 相對於中心的行偏移
+    int dx;         // 相對於中心的像素偏移
+    float weight;
+} ConvTap;
+
+// 二維卷積核心：輸出為 sum(weight * 鄰居) / divisor，截斷為整數並限制在 [0, 255]
+// 以 convKernelInit / convKernelParse 建立，會同時找出非零項並判斷是否可分離
+typedef struct {
+    int width;                                      // 核心寬度（奇數）
+    int height;                                     // 核心高度（奇數）
+    float weights[CONV_MAX_SIZE * CONV_MAX_SIZE];   // 依行排列的權重
+    float divisor;                                  // 結果的除數
+
+    int tapCount;                                   // 非零項的數量
+    ConvTap taps[CONV_MAX_SIZE * CONV_MAX_SIZE];    // 非零項
+    int separable;                                  // 核心為秩 1 時改用兩次一維卷積
+    float rowWeights[CONV_MAX_SIZE];                // 可分離時的水平權重
+    float colWeights[CONV_MAX_SIZE];                // 可分離時的垂直權重
+} ConvKernel;
+
+// 建立卷積核心
+// width, height: 核心寬高，須為 1 ~ CONV_MAX_SIZE 之間的奇數
+// weights: width * height 個依行排列的權重
+// divisor: 結果的除數（不可為 0）
+// 權重與除數都是整數、且 sum(|weight|) * 255 < 2^24 時，所有中間結果都是精確的整數，
+// 結果與整數運算完全相同；可分離時也會分解為兩個整數向量
+// 成功傳回 0，參數不合法時傳回 -1
+int convKernelInit(ConvKernel* kernel, int width, int height, const float* weights, float divisor);
+
+// 由文字描述建立卷積核心
+// 可以是預設核心的名稱（box3、box5、gauss3、gauss5、sharpen、laplacian、sobel-x、sobel-y、emboss），
+// 或是 "WxH:w1,w2,...[/divisor]"，例如 "3x3:1,2,1,2,4,2,1,2,1/16"
+// 成功傳回 0，格式錯誤時傳回 -1
+int convKernelParse(ConvKernel* kernel, const char* spec);
+
+// 對影像進行卷積，每個通道分別處理
+// 與作業 2 相同，只處理距離左右邊界至少 width / 2、上下邊界至少 height / 2 的像素，其餘像素保持 dst 原本的內容
+// 影像切成區塊後以多執行緒處理，結果與單執行緒相同；src 與 dst 不可指向同一塊記憶體
+// 成功傳回 0，記憶體不足時傳回 -1
+int convolve(const ConvKernel* kernel, const ImageView* src, ImageView* dst);
+
+// 與 convolve 相同，但依 border 補上影像外的鄰域後處理所有像素（包含邊界），見 imageApplyBorder
+// border 為 NULL 或 BORDER_NONE 時等同 convolve
+int convolveBorder(const ConvKernel* kernel, const ImageView* src, ImageView* dst, const ImageBorder* border);
+
+// 以同一次走訪計算多個大小相同的卷積：每個位置的鄰居只讀取一次，再分別以 kernels[k] 累加到 dsts[k]
+// 處理範圍與 convolve 相同；一律以二維的逐項累加計算，對不可分離的核心與 convolve 的結果逐位元相同，
+// 可分離且權重不是整數的核心則可能因捨入順序不同而有 1 的差異
+// 成功傳回 0，核心大小不同或記憶體不足時傳回 -1
+int convolveFanOut(const ConvKernel* kernels, int count, const ImageView* src, ImageView* dsts);
+
+#endif
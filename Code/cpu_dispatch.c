@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu_dispatch.h"
+
+static const char* const levelNames[] = { "scalar", "sse2", "sse4.1", "avx2", "avx512" };
+
+static int currentLevel = -1;   // -1 表示尚未決定
+
+// CPU 支援的最高等級
+static CpuLevel detectLevel(void) {
+#if defined(CPU_X86)
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("sse2")) return CPU_SCALAR;
+    if (!__builtin_cpu_supports("ssse3") || !__builtin_cpu_supports("sse4.1")) return CPU_SSE2;
+    if (!__builtin_cpu_supports("avx2")) return CPU_SSE41;
+    if (!__builtin_cpu_supports("avx512f") || !__builtin_cpu_supports("avx512bw") ||
+        !__builtin_cpu_supports("avx512vl") || !__builtin_cpu_supports("avx512vbmi")) return CPU_AVX2;
+    return CPU_AVX512;
+#else
+    return CPU_SCALAR;
+#endif
+}
+
+const char* cpuLevelName(CpuLevel level) {
+    return levelNames[level];
+}
+
+int cpuParseLevel(const char* name, CpuLevel* level) {
+    for (int i = 0; i <= CPU_AVX512; i++) {
+        if (strcmp(name, levelNames[i]) == 0) {
+            *level = (CpuLevel)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void cpuSetLevel(CpuLevel level) {
+    CpuLevel supported = detectLevel();
+    currentLevel = level < supported ? level : supported;
+}
+
+CpuLevel cpuLevel(void) {
+    if (currentLevel < 0) {
+        CpuLevel level = CPU_AVX512;
+        const char* env = getenv("DIP_ISA");
+        if (env && *env && cpuParseLevel(env, &level) != 0) {
+            fprintf(stderr, "無法辨識 DIP_ISA=%s，改用 CPU 支援的最高等級。\n", env);
+            level = CPU_AVX512;
+        }
+        cpuSetLevel(level);
+    }
+    return (CpuLevel)currentLevel;
+}
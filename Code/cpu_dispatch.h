@@ -0,0 +1,39 @@
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+// 執行期選擇向量指令集：各核心的向量版本以 GCC 的 target 屬性個別編譯，
+// 因此不需要 -march=native，同一個執行檔在舊的 CPU 上也能執行，在新的 CPU 上使用較寬的向量
+//
+// 每個等級包含前一個等級的所有指令
+typedef enum {
+    CPU_SCALAR,     // 不使用向量指令
+    CPU_SSE2,       // x86-64 的基本指令集
+    CPU_SSE41,      // SSSE3 + SSE4.1
+    CPU_AVX2,       // AVX2（不使用 FMA，結果與其他等級逐位元相同）
+    CPU_AVX512      // AVX-512 F / BW / VL / VBMI
+} CpuLevel;
+
+// 目前使用的等級：第一次呼叫時以 CPUID 偵測，環境變數 DIP_ISA 可以指定較低的等級
+// （scalar、sse2、sse4.1、avx2、avx512，高於 CPU 支援的等級時改用 CPU 支援的最高等級）
+CpuLevel cpuLevel(void);
+
+// 指定使用的等級（高於 CPU 支援的等級時改用 CPU 支援的最高等級）
+void cpuSetLevel(CpuLevel level);
+
+// 等級的名稱（與 DIP_ISA 的寫法相同）
+const char* cpuLevelName(CpuLevel level);
+
+// 解析等級的名稱，成功傳回 0，無法辨識時傳回 -1
+int cpuParseLevel(const char* name, CpuLevel* level);
+
+// 各等級的向量函式加上對應的屬性，呼叫前須先確認 cpuLevel() 不低於該等級
+// GCC 的 AVX-512F 同時啟用 FMA，另外關閉乘加合併，浮點結果才會與其他等級相同
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_X86 1
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_SSE41 __attribute__((target("ssse3,sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512vl,avx512vbmi"), optimize("fp-contract=off")))
+#endif
+
+#endif
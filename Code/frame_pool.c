@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frame_pool.h"
+#include "trace.h"
+
+void framePoolInit(FramePool* pool, size_t cacheLimit, int prefault) {
+    memset(pool, 0, sizeof(*pool));
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->cacheLimit = cacheLimit;
+    pool->prefault = prefault;
+}
+
+// 從串列中移除並釋放閒置的緩衝區，直到閒置容量不超過 limit（呼叫時須持有鎖）
+static void releaseIdle(FramePool* pool, size_t limit) {
+    FrameBlock** link = &pool->blocks;
+    while (*link && pool->stats.bytesReserved - pool->stats.bytesInUse > limit) {
+        FrameBlock* block = *link;
+        if (block->inUse) {
+            link = &block->next;
+            continue;
+        }
+        *link = block->next;
+        pool->stats.bytesReserved -= block->size;
+        free(block->data);
+        free(block);
+    }
+}
+
+void framePoolDestroy(FramePool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    releaseIdle(pool, 0);
+    pool->cacheLimit = 0; // 之後歸還的緩衝區直接釋放
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void* framePoolAcquire(FramePool* pool, size_t size, size_t alignment) {
+    if (alignment < sizeof(void*)) alignment = sizeof(void*);
+    size_t unit = alignment > FRAME_POOL_PAGE ? alignment : FRAME_POOL_PAGE;
+    size = (size + unit - 1) / unit * unit;
+    if (size == 0) size = unit;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stats.acquires++;
+    for (FrameBlock* block = pool->blocks; block; block = block->next) {
+        if (!block->inUse && block->size == size && block->alignment % alignment == 0) {
+            block->inUse = 1;
+            pool->stats.reuses++;
+            pool->stats.bytesInUse += size;
+            if (pool->stats.bytesInUse > pool->stats.peakBytesInUse) pool->stats.peakBytesInUse = pool->stats.bytesInUse;
+            pthread_mutex_unlock(&pool->lock);
+            return block->data;
+        }
+    }
+    int prefault = pool->prefault;
+    pthread_mutex_unlock(&pool->lock);
+
+    // 沒有可用的閒置緩衝區：在鎖外向系統配置，避免其他執行緒等待
+    TRACE_BEGIN(span, "pool.allocate");
+    FrameBlock* block = (FrameBlock*)malloc(sizeof(FrameBlock));
+    void* data = aligned_alloc(alignment, size);
+    if (!block || !data) {
+        free(block);
+        free(data);
+        return NULL;
+    }
+    if (prefault) {
+        // 每頁寫入一次，讓核心在這裡就配置實體頁面，而不是在第一次處理影像時
+        volatile uint8_t* p = (volatile uint8_t*)data;
+        for (size_t offset = 0; offset < size; offset += FRAME_POOL_PAGE) p[offset] = 0;
+    }
+    TRACE_END(span, prefault ? size : 0, 0);
+    block->data = data;
+    block->size = size;
+    block->alignment = alignment;
+    block->inUse = 1;
+
+    pthread_mutex_lock(&pool->lock);
+    block->next = pool->blocks;
+    pool->blocks = block;
+    pool->stats.allocations++;
+    pool->stats.bytesInUse += size;
+    pool->stats.bytesReserved += size;
+    if (pool->stats.bytesInUse > pool->stats.peakBytesInUse) pool->stats.peakBytesInUse = pool->stats.bytesInUse;
+    if (pool->stats.bytesReserved > pool->stats.peakBytesReserved) pool->stats.peakBytesReserved = pool->stats.bytesReserved;
+    pthread_mutex_unlock(&pool->lock);
+    return data;
+}
+
+void framePoolRelease(FramePool* pool, void* data) {
+    if (!data) return;
+    pthread_mutex_lock(&pool->lock);
+    FrameBlock* block = pool->blocks;
+    while (block && block->data != data) block = block->next;
+    if (!block || !block->inUse) {
+        pthread_mutex_unlock(&pool->lock);
+        fprintf(stderr, "歸還的緩衝區不屬於此緩衝區池。\n");
+        return;
+    }
+    block->inUse = 0;
+    pool->stats.bytesInUse -= block->size;
+    releaseIdle(pool, pool->cacheLimit);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void framePoolTrim(FramePool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    releaseIdle(pool, 0);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void framePoolGetStats(FramePool* pool, FramePoolStats* stats) {
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static FramePool sharedPool;
+static pthread_once_t sharedOnce = PTHREAD_ONCE_INIT;
+
+static void sharedInit(void) {
+    size_t megabytes = FRAME_POOL_DEFAULT_CACHE_MB;
+    const char* env = getenv("DIP_POOL_MB");
+    if (env && *env) {
+        char* end;
+        long value = strtol(env, &end, 10);
+        if (*end == '\0' && value >= 0) {
+            megabytes = (size_t)value;
+        } else {
+            fprintf(stderr, "無法辨識 DIP_POOL_MB=%s，使用預設值 %d。\n", env, FRAME_POOL_DEFAULT_CACHE_MB);
+        }
+    }
+    const char* prefault = getenv("DIP_POOL_PREFAULT");
+    framePoolInit(&sharedPool, megabytes << 20, prefault && strcmp(prefault, "1") == 0);
+}
+
+FramePool* framePoolShared(void) {
+    pthread_once(&sharedOnce, sharedInit);
+    return &sharedPool;
+}
@@ -0,0 +1,72 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// 影像緩衝區池：釋放的緩衝區不還給系統，依 (大小, 對齊) 留給之後相同大小的要求重複使用
+// 批次處理與多階段的處理流程每張影像都需要相同大小的緩衝區，重複使用可以避免反覆 malloc / free
+// 大塊記憶體，以及每次第一次寫入新配置的頁面時的 page fault
+//
+// 大小先進位到 FRAME_POOL_PAGE 的倍數後比對，只重複使用大小相同、對齊足夠的緩衝區
+// 可以在多個執行緒中同時取得與歸還
+
+#define FRAME_POOL_PAGE 4096                // 大小的進位單位，也是預先觸碰頁面的間隔
+#define FRAME_POOL_DEFAULT_CACHE_MB 256     // 共用池預設最多保留的閒置容量
+
+// 緩衝區池的統計
+typedef struct {
+    size_t bytesInUse;          // 目前借出的位元組數
+    size_t peakBytesInUse;      // 借出位元組數的最高值（high-water mark）
+    size_t bytesReserved;       // 向系統配置且尚未釋放的位元組數（借出 + 閒置）
+    size_t peakBytesReserved;   // 配置位元組數的最高值
+    uint64_t acquires;          // 取得緩衝區的次數
+    uint64_t reuses;            // 其中重複使用閒置緩衝區的次數
+    uint64_t allocations;       // 向系統配置新緩衝區的次數
+} FramePoolStats;
+
+// 池中的一塊緩衝區
+typedef struct FrameBlock {
+    void* data;
+    size_t size;                // 配置的大小（FRAME_POOL_PAGE 的倍數）
+    size_t alignment;
+    int inUse;
+    struct FrameBlock* next;
+} FrameBlock;
+
+typedef struct {
+    pthread_mutex_t lock;
+    FrameBlock* blocks;         // 所有緩衝區（借出與閒置），新配置的在前
+    size_t cacheLimit;          // 閒置緩衝區的總容量上限，超過時釋放閒置的緩衝區
+    int prefault;               // 1 表示新配置的緩衝區先觸碰每一頁
+    FramePoolStats stats;
+} FramePool;
+
+// 初始化緩衝區池
+// cacheLimit: 最多保留的閒置位元組數（0 表示不保留，歸還時直接釋放）
+// prefault: 1 表示新配置的緩衝區在交給呼叫者前先觸碰每一頁，讓 page fault 集中在配置時發生
+void framePoolInit(FramePool* pool, size_t cacheLimit, int prefault);
+
+// 釋放池中所有閒置的緩衝區；仍借出的緩衝區在歸還時才釋放
+void framePoolDestroy(FramePool* pool);
+
+// 取得至少 size 個位元組、以 alignment（2 的冪次）對齊的緩衝區，內容未初始化
+// 有大小相同的閒置緩衝區時直接重複使用；記憶體不足時傳回 NULL
+void* framePoolAcquire(FramePool* pool, size_t size, size_t alignment);
+
+// 歸還以 framePoolAcquire 取得的緩衝區（NULL 時不做任何事）
+void framePoolRelease(FramePool* pool, void* data);
+
+// 釋放所有閒置的緩衝區
+void framePoolTrim(FramePool* pool);
+
+// 取得統計
+void framePoolGetStats(FramePool* pool, FramePoolStats* stats);
+
+// Image 與批次處理共用的緩衝區池，第一次使用時建立
+// 環境變數 DIP_POOL_MB 設定保留的閒置容量（預設 FRAME_POOL_DEFAULT_CACHE_MB，0 表示不保留），
+// DIP_POOL_PREFAULT=1 時新配置的緩衝區先觸碰每一頁
+FramePool* framePoolShared(void);
+
+#endif
@@ -0,0 +1,621 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "gaussian.h"
+#include "image.h"
+#include "frame_pool.h"
+#include "cpu_dispatch.h"
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
+#include "trace.h"
+
+// 遞迴會累積誤差，乘加合併（-march=native 時 GCC 會把純量與 intrinsic 的乘法加法合併成 FMA）會讓各等級的結果不同
+#pragma GCC optimize("fp-contract=off")
+
+#define COLUMN_ALIGN 64     // 垂直方向每個工作的欄數（float 個數）取此倍數，區段從快取行的邊界開始
+
+// Triggs & Sdika (2006) 的邊界矩陣 M：由前往後最後三個輸出 u[N-1..N-3] 減去穩態值後乘上 M，
+// 得到（未正規化的）由後往前的 v[N-1..N+1]；這裡再乘上前一步的伴隨矩陣（u[N] 由 u[N-1..N-3] 推得），
+// 直接得到遞迴開始前需要的 v[N..N+2]，兩個方向各乘一次 B 後偏差只剩一次 B
+// 大 sigma 時 M 的元素很大且互相抵銷，必須以遞迴實際使用的 float 係數計算；
+// 不可內嵌：GCC 12 -O2 的 SLP 向量化會把呼叫端尚未捨入成 float 的 double 商直接代入，M 因而偏差
+__attribute__((noinline)) static void boundaryMatrix(RecursiveGaussian* g) {
+    double c1 = g->a1, c2 = g->a2, c3 = g->a3;
+    double scale = 1.0 / ((1.0 + c1 - c2 + c3) * (1.0 - c1 - c2 - c3) * (1.0 + c2 + (c1 - c3) * c3));
+    double m[3][3] = {
+        { -c3 * c1 + 1.0 - c3 * c3 - c2, (c3 + c1) * (c2 + c3 * c1), c3 * (c1 + c3 * c2) },
+        { c1 + c3 * c2, -(c2 - 1.0) * (c2 + c3 * c1), -c3 * (c3 * c1 + c3 * c3 + c2 - 1.0) },
+        { c3 * c1 + c2 + c1 * c1 - c2 * c2, c1 * c2 + c3 * c2 * c2 - c1 * c3 * c3 - c3 * c3 * c3 - c3 * c2 + c3, c3 * (c1 + c3 * c2) }
+    };
+    double step[3][3] = { { c1, c2, c3 }, { 1.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0 } };
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            double sum = 0.0;
+            for (int k = 0; k < 3; k++) sum += m[i][k] * step[k][j];
+            g->boundary[i][j] = g->b * scale * sum;
+        }
+    }
+}
+
+int recursiveGaussianInit(RecursiveGaussian* g, double sigma) {
+    if (!(sigma >= 0.5 && sigma <= GAUSSIAN_MAX_SIGMA)) { // 同時排除 NaN
+        fprintf(stderr, "高斯模糊的 sigma 須介於 0.5 與 %g 之間。\n", GAUSSIAN_MAX_SIGMA);
+        return -1;
+    }
+    // Young & van Vliet (1995) 的公式 (11b) 與 (8c)
+    double q = sigma >= 2.5 ? 0.98711 * sigma - 0.96330 : 3.97156 - 4.14554 * sqrt(1.0 - 0.26891 * sigma);
+    double b0 = 1.57825 + 2.44413 * q + 1.4281 * q * q + 0.422205 * q * q * q;
+    double b1 = 2.44413 * q + 2.85619 * q * q + 1.26661 * q * q * q;
+    double b2 = -(1.4281 * q * q + 1.26661 * q * q * q);
+    double b3 = 0.422205 * q * q * q;
+    g->a1 = (float)(b1 / b0);
+    g->a2 = (float)(b2 / b0);
+    g->a3 = (float)(b3 / b0);
+    g->b = 1.0f - (g->a1 + g->a2 + g->a3); // 權重總和為 1，常數輸入的輸出不變
+    if (!(g->b > 0.0f)) { // 上限內不會發生，保留檢查以免日後調整上限時靜默地輸出常數
+        fprintf(stderr, "高斯模糊的 sigma 太大，遞迴係數超出 float 的精度。\n");
+        return -1;
+    }
+
+    boundaryMatrix(g);
+    return 0;
+}
+
+// 遞迴的一步：out = (b * x + (a2 * p2 + a3 * p3)) + a1 * p1
+// 前一個輸出 p1 最後才加入，相依鏈只有一次乘法與一次加法；其餘的項可以提早計算
+// 向量版本的乘法與加法順序與純量相同（不使用 FMA），各等級的結果逐位元相同
+static inline float recurse(const RecursiveGaussian* g, float x, float p1, float p2, float p3) {
+    return (g->b * x + (g->a2 * p2 + g->a3 * p3)) + g->a1 * p1;
+}
+
+// 由後往前遞迴開始前，最後一個像素之後三個位置的輸出 state[0..2]（依序為 p1、p2、p3）
+// edge: 最後一個輸入像素；u0、u1、u2: 由前往後的最後三個輸出（不足三個時以第一個像素補上，即由前往後的初始值）
+// 各等級都以這個純量函式計算初始值，結果逐位元相同
+static inline void backwardState(const RecursiveGaussian* g, float edge, float u0, float u1, float u2, float* state) {
+    double d0 = (double)u0 - edge, d1 = (double)u1 - edge, d2 = (double)u2 - edge;
+    for (int k = 0; k < 3; k++) {
+        state[k] = (float)(edge + (g->boundary[k][0] * d0 + g->boundary[k][1] * d1 + g->boundary[k][2] * d2));
+    }
+}
+
+// ======= 水平方向 =======
+// 同一行的遞迴必須依序進行；向量版本一次處理相鄰的 4 / 8 行：每次載入各行的 4 / 8 個 float 並轉置，
+// 讓每個向量的各個 lane 是不同行的同一位置，遞迴就能以向量一次推進多行
+
+// 一行的每個通道分別由左往右、再由右往左遞迴，結果存成 float
+static void horizontalRow(const RecursiveGaussian* g, const uint8_t* src, float* out, int width, int ch) {
+    for (int c = 0; c < ch; c++) {
+        float p1 = src[c], p2 = p1, p3 = p1;
+        for (int x = 0; x < width; x++) {
+            float v = recurse(g, src[x * ch + c], p1, p2, p3);
+            out[x * ch + c] = v;
+            p3 = p2;
+            p2 = p1;
+            p1 = v;
+        }
+        float state[3];
+        backwardState(g, src[(width - 1) * ch + c], p1, p2, p3, state);
+        p1 = state[0];
+        p2 = state[1];
+        p3 = state[2];
+        for (int x = width - 1; x >= 0; x--) {
+            float v = recurse(g, out[x * ch + c], p1, p2, p3);
+            out[x * ch + c] = v;
+            p3 = p2;
+            p2 = p1;
+            p1 = v;
+        }
+    }
+}
+
+#if defined(CPU_X86)
+// 向量版本由右往左的初始值：row 為輸入，out 為由前往後的結果（count 個 float），c 為通道
+static void backwardRowState(const RecursiveGaussian* g, const uint8_t* row, const float* out, int count, int ch, int c, float* state) {
+    float u[3];
+    for (int k = 0; k < 3; k++) {
+        int p = count - (k + 1) * ch + c;
+        u[k] = p >= 0 ? out[p] : row[c];
+    }
+    backwardState(g, row[count - ch + c], u[0], u[1], u[2], state);
+}
+
+TARGET_AVX2 static inline void transpose8AVX2(__m256* r) {
+    __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]), t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]), t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]), t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]), t7 = _mm256_unpackhi_ps(r[6], r[7]);
+    __m256 s0 = _mm256_shuffle_ps(t0, t2, 0x44), s1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+    __m256 s2 = _mm256_shuffle_ps(t1, t3, 0x44), s3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+    __m256 s4 = _mm256_shuffle_ps(t4, t6, 0x44), s5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+    __m256 s6 = _mm256_shuffle_ps(t5, t7, 0x44), s7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+    r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+    r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+    r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+    r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+    r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+    r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+    r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+    r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// 向量的一步，運算順序與 recurse 相同
+TARGET_AVX2 static inline __m256 recurseAVX2(__m256 b, __m256 a1, __m256 a2, __m256 a3, __m256 x, __m256 p1, __m256 p2, __m256 p3) {
+    __m256 rest = _mm256_add_ps(_mm256_mul_ps(b, x), _mm256_add_ps(_mm256_mul_ps(a2, p2), _mm256_mul_ps(a3, p3)));
+    return _mm256_add_ps(rest, _mm256_mul_ps(a1, p1));
+}
+
+// 相鄰 8 行的水平方向遞迴：rows 為輸入，outs 為各行的輸出，每行 count 個 float
+// 位置 p 的遞迴使用 p - ch、p - 2ch、p - 3ch 的結果；w 保留最近三組（24 個位置）轉置後的向量，
+// ch 為常數時展開後所有索引都是常數，歷史值留在暫存器中，不經過記憶體
+TARGET_AVX2 static inline __attribute__((always_inline)) void horizontalGroupAVX2(const RecursiveGaussian* g, const uint8_t* const* rows,
+                                                                                   float* const* outs, int count, int ch) {
+    __m256 b = _mm256_set1_ps(g->b), a1 = _mm256_set1_ps(g->a1), a2 = _mm256_set1_ps(g->a2), a3 = _mm256_set1_ps(g->a3);
+    __m256 edge[IMAGE_MAX_CHANNELS];
+    __m256 w[24], t[8];
+    float block[8][8] __attribute__((aligned(32)));
+
+    // 由左往右：w[0..15] 為前兩組的結果，w[16..23] 為本組；第一組之前以各通道的邊緣值填滿
+    for (int c = 0; c < ch; c++) edge[c] = _mm256_setr_ps(rows[0][c], rows[1][c], rows[2][c], rows[3][c], rows[4][c], rows[5][c], rows[6][c], rows[7][c]);
+    for (int q = 0; q < 16; q++) w[q] = edge[((q - 16) % ch + ch) % ch];
+    for (int p0 = 0; p0 < count; p0 += 8) {
+        int n = count - p0 < 8 ? count - p0 : 8;
+        if (n == 8) {
+            for (int r = 0; r < 8; r++) t[r] = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(rows[r] + p0))));
+        } else {
+            for (int r = 0; r < 8; r++) {
+                for (int j = 0; j < 8; j++) block[r][j] = j < n ? rows[r][p0 + j] : 0.0f;
+                t[r] = _mm256_load_ps(block[r]);
+            }
+        }
+        transpose8AVX2(t);
+        // 不足一組時多算的位置只會被之後的位置使用，不影響前面 n 個結果
+#pragma GCC unroll 8
+        for (int j = 0; j < 8; j++) {
+            w[16 + j] = recurseAVX2(b, a1, a2, a3, t[j], w[16 + j - ch], w[16 + j - 2 * ch], w[16 + j - 3 * ch]);
+            t[j] = w[16 + j];
+        }
+        transpose8AVX2(t);
+        for (int r = 0; r < 8; r++) {
+            if (n == 8) {
+                _mm256_storeu_ps(outs[r] + p0, t[r]);
+            } else {
+                _mm256_store_ps(block[r], t[r]);
+                memcpy(outs[r] + p0, block[r], n * sizeof(float));
+            }
+        }
+        for (int q = 0; q < 16; q++) w[q] = w[q + 8];
+    }
+
+    // 由右往左：w[0..7] 為本組，w[8..23] 為後兩組的結果；最後一個像素之後依序填入各通道的初始值
+    int last = (count - 1) / 8 * 8;
+    __m256 after[3][IMAGE_MAX_CHANNELS];
+    for (int c = 0; c < ch; c++) {
+        float state[3][8] __attribute__((aligned(32)));
+        for (int r = 0; r < 8; r++) {
+            float s[3];
+            backwardRowState(g, rows[r], outs[r], count, ch, c, s);
+            for (int k = 0; k < 3; k++) state[k][r] = s[k];
+        }
+        for (int k = 0; k < 3; k++) after[k][c] = _mm256_load_ps(state[k]);
+    }
+    for (int q = count - last; q < 24; q++) {
+        int k = (last + q - count) / ch;
+        w[q] = after[k < 2 ? k : 2][(last + q) % ch];
+    }
+    for (int p0 = last; p0 >= 0; p0 -= 8) {
+        int n = count - p0 < 8 ? count - p0 : 8;
+        for (int r = 0; r < 8; r++) {
+            if (n == 8) {
+                t[r] = _mm256_loadu_ps(outs[r] + p0);
+            } else {
+                memcpy(block[r], outs[r] + p0, n * sizeof(float));
+                t[r] = _mm256_load_ps(block[r]);
+            }
+        }
+        transpose8AVX2(t);
+        if (n == 8) {
+#pragma GCC unroll 8
+            for (int j = 7; j >= 0; j--) {
+                w[j] = recurseAVX2(b, a1, a2, a3, t[j], w[j + ch], w[j + 2 * ch], w[j + 3 * ch]);
+                t[j] = w[j];
+            }
+        } else {
+            // 最右邊不足一組：只計算實際存在的位置，之後的位置保留邊緣值
+            for (int j = n - 1; j >= 0; j--) {
+                w[j] = recurseAVX2(b, a1, a2, a3, t[j], w[j + ch], w[j + 2 * ch], w[j + 3 * ch]);
+                t[j] = w[j];
+            }
+        }
+        transpose8AVX2(t);
+        for (int r = 0; r < 8; r++) {
+            if (n == 8) {
+                _mm256_storeu_ps(outs[r] + p0, t[r]);
+            } else {
+                _mm256_store_ps(block[r], t[r]);
+                memcpy(outs[r] + p0, block[r], n * sizeof(float));
+            }
+        }
+        for (int q = 23; q >= 8; q--) w[q] = w[q - 8];
+    }
+}
+
+TARGET_AVX2 static void horizontalRowsAVX2(const RecursiveGaussian* g, const uint8_t* const* rows, float* const* outs, int count, int ch) {
+    switch (ch) {
+    case 1: horizontalGroupAVX2(g, rows, outs, count, 1); break;
+    case 2: horizontalGroupAVX2(g, rows, outs, count, 2); break;
+    case 3: horizontalGroupAVX2(g, rows, outs, count, 3); break;
+    default: horizontalGroupAVX2(g, rows, outs, count, 4); break;
+    }
+}
+
+TARGET_SSE2 static inline __m128 recurseSSE2(__m128 b, __m128 a1, __m128 a2, __m128 a3, __m128 x, __m128 p1, __m128 p2, __m128 p3) {
+    __m128 rest = _mm_add_ps(_mm_mul_ps(b, x), _mm_add_ps(_mm_mul_ps(a2, p2), _mm_mul_ps(a3, p3)));
+    return _mm_add_ps(rest, _mm_mul_ps(a1, p1));
+}
+
+// 相鄰 4 行的水平方向遞迴，做法與 horizontalGroupAVX2 相同，w 保留最近四組（16 個位置）
+TARGET_SSE2 static inline __attribute__((always_inline)) void horizontalGroupSSE2(const RecursiveGaussian* g, const uint8_t* const* rows,
+                                                                                   float* const* outs, int count, int ch) {
+    __m128 b = _mm_set1_ps(g->b), a1 = _mm_set1_ps(g->a1), a2 = _mm_set1_ps(g->a2), a3 = _mm_set1_ps(g->a3);
+    __m128 edge[IMAGE_MAX_CHANNELS];
+    __m128 w[16], t[4];
+    float block[4][4] __attribute__((aligned(16)));
+
+    for (int c = 0; c < ch; c++) edge[c] = _mm_setr_ps(rows[0][c], rows[1][c], rows[2][c], rows[3][c]);
+    for (int q = 0; q < 12; q++) w[q] = edge[((q - 12) % ch + ch) % ch];
+    for (int p0 = 0; p0 < count; p0 += 4) {
+        int n = count - p0 < 4 ? count - p0 : 4;
+        for (int r = 0; r < 4; r++) {
+            if (n == 4) {
+                int32_t bytes;
+                memcpy(&bytes, rows[r] + p0, 4);
+                __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), _mm_setzero_si128());
+                t[r] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, _mm_setzero_si128()));
+            } else {
+                for (int j = 0; j < 4; j++) block[r][j] = j < n ? rows[r][p0 + j] : 0.0f;
+                t[r] = _mm_load_ps(block[r]);
+            }
+        }
+        _MM_TRANSPOSE4_PS(t[0], t[1], t[2], t[3]);
+#pragma GCC unroll 4
+        for (int j = 0; j < 4; j++) {
+            w[12 + j] = recurseSSE2(b, a1, a2, a3, t[j], w[12 + j - ch], w[12 + j - 2 * ch], w[12 + j - 3 * ch]);
+            t[j] = w[12 + j];
+        }
+        _MM_TRANSPOSE4_PS(t[0], t[1], t[2], t[3]);
+        for (int r = 0; r < 4; r++) {
+            if (n == 4) {
+                _mm_storeu_ps(outs[r] + p0, t[r]);
+            } else {
+                _mm_store_ps(block[r], t[r]);
+                memcpy(outs[r] + p0, block[r], n * sizeof(float));
+            }
+        }
+        for (int q = 0; q < 12; q++) w[q] = w[q + 4];
+    }
+
+    int last = (count - 1) / 4 * 4;
+    __m128 after[3][IMAGE_MAX_CHANNELS];
+    for (int c = 0; c < ch; c++) {
+        float state[3][4] __attribute__((aligned(16)));
+        for (int r = 0; r < 4; r++) {
+            float s[3];
+            backwardRowState(g, rows[r], outs[r], count, ch, c, s);
+            for (int k = 0; k < 3; k++) state[k][r] = s[k];
+        }
+        for (int k = 0; k < 3; k++) after[k][c] = _mm_load_ps(state[k]);
+    }
+    for (int q = count - last; q < 16; q++) {
+        int k = (last + q - count) / ch;
+        w[q] = after[k < 2 ? k : 2][(last + q) % ch];
+    }
+    for (int p0 = last; p0 >= 0; p0 -= 4) {
+        int n = count - p0 < 4 ? count - p0 : 4;
+        for (int r = 0; r < 4; r++) {
+            if (n == 4) {
+                t[r] = _mm_loadu_ps(outs[r] + p0);
+            } else {
+                memcpy(block[r], outs[r] + p0, n * sizeof(float));
+                t[r] = _mm_load_ps(block[r]);
+            }
+        }
+        _MM_TRANSPOSE4_PS(t[0], t[1], t[2], t[3]);
+        if (n == 4) {
+#pragma GCC unroll 4
+            for (int j = 3; j >= 0; j--) {
+                w[j] = recurseSSE2(b, a1, a2, a3, t[j], w[j + ch], w[j + 2 * ch], w[j + 3 * ch]);
+                t[j] = w[j];
+            }
+        } else {
+            for (int j = n - 1; j >= 0; j--) {
+                w[j] = recurseSSE2(b, a1, a2, a3, t[j], w[j + ch], w[j + 2 * ch], w[j + 3 * ch]);
+                t[j] = w[j];
+            }
+        }
+        _MM_TRANSPOSE4_PS(t[0], t[1], t[2], t[3]);
+        for (int r = 0; r < 4; r++) {
+            if (n == 4) {
+                _mm_storeu_ps(outs[r] + p0, t[r]);
+            } else {
+                _mm_store_ps(block[r], t[r]);
+                memcpy(outs[r] + p0, block[r], n * sizeof(float));
+            }
+        }
+        for (int q = 15; q >= 4; q--) w[q] = w[q - 4];
+    }
+}
+
+TARGET_SSE2 static void horizontalRowsSSE2(const RecursiveGaussian* g, const uint8_t* const* rows, float* const* outs, int count, int ch) {
+    switch (ch) {
+    case 1: horizontalGroupSSE2(g, rows, outs, count, 1); break;
+    case 2: horizontalGroupSSE2(g, rows, outs, count, 2); break;
+    case 3: horizontalGroupSSE2(g, rows, outs, count, 3); break;
+    default: horizontalGroupSSE2(g, rows, outs, count, 4); break;
+    }
+}
+#endif
+
+// 水平方向處理第 y0 行到 y1 之前的行，結果寫入 out（每行 rowFloats 個 float）
+static void horizontalRows(const RecursiveGaussian* g, const ImageView* src, float* out, int rowFloats, int y0, int y1) {
+    int y = y0;
+#if defined(CPU_X86)
+    // AVX-512 的等級也使用 8 行一組：遞迴的瓶頸在相依的延遲，更寬的轉置沒有好處
+    CpuLevel level = cpuLevel();
+    int group = level >= CPU_AVX2 ? 8 : (level >= CPU_SSE2 ? 4 : 0);
+    for (; group > 0 && y + group <= y1; y += group) {
+        const uint8_t* rows[8];
+        float* outs[8];
+        for (int r = 0; r < group; r++) {
+            rows[r] = imageRow(src, y + r);
+            outs[r] = out + (size_t)(y + r) * rowFloats;
+        }
+        if (group == 8) {
+            horizontalRowsAVX2(g, rows, outs, rowFloats, src->channels);
+        } else {
+            horizontalRowsSSE2(g, rows, outs, rowFloats, src->channels);
+        }
+    }
+#endif
+    for (; y < y1; y++) horizontalRow(g, imageRow(src, y), out + (size_t)y * rowFloats, src->width, src->channels);
+}
+
+// ======= 垂直方向 =======
+// 同一行中相鄰的欄彼此獨立，以向量一次推進多欄；row 就地更新為遞迴的結果
+// 處理第 i 個到 end 之前的 float 中前面整數組，傳回處理到的位置
+
+#if defined(CPU_X86)
+TARGET_AVX512 static int recurseColumnsAVX512(const RecursiveGaussian* g, float* row, const float* p1, const float* p2, const float* p3, int i, int end) {
+    __m512 b = _mm512_set1_ps(g->b), a1 = _mm512_set1_ps(g->a1), a2 = _mm512_set1_ps(g->a2), a3 = _mm512_set1_ps(g->a3);
+    for (; i + 16 <= end; i += 16) {
+        __m512 rest = _mm512_add_ps(_mm512_mul_ps(b, _mm512_loadu_ps(row + i)), _mm512_add_ps(_mm512_mul_ps(a2, _mm512_loadu_ps(p2 + i)), _mm512_mul_ps(a3, _mm512_loadu_ps(p3 + i))));
+        _mm512_storeu_ps(row + i, _mm512_add_ps(rest, _mm512_mul_ps(a1, _mm512_loadu_ps(p1 + i))));
+    }
+    return i;
+}
+
+TARGET_AVX2 static int recurseColumnsAVX2(const RecursiveGaussian* g, float* row, const float* p1, const float* p2, const float* p3, int i, int end) {
+    __m256 b = _mm256_set1_ps(g->b), a1 = _mm256_set1_ps(g->a1), a2 = _mm256_set1_ps(g->a2), a3 = _mm256_set1_ps(g->a3);
+    for (; i + 8 <= end; i += 8) {
+        __m256 rest = _mm256_add_ps(_mm256_mul_ps(b, _mm256_loadu_ps(row + i)), _mm256_add_ps(_mm256_mul_ps(a2, _mm256_loadu_ps(p2 + i)), _mm256_mul_ps(a3, _mm256_loadu_ps(p3 + i))));
+        _mm256_storeu_ps(row + i, _mm256_add_ps(rest, _mm256_mul_ps(a1, _mm256_loadu_ps(p1 + i))));
+    }
+    return i;
+}
+
+TARGET_SSE2 static int recurseColumnsSSE2(const RecursiveGaussian* g, float* row, const float* p1, const float* p2, const float* p3, int i, int end) {
+    __m128 b = _mm_set1_ps(g->b), a1 = _mm_set1_ps(g->a1), a2 = _mm_set1_ps(g->a2), a3 = _mm_set1_ps(g->a3);
+    for (; i + 4 <= end; i += 4) {
+        __m128 rest = _mm_add_ps(_mm_mul_ps(b, _mm_loadu_ps(row + i)), _mm_add_ps(_mm_mul_ps(a2, _mm_loadu_ps(p2 + i)), _mm_mul_ps(a3, _mm_loadu_ps(p3 + i))));
+        _mm_storeu_ps(row + i, _mm_add_ps(rest, _mm_mul_ps(a1, _mm_loadu_ps(p1 + i))));
+    }
+    return i;
+}
+#endif
+
+static void recurseColumns(const RecursiveGaussian* g, float* row, const float* p1, const float* p2, const float* p3, int count) {
+    int i = 0;
+#if defined(CPU_X86)
+    CpuLevel level = cpuLevel();
+    if (level >= CPU_AVX512) {
+        i = recurseColumnsAVX512(g, row, p1, p2, p3, i, count);
+    } else if (level >= CPU_AVX2) {
+        i = recurseColumnsAVX2(g, row, p1, p2, p3, i, count);
+    } else if (level >= CPU_SSE2) {
+        i = recurseColumnsSSE2(g, row, p1, p2, p3, i, count);
+    }
+#endif
+    for (; i < count; i++) row[i] = recurse(g, row[i], p1[i], p2[i], p3[i]);
+}
+
+// ======= 整張影像 =======
+
+typedef struct {
+    const ImageView* src;
+    ImageView* dst;
+    const RecursiveGaussian* g;
+    const UnsharpParams* sharpen;   // NULL 時輸出模糊結果
+    float* buffer;                  // 水平方向的結果，每行 rowFloats 個 float，最後多四行存放遞迴開始前的邊緣值與最後一行的輸入
+    int rowFloats;
+    int bandHeight;                 // 水平方向每個工作的行數
+    int columnWidth;                // 垂直方向每個工作的欄數（float 個數）
+} GaussianJob;
+
+static void horizontalTask(int band, void* ctx) {
+    GaussianJob* job = (GaussianJob*)ctx;
+    const ImageView* src = job->src;
+    int yEnd = (band + 1) * job->bandHeight < src->height ? (band + 1) * job->bandHeight : src->height;
+    horizontalRows(job->g, src, job->buffer, job->rowFloats, band * job->bandHeight, yEnd);
+}
+
+static inline uint8_t roundPixel(float v) {
+    if (v <= 0.0f) return 0;
+    if (v >= 255.0f) return 255;
+    return (uint8_t)(v + 0.5f);
+}
+
+// 輸出時的四捨五入與門檻判斷：向量版本先限制在 0 ~ 255 再加 0.5 捨去小數，與 roundPixel 相同
+// 傳回處理到的位置；AVX-512 的等級也使用 AVX2 的版本（瓶頸在記憶體）
+
+#if defined(CPU_X86)
+TARGET_AVX2 static inline __m256 emitValueAVX2(__m256 s, __m256 blur, int sharpen, __m256 amount, __m256 threshold) {
+    __m256 v = blur;
+    if (sharpen) {
+        __m256 diff = _mm256_sub_ps(s, blur);
+        __m256 strong = _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), diff), threshold, _CMP_GE_OQ);
+        v = _mm256_blendv_ps(s, _mm256_add_ps(s, _mm256_mul_ps(amount, diff)), strong);
+    }
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+    return _mm256_add_ps(v, _mm256_set1_ps(0.5f));
+}
+
+TARGET_AVX2 static int emitAVX2(const uint8_t* src, const float* blur, uint8_t* out, int sharpen, float amount, float threshold, int i, int end) {
+    __m256 vAmount = _mm256_set1_ps(amount), vThreshold = _mm256_set1_ps(threshold);
+    for (; i + 16 <= end; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(src + i));
+        __m256 s0 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+        __m256 s1 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+        __m256i r0 = _mm256_cvttps_epi32(emitValueAVX2(s0, _mm256_loadu_ps(blur + i), sharpen, vAmount, vThreshold));
+        __m256i r1 = _mm256_cvttps_epi32(emitValueAVX2(s1, _mm256_loadu_ps(blur + i + 8), sharpen, vAmount, vThreshold));
+        __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(r0, r1), 0xD8);
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1)));
+    }
+    return i;
+}
+
+TARGET_SSE2 static inline __m128 emitValueSSE2(__m128 s, __m128 blur, int sharpen, __m128 amount, __m128 threshold) {
+    __m128 v = blur;
+    if (sharpen) {
+        __m128 diff = _mm_sub_ps(s, blur);
+        __m128 strong = _mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), diff), threshold);
+        v = _mm_or_ps(_mm_and_ps(strong, _mm_add_ps(s, _mm_mul_ps(amount, diff))), _mm_andnot_ps(strong, s));
+    }
+    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+    return _mm_add_ps(v, _mm_set1_ps(0.5f));
+}
+
+TARGET_SSE2 static int emitSSE2(const uint8_t* src, const float* blur, uint8_t* out, int sharpen, float amount, float threshold, int i, int end) {
+    __m128 vAmount = _mm_set1_ps(amount), vThreshold = _mm_set1_ps(threshold);
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= end; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_unpacklo_epi8(bytes, zero), hi = _mm_unpackhi_epi8(bytes, zero);
+        __m128i words[4] = { _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero), _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero) };
+        __m128i r[4];
+        for (int k = 0; k < 4; k++) {
+            r[k] = _mm_cvttps_epi32(emitValueSSE2(_mm_cvtepi32_ps(words[k]), _mm_loadu_ps(blur + i + 4 * k), sharpen, vAmount, vThreshold));
+        }
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(_mm_packs_epi32(r[0], r[1]), _mm_packs_epi32(r[2], r[3])));
+    }
+    return i;
+}
+#endif
+
+// 輸出一行中一段欄的最終結果
+static void emitRow(const GaussianJob* job, const uint8_t* src, const float* blur, uint8_t* out, int count) {
+    int sharpen = job->sharpen != NULL;
+    float amount = sharpen ? (float)job->sharpen->amount : 0.0f;
+    float threshold = sharpen ? (float)job->sharpen->threshold : 0.0f;
+    int i = 0;
+#if defined(CPU_X86)
+    CpuLevel level = cpuLevel();
+    if (level >= CPU_AVX2) {
+        i = emitAVX2(src, blur, out, sharpen, amount, threshold, i, count);
+    } else if (level >= CPU_SSE2) {
+        i = emitSSE2(src, blur, out, sharpen, amount, threshold, i, count);
+    }
+#endif
+    for (; i < count; i++) {
+        if (!sharpen) {
+            out[i] = roundPixel(blur[i]);
+            continue;
+        }
+        float diff = src[i] - blur[i];
+        out[i] = fabsf(diff) >= threshold ? roundPixel(src[i] + amount * diff) : src[i];
+    }
+}
+
+// 一段欄由上往下、再由下往上遞迴，由下往上時每完成一行就輸出
+// 每個工作的欄數很寬，逐行循序讀寫，硬體預取與 TLB 都能跟上（窄的欄區段每行只讀幾百個位元組就跳到下一行，反而較慢）
+static void verticalTask(int strip, void* ctx) {
+    GaussianJob* job = (GaussianJob*)ctx;
+    int height = job->src->height;
+    int x0 = strip * job->columnWidth;
+    int count = job->rowFloats - x0 < job->columnWidth ? job->rowFloats - x0 : job->columnWidth;
+    size_t stride = (size_t)job->rowFloats;
+    float* column = job->buffer + x0;
+    float* edge = column + height * stride; // 就地更新後原值會被覆蓋，先複製邊緣值
+    float* after[3] = { edge, edge + stride, edge + 2 * stride };
+    float* lastInput = edge + 3 * stride;
+
+    memcpy(edge, column, count * sizeof(float));
+    memcpy(lastInput, column + (height - 1) * stride, count * sizeof(float));
+    for (int y = 0; y < height; y++) {
+        const float* p1 = y >= 1 ? column + (y - 1) * stride : edge;
+        const float* p2 = y >= 2 ? column + (y - 2) * stride : edge;
+        const float* p3 = y >= 3 ? column + (y - 3) * stride : edge;
+        recurseColumns(job->g, column + y * stride, p1, p2, p3, count);
+    }
+
+    // 由下往上的初始值；不足三行時由上往下的前幾個輸出以第一行的輸入（仍存在 edge 中）補上
+    const float* u[3];
+    for (int k = 0; k < 3; k++) u[k] = height - 1 - k >= 0 ? column + (height - 1 - k) * stride : edge;
+    for (int i = 0; i < count; i++) {
+        float state[3];
+        backwardState(job->g, lastInput[i], u[0][i], u[1][i], u[2][i], state);
+        for (int k = 0; k < 3; k++) after[k][i] = state[k];
+    }
+    // 初始值緊接在最後一行之後，第 height ~ height + 2 行就是 after[0..2]
+    for (int y = height - 1; y >= 0; y--) {
+        recurseColumns(job->g, column + y * stride, column + (y + 1) * stride, column + (y + 2) * stride, column + (y + 3) * stride, count);
+        emitRow(job, imageRow(job->src, y) + x0, column + y * stride, imageRow(job->dst, y) + x0, count);
+    }
+}
+
+static int recursiveBlur(const ImageView* src, ImageView* dst, double sigma, const UnsharpParams* sharpen) {
+    RecursiveGaussian g;
+    if (recursiveGaussianInit(&g, sigma) != 0) return -1;
+    if (src->width <= 0 || src->height <= 0) return 0;
+
+    GaussianJob job = { src, dst, &g, sharpen, NULL, src->width * src->channels, 0, 0 };
+    job.buffer = (float*)framePoolAcquire(framePoolShared(), (size_t)job.rowFloats * (src->height + 4) * sizeof(float), IMAGE_ALIGN);
+    if (!job.buffer) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        return -1;
+    }
+
+    // 水平方向完全讀完 src 後才開始寫入 dst，因此 src 與 dst 可以相同
+    int bands = threadPoolThreads() * 4;
+    job.bandHeight = ((src->height + bands - 1) / bands + 7) / 8 * 8; // 向量版本一次處理 8 行
+    parallelFor((src->height + job.bandHeight - 1) / job.bandHeight, horizontalTask, &job);
+    // 垂直方向每個執行緒一段欄
+    int strips = threadPoolThreads();
+    job.columnWidth = ((job.rowFloats + strips - 1) / strips + COLUMN_ALIGN - 1) / COLUMN_ALIGN * COLUMN_ALIGN;
+    parallelFor((job.rowFloats + job.columnWidth - 1) / job.columnWidth, verticalTask, &job);
+
+    framePoolRelease(framePoolShared(), job.buffer);
+    return 0;
+}
+
+int gaussianBlur(const ImageView* src, ImageView* dst, double sigma) {
+    TRACE_BEGIN(span, "gaussian");
+    int result = recursiveBlur(src, dst, sigma, NULL);
+    TRACE_END(span, 2 * (uint64_t)src->width * src->height * src->channels, (uint64_t)src->width * src->height);
+    return result;
+}
+
+int unsharpMask(const ImageView* src, ImageView* dst, const UnsharpParams* params) {
+    if (params->threshold < 0 || params->threshold > 255) {
+        fprintf(stderr, "反銳化遮罩的門檻須介於 0 與 255 之間。\n");
+        return -1;
+    }
+    if (!isfinite(params->amount)) {
+        fprintf(stderr, "反銳化遮罩的強度須為有限的數值。\n");
+        return -1;
+    }
+    TRACE_BEGIN(span, "unsharp");
+    int result = recursiveBlur(src, dst, params->radius, params);
+    TRACE_END(span, 2 * (uint64_t)src->width * src->height * src->channels, (uint64_t)src->width * src->height);
+    return result;
+}
@@ -0,0 +1,41 @@
+#ifndef GAUSSIAN_H
+#define GAUSSIAN_H
+
+#include "bmp_io.h"
+
+// sigma 的上限：係數以 float 保存，sigma 越大 B = 1 - (a1 + a2 + a3) 的相對誤差越大，
+// sigma 為 100 時 B 約偏差 8%，模糊結果與真正的高斯約差 3 個灰階；sigma 約 1000 時 B 捨入為 0，遞迴不再使用輸入
+#define GAUSSIAN_MAX_SIGMA 100.0
+
+// 遞迴（IIR）高斯模糊，係數依 Young & van Vliet：
+// 每個方向先由前往後、再由後往前各做一次三階遞迴，每像素的計算量與 sigma 無關
+// 邊界以最邊緣的像素延伸：由前往後的初始值取邊緣像素的穩態值，由後往前的初始值依 Triggs & Sdika (2006)
+// 由前往後最後三個輸出與邊緣像素算出，結果等同影像外無限延伸邊緣像素後的遞迴
+typedef struct {
+    float b;            // 輸入的權重 B
+    float a1, a2, a3;   // 前三個輸出的權重 b1 / b0、b2 / b0、b3 / b0
+    double boundary[3][3]; // 由後往前遞迴開始前最後一個像素之後三個位置的輸出 = 邊緣像素 + boundary * (前三個輸出 - 邊緣像素)
+} RecursiveGaussian;
+
+// 依 sigma 計算遞迴係數，sigma 須介於 0.5 與 GAUSSIAN_MAX_SIGMA 之間
+// 成功傳回 0，sigma 超出範圍時傳回 -1
+int recursiveGaussianInit(RecursiveGaussian* g, double sigma);
+
+// 以遞迴高斯模糊影像，每個通道分別處理，所有像素（包含邊界）都會寫入；src 與 dst 可以相同
+// 先做水平方向（以 SIMD 一次處理相鄰的多行），再做垂直方向（以 SIMD 一次處理同一行的多欄），
+// 兩個方向都以多執行緒處理
+// 成功傳回 0，sigma 超出範圍或記憶體不足時傳回 -1
+int gaussianBlur(const ImageView* src, ImageView* dst, double sigma);
+
+// 反銳化遮罩（unsharp mask）的參數
+typedef struct {
+    double radius;      // 模糊的 sigma（像素），決定強化的邊緣寬度
+    double amount;      // 強度：結果 = 原始值 + amount * (原始值 - 模糊值)，須為有限的數值
+    int threshold;      // 只強化 |原始值 - 模糊值| >= threshold 的像素，避免放大平坦區域的雜訊（0 ~ 255）
+} UnsharpParams;
+
+// 以遞迴高斯模糊進行反銳化遮罩，計算量與 radius 無關；src 與 dst 可以相同
+// 成功傳回 0，參數不合法或記憶體不足時傳回 -1
+int unsharpMask(const ImageView* src, ImageView* dst, const UnsharpParams* params);
+
+#endif
@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "geometry.h"
+#include "thread_pool.h"
+#include "cpu_dispatch.h"
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
+#include "trace.h"
+
+#define BLOCK_PIXELS 16     // 翻轉時一次反轉的像素數（24 位元為三個向量、32 位元為四個向量）
+#define TILE 32             // 轉置區塊的邊長（像素），輸入與輸出區塊合計最多 8 KB，同時使用的分頁也不超過 TLB 的容量
+
+static inline void copyPixel(uint8_t* dst, const uint8_t* src, int ch) {
+    if (ch == 4) {
+        memcpy(dst, src, 4);
+    } else if (ch == 3) {
+        memcpy(dst, src, 3);
+    } else {
+        for (int c = 0; c < ch; c++) dst[c] = src[c];
+    }
+}
+
+// ======= 翻轉 =======
+
+#if defined(CPU_X86)
+// 反轉 16 個 24 位元像素（48 位元組）時，輸出向量 k 的每個位元組取自哪些輸入向量的哪個位置（-1 表示補 0）
+static const int8_t reverse3Masks[7][16] = {
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 14 },    // 輸出 0 <- 輸入 1
+    { 13, 14, 15, 10, 11, 12, 7, 8, 9, 4, 5, 6, 1, 2, 3, -1 },             // 輸出 0 <- 輸入 2
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 15, -1 },    // 輸出 1 <- 輸入 0
+    { 15, -1, 11, 12, 13, 8, 9, 10, 5, 6, 7, 2, 3, 4, -1, 0 },             // 輸出 1 <- 輸入 1
+    { -1, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },     // 輸出 1 <- 輸入 2
+    { -1, 12, 13, 14, 9, 10, 11, 6, 7, 8, 3, 4, 5, 0, 1, 2 },              // 輸出 2 <- 輸入 0
+    { 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },     // 輸出 2 <- 輸入 1
+};
+
+TARGET_SSE41 static inline void reverseBlock3(const uint8_t* in, __m128i* out, const __m128i* m) {
+    __m128i v0 = _mm_loadu_si128((const __m128i*)in);
+    __m128i v1 = _mm_loadu_si128((const __m128i*)in + 1);
+    __m128i v2 = _mm_loadu_si128((const __m128i*)in + 2);
+    out[0] = _mm_or_si128(_mm_shuffle_epi8(v1, m[0]), _mm_shuffle_epi8(v2, m[1]));
+    out[1] = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, m[2]), _mm_shuffle_epi8(v1, m[3])), _mm_shuffle_epi8(v2, m[4]));
+    out[2] = _mm_or_si128(_mm_shuffle_epi8(v0, m[5]), _mm_shuffle_epi8(v1, m[6]));
+}
+
+TARGET_SSE2 static inline void reverseBlock4(const uint8_t* in, __m128i* out) {
+    for (int k = 0; k < 4; k++) {
+        out[3 - k] = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)in + k), 0x1B);
+    }
+}
+
+// 向量版本從兩端各交換整數個區塊，傳回左端處理到的像素（右端處理到 width - 傳回值）
+TARGET_SSE41 static int reverseRow3SSE41(const uint8_t* in, uint8_t* out, int width) {
+    int left = 0, right = width;
+    __m128i m[7];
+    for (int k = 0; k < 7; k++) m[k] = _mm_loadu_si128((const __m128i*)reverse3Masks[k]);
+    for (; right - left >= 2 * BLOCK_PIXELS; left += BLOCK_PIXELS, right -= BLOCK_PIXELS) {
+        __m128i a[3], b[3];
+        reverseBlock3(in + left * 3, a, m);
+        reverseBlock3(in + (right - BLOCK_PIXELS) * 3, b, m);
+        for (int k = 0; k < 3; k++) {
+            _mm_storeu_si128((__m128i*)(out + left * 3) + k, b[k]);
+            _mm_storeu_si128((__m128i*)(out + (right - BLOCK_PIXELS) * 3) + k, a[k]);
+        }
+    }
+    return left;
+}
+
+TARGET_SSE2 static int reverseRow4SSE2(const uint8_t* in, uint8_t* out, int width) {
+    int left = 0, right = width;
+    for (; right - left >= 2 * BLOCK_PIXELS; left += BLOCK_PIXELS, right -= BLOCK_PIXELS) {
+        __m128i a[4], b[4];
+        reverseBlock4(in + left * 4, a);
+        reverseBlock4(in + (right - BLOCK_PIXELS) * 4, b);
+        for (int k = 0; k < 4; k++) {
+            _mm_storeu_si128((__m128i*)(out + left * 4) + k, b[k]);
+            _mm_storeu_si128((__m128i*)(out + (right - BLOCK_PIXELS) * 4) + k, a[k]);
+        }
+    }
+    return left;
+}
+#endif
+
+// 將一行像素左右反轉後寫入 out（in 與 out 可以相同）
+// 每次從兩端各讀入一段像素，反轉後交換寫回，因此就地處理也不需要暫存的行
+static void reverseRow(const uint8_t* in, uint8_t* out, int width, int ch) {
+    int left = 0;
+#if defined(CPU_X86)
+    if (ch == 3 && cpuLevel() >= CPU_SSE41) {
+        left = reverseRow3SSE41(in, out, width);
+    } else if (ch == 4 && cpuLevel() >= CPU_SSE2) {
+        left = reverseRow4SSE2(in, out, width);
+    }
+#endif
+    // 中間剩下的像素逐一交換
+    for (int l = left, r = width - left - 1; l <= r; l++, r--) {
+        uint8_t tmp[4];
+        copyPixel(tmp, in + l * ch, ch);
+        copyPixel(out + l * ch, in + r * ch, ch);
+        copyPixel(out + r * ch, tmp, ch);
+    }
+}
+
+typedef struct {
+    const ImageView* src;
+    ImageView* dst;
+    int mirror;         // 1：src 第 y 行寫到 dst 第 height - 1 - y 行
+    int bandHeight;
+} FlipJob;
+
+static void flipTask(int band, void* ctx) {
+    FlipJob* job = (FlipJob*)ctx;
+    const ImageView* src = job->src;
+    int yEnd = (band + 1) * job->bandHeight < src->height ? (band + 1) * job->bandHeight : src->height;
+    for (int y = band * job->bandHeight; y < yEnd; y++) {
+        int dy = job->mirror ? src->height - 1 - y : y;
+        reverseRow(imageRow(src, y), imageRow(job->dst, dy), src->width, src->channels);
+    }
+}
+
+// 以行區段平行反轉每一行
+static void reverseRows(const ImageView* src, ImageView* dst, int mirror) {
+    int bands = threadPoolThreads() * 4;
+    FlipJob job = { src, dst, mirror, (src->height + bands - 1) / bands };
+    if (job.bandHeight < 1) job.bandHeight = 1;
+    parallelFor((src->height + job.bandHeight - 1) / job.bandHeight, flipTask, &job);
+}
+
+void flipHorizontal(const ImageView* src, ImageView* dst) {
+    reverseRows(src, dst, 0);
+}
+
+typedef struct {
+    const ImageView* src;
+    ImageView* dst;
+    int bandPairs;
+} SwapJob;
+
+// 交換上下對稱的兩行，以一小段暫存區分段複製，src 與 dst 相同時就地交換
+static void swapTask(int band, void* ctx) {
+    SwapJob* job = (SwapJob*)ctx;
+    const ImageView* src = job->src;
+    int pairs = (src->height + 1) / 2;
+    int end = (band + 1) * job->bandPairs < pairs ? (band + 1) * job->bandPairs : pairs;
+    size_t rowBytes = (size_t)src->width * src->channels;
+    uint8_t tmp[1024];
+    for (int y = band * job->bandPairs; y < end; y++) {
+        int mirror = src->height - 1 - y;
+        for (size_t i = 0; i < rowBytes; i += sizeof(tmp)) {
+            size_t n = rowBytes - i < sizeof(tmp) ? rowBytes - i : sizeof(tmp);
+            memcpy(tmp, imageRow(src, y) + i, n);
+            memmove(imageRow(job->dst, y) + i, imageRow(src, mirror) + i, n);
+            memcpy(imageRow(job->dst, mirror) + i, tmp, n);
+        }
+    }
+}
+
+void flipVertical(const ImageView* src, ImageView* dst) {
+    int pairs = (src->height + 1) / 2;
+    int bands = threadPoolThreads() * 4;
+    SwapJob job = { src, dst, (pairs + bands - 1) / bands };
+    if (job.bandPairs < 1) job.bandPairs = 1;
+    parallelFor((pairs + job.bandPairs - 1) / job.bandPairs, swapTask, &job);
+}
+
+// ======= 轉置與旋轉 90 / 270 度 =======
+//
+// 輸入 (x, y) 寫到輸出 (x', y')，x' = flipX ? H - 1 - y : y，y' = flipY ? W - 1 - x : x
+// 轉置為 (0, 0)，順時針 90 度為 (1, 0)，270 度為 (0, 1)，副對角線轉置為 (1, 1)
+// 逐行讀取輸入時輸出是沿著行距往下寫，整張影像這樣寫每個像素都會落在不同的快取線上；
+// 改為一次處理 TILE x TILE 的區塊，區塊內的輸出行在處理期間都留在快取中
+
+typedef struct {
+    const ImageView* src;
+    ImageView* dst;
+    int flipX, flipY;
+} TransposeJob;
+
+#if defined(CPU_X86)
+// 轉置 4x4 個 32 位元像素：r[i] 為輸入第 i 行，轉置後 r[i] 為輸入第 i 欄
+TARGET_SSE2 static inline void transpose4x4(__m128i* r) {
+    __m128i t0 = _mm_unpacklo_epi32(r[0], r[1]);
+    __m128i t1 = _mm_unpacklo_epi32(r[2], r[3]);
+    __m128i t2 = _mm_unpackhi_epi32(r[0], r[1]);
+    __m128i t3 = _mm_unpackhi_epi32(r[2], r[3]);
+    r[0] = _mm_unpacklo_epi64(t0, t1);
+    r[1] = _mm_unpackhi_epi64(t0, t1);
+    r[2] = _mm_unpacklo_epi64(t2, t3);
+    r[3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+// 以 4x4 的向量區塊轉置 32 位元像素的區塊，傳回處理到的行（之後的行由呼叫者逐像素處理）
+TARGET_SSE2 static int transposeTile4SSE2(const TransposeJob* job, int x0, int x1, int y0, int y1) {
+    const ImageView* src = job->src;
+    int W = src->width, H = src->height;
+    int yEnd = y0 + (y1 - y0) / 4 * 4, xEnd = x0 + (x1 - x0) / 4 * 4;
+    for (int x = x0; x < xEnd; x += 4) {
+        // 沿輸出行的方向依序寫入，每條輸出快取線盡快寫滿；flipX 時輸出欄號遞減，寫入前反轉向量內的順序
+        for (int y = y0; y < yEnd; y += 4) {
+            int dx = job->flipX ? H - 4 - y : y;
+            __m128i r[4];
+            for (int k = 0; k < 4; k++) r[k] = _mm_loadu_si128((const __m128i*)(imageRow(src, y + k) + (size_t)x * 4));
+            transpose4x4(r);
+            for (int k = 0; k < 4; k++) {
+                int dy = job->flipY ? W - 1 - (x + k) : x + k;
+                __m128i v = job->flipX ? _mm_shuffle_epi32(r[k], 0x1B) : r[k];
+                _mm_storeu_si128((__m128i*)(imageRow(job->dst, dy) + (size_t)dx * 4), v);
+            }
+        }
+    }
+    for (int y = y0; y < yEnd; y++) {
+        int sx = job->flipX ? H - 1 - y : y;
+        for (int xr = xEnd; xr < x1; xr++) {
+            int dy = job->flipY ? W - 1 - xr : xr;
+            copyPixel(imageRow(job->dst, dy) + (size_t)sx * 4, imageRow(src, y) + (size_t)xr * 4, 4);
+        }
+    }
+    return yEnd;
+}
+#endif
+
+static void transposeTile(const TransposeJob* job, int x0, int x1, int y0, int y1) {
+    const ImageView* src = job->src;
+    int ch = src->channels;
+    int W = src->width, H = src->height;
+    int y = y0;
+#if defined(CPU_X86)
+    if (ch == 4 && cpuLevel() >= CPU_SSE2) y = transposeTile4SSE2(job, x0, x1, y0, y1);
+#endif
+    for (; y < y1; y++) {
+        const uint8_t* in = imageRow(src, y);
+        size_t dx = (size_t)(job->flipX ? H - 1 - y : y) * ch;
+        for (int x = x0; x < x1; x++) {
+            int dy = job->flipY ? W - 1 - x : x;
+            copyPixel(imageRow(job->dst, dy) + dx, in + (size_t)x * ch, ch);
+        }
+    }
+}
+
+// 處理一列區塊
+static void transposeTask(int tileRow, void* ctx) {
+    TransposeJob* job = (TransposeJob*)ctx;
+    int y0 = tileRow * TILE;
+    int y1 = y0 + TILE < job->src->height ? y0 + TILE : job->src->height;
+    for (int x0 = 0; x0 < job->src->width; x0 += TILE) {
+        int x1 = x0 + TILE < job->src->width ? x0 + TILE : job->src->width;
+        transposeTile(job, x0, x1, y0, y1);
+    }
+}
+
+static void transposeImage(const ImageView* src, ImageView* dst, int flipX, int flipY) {
+    TransposeJob job = { src, dst, flipX, flipY };
+    parallelFor((src->height + TILE - 1) / TILE, transposeTask, &job);
+}
+
+// ======= 介面 =======
+
+void geomOutputSize(GeomTransform transform, int width, int height, int* outWidth, int* outHeight) {
+    int swap = transform == GEOM_ROTATE_90 || transform == GEOM_ROTATE_270 ||
+               transform == GEOM_TRANSPOSE || transform == GEOM_TRANSVERSE;
+    *outWidth = swap ? height : width;
+    *outHeight = swap ? width : height;
+}
+
+int geomTransform(const ImageView* src, ImageView* dst, GeomTransform transform) {
+    int width, height;
+    geomOutputSize(transform, src->width, src->height, &width, &height);
+    if (dst->width != width || dst->height != height || dst->channels != src->channels) {
+        fprintf(stderr, "幾何變換的輸出尺寸或通道數不符。\n");
+        return -1;
+    }
+
+    TRACE_BEGIN(span, "geometry");
+    switch (transform) {
+    case GEOM_FLIP_HORIZONTAL: flipHorizontal(src, dst); break;
+    case GEOM_FLIP_VERTICAL: flipVertical(src, dst); break;
+    case GEOM_ROTATE_180:
+        if (src->data == dst->data) {
+            // 就地處理時分成上下、左右兩次翻轉
+            flipVertical(src, dst);
+            flipHorizontal(dst, dst);
+        } else {
+            reverseRows(src, dst, 1);
+        }
+        break;
+    case GEOM_ROTATE_90: transposeImage(src, dst, 1, 0); break;
+    case GEOM_ROTATE_270: transposeImage(src, dst, 0, 1); break;
+    case GEOM_TRANSPOSE: transposeImage(src, dst, 0, 0); break;
+    case GEOM_TRANSVERSE: transposeImage(src, dst, 1, 1); break;
+    default:
+        fprintf(stderr, "不支援的幾何變換。\n");
+        return -1;
+    }
+    TRACE_END(span, 2 * (uint64_t)src->width * src->height * src->channels, (uint64_t)src->width * src->height);
+    return 0;
+}
+
+GeomTransform geomBottomUp(GeomTransform transform) {
+    switch (transform) {
+    case GEOM_ROTATE_90: return GEOM_ROTATE_270;
+    case GEOM_ROTATE_270: return GEOM_ROTATE_90;
+    case GEOM_TRANSPOSE: return GEOM_TRANSVERSE;
+    case GEOM_TRANSVERSE: return GEOM_TRANSPOSE;
+    default: return transform;
+    }
+}
+
+int geomParse(const char* name, GeomTransform* transform) {
+    static const struct { const char* name; GeomTransform transform; } names[] = {
+        { "flip-h", GEOM_FLIP_HORIZONTAL },
+        { "flip-v", GEOM_FLIP_VERTICAL },
+        { "rotate90", GEOM_ROTATE_90 },
+        { "rotate180", GEOM_ROTATE_180 },
+        { "rotate270", GEOM_ROTATE_270 },
+        { "transpose", GEOM_TRANSPOSE },
+        { "transverse", GEOM_TRANSVERSE },
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i].name) == 0) {
+            *transform = names[i].transform;
+            return 0;
+        }
+    }
+    fprintf(stderr, "未知的幾何變換：%s。\n", name);
+    return -1;
+}
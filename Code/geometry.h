@@ -0,0 +1,41 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include "bmp_io.h"
+
+// 幾何變換，方向以第 0 行在最上方（矩陣的行列）定義
+typedef enum {
+    GEOM_FLIP_HORIZONTAL,   // 左右翻轉
+    GEOM_FLIP_VERTICAL,     // 上下翻轉
+    GEOM_ROTATE_90,         // 順時針旋轉 90 度
+    GEOM_ROTATE_180,        // 旋轉 180 度
+    GEOM_ROTATE_270,        // 順時針旋轉 270 度（逆時針 90 度）
+    GEOM_TRANSPOSE,         // 沿主對角線轉置（左上角不動）
+    GEOM_TRANSVERSE         // 沿副對角線轉置（右上角不動）
+} GeomTransform;
+
+// 左右翻轉，src 與 dst 大小須相同，可以是同一塊記憶體（就地翻轉）
+// 從每行兩端同時向中間處理，以向量重排一次反轉一段像素（32 位元用 SSE2，24 位元需要 SSSE3 的 pshufb）
+void flipHorizontal(const ImageView* src, ImageView* dst);
+
+// 上下翻轉，src 與 dst 大小須相同，可以是同一塊記憶體
+void flipVertical(const ImageView* src, ImageView* dst);
+
+// 執行幾何變換，dst 的大小須為 geomOutputSize 的結果，通道數須與 src 相同
+// 翻轉與旋轉 180 度可以就地處理（src 與 dst 相同）；旋轉 90 / 270 度與轉置時 src 與 dst 不可重疊，
+// 以快取大小的區塊處理，避免沿著行距跨越整張影像寫入；32 位元像素以 SSE2 一次轉置 4x4 個像素
+// 成功傳回 0，尺寸不符或不支援的變換時傳回 -1
+int geomTransform(const ImageView* src, ImageView* dst, GeomTransform transform);
+
+// 變換後的影像大小
+void geomOutputSize(GeomTransform transform, int width, int height, int* outWidth, int* outHeight);
+
+// 將以顯示方向定義的變換換成在由下往上儲存的視圖（一般的 BMP）上等價的變換
+// 行的順序相反時，旋轉方向與兩種轉置互換，翻轉不變
+GeomTransform geomBottomUp(GeomTransform transform);
+
+// 由名稱（flip-h、flip-v、rotate90、rotate180、rotate270、transpose、transverse）取得變換
+// 成功傳回 0，名稱不正確時傳回 -1
+int geomParse(const char* name, GeomTransform* transform);
+
+#endif
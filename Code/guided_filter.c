@@ -0,0 +1,918 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "guided_filter.h"
+#include "image.h"
+#include "resize.h"
+#include "frame_pool.h"
+#include "thread_pool.h"
+#include "cpu_dispatch.h"
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
+#include "trace.h"
+
+// 純量與向量版本的運算順序相同，關閉乘加合併（-march=native 時 GCC 會合併成 FMA）才能讓各等級的輸出逐位元相同
+#pragma GCC optimize("fp-contract=off")
+
+#define GUIDED_STRIP_ROWS 64    // 每個條帶的行數（半徑大時取 4r），與執行緒數無關，結果因此也與執行緒數無關
+#define LANE_PAD 4              // 欄總和多留的 lane：前綴和一次讀寫一個像素的 4 個 lane
+
+typedef struct {
+    const ImageView* guide;     // 導引影像（自我導引時與 src 相同）
+    const ImageView* src;
+    ImageView* dst;             // 輸出影像；NULL 時改為把平均後的係數寫入 meanA / meanB（快速版）
+    float* meanA;
+    float* meanB;
+    int radius;
+    double epsilon;
+    int selfGuided;
+    int stripHeight;
+    const double* countLanes;   // 每個 lane 的窗口在水平方向涵蓋的像素數
+    const double* inverseLanes; // countLanes 的倒數
+    atomic_int failed;          // 任一條帶記憶體分配失敗時設為 1
+} GuidedJob;
+
+// 一個條帶的暫存空間
+// 水平方向的窗口總和以前綴和相減求出：prefix 前面補 r + 1 個像素的 0、後面重複最後一個像素 r 次，
+// lane i 的窗口總和就是 prefix[i + span] - prefix[i]（span = (2r + 1) * 通道數），邊緣不必另外處理
+typedef struct {
+    uint32_t* stats[4];         // 欄總和：導引值、導引值平方、輸入值、導引值乘輸入值（自我導引時只用前兩個）
+    uint32_t* statsPrefix[4];   // 欄總和的水平前綴和，以無號數模 2^32 累加，相減後即為正確的窗口總和
+    double* sumA;               // 係數 a、b 的欄總和
+    double* sumB;
+    double* prefixA;            // 係數欄總和的水平前綴和
+    double* prefixB;
+    float* meanA;               // 目前輸出行平均後的係數
+    float* meanB;
+    uint8_t* guideAdd;          // 灰階導引展開成每個通道一份後的行
+    uint8_t* guideRemove;
+    uint8_t* guideOut;
+    float* zero;                // 全為 0 的一行，作為不需要加入或移出的行
+    float* ringA;               // 最近 2r + 2 行的係數，第 y 行放在 y % ringRows
+    float* ringB;
+    int ringRows;
+} GuidedScratch;
+
+// 窗口在 [0, size) 內涵蓋的像素數
+static inline int windowCount(int center, int radius, int size) {
+    int lo = center - radius < 0 ? 0 : center - radius;
+    int hi = center + radius >= size ? size - 1 : center + radius;
+    return hi - lo + 1;
+}
+
+static inline uint8_t roundPixel(float v) {
+    if (v <= 0.0f) return 0;
+    if (v >= 255.0f) return 255;
+    return (uint8_t)(v + 0.5f);
+}
+
+// 導引影像的第 y 行，每個 lane 一個值；灰階導引展開到 buffer
+static const uint8_t* guideLanes(const ImageView* guide, int channels, int y, uint8_t* buffer) {
+    const uint8_t* row = imageRow(guide, y);
+    if (guide->channels == channels) return row;
+    for (int x = 0; x < guide->width; x++) {
+        for (int c = 0; c < channels; c++) buffer[x * channels + c] = row[x];
+    }
+    return buffer;
+}
+
+// 前綴和的尾端重複最後一個像素 r 次
+static void extendPrefix(void* prefix, size_t elementSize, int width, int ch, int r) {
+    uint8_t* base = (uint8_t*)prefix;
+    size_t pixel = ch * elementSize;
+    const uint8_t* last = base + (size_t)(r + width) * pixel;
+    for (int k = 0; k < r; k++) memcpy(base + (size_t)(r + 1 + width + k) * pixel, last, pixel);
+}
+
+#if defined(CPU_X86)
+// ---- 欄總和：加入一行並移出一行 ----
+
+// col += widen(add) - widen(remove)，8 個 16 位元值
+TARGET_SSE2 static inline void addWordsSSE2(uint32_t* col, __m128i add, __m128i remove) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_sub_epi32(_mm_unpacklo_epi16(add, zero), _mm_unpacklo_epi16(remove, zero));
+    __m128i hi = _mm_sub_epi32(_mm_unpackhi_epi16(add, zero), _mm_unpackhi_epi16(remove, zero));
+    _mm_storeu_si128((__m128i*)col, _mm_add_epi32(_mm_loadu_si128((const __m128i*)col), lo));
+    _mm_storeu_si128((__m128i*)(col + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i*)(col + 4)), hi));
+}
+
+// 乘積最大 255 * 255，以 16 位元無號數相乘不會溢位
+TARGET_SSE2 static int updateStatsSSE2(uint32_t* const* stats, const uint8_t* gAdd, const uint8_t* gRemove,
+                                       const uint8_t* pAdd, const uint8_t* pRemove, int i, int end) {
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= end; i += 8) {
+        __m128i gn = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(gAdd + i)), zero);
+        __m128i go = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(gRemove + i)), zero);
+        addWordsSSE2(stats[0] + i, gn, go);
+        addWordsSSE2(stats[1] + i, _mm_mullo_epi16(gn, gn), _mm_mullo_epi16(go, go));
+        if (pAdd) {
+            __m128i pn = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(pAdd + i)), zero);
+            __m128i po = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(pRemove + i)), zero);
+            addWordsSSE2(stats[2] + i, pn, po);
+            addWordsSSE2(stats[3] + i, _mm_mullo_epi16(gn, pn), _mm_mullo_epi16(go, po));
+        }
+    }
+    return i;
+}
+
+TARGET_AVX2 static inline void addWordsAVX2(uint32_t* col, __m256i add, __m256i remove) {
+    __m256i lo = _mm256_sub_epi32(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(add)), _mm256_cvtepu16_epi32(_mm256_castsi256_si128(remove)));
+    __m256i hi = _mm256_sub_epi32(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(add, 1)), _mm256_cvtepu16_epi32(_mm256_extracti128_si256(remove, 1)));
+    _mm256_storeu_si256((__m256i*)col, _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)col), lo));
+    _mm256_storeu_si256((__m256i*)(col + 8), _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(col + 8)), hi));
+}
+
+TARGET_AVX2 static int updateStatsAVX2(uint32_t* const* stats, const uint8_t* gAdd, const uint8_t* gRemove,
+                                       const uint8_t* pAdd, const uint8_t* pRemove, int i, int end) {
+    for (; i + 16 <= end; i += 16) {
+        __m256i gn = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(gAdd + i)));
+        __m256i go = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(gRemove + i)));
+        addWordsAVX2(stats[0] + i, gn, go);
+        addWordsAVX2(stats[1] + i, _mm256_mullo_epi16(gn, gn), _mm256_mullo_epi16(go, go));
+        if (pAdd) {
+            __m256i pn = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(pAdd + i)));
+            __m256i po = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(pRemove + i)));
+            addWordsAVX2(stats[2] + i, pn, po);
+            addWordsAVX2(stats[3] + i, _mm256_mullo_epi16(gn, pn), _mm256_mullo_epi16(go, po));
+        }
+    }
+    return i;
+}
+#endif
+
+// 將第 add 行加入、第 remove 行移出導引值與輸入值的欄總和（-1 表示不加入或不移出）
+static void updateStats(const GuidedJob* job, GuidedScratch* s, int add, int remove) {
+    int ch = job->src->channels;
+    int lanes = job->src->width * ch;
+    const uint8_t* zero = (const uint8_t*)s->zero;
+    const uint8_t* gAdd = add >= 0 ? guideLanes(job->guide, ch, add, s->guideAdd) : zero;
+    const uint8_t* gRemove = remove >= 0 ? guideLanes(job->guide, ch, remove, s->guideRemove) : zero;
+    const uint8_t* pAdd = NULL;
+    const uint8_t* pRemove = NULL;
+    if (!job->selfGuided) {
+        pAdd = add >= 0 ? imageRow(job->src, add) : zero;
+        pRemove = remove >= 0 ? imageRow(job->src, remove) : zero;
+    }
+    int i = 0;
+#if defined(CPU_X86)
+    CpuLevel level = cpuLevel();
+    if (level >= CPU_AVX2) {
+        i = updateStatsAVX2(s->stats, gAdd, gRemove, pAdd, pRemove, i, lanes);
+    } else if (level >= CPU_SSE2) {
+        i = updateStatsSSE2(s->stats, gAdd, gRemove, pAdd, pRemove, i, lanes);
+    }
+#endif
+    for (; i < lanes; i++) {
+        uint32_t gn = gAdd[i], go = gRemove[i];
+        s->stats[0][i] += gn - go;
+        s->stats[1][i] += gn * gn - go * go;
+        if (pAdd) {
+            uint32_t pn = pAdd[i], po = pRemove[i];
+            s->stats[2][i] += pn - po;
+            s->stats[3][i] += gn * pn - go * po;
+        }
+    }
+}
+
+#if defined(CPU_X86)
+// ---- 水平前綴和：一個向量放一個像素的 4 個 lane，通道數不足 4 時多寫的 lane 會被下一個像素覆蓋 ----
+
+TARGET_SSE2 static void prefixStatsSSE2(const uint32_t* colA, const uint32_t* colB, uint32_t* prefixA, uint32_t* prefixB, int width, int ch) {
+    __m128i accA = _mm_setzero_si128(), accB = _mm_setzero_si128();
+    for (int x = 0; x < width; x++) {
+        accA = _mm_add_epi32(accA, _mm_loadu_si128((const __m128i*)(colA + x * ch)));
+        accB = _mm_add_epi32(accB, _mm_loadu_si128((const __m128i*)(colB + x * ch)));
+        _mm_storeu_si128((__m128i*)(prefixA + x * ch), accA);
+        _mm_storeu_si128((__m128i*)(prefixB + x * ch), accB);
+    }
+}
+
+TARGET_SSE2 static void prefixCoefficientsSSE2(const double* colA, const double* colB, double* prefixA, double* prefixB, int width, int ch) {
+    __m128d accA0 = _mm_setzero_pd(), accA1 = _mm_setzero_pd(), accB0 = _mm_setzero_pd(), accB1 = _mm_setzero_pd();
+    for (int x = 0; x < width; x++) {
+        accA0 = _mm_add_pd(accA0, _mm_loadu_pd(colA + x * ch));
+        accA1 = _mm_add_pd(accA1, _mm_loadu_pd(colA + x * ch + 2));
+        accB0 = _mm_add_pd(accB0, _mm_loadu_pd(colB + x * ch));
+        accB1 = _mm_add_pd(accB1, _mm_loadu_pd(colB + x * ch + 2));
+        _mm_storeu_pd(prefixA + x * ch, accA0);
+        _mm_storeu_pd(prefixA + x * ch + 2, accA1);
+        _mm_storeu_pd(prefixB + x * ch, accB0);
+        _mm_storeu_pd(prefixB + x * ch + 2, accB1);
+    }
+}
+
+TARGET_AVX2 static void prefixCoefficientsAVX2(const double* colA, const double* colB, double* prefixA, double* prefixB, int width, int ch) {
+    __m256d accA = _mm256_setzero_pd(), accB = _mm256_setzero_pd();
+    for (int x = 0; x < width; x++) {
+        accA = _mm256_add_pd(accA, _mm256_loadu_pd(colA + x * ch));
+        accB = _mm256_add_pd(accB, _mm256_loadu_pd(colB + x * ch));
+        _mm256_storeu_pd(prefixA + x * ch, accA);
+        _mm256_storeu_pd(prefixB + x * ch, accB);
+    }
+}
+#endif
+
+// 兩組欄總和的前綴和，寫在 prefix 的第 r + 1 個像素之後
+static void prefixStats(const uint32_t* colA, const uint32_t* colB, uint32_t* prefixA, uint32_t* prefixB, int width, int ch, int r) {
+    uint32_t* outA = prefixA + (size_t)(r + 1) * ch;
+    uint32_t* outB = prefixB + (size_t)(r + 1) * ch;
+#if defined(CPU_X86)
+    if (cpuLevel() >= CPU_SSE2) {
+        prefixStatsSSE2(colA, colB, outA, outB, width, ch);
+    } else
+#endif
+    {
+        uint32_t accA[IMAGE_MAX_CHANNELS] = { 0 }, accB[IMAGE_MAX_CHANNELS] = { 0 };
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < ch; c++) {
+                outA[x * ch + c] = accA[c] += colA[x * ch + c];
+                outB[x * ch + c] = accB[c] += colB[x * ch + c];
+            }
+        }
+    }
+    extendPrefix(prefixA, sizeof(uint32_t), width, ch, r);
+    extendPrefix(prefixB, sizeof(uint32_t), width, ch, r);
+}
+
+static void prefixCoefficients(GuidedScratch* s, int width, int ch, int r) {
+    double* outA = s->prefixA + (size_t)(r + 1) * ch;
+    double* outB = s->prefixB + (size_t)(r + 1) * ch;
+#if defined(CPU_X86)
+    CpuLevel level = cpuLevel();
+    if (level >= CPU_AVX2) {
+        prefixCoefficientsAVX2(s->sumA, s->sumB, outA, outB, width, ch);
+    } else if (level >= CPU_SSE2) {
+        prefixCoefficientsSSE2(s->sumA, s->sumB, outA, outB, width, ch);
+    } else
+#endif
+    {
+        double accA[IMAGE_MAX_CHANNELS] = { 0 }, accB[IMAGE_MAX_CHANNELS] = { 0 };
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < ch; c++) {
+                outA[x * ch + c] = accA[c] += s->sumA[x * ch + c];
+                outB[x * ch + c] = accB[c] += s->sumB[x * ch + c];
+            }
+        }
+    }
+    extendPrefix(s->prefixA, sizeof(double), width, ch, r);
+    extendPrefix(s->prefixB, sizeof(double), width, ch, r);
+}
+
+// 求一行係數所需的窗口總和與常數
+typedef struct {
+    const uint32_t* prefixI;
+    const uint32_t* prefixII;
+    const uint32_t* prefixP;
+    const uint32_t* prefixIP;
+    int span;                   // 窗口寬度的 lane 數 (2r + 1) * 通道數
+    const double* count;
+    const double* inverse;
+    double countY, inverseY;
+    double epsilon;
+} CoefficientRow;
+
+#if defined(CPU_X86)
+// 無號 32 位元整數轉成 double（沒有誤差）
+TARGET_SSE2 static inline __m128d unsignedToDoubleSSE2(__m128i v) {
+    return _mm_add_pd(_mm_cvtepi32_pd(_mm_xor_si128(v, _mm_set1_epi32(INT32_MIN))), _mm_set1_pd(2147483648.0));
+}
+
+TARGET_SSE2 static inline __m128i windowSSE2(const uint32_t* prefix, int span, int i) {
+    return _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(prefix + i + span)), _mm_loadu_si128((const __m128i*)(prefix + i)));
+}
+
+TARGET_SSE2 static int coefficientRowSSE2(const CoefficientRow* g, float* a, float* b, int i, int end) {
+    __m128d countY = _mm_set1_pd(g->countY), inverseY = _mm_set1_pd(g->inverseY), epsilon = _mm_set1_pd(g->epsilon);
+    for (; i + 4 <= end; i += 4) {
+        __m128i wI = windowSSE2(g->prefixI, g->span, i), wII = windowSSE2(g->prefixII, g->span, i);
+        __m128i wP = windowSSE2(g->prefixP, g->span, i), wIP = windowSSE2(g->prefixIP, g->span, i);
+        __m128 num[2], den[2];
+        __m128d sumI[2], sumP[2], inverse[2];
+        for (int k = 0; k < 2; k++) {
+            sumI[k] = _mm_cvtepi32_pd(wI);
+            sumP[k] = _mm_cvtepi32_pd(wP);
+            __m128d sumII = unsignedToDoubleSSE2(wII), sumIP = unsignedToDoubleSSE2(wIP);
+            __m128d n = _mm_mul_pd(_mm_loadu_pd(g->count + i + 2 * k), countY);
+            __m128d epsilonN2 = _mm_mul_pd(_mm_mul_pd(epsilon, n), n);
+            num[k] = _mm_cvtpd_ps(_mm_sub_pd(_mm_mul_pd(n, sumIP), _mm_mul_pd(sumI[k], sumP[k])));
+            den[k] = _mm_cvtpd_ps(_mm_add_pd(_mm_sub_pd(_mm_mul_pd(n, sumII), _mm_mul_pd(sumI[k], sumI[k])), epsilonN2));
+            inverse[k] = _mm_mul_pd(_mm_loadu_pd(g->inverse + i + 2 * k), inverseY);
+            wI = _mm_srli_si128(wI, 8);
+            wII = _mm_srli_si128(wII, 8);
+            wP = _mm_srli_si128(wP, 8);
+            wIP = _mm_srli_si128(wIP, 8);
+        }
+        __m128 coefA = _mm_div_ps(_mm_movelh_ps(num[0], num[1]), _mm_movelh_ps(den[0], den[1]));
+        __m128d a0 = _mm_cvtps_pd(coefA), a1 = _mm_cvtps_pd(_mm_movehl_ps(coefA, coefA));
+        __m128 b0 = _mm_cvtpd_ps(_mm_mul_pd(_mm_sub_pd(sumP[0], _mm_mul_pd(a0, sumI[0])), inverse[0]));
+        __m128 b1 = _mm_cvtpd_ps(_mm_mul_pd(_mm_sub_pd(sumP[1], _mm_mul_pd(a1, sumI[1])), inverse[1]));
+        _mm_storeu_ps(a + i, coefA);
+        _mm_storeu_ps(b + i, _mm_movelh_ps(b0, b1));
+    }
+    return i;
+}
+
+TARGET_AVX2 static inline __m256d unsignedToDoubleAVX2(__m128i v) {
+    return _mm256_add_pd(_mm256_cvtepi32_pd(_mm_xor_si128(v, _mm_set1_epi32(INT32_MIN))), _mm256_set1_pd(2147483648.0));
+}
+
+TARGET_AVX2 static inline __m256i windowAVX2(const uint32_t* prefix, int span, int i) {
+    return _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(prefix + i + span)), _mm256_loadu_si256((const __m256i*)(prefix + i)));
+}
+
+TARGET_AVX2 static inline __m128i halfAVX2(__m256i v, int k) {
+    return k ? _mm256_extracti128_si256(v, 1) : _mm256_castsi256_si128(v);
+}
+
+TARGET_AVX2 static int coefficientRowAVX2(const CoefficientRow* g, float* a, float* b, int i, int end) {
+    __m256d countY = _mm256_set1_pd(g->countY), inverseY = _mm256_set1_pd(g->inverseY), epsilon = _mm256_set1_pd(g->epsilon);
+    for (; i + 8 <= end; i += 8) {
+        __m256i wI = windowAVX2(g->prefixI, g->span, i), wII = windowAVX2(g->prefixII, g->span, i);
+        __m256i wP = windowAVX2(g->prefixP, g->span, i), wIP = windowAVX2(g->prefixIP, g->span, i);
+        __m128 num[2], den[2], coefB[2];
+        __m256d sumI[2], sumP[2], inverse[2];
+        for (int k = 0; k < 2; k++) {
+            sumI[k] = _mm256_cvtepi32_pd(halfAVX2(wI, k));
+            sumP[k] = _mm256_cvtepi32_pd(halfAVX2(wP, k));
+            __m256d sumII = unsignedToDoubleAVX2(halfAVX2(wII, k)), sumIP = unsignedToDoubleAVX2(halfAVX2(wIP, k));
+            __m256d n = _mm256_mul_pd(_mm256_loadu_pd(g->count + i + 4 * k), countY);
+            __m256d epsilonN2 = _mm256_mul_pd(_mm256_mul_pd(epsilon, n), n);
+            num[k] = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_mul_pd(n, sumIP), _mm256_mul_pd(sumI[k], sumP[k])));
+            den[k] = _mm256_cvtpd_ps(_mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(n, sumII), _mm256_mul_pd(sumI[k], sumI[k])), epsilonN2));
+            inverse[k] = _mm256_mul_pd(_mm256_loadu_pd(g->inverse + i + 4 * k), inverseY);
+        }
+        __m256 coefA = _mm256_div_ps(_mm256_set_m128(num[1], num[0]), _mm256_set_m128(den[1], den[0]));
+        for (int k = 0; k < 2; k++) {
+            __m256d ak = _mm256_cvtps_pd(k ? _mm256_extractf128_ps(coefA, 1) : _mm256_castps256_ps128(coefA));
+            coefB[k] = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_sub_pd(sumP[k], _mm256_mul_pd(ak, sumI[k])), inverse[k]));
+        }
+        _mm256_storeu_ps(a + i, coefA);
+        _mm256_storeu_ps(b + i, _mm256_set_m128(coefB[1], coefB[0]));
+    }
+    return i;
+}
+#endif
+
+// 由窗口總和求出第 y 行每個 lane 的係數 a、b
+// 以窗口像素數 n 通分：a = (n * ΣIp - ΣI * Σp) / (n * ΣI² - (ΣI)² + epsilon * n²)，b = (Σp - a * ΣI) / n
+// 分子與分母的前兩項都是小於 2^53 的整數（見 GUIDED_MAX_RADIUS），以 double 計算沒有誤差，變異數不會因相減而失去精度；
+// 相除時轉成 float，a 本身也以 float 儲存
+static void coefficientRow(const GuidedJob* job, const GuidedScratch* s, int y, float* a, float* b) {
+    int ch = job->src->channels;
+    int lanes = job->src->width * ch;
+    int r = job->radius;
+    CoefficientRow g;
+    g.prefixI = s->statsPrefix[0];
+    g.prefixII = s->statsPrefix[1];
+    g.prefixP = job->selfGuided ? s->statsPrefix[0] : s->statsPrefix[2];
+    g.prefixIP = job->selfGuided ? s->statsPrefix[1] : s->statsPrefix[3];
+    g.span = (2 * r + 1) * ch;
+    g.count = job->countLanes;
+    g.inverse = job->inverseLanes;
+    g.countY = windowCount(y, r, job->src->height);
+    g.inverseY = 1.0 / g.countY;
+    g.epsilon = job->epsilon;
+    int i = 0;
+#if defined(CPU_X86)
+    CpuLevel level = cpuLevel();
+    if (level >= CPU_AVX2) {
+        i = coefficientRowAVX2(&g, a, b, i, lanes);
+    } else if (level >= CPU_SSE2) {
+        i = coefficientRowSSE2(&g, a, b, i, lanes);
+    }
+#endif
+    for (; i < lanes; i++) {
+        int32_t wI = (int32_t)(g.prefixI[i + g.span] - g.prefixI[i]);
+        int32_t wP = (int32_t)(g.prefixP[i + g.span] - g.prefixP[i]);
+        uint32_t wII = g.prefixII[i + g.span] - g.prefixII[i];
+        uint32_t wIP = g.prefixIP[i + g.span] - g.prefixIP[i];
+        double n = g.count[i] * g.countY;
+        double epsilonN2 = g.epsilon * n * n;
+        double sumI = wI, sumP = wP;
+        float num = (float)(n * (double)wIP - sumI * sumP);
+        float den = (float)(n * (double)wII - sumI * sumI + epsilonN2);
+        float coefA = num / den;
+        a[i] = coefA;
+        b[i] = (float)((sumP - (double)coefA * sumI) * (g.inverse[i] * g.inverseY));
+    }
+}
+
+#if defined(CPU_X86)
+// ---- 係數的欄總和：加入一行並移出一行 ----
+
+TARGET_SSE2 static int updateCoefficientsSSE2(GuidedScratch* s, const float* addA, const float* addB, const float* removeA, const float* removeB, int i, int end) {
+    for (; i + 2 <= end; i += 2) {
+        __m128d na = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)(addA + i))));
+        __m128d oa = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)(removeA + i))));
+        __m128d nb = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)(addB + i))));
+        __m128d ob = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)(removeB + i))));
+        _mm_storeu_pd(s->sumA + i, _mm_add_pd(_mm_loadu_pd(s->sumA + i), _mm_sub_pd(na, oa)));
+        _mm_storeu_pd(s->sumB + i, _mm_add_pd(_mm_loadu_pd(s->sumB + i), _mm_sub_pd(nb, ob)));
+    }
+    return i;
+}
+
+TARGET_AVX2 static int updateCoefficientsAVX2(GuidedScratch* s, const float* addA, const float* addB, const float* removeA, const float* removeB, int i, int end) {
+    for (; i + 4 <= end; i += 4) {
+        __m256d na = _mm256_cvtps_pd(_mm_loadu_ps(addA + i)), oa = _mm256_cvtps_pd(_mm_loadu_ps(removeA + i));
+        __m256d nb = _mm256_cvtps_pd(_mm_loadu_ps(addB + i)), ob = _mm256_cvtps_pd(_mm_loadu_ps(removeB + i));
+        _mm256_storeu_pd(s->sumA + i, _mm256_add_pd(_mm256_loadu_pd(s->sumA + i), _mm256_sub_pd(na, oa)));
+        _mm256_storeu_pd(s->sumB + i, _mm256_add_pd(_mm256_loadu_pd(s->sumB + i), _mm256_sub_pd(nb, ob)));
+    }
+    return i;
+}
+#endif
+
+// 將第 add 行的係數加入、第 remove 行的係數移出係數的欄總和（-1 表示不加入或不移出）
+static void updateCoefficients(GuidedScratch* s, int lanes, int add, int remove) {
+    const float* addA = add >= 0 ? s->ringA + (size_t)(add % s->ringRows) * lanes : s->zero;
+    const float* addB = add >= 0 ? s->ringB + (size_t)(add % s->ringRows) * lanes : s->zero;
+    const float* removeA = remove >= 0 ? s->ringA + (size_t)(remove % s->ringRows) * lanes : s->zero;
+    const float* removeB = remove >= 0 ? s->ringB + (size_t)(remove % s->ringRows) * lanes : s->zero;
+    int i = 0;
+#if defined(CPU_X86)
+    CpuLevel level = cpuLevel();
+    if (level >= CPU_AVX2) {
+        i = updateCoefficientsAVX2(s, addA, addB, removeA, removeB, i, lanes);
+    } else if (level >= CPU_SSE2) {
+        i = updateCoefficientsSSE2(s, addA, addB, removeA, removeB, i, lanes);
+    }
+#endif
+    for (; i < lanes; i++) {
+        s->sumA[i] += (double)addA[i] - (double)removeA[i];
+        s->sumB[i] += (double)addB[i] - (double)removeB[i];
+    }
+}
+
+#if defined(CPU_X86)
+// ---- 平均後的係數 ----
+
+TARGET_SSE2 static int meanRowSSE2(const GuidedScratch* s, const double* inverse, double inverseY, int span, int i, int end) {
+    __m128d vInverseY = _mm_set1_pd(inverseY);
+    for (; i + 4 <= end; i += 4) {
+        __m128 meanA[2], meanB[2];
+        for (int k = 0; k < 2; k++) {
+            int j = i + 2 * k;
+            __m128d scale = _mm_mul_pd(_mm_loadu_pd(inverse + j), vInverseY);
+            meanA[k] = _mm_cvtpd_ps(_mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(s->prefixA + j + span), _mm_loadu_pd(s->prefixA + j)), scale));
+            meanB[k] = _mm_cvtpd_ps(_mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(s->prefixB + j + span), _mm_loadu_pd(s->prefixB + j)), scale));
+        }
+        _mm_storeu_ps(s->meanA + i, _mm_movelh_ps(meanA[0], meanA[1]));
+        _mm_storeu_ps(s->meanB + i, _mm_movelh_ps(meanB[0], meanB[1]));
+    }
+    return i;
+}
+
+TARGET_AVX2 static int meanRowAVX2(const GuidedScratch* s, const double* inverse, double inverseY, int span, int i, int end) {
+    __m256d vInverseY = _mm256_set1_pd(inverseY);
+    for (; i + 8 <= end; i += 8) {
+        __m128 meanA[2], meanB[2];
+        for (int k = 0; k < 2; k++) {
+            int j = i + 4 * k;
+            __m256d scale = _mm256_mul_pd(_mm256_loadu_pd(inverse + j), vInverseY);
+            meanA[k] = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(s->prefixA + j + span), _mm256_loadu_pd(s->prefixA + j)), scale));
+            meanB[k] = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(s->prefixB + j + span), _mm256_loadu_pd(s->prefixB + j)), scale));
+        }
+        _mm256_storeu_ps(s->meanA + i, _mm256_set_m128(meanA[1], meanA[0]));
+        _mm256_storeu_ps(s->meanB + i, _mm256_set_m128(meanB[1], meanB[0]));
+    }
+    return i;
+}
+
+// ---- 組合輸出：a、b 在上下兩行之間線性內插後 q = a * I + b ----
+
+TARGET_SSE2 static int combineRowSSE2(const float* a0, const float* a1, const float* b0, const float* b1, float fy,
+                                      const uint8_t* guide, uint8_t* out, int i, int end) {
+    __m128 vFy = _mm_set1_ps(fy);
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= end; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(guide + i));
+        __m128i lo = _mm_unpacklo_epi8(bytes, zero), hi = _mm_unpackhi_epi8(bytes, zero);
+        __m128i words[4] = { _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero), _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero) };
+        __m128i r[4];
+        for (int k = 0; k < 4; k++) {
+            int j = i + 4 * k;
+            __m128 ta = _mm_loadu_ps(a0 + j), tb = _mm_loadu_ps(b0 + j);
+            __m128 a = _mm_add_ps(ta, _mm_mul_ps(vFy, _mm_sub_ps(_mm_loadu_ps(a1 + j), ta)));
+            __m128 b = _mm_add_ps(tb, _mm_mul_ps(vFy, _mm_sub_ps(_mm_loadu_ps(b1 + j), tb)));
+            __m128 v = _mm_add_ps(_mm_mul_ps(a, _mm_cvtepi32_ps(words[k])), b);
+            v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+            r[k] = _mm_cvttps_epi32(_mm_add_ps(v, _mm_set1_ps(0.5f)));
+        }
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(_mm_packs_epi32(r[0], r[1]), _mm_packs_epi32(r[2], r[3])));
+    }
+    return i;
+}
+
+TARGET_AVX2 static int combineRowAVX2(const float* a0, const float* a1, const float* b0, const float* b1, float fy,
+                                      const uint8_t* guide, uint8_t* out, int i, int end) {
+    __m256 vFy = _mm256_set1_ps(fy);
+    for (; i + 16 <= end; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(guide + i));
+        __m256i r[2];
+        for (int k = 0; k < 2; k++) {
+            int j = i + 8 * k;
+            __m256 g = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(k ? _mm_srli_si128(bytes, 8) : bytes));
+            __m256 ta = _mm256_loadu_ps(a0 + j), tb = _mm256_loadu_ps(b0 + j);
+            __m256 a = _mm256_add_ps(ta, _mm256_mul_ps(vFy, _mm256_sub_ps(_mm256_loadu_ps(a1 + j), ta)));
+            __m256 b = _mm256_add_ps(tb, _mm256_mul_ps(vFy, _mm256_sub_ps(_mm256_loadu_ps(b1 + j), tb)));
+            __m256 v = _mm256_add_ps(_mm256_mul_ps(a, g), b);
+            v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+            r[k] = _mm256_cvttps_epi32(_mm256_add_ps(v, _mm256_set1_ps(0.5f)));
+        }
+        __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(r[0], r[1]), 0xD8);
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1)));
+    }
+    return i;
+}
+#endif
+
+static void combineRow(const float* a0, const float* a1, const float* b0, const float* b1, float fy,
+                       const uint8_t* guide, uint8_t* out, int count) {
+    int i = 0;
+#if defined(CPU_X86)
+    CpuLevel level = cpuLevel();
+    if (level >= CPU_AVX2) {
+        i = combineRowAVX2(a0, a1, b0, b1, fy, guide, out, i, count);
+    } else if (level >= CPU_SSE2) {
+        i = combineRowSSE2(a0, a1, b0, b1, fy, guide, out, i, count);
+    }
+#endif
+    for (; i < count; i++) {
+        float a = a0[i] + fy * (a1[i] - a0[i]);
+        float b = b0[i] + fy * (b1[i] - b0[i]);
+        out[i] = roundPixel(a * guide[i] + b);
+    }
+}
+
+// 由係數的欄總和求出第 y 行的輸出 q = mean(a) * I + mean(b)，或寫出平均後的係數
+static void outputRow(const GuidedJob* job, GuidedScratch* s, int y) {
+    int width = job->src->width;
+    int ch = job->src->channels;
+    int r = job->radius;
+    int lanes = width * ch;
+    int span = (2 * r + 1) * ch;
+    double inverseY = 1.0 / windowCount(y, r, job->src->height);
+    prefixCoefficients(s, width, ch, r);
+
+    int i = 0;
+#if defined(CPU_X86)
+    CpuLevel level = cpuLevel();
+    if (level >= CPU_AVX2) {
+        i = meanRowAVX2(s, job->inverseLanes, inverseY, span, i, lanes);
+    } else if (level >= CPU_SSE2) {
+        i = meanRowSSE2(s, job->inverseLanes, inverseY, span, i, lanes);
+    }
+#endif
+    for (; i < lanes; i++) {
+        double scale = job->inverseLanes[i] * inverseY;
+        s->meanA[i] = (float)((s->prefixA[i + span] - s->prefixA[i]) * scale);
+        s->meanB[i] = (float)((s->prefixB[i + span] - s->prefixB[i]) * scale);
+    }
+
+    if (job->dst) {
+        const uint8_t* guide = guideLanes(job->guide, ch, y, s->guideOut);
+        combineRow(s->meanA, s->meanA, s->meanB, s->meanB, 0.0f, guide, imageRow(job->dst, y), lanes);
+    } else {
+        memcpy(job->meanA + (size_t)y * lanes, s->meanA, lanes * sizeof(float));
+        memcpy(job->meanB + (size_t)y * lanes, s->meanB, lanes * sizeof(float));
+    }
+}
+
+// 求出第 y 行的係數放入環狀緩衝區；各行須依序求出，a0 為條帶第一個需要係數的行
+static void nextCoefficients(const GuidedJob* job, GuidedScratch* s, int y, int a0) {
+    int width = job->src->width;
+    int ch = job->src->channels;
+    int r = job->radius;
+    int add = y + r < job->src->height ? y + r : -1;
+    int remove = y > a0 && y - r - 1 >= 0 ? y - r - 1 : -1;
+    if (add >= 0 || remove >= 0) updateStats(job, s, add, remove);
+    prefixStats(s->stats[0], s->stats[1], s->statsPrefix[0], s->statsPrefix[1], width, ch, r);
+    if (!job->selfGuided) prefixStats(s->stats[2], s->stats[3], s->statsPrefix[2], s->statsPrefix[3], width, ch, r);
+    size_t offset = (size_t)(y % s->ringRows) * width * ch;
+    coefficientRow(job, s, y, s->ringA + offset, s->ringB + offset);
+}
+
+// 切出暫存空間，每塊從快取行的邊界開始；base 為 NULL 時只計算大小
+// 傳回總位元組數，*zeroBytes 為開頭需要清為 0 的位元組數（環狀緩衝區以外的部分）
+static size_t scratchLayout(const GuidedJob* job, GuidedScratch* s, uint8_t* base, size_t* zeroBytes) {
+    int ch = job->src->channels;
+    int r = job->radius;
+    size_t lanes = (size_t)job->src->width * ch;
+    size_t pitch = lanes + LANE_PAD;
+    size_t extended = lanes + (size_t)(2 * r + 1) * ch + LANE_PAD;
+    int statCount = job->selfGuided ? 2 : 4;
+    size_t offset = 0;
+#define CARVE(ptr, type, count) do { \
+        if (base) ptr = (type*)(base + offset); \
+        offset += ((count) * sizeof(type) + IMAGE_ALIGN - 1) & ~(size_t)(IMAGE_ALIGN - 1); \
+    } while (0)
+    for (int k = 0; k < statCount; k++) {
+        CARVE(s->stats[k], uint32_t, pitch);
+        CARVE(s->statsPrefix[k], uint32_t, extended);
+    }
+    CARVE(s->sumA, double, pitch);
+    CARVE(s->sumB, double, pitch);
+    CARVE(s->prefixA, double, extended);
+    CARVE(s->prefixB, double, extended);
+    CARVE(s->zero, float, lanes);
+    *zeroBytes = offset;
+    CARVE(s->meanA, float, lanes);
+    CARVE(s->meanB, float, lanes);
+    CARVE(s->guideAdd, uint8_t, lanes);
+    CARVE(s->guideRemove, uint8_t, lanes);
+    CARVE(s->guideOut, uint8_t, lanes);
+    s->ringRows = 2 * r + 2;
+    CARVE(s->ringA, float, (size_t)s->ringRows * lanes);
+    CARVE(s->ringB, float, (size_t)s->ringRows * lanes);
+#undef CARVE
+    return offset;
+}
+
+// 處理一個條帶：依序求出條帶與上下 r 行的係數，每求出一行就對係數做方框平均並輸出一行
+// 係數只保留最近 2r + 2 行，暫存空間與條帶高度無關
+static void guidedStripTask(int strip, void* ctx) {
+    GuidedJob* job = (GuidedJob*)ctx;
+    int height = job->src->height;
+    int lanes = job->src->width * job->src->channels;
+    int r = job->radius;
+    int y0 = strip * job->stripHeight;
+    int y1 = y0 + job->stripHeight < height ? y0 + job->stripHeight : height;
+    int a0 = y0 - r < 0 ? 0 : y0 - r;           // 第一個需要係數的行
+
+    GuidedScratch s;
+    size_t zeroBytes;
+    size_t bytes = scratchLayout(job, &s, NULL, &zeroBytes);
+    uint8_t* buffer = (uint8_t*)framePoolAcquire(framePoolShared(), bytes, IMAGE_ALIGN);
+    if (!buffer) {
+        atomic_store(&job->failed, 1);
+        return;
+    }
+    scratchLayout(job, &s, buffer, &zeroBytes);
+    memset(buffer, 0, zeroBytes);
+
+    // 導引值的欄總和涵蓋第 y - r ~ y + r 行，先加入第 a0 行需要的前 2r 行
+    for (int y = a0 - r < 0 ? 0 : a0 - r; y < a0 + r && y < height; y++) updateStats(job, &s, y, -1);
+    // 係數的欄總和涵蓋第 y - r ~ y + r 行，先求出並加入第 y0 行需要的前 2r 行
+    for (int y = a0; y < y0 + r && y < height; y++) {
+        nextCoefficients(job, &s, y, a0);
+        updateCoefficients(&s, lanes, y, -1);
+    }
+    for (int y = y0; y < y1; y++) {
+        int add = y + r < height ? y + r : -1;
+        int remove = y > y0 && y - r - 1 >= 0 ? y - r - 1 : -1;
+        if (add >= 0) nextCoefficients(job, &s, add, a0);
+        if (add >= 0 || remove >= 0) updateCoefficients(&s, lanes, add, remove);
+        outputRow(job, &s, y);
+    }
+
+    framePoolRelease(framePoolShared(), buffer);
+}
+
+// 以條帶平行處理整張影像（dst 為 NULL 時輸出平均後的係數）
+static int guidedStrips(GuidedJob* job) {
+    int width = job->src->width;
+    int height = job->src->height;
+    int ch = job->src->channels;
+    size_t lanes = (size_t)width * ch;
+    double* counts = (double*)malloc(2 * lanes * sizeof(double));
+    if (!counts) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        return -1;
+    }
+    for (int x = 0; x < width; x++) {
+        double count = windowCount(x, job->radius, width);
+        for (int c = 0; c < ch; c++) {
+            counts[x * ch + c] = count;
+            counts[lanes + x * ch + c] = 1.0 / count;
+        }
+    }
+    job->countLanes = counts;
+    job->inverseLanes = counts + lanes;
+
+    job->stripHeight = 4 * job->radius > GUIDED_STRIP_ROWS ? 4 * job->radius : GUIDED_STRIP_ROWS;
+    atomic_init(&job->failed, 0);
+    parallelFor((height + job->stripHeight - 1) / job->stripHeight, guidedStripTask, job);
+    free(counts);
+    if (atomic_load(&job->failed)) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        return -1;
+    }
+    return 0;
+}
+
+// ======= 快速版：縮小後計算係數，放大後與完整解析度的導引影像組合 =======
+
+typedef struct {
+    const ImageView* guide;
+    ImageView* dst;
+    const float* meanA;         // 縮小影像上平均後的係數
+    const float* meanB;
+    int lowWidth, lowHeight;
+    const int* left;            // 每個輸出欄左右兩側的係數欄與右側的權重
+    const int* right;
+    const float* fracX;
+    int bandHeight;
+    atomic_int failed;
+} UpsampleJob;
+
+// 輸出座標 x 對應到縮小影像的左側格點與右側的權重（像素中心對齊）
+static void upsampleWeights(int x, int size, int lowSize, int* left, float* frac) {
+    double u = (x + 0.5) * lowSize / size - 0.5;
+    if (u <= 0.0) {
+        *left = 0;
+        *frac = 0.0f;
+    } else if (u >= lowSize - 1) {
+        *left = lowSize - 1;
+        *frac = 0.0f;
+    } else {
+        *left = (int)u;
+        *frac = (float)(u - *left);
+    }
+}
+
+// 把縮小影像的一行係數水平內插到完整寬度
+static void expandRow(const UpsampleJob* job, const float* low, float* out) {
+    int ch = job->dst->channels;
+    for (int x = 0; x < job->dst->width; x++) {
+        const float* l = low + job->left[x] * ch;
+        const float* rgt = low + job->right[x] * ch;
+        float fx = job->fracX[x];
+        for (int c = 0; c < ch; c++) out[x * ch + c] = l[c] + fx * (rgt[c] - l[c]);
+    }
+}
+
+// 每個縮小影像的係數行只水平內插一次，輸出行在上下兩行之間垂直內插
+static void upsampleTask(int band, void* ctx) {
+    UpsampleJob* job = (UpsampleJob*)ctx;
+    int height = job->dst->height;
+    int ch = job->dst->channels;
+    size_t lanes = (size_t)job->dst->width * ch;
+    size_t lowLanes = (size_t)job->lowWidth * ch;
+    float* buffer = (float*)framePoolAcquire(framePoolShared(), 4 * lanes * sizeof(float) + lanes, IMAGE_ALIGN);
+    if (!buffer) {
+        atomic_store(&job->failed, 1);
+        return;
+    }
+    float* topA = buffer;
+    float* topB = topA + lanes;
+    float* bottomA = topB + lanes;
+    float* bottomB = bottomA + lanes;
+    uint8_t* guideBuffer = (uint8_t*)(bottomB + lanes);
+
+    int topRow = -1, bottomRow = -1;  // 目前內插好的縮小影像行
+    int yEnd = (band + 1) * job->bandHeight < height ? (band + 1) * job->bandHeight : height;
+    for (int y = band * job->bandHeight; y < yEnd; y++) {
+        int top;
+        float fy;
+        upsampleWeights(y, height, job->lowHeight, &top, &fy);
+        int bottom = top + 1 < job->lowHeight ? top + 1 : top;
+        if (top != topRow) {
+            if (top == bottomRow) {
+                float* t = topA; topA = bottomA; bottomA = t;
+                t = topB; topB = bottomB; bottomB = t;
+                bottomRow = -1;
+            } else {
+                expandRow(job, job->meanA + top * lowLanes, topA);
+                expandRow(job, job->meanB + top * lowLanes, topB);
+            }
+            topRow = top;
+        }
+        if (bottom != bottomRow) {
+            expandRow(job, job->meanA + bottom * lowLanes, bottomA);
+            expandRow(job, job->meanB + bottom * lowLanes, bottomB);
+            bottomRow = bottom;
+        }
+        const uint8_t* guide = guideLanes(job->guide, ch, y, guideBuffer);
+        combineRow(topA, bottomA, topB, bottomB, fy, guide, imageRow(job->dst, y), (int)lanes);
+    }
+    framePoolRelease(framePoolShared(), buffer);
+}
+
+// 實際計算係數時的半徑：快速版為縮小後的半徑（四捨五入，至少為 1）
+static int guidedRadius(const GuidedParams* params) {
+    int s = params->subsample;
+    int radius = (params->radius + s / 2) / s;
+    return radius > 1 ? radius : 1;
+}
+
+// 快速版的各步驟，緩衝區由 guidedFast 配置
+static int guidedFastRun(const ImageView* guide, const ImageView* src, ImageView* dst, const GuidedParams* params, int selfGuided,
+                         ImageView* lowSrc, ImageView* lowGuide, float* coefficients, int* columns, float* fracX) {
+    int s = params->subsample;
+    size_t lowLanes = (size_t)lowSrc->width * lowSrc->channels;
+
+    // 以面積平均縮小
+    if (resizeImage(src, lowSrc, RESIZE_AREA) != 0) return -1;
+    if (!selfGuided && resizeImage(guide, lowGuide, RESIZE_AREA) != 0) return -1;
+
+    GuidedJob job;
+    job.guide = lowGuide;
+    job.src = lowSrc;
+    job.dst = NULL;
+    job.meanA = coefficients;
+    job.meanB = coefficients + lowLanes * lowSrc->height;
+    job.radius = guidedRadius(params);
+    job.epsilon = params->epsilon;
+    job.selfGuided = selfGuided;
+    if (guidedStrips(&job) != 0) return -1;
+
+    int* left = columns;
+    int* right = columns + src->width;
+    for (int x = 0; x < src->width; x++) {
+        upsampleWeights(x, src->width, lowSrc->width, &left[x], &fracX[x]);
+        right[x] = left[x] + 1 < lowSrc->width ? left[x] + 1 : left[x];
+    }
+    UpsampleJob up;
+    up.guide = guide;
+    up.dst = dst;
+    up.meanA = job.meanA;
+    up.meanB = job.meanB;
+    up.lowWidth = lowSrc->width;
+    up.lowHeight = lowSrc->height;
+    up.left = left;
+    up.right = right;
+    up.fracX = fracX;
+    int bands = threadPoolThreads() * 4;
+    up.bandHeight = (src->height + bands - 1) / bands;
+    if (up.bandHeight < s) up.bandHeight = s;
+    atomic_init(&up.failed, 0);
+    parallelFor((src->height + up.bandHeight - 1) / up.bandHeight, upsampleTask, &up);
+    if (atomic_load(&up.failed)) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int guidedFast(const ImageView* guide, const ImageView* src, ImageView* dst, const GuidedParams* params, int selfGuided) {
+    int s = params->subsample;
+    int lowWidth = (src->width + s - 1) / s;
+    int lowHeight = (src->height + s - 1) / s;
+
+    Image lowSrc, lowGuide;
+    if (imageCreate(&lowSrc, lowWidth, lowHeight, src->channels, IMAGE_INTERLEAVED) != 0) return -1;
+    if (!selfGuided && imageCreate(&lowGuide, lowWidth, lowHeight, guide->channels, IMAGE_INTERLEAVED) != 0) {
+        imageFree(&lowSrc);
+        return -1;
+    }
+    float* coefficients = (float*)framePoolAcquire(framePoolShared(), 2 * (size_t)lowWidth * src->channels * lowHeight * sizeof(float), IMAGE_ALIGN);
+    int* columns = (int*)malloc(2 * (size_t)src->width * sizeof(int));
+    float* fracX = (float*)malloc(src->width * sizeof(float));
+
+    int result = -1;
+    if (!coefficients || !columns || !fracX) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+    } else {
+        ImageView lowSrcView = imageView(&lowSrc);
+        ImageView lowGuideView = selfGuided ? lowSrcView : imageView(&lowGuide);
+        result = guidedFastRun(guide, src, dst, params, selfGuided, &lowSrcView, &lowGuideView, coefficients, columns, fracX);
+    }
+
+    free(columns);
+    free(fracX);
+    framePoolRelease(framePoolShared(), coefficients);
+    if (!selfGuided) imageFree(&lowGuide);
+    imageFree(&lowSrc);
+    return result;
+}
+
+int guidedFilter(const ImageView* guide, const ImageView* src, ImageView* dst, const GuidedParams* params) {
+    if (params->radius < 1 || params->subsample < 1 || !(params->epsilon > 0.0)) {
+        fprintf(stderr, "導引濾波的半徑與縮小倍率須至少為 1，epsilon 須大於 0。\n");
+        return -1;
+    }
+    if (guidedRadius(params) > GUIDED_MAX_RADIUS) {
+        fprintf(stderr, "導引濾波的半徑除以縮小倍率後不可超過 %d。\n", GUIDED_MAX_RADIUS);
+        return -1;
+    }
+    int selfGuided = !guide || guide->data == src->data;
+    if (selfGuided) {
+        guide = src;
+    } else if (guide->width != src->width || guide->height != src->height ||
+               (guide->channels != 1 && guide->channels != src->channels)) {
+        fprintf(stderr, "導引影像須與輸入影像大小相同，且為灰階或通道數相同。\n");
+        return -1;
+    }
+    if (src->width <= 0 || src->height <= 0) return 0;
+
+    TRACE_BEGIN(span, "guided");
+    int result;
+    if (params->subsample > 1) {
+        result = guidedFast(guide, src, dst, params, selfGuided);
+    } else {
+        GuidedJob job;
+        job.guide = guide;
+        job.src = src;
+        job.dst = dst;
+        job.meanA = job.meanB = NULL;
+        job.radius = params->radius;
+        job.epsilon = params->epsilon;
+        job.selfGuided = selfGuided;
+        result = guidedStrips(&job);
+    }
+    TRACE_END(span, 2 * (uint64_t)src->width * src->height * src->channels, (uint64_t)src->width * src->height);
+    return result;
+}
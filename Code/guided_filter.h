@@ -0,0 +1,29 @@
+#ifndef GUIDED_FILTER_H
+#define GUIDED_FILTER_H
+
+#include "bmp_io.h"
+
+// 計算係數時的半徑上限：窗口內導引值平方的總和須放得進 32 位元無號整數，
+// 通分後的分子與分母也才是 double 能精確表示的整數
+#define GUIDED_MAX_RADIUS 127
+
+// 導引濾波（He, Sun & Tang）：在每個 (2r+1) x (2r+1) 窗口內把輸出視為導引影像的線性函數 q = a * I + b，
+// 以最小平方求出 a、b 後對所有涵蓋該像素的窗口取平均。導引影像的邊緣處變異數大，a 接近 1，邊緣被保留；
+// 平坦處變異數遠小於 epsilon，a 接近 0，輸出接近窗口的平均值，效果類似雙邊濾波
+// 所有窗口平均都以累加總和的方框濾波計算（往下一行每欄加入一個值並移出一個值，往右一格再加入並移出一欄），
+// 每像素的計算量與半徑無關；影像邊緣的窗口只涵蓋影像內的像素
+typedef struct {
+    int radius;         // 窗口半徑 r（至少 1，除以 subsample 後不超過 GUIDED_MAX_RADIUS）
+    double epsilon;     // 正則化項，單位為 8 位元亮度的平方；變異數遠小於 epsilon 的區域被平滑
+    int subsample;      // 快速版的縮小倍率 s（1 為完整解析度）：係數在縮小 s 倍的影像上以半徑 r / s 計算，
+                        // 再以雙線性內插放大後與完整解析度的導引影像組合，計算量約為 1 / s^2
+} GuidedParams;
+
+// 以導引濾波處理 src，每個通道分別處理，所有像素（包含邊界）都會寫入
+// guide 為 NULL 時以 src 本身導引；否則須與 src 大小相同，可為灰階（所有通道共用）或與 src 通道數相同（逐通道導引）
+// 影像切成固定高度的條帶以多執行緒處理，每個條帶上下多算 r 行係數；結果與執行緒數及 SIMD 等級無關
+// src 與 dst 不可指向同一塊記憶體
+// 成功傳回 0，參數不合法或記憶體不足時傳回 -1
+int guidedFilter(const ImageView* guide, const ImageView* src, ImageView* dst, const GuidedParams* params);
+
+#endif
@@ -0,0 +1,165 @@
+// 色相與飽和度調整的向量版本，由 color_ops.c 引入兩次：定義 HUESAT_AVX2 時產生 AVX2 版本（一次 8 個像素），
+// 否則產生 SSE2 版本（一次 4 個像素）；函式名稱加上指令集的後綴（例如 hueSatRowAVX2），兩個版本不會衝突
+//
+// 每個通道值都是小整數，以 float 存放時加減乘都是精確的；
+// 唯一的除法 w * max / (HUE_STEPS * delta) 的商不超過 255、與整數的距離至少 1 / (HUE_STEPS * delta)，
+// 正確捨入的 float 除法不會跨過整數，因此 ceil 後與整數版本逐像素相同
+
+#define HS_CONCAT(a, b) a##b
+#define HS_NAME(a, b) HS_CONCAT(a, b)
+
+#if defined(HUESAT_AVX2)
+#define HS_SUFFIX AVX2
+#define HS_TARGET TARGET_AVX2
+#define HUESAT_LANES 8
+#define HueSatVec __m256
+#else
+#define HS_SUFFIX SSE2
+#define HS_TARGET TARGET_SSE2
+#define HUESAT_LANES 4
+#define HueSatVec __m128
+#endif
+
+#define hsLoad HS_NAME(hsLoad, HS_SUFFIX)
+#define hsStore HS_NAME(hsStore, HS_SUFFIX)
+#define hsSet HS_NAME(hsSet, HS_SUFFIX)
+#define hsAdd HS_NAME(hsAdd, HS_SUFFIX)
+#define hsSub HS_NAME(hsSub, HS_SUFFIX)
+#define hsMul HS_NAME(hsMul, HS_SUFFIX)
+#define hsDiv HS_NAME(hsDiv, HS_SUFFIX)
+#define hsMin HS_NAME(hsMin, HS_SUFFIX)
+#define hsMax HS_NAME(hsMax, HS_SUFFIX)
+#define hsEq HS_NAME(hsEq, HS_SUFFIX)
+#define hsLt HS_NAME(hsLt, HS_SUFFIX)
+#define hsGe HS_NAME(hsGe, HS_SUFFIX)
+#define hsAnd HS_NAME(hsAnd, HS_SUFFIX)
+#define hsAndNot HS_NAME(hsAndNot, HS_SUFFIX)
+#define hsSelect HS_NAME(hsSelect, HS_SUFFIX)
+#define hsTrunc HS_NAME(hsTrunc, HS_SUFFIX)
+#define hueSatLanes HS_NAME(hueSatLanes, HS_SUFFIX)
+#define hueSatRow HS_NAME(hueSatRow, HS_SUFFIX)
+
+#if defined(HUESAT_AVX2)
+HS_TARGET static inline HueSatVec hsLoad(const uint8_t *p) { return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p))); }
+HS_TARGET static inline void hsStore(uint8_t *p, HueSatVec v) {
+    __m256i v32 = _mm256_cvttps_epi32(v);
+    __m128i v16 = _mm_packs_epi32(_mm256_castsi256_si128(v32), _mm256_extracti128_si256(v32, 1));
+    _mm_storel_epi64((__m128i *)p, _mm_packus_epi16(v16, v16));
+}
+HS_TARGET static inline HueSatVec hsSet(float v) { return _mm256_set1_ps(v); }
+HS_TARGET static inline HueSatVec hsAdd(HueSatVec a, HueSatVec b) { return _mm256_add_ps(a, b); }
+HS_TARGET static inline HueSatVec hsSub(HueSatVec a, HueSatVec b) { return _mm256_sub_ps(a, b); }
+HS_TARGET static inline HueSatVec hsMul(HueSatVec a, HueSatVec b) { return _mm256_mul_ps(a, b); }
+HS_TARGET static inline HueSatVec hsDiv(HueSatVec a, HueSatVec b) { return _mm256_div_ps(a, b); }
+HS_TARGET static inline HueSatVec hsMin(HueSatVec a, HueSatVec b) { return _mm256_min_ps(a, b); }
+HS_TARGET static inline HueSatVec hsMax(HueSatVec a, HueSatVec b) { return _mm256_max_ps(a, b); }
+HS_TARGET static inline HueSatVec hsEq(HueSatVec a, HueSatVec b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+HS_TARGET static inline HueSatVec hsLt(HueSatVec a, HueSatVec b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+HS_TARGET static inline HueSatVec hsGe(HueSatVec a, HueSatVec b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+HS_TARGET static inline HueSatVec hsAnd(HueSatVec a, HueSatVec b) { return _mm256_and_ps(a, b); }
+HS_TARGET static inline HueSatVec hsAndNot(HueSatVec mask, HueSatVec b) { return _mm256_andnot_ps(mask, b); }
+HS_TARGET static inline HueSatVec hsSelect(HueSatVec mask, HueSatVec a, HueSatVec b) { return _mm256_blendv_ps(b, a, mask); }
+HS_TARGET static inline HueSatVec hsTrunc(HueSatVec a) { return _mm256_cvtepi32_ps(_mm256_cvttps_epi32(a)); }
+#else
+HS_TARGET static inline HueSatVec hsLoad(const uint8_t *p) {
+    int32_t bytes;
+    memcpy(&bytes, p, 4);
+    __m128i v16 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), _mm_setzero_si128());
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v16, _mm_setzero_si128()));
+}
+HS_TARGET static inline void hsStore(uint8_t *p, HueSatVec v) {
+    __m128i v16 = _mm_packs_epi32(_mm_cvttps_epi32(v), _mm_setzero_si128());
+    int32_t bytes = _mm_cvtsi128_si32(_mm_packus_epi16(v16, v16));
+    memcpy(p, &bytes, 4);
+}
+HS_TARGET static inline HueSatVec hsSet(float v) { return _mm_set1_ps(v); }
+HS_TARGET static inline HueSatVec hsAdd(HueSatVec a, HueSatVec b) { return _mm_add_ps(a, b); }
+HS_TARGET static inline HueSatVec hsSub(HueSatVec a, HueSatVec b) { return _mm_sub_ps(a, b); }
+HS_TARGET static inline HueSatVec hsMul(HueSatVec a, HueSatVec b) { return _mm_mul_ps(a, b); }
+HS_TARGET static inline HueSatVec hsDiv(HueSatVec a, HueSatVec b) { return _mm_div_ps(a, b); }
+HS_TARGET static inline HueSatVec hsMin(HueSatVec a, HueSatVec b) { return _mm_min_ps(a, b); }
+HS_TARGET static inline HueSatVec hsMax(HueSatVec a, HueSatVec b) { return _mm_max_ps(a, b); }
+HS_TARGET static inline HueSatVec hsEq(HueSatVec a, HueSatVec b) { return _mm_cmpeq_ps(a, b); }
+HS_TARGET static inline HueSatVec hsLt(HueSatVec a, HueSatVec b) { return _mm_cmplt_ps(a, b); }
+HS_TARGET static inline HueSatVec hsGe(HueSatVec a, HueSatVec b) { return _mm_cmpge_ps(a, b); }
+HS_TARGET static inline HueSatVec hsAnd(HueSatVec a, HueSatVec b) { return _mm_and_ps(a, b); }
+HS_TARGET static inline HueSatVec hsAndNot(HueSatVec mask, HueSatVec b) { return _mm_andnot_ps(mask, b); }
+HS_TARGET static inline HueSatVec hsSelect(HueSatVec mask, HueSatVec a, HueSatVec b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+HS_TARGET static inline HueSatVec hsTrunc(HueSatVec a) { return _mm_cvtepi32_ps(_mm_cvttps_epi32(a)); }
+#endif
+
+// 同時調整 HUESAT_LANES 個像素，步驟與 hueSatPixel 相同
+HS_TARGET static inline void hueSatLanes(uint8_t *pixels, const HueSatParams *params) {
+    uint8_t planes[3][HUESAT_LANES];
+    for (int i = 0; i < HUESAT_LANES; i++) {
+        planes[0][i] = pixels[3 * i];
+        planes[1][i] = pixels[3 * i + 1];
+        planes[2][i] = pixels[3 * i + 2];
+    }
+    HueSatVec b = hsLoad(planes[0]), g = hsLoad(planes[1]), r = hsLoad(planes[2]);
+    HueSatVec zero = hsSet(0.0f);
+    HueSatVec max = hsMax(hsMax(b, g), r);
+    HueSatVec delta = hsSub(max, hsMin(hsMin(b, g), r));
+    HueSatVec steps = hsSet((float)HUE_STEPS);
+    HueSatVec unit = hsMul(delta, steps);
+    HueSatVec delta2 = hsAdd(delta, delta);
+    HueSatVec unit4 = hsMul(unit, hsSet(4.0f)), unit6 = hsMul(unit, hsSet(6.0f));
+
+    HueSatVec isR = hsEq(r, max);
+    HueSatVec isG = hsAndNot(isR, hsEq(g, max));
+    HueSatVec h = hsSelect(isR, hsSub(g, b), hsSelect(isG, hsAdd(hsSub(b, r), delta2), hsAdd(hsSub(r, g), hsAdd(delta2, delta2))));
+    h = hsMul(h, steps);
+    h = hsAdd(h, hsAnd(hsLt(h, zero), unit6));
+    h = hsAdd(h, hsTrunc(hsMul(hsAdd(hsMul(delta, hsSet((float)params->hueQ12)), hsSet(128.0f)), hsSet(1.0f / 256.0f))));
+    h = hsSub(h, hsAnd(hsGe(h, unit6), unit6));
+
+    HueSatVec factor = hsSet((float)params->factorQ8);
+    HueSatVec clip = hsAnd(hsLt(zero, delta), hsGe(hsMul(delta, factor), hsMul(max, hsSet(256.0f))));
+    HueSatVec num = hsSelect(clip, max, factor);
+    HueSatVec den = hsSelect(clip, unit, hsSet(HUE_STEPS * 256.0f));
+
+    for (int c = 0; c < 3; c++) {
+        HueSatVec k = hsAdd(hsMul(hsSet((float)(2 * c + 1)), unit), h);
+        k = hsSub(k, hsAnd(hsGe(k, unit6), unit6));
+        HueSatVec w = hsMax(hsMin(hsMin(k, hsSub(unit4, k)), unit), zero);
+        HueSatVec q = hsDiv(hsMul(w, num), den);
+        HueSatVec t = hsTrunc(q);
+        t = hsAdd(t, hsAnd(hsLt(t, q), hsSet(1.0f)));
+        hsStore(planes[c], hsSub(max, t));
+    }
+    for (int i = 0; i < HUESAT_LANES; i++) {
+        pixels[3 * i] = planes[0][i];
+        pixels[3 * i + 1] = planes[1][i];
+        pixels[3 * i + 2] = planes[2][i];
+    }
+}
+
+// 以向量版本處理一行中前面整數組的像素，傳回處理到的像素，剩下的由呼叫者逐一處理
+HS_TARGET static int hueSatRow(uint8_t *row, int width, const HueSatParams *params) {
+    int i = 0;
+    for (; i + HUESAT_LANES <= width; i += HUESAT_LANES) hueSatLanes(row + 3 * i, params);
+    return i;
+}
+
+#undef HS_SUFFIX
+#undef HS_TARGET
+#undef HUESAT_LANES
+#undef HueSatVec
+#undef hsLoad
+#undef hsStore
+#undef hsSet
+#undef hsAdd
+#undef hsSub
+#undef hsMul
+#undef hsDiv
+#undef hsMin
+#undef hsMax
+#undef hsEq
+#undef hsLt
+#undef hsGe
+#undef hsAnd
+#undef hsAndNot
+#undef hsSelect
+#undef hsTrunc
+#undef hueSatLanes
+#undef hueSatRow
@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "image.h"
+#include "frame_pool.h"
+
+int imageCreatePadded(Image* img, int width, int height, int channels, ImageLayout layout, int haloX, int haloY) {
+    memset(img, 0, sizeof(*img));
+    if (width <= 0 || height <= 0 || channels < 1 || channels > IMAGE_MAX_CHANNELS || haloX < 0 || haloY < 0) {
+        fprintf(stderr, "不合法的影像尺寸或通道數。\n");
+        return -1;
+    }
+    int pixelBytes = layout == IMAGE_PLANAR ? 1 : channels;
+    // 左側鄰域補到 IMAGE_ALIGN 的倍數，讓內部每行的起點仍然對齊
+    size_t left = ((size_t)haloX * pixelBytes + IMAGE_ALIGN - 1) / IMAGE_ALIGN * IMAGE_ALIGN;
+    size_t rowBytes = left + (size_t)(width + haloX) * pixelBytes;
+    size_t stride = (rowBytes + IMAGE_ALIGN - 1) / IMAGE_ALIGN * IMAGE_ALIGN;
+    size_t planeBytes = stride * (height + 2 * (size_t)haloY);
+    int planeCount = layout == IMAGE_PLANAR ? channels : 1;
+    // 由共用的緩衝區池配置，相同大小的影像（批次中的每一張、各處理階段的暫存）重複使用同一塊記憶體
+    img->buffer = framePoolAcquire(framePoolShared(), planeBytes * planeCount, IMAGE_ALIGN);
+    if (!img->buffer) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        return -1;
+    }
+    img->layout = layout;
+    img->width = width;
+    img->height = height;
+    img->channels = channels;
+    img->haloX = haloX;
+    img->haloY = haloY;
+    img->stride = (ptrdiff_t)stride;
+    for (int c = 0; c < planeCount; c++) img->planes[c] = (uint8_t*)img->buffer + planeBytes * c + stride * haloY + left;
+    return 0;
+}
+
+int imageCreate(Image* img, int width, int height, int channels, ImageLayout layout) {
+    return imageCreatePadded(img, width, height, channels, layout, 0, 0);
+}
+
+void imageFree(Image* img) {
+    framePoolRelease(framePoolShared(), img->buffer);
+    memset(img, 0, sizeof(*img));
+}
+
+ImageView imageView(const Image* img) {
+    ImageView view = { img->planes[0], img->width, img->height, img->channels, img->stride };
+    return view;
+}
+
+ImageView imagePlane(const Image* img, int channel) {
+    ImageView view = { img->planes[channel], img->width, img->height, 1, img->stride };
+    return view;
+}
+
+ImageView imagePaddedView(const Image* img) {
+    ImageView view = imageView(img);
+    return imageSubView(&view, -img->haloX, -img->haloY, img->width + 2 * img->haloX, img->height + 2 * img->haloY);
+}
+
+ImageView imagePaddedPlane(const Image* img, int channel) {
+    ImageView view = imagePlane(img, channel);
+    return imageSubView(&view, -img->haloX, -img->haloY, img->width + 2 * img->haloX, img->height + 2 * img->haloY);
+}
+
+// ======= 邊界 =======
+
+// 第 i 個像素（可能在 [0, n) 之外）依邊界方式對應到的內部像素
+static int borderIndex(int i, int n, BorderMode mode) {
+    if (mode == BORDER_REPLICATE) return i < 0 ? 0 : (i >= n ? n - 1 : i);
+    if (n == 1) return 0;
+    // 鄰域比影像寬時可能需要反射多次
+    while (i < 0 || i >= n) i = i < 0 ? -i : 2 * (n - 1) - i;
+    return i;
+}
+
+// 填入一行左右兩側的鄰域
+static void fillRowSides(uint8_t* row, int width, int halo, int ch, const ImageBorder* border) {
+    if (border->mode == BORDER_CONSTANT) {
+        memset(row - (ptrdiff_t)halo * ch, border->value, (size_t)halo * ch);
+        memset(row + (size_t)width * ch, border->value, (size_t)halo * ch);
+        return;
+    }
+    if (border->mode == BORDER_REPLICATE && ch == 1) {
+        memset(row - halo, row[0], halo);
+        memset(row + width, row[width - 1], halo);
+        return;
+    }
+    for (int x = 1; x <= halo; x++) {
+        memcpy(row - (ptrdiff_t)x * ch, row + (size_t)borderIndex(-x, width, border->mode) * ch, ch);
+        memcpy(row + (size_t)(width - 1 + x) * ch, row + (size_t)borderIndex(width - 1 + x, width, border->mode) * ch, ch);
+    }
+}
+
+typedef struct {
+    const ImageView* planes;    // 各平面（交錯格式只有一個）的內部視圖
+    int planeCount;
+    int halo;
+    const ImageBorder* border;
+    int bandHeight;
+} BorderJob;
+
+static void borderTask(int band, void* ctx) {
+    BorderJob* job = (BorderJob*)ctx;
+    for (int p = 0; p < job->planeCount; p++) {
+        const ImageView* plane = &job->planes[p];
+        int yEnd = (band + 1) * job->bandHeight < plane->height ? (band + 1) * job->bandHeight : plane->height;
+        for (int y = band * job->bandHeight; y < yEnd; y++) {
+            fillRowSides(imageRow(plane, y), plane->width, job->halo, plane->channels, job->border);
+        }
+    }
+}
+
+int imageParseBorder(const char* spec, ImageBorder* border) {
+    border->value = 0;
+    if (strcmp(spec, "none") == 0) {
+        border->mode = BORDER_NONE;
+    } else if (strcmp(spec, "replicate") == 0) {
+        border->mode = BORDER_REPLICATE;
+    } else if (strcmp(spec, "reflect") == 0) {
+        border->mode = BORDER_REFLECT;
+    } else if (strncmp(spec, "constant", 8) == 0 && (spec[8] == '\0' || spec[8] == ':')) {
+        border->mode = BORDER_CONSTANT;
+        if (spec[8] == ':') {
+            char* end;
+            long value = strtol(spec + 9, &end, 10);
+            if (end == spec + 9 || *end != '\0' || value < 0 || value > 255) {
+                fprintf(stderr, "邊界常數須介於 0 與 255 之間。\n");
+                return -1;
+            }
+            border->value = (uint8_t)value;
+        }
+    } else {
+        fprintf(stderr, "未知的邊界方式 %s（可用 none、replicate、reflect 或 constant[:V]）。\n", spec);
+        return -1;
+    }
+    return 0;
+}
+
+void imageFillBorder(Image* img, const ImageBorder* border) {
+    if (border->mode == BORDER_NONE || (img->haloX == 0 && img->haloY == 0)) return;
+    int planeCount = img->layout == IMAGE_PLANAR ? img->channels : 1;
+    ImageView planes[IMAGE_MAX_CHANNELS];
+    for (int p = 0; p < planeCount; p++) planes[p] = img->layout == IMAGE_PLANAR ? imagePlane(img, p) : imageView(img);
+
+    if (img->haloX > 0) {
+        int bands = threadPoolThreads() * 4;
+        BorderJob job = { planes, planeCount, img->haloX, border, (img->height + bands - 1) / bands };
+        if (job.bandHeight < 1) job.bandHeight = 1;
+        parallelFor((img->height + job.bandHeight - 1) / job.bandHeight, borderTask, &job);
+    }
+
+    // 上下的鄰域行整行（包含已填好的左右鄰域）複製自對應的內部行
+    for (int p = 0; p < planeCount; p++) {
+        ImageView padded = img->layout == IMAGE_PLANAR ? imagePaddedPlane(img, p) : imagePaddedView(img);
+        size_t rowBytes = (size_t)padded.width * padded.channels;
+        for (int y = 0; y < img->haloY; y++) {
+            int top = img->haloY - 1 - y, bottom = img->haloY + img->height + y;
+            if (border->mode == BORDER_CONSTANT) {
+                memset(imageRow(&padded, top), border->value, rowBytes);
+                memset(imageRow(&padded, bottom), border->value, rowBytes);
+            } else {
+                memcpy(imageRow(&padded, top), imageRow(&padded, img->haloY + borderIndex(-1 - y, img->height, border->mode)), rowBytes);
+                memcpy(imageRow(&padded, bottom), imageRow(&padded, img->haloY + borderIndex(img->height + y, img->height, border->mode)), rowBytes);
+            }
+        }
+    }
+}
+
+// ======= 排列方式轉換 =======
+//
+// SSE2 沒有任意的位元組重排指令，改用固定的 unpack 網路：把 n 個向量配對成 (j, j + n / 2)，
+// 以 unpacklo / unpackhi 交錯後得到新的 n 個向量。3 通道（6 個向量、32 個像素）重複 5 次、
+// 4 通道（4 個向量、16 個像素）重複 4 次後，位元組恰好依通道排好；反方向則以逆運算（取偶數 / 奇數位元組）重複相同次數
+
+#if defined(__SSE2__)
+static inline void unpackRound(__m128i* v, int n) {
+    __m128i out[6];
+#pragma GCC unroll 6
+    for (int j = 0; j < n / 2; j++) {
+        out[2 * j] = _mm_unpacklo_epi8(v[j], v[j + n / 2]);
+        out[2 * j + 1] = _mm_unpackhi_epi8(v[j], v[j + n / 2]);
+    }
+#pragma GCC unroll 6
+    for (int j = 0; j < n; j++) v[j] = out[j];
+}
+
+static inline void packRound(__m128i* v, int n) {
+    __m128i out[6];
+    __m128i even = _mm_set1_epi16(0x00FF);
+#pragma GCC unroll 6
+    for (int j = 0; j < n / 2; j++) {
+        __m128i lo = v[2 * j], hi = v[2 * j + 1];
+        out[j] = _mm_packus_epi16(_mm_and_si128(lo, even), _mm_and_si128(hi, even));
+        out[j + n / 2] = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+    }
+#pragma GCC unroll 6
+    for (int j = 0; j < n; j++) v[j] = out[j];
+}
+#endif
+
+// 將一行交錯的像素拆到各通道的平面
+static void deinterleaveRow(const uint8_t* src, uint8_t* const* dst, int width, int ch) {
+    int x = 0;
+    if (ch == 1) {
+        memcpy(dst[0], src, width);
+        return;
+    }
+#if defined(__SSE2__)
+    if (ch == 3) {
+        for (; x + 32 <= width; x += 32) {
+            __m128i v[6];
+            for (int k = 0; k < 6; k++) v[k] = _mm_loadu_si128((const __m128i*)(src + x * 3) + k);
+#pragma GCC unroll 6
+            for (int r = 0; r < 5; r++) unpackRound(v, 6);
+            for (int c = 0; c < 3; c++) {
+                _mm_storeu_si128((__m128i*)(dst[c] + x), v[2 * c]);
+                _mm_storeu_si128((__m128i*)(dst[c] + x + 16), v[2 * c + 1]);
+            }
+        }
+    } else if (ch == 4) {
+        for (; x + 16 <= width; x += 16) {
+            __m128i v[4];
+            for (int k = 0; k < 4; k++) v[k] = _mm_loadu_si128((const __m128i*)(src + x * 4) + k);
+#pragma GCC unroll 6
+            for (int r = 0; r < 4; r++) unpackRound(v, 4);
+            for (int c = 0; c < 4; c++) _mm_storeu_si128((__m128i*)(dst[c] + x), v[c]);
+        }
+    }
+#endif
+    for (; x < width; x++) {
+        for (int c = 0; c < ch; c++) dst[c][x] = src[x * ch + c];
+    }
+}
+
+// 將各通道平面中的一行合併成交錯的像素
+static void interleaveRow(const uint8_t* const* src, uint8_t* dst, int width, int ch) {
+    int x = 0;
+    if (ch == 1) {
+        memcpy(dst, src[0], width);
+        return;
+    }
+#if defined(__SSE2__)
+    if (ch == 3) {
+        for (; x + 32 <= width; x += 32) {
+            __m128i v[6];
+            for (int c = 0; c < 3; c++) {
+                v[2 * c] = _mm_loadu_si128((const __m128i*)(src[c] + x));
+                v[2 * c + 1] = _mm_loadu_si128((const __m128i*)(src[c] + x + 16));
+            }
+#pragma GCC unroll 6
+            for (int r = 0; r < 5; r++) packRound(v, 6);
+            for (int k = 0; k < 6; k++) _mm_storeu_si128((__m128i*)(dst + x * 3) + k, v[k]);
+        }
+    } else if (ch == 4) {
+        for (; x + 16 <= width; x += 16) {
+            __m128i v[4];
+            for (int c = 0; c < 4; c++) v[c] = _mm_loadu_si128((const __m128i*)(src[c] + x));
+#pragma GCC unroll 6
+            for (int r = 0; r < 4; r++) packRound(v, 4);
+            for (int k = 0; k < 4; k++) _mm_storeu_si128((__m128i*)(dst + x * 4) + k, v[k]);
+        }
+    }
+#endif
+    for (; x < width; x++) {
+        for (int c = 0; c < ch; c++) dst[x * ch + c] = src[c][x];
+    }
+}
+
+typedef struct {
+    const ImageView* view;
+    const Image* planar;
+    int toPlanar;       // 1：交錯 -> 平面，0：平面 -> 交錯
+    int bandHeight;
+} ConvertJob;
+
+static void convertTask(int band, void* ctx) {
+    ConvertJob* job = (ConvertJob*)ctx;
+    int ch = job->view->channels;
+    int yEnd = (band + 1) * job->bandHeight < job->view->height ? (band + 1) * job->bandHeight : job->view->height;
+    for (int y = band * job->bandHeight; y < yEnd; y++) {
+        uint8_t* planes[IMAGE_MAX_CHANNELS];
+        for (int c = 0; c < ch; c++) planes[c] = job->planar->planes[c] + (ptrdiff_t)y * job->planar->stride;
+        if (job->toPlanar) {
+            deinterleaveRow(imageRow(job->view, y), planes, job->view->width, ch);
+        } else {
+            interleaveRow((const uint8_t* const*)planes, imageRow(job->view, y), job->view->width, ch);
+        }
+    }
+}
+
+// 以行區段平行轉換
+static void convert(const ImageView* view, const Image* planar, int toPlanar) {
+    int bands = threadPoolThreads() * 4;
+    ConvertJob job = { view, planar, toPlanar, (view->height + bands - 1) / bands };
+    if (job.bandHeight < 1) job.bandHeight = 1;
+    parallelFor((view->height + job.bandHeight - 1) / job.bandHeight, convertTask, &job);
+}
+
+void imageDeinterleave(const ImageView* src, Image* dst) {
+    convert(src, dst, 1);
+}
+
+void imageInterleave(const Image* src, ImageView* dst) {
+    convert(dst, src, 0);
+}
+
+// ======= 依排列方式執行核心 =======
+
+int imageApply(const ImageKernel* kernel, const ImageView* src, ImageView* dst, void* ctx) {
+    if (kernel->layout == IMAGE_INTERLEAVED || src->channels == 1) {
+        parallelTiles(src, dst, kernel->haloX, kernel->haloY, kernel->run, ctx);
+        return 0;
+    }
+
+    Image in, out;
+    if (imageCreate(&in, src->width, src->height, src->channels, IMAGE_PLANAR) != 0) return -1;
+    if (imageCreate(&out, src->width, src->height, src->channels, IMAGE_PLANAR) != 0) {
+        imageFree(&in);
+        return -1;
+    }
+    imageDeinterleave(src, &in);
+    // 有鄰域的核心不會寫入邊界像素，輸出平面要先帶有 dst 原本的內容
+    if (kernel->haloX > 0 || kernel->haloY > 0) imageDeinterleave(dst, &out);
+
+    for (int c = 0; c < src->channels; c++) {
+        ImageView planeIn = imagePlane(&in, c), planeOut = imagePlane(&out, c);
+        parallelTiles(&planeIn, &planeOut, kernel->haloX, kernel->haloY, kernel->run, ctx);
+    }
+    imageInterleave(&out, dst);
+    imageFree(&in);
+    imageFree(&out);
+    return 0;
+}
+
+int imageApplyBorder(const ImageKernel* kernel, const ImageView* src, ImageView* dst, const ImageBorder* border, void* ctx) {
+    if (!border || border->mode == BORDER_NONE) return imageApply(kernel, src, dst, ctx);
+
+    int haloX = kernel->haloX, haloY = kernel->haloY;
+    ImageLayout layout = src->channels == 1 ? IMAGE_INTERLEAVED : kernel->layout;
+    Image in;
+    if (imageCreatePadded(&in, src->width, src->height, src->channels, layout, haloX, haloY) != 0) return -1;
+    if (layout == IMAGE_INTERLEAVED) {
+        ImageView inner = imageView(&in);
+        imageCopy(src, &inner);
+    } else {
+        imageDeinterleave(src, &in);
+    }
+    imageFillBorder(&in, border);
+
+    if (layout == IMAGE_INTERLEAVED) {
+        // 以 dst 為內部、向外擴大 halo 的視圖：核心只寫入距離視圖邊界至少 halo 的像素，
+        // 也就是 dst 本身，擴大出去的部分不會被存取，dst 不需要預留鄰域
+        ImageView padded = imagePaddedView(&in);
+        ImageView target = imageSubView(dst, -haloX, -haloY, dst->width + 2 * haloX, dst->height + 2 * haloY);
+        parallelTiles(&padded, &target, haloX, haloY, kernel->run, ctx);
+        imageFree(&in);
+        return 0;
+    }
+
+    Image out;
+    if (imageCreatePadded(&out, src->width, src->height, src->channels, IMAGE_PLANAR, haloX, haloY) != 0) {
+        imageFree(&in);
+        return -1;
+    }
+    for (int c = 0; c < src->channels; c++) {
+        ImageView planeIn = imagePaddedPlane(&in, c), planeOut = imagePaddedPlane(&out, c);
+        parallelTiles(&planeIn, &planeOut, haloX, haloY, kernel->run, ctx);
+    }
+    imageInterleave(&out, dst); // 只合併內部像素，out 的鄰域沒有被寫入也不會被讀取
+    imageFree(&in);
+    imageFree(&out);
+    return 0;
+}
@@ -0,0 +1,104 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "bmp_io.h"
+#include "thread_pool.h"
+
+#define IMAGE_ALIGN 64          // 每行起始位址與行距的對齊（一條快取線，也是 AVX-512 向量的寬度）
+#define IMAGE_MAX_CHANNELS 4
+
+// 像素在記憶體中的排列方式
+typedef enum {
+    IMAGE_INTERLEAVED,  // 同一像素的通道相鄰存放（與 BMP 的 BGR / BGRA 相同）
+    IMAGE_PLANAR        // 每個通道各自存成一個連續的平面
+} ImageLayout;
+
+// 邊界外像素的取值方式（濾波器在影像邊緣需要的鄰域）
+typedef enum {
+    BORDER_NONE,        // 不處理邊界：只計算鄰域完整的內部像素（作業 2 的做法）
+    BORDER_REPLICATE,   // 重複最邊緣的像素：aaa|abcd|ddd
+    BORDER_REFLECT,     // 以邊緣像素為軸鏡射（不重複邊緣）：dcb|abcd|cba
+    BORDER_CONSTANT     // 填入固定值
+} BorderMode;
+
+typedef struct {
+    BorderMode mode;
+    uint8_t value;      // BORDER_CONSTANT 填入的值
+} ImageBorder;
+
+// 自行配置記憶體的影像，支援交錯與平面兩種排列
+// 每行（平面格式為每個平面的每行）都從 64 位元組對齊的位址開始
+// 可以在四周預留 haloX / haloY 個像素的鄰域（見 imageCreatePadded），planes 指向內部的第 0 行第 0 個像素
+typedef struct {
+    ImageLayout layout;
+    int width;
+    int height;
+    int channels;
+    int haloX, haloY;                       // 四周預留的鄰域大小
+    ptrdiff_t stride;                       // 相鄰兩行的位元組距離（IMAGE_ALIGN 的倍數）
+    uint8_t* planes[IMAGE_MAX_CHANNELS];    // 平面格式時為各通道第 0 行的位址；交錯格式只使用 planes[0]
+    void* buffer;                           // 配置的記憶體
+} Image;
+
+// 配置影像，內容未初始化
+// 成功傳回 0，參數不合法或記憶體不足時傳回 -1
+int imageCreate(Image* img, int width, int height, int channels, ImageLayout layout);
+
+// 配置四周帶有 haloX / haloY 個像素鄰域的影像，內容未初始化
+// 內部每行仍從 64 位元組對齊的位址開始；以 imageFillBorder 填好鄰域後，
+// 濾波核心可以在 imagePaddedView 上以相同的內層迴圈處理所有像素，不需要檢查邊界
+// 成功傳回 0，參數不合法或記憶體不足時傳回 -1
+int imageCreatePadded(Image* img, int width, int height, int channels, ImageLayout layout, int haloX, int haloY);
+
+// 釋放影像的記憶體
+void imageFree(Image* img);
+
+// 交錯格式影像的視圖
+ImageView imageView(const Image* img);
+
+// 平面格式影像中第 c 個通道的單通道視圖
+ImageView imagePlane(const Image* img, int channel);
+
+// 解析邊界方式：none、replicate、reflect 或 constant[:V]（V 為 0 ~ 255，預設 0）
+// 成功傳回 0，格式錯誤時傳回 -1
+int imageParseBorder(const char* spec, ImageBorder* border);
+
+// 包含鄰域的交錯視圖，大小為 (width + 2 * haloX) x (height + 2 * haloY)
+ImageView imagePaddedView(const Image* img);
+
+// 平面格式影像中第 c 個通道包含鄰域的單通道視圖
+ImageView imagePaddedPlane(const Image* img, int channel);
+
+// 依 border 由內部像素填入四周的鄰域（BORDER_NONE 時不做任何事）
+// 左右的鄰域與內部各行一起以多執行緒填入，上下的鄰域行整行複製
+void imageFillBorder(Image* img, const ImageBorder* border);
+
+// 將交錯排列的視圖拆成平面格式的影像（尺寸與通道數須相同）
+// 3、4 通道以 SSE2 一次轉換 32 / 16 個像素，各行區段以多執行緒處理
+void imageDeinterleave(const ImageView* src, Image* dst);
+
+// 將平面格式的影像合併回交錯排列的視圖（尺寸與通道數須相同）
+void imageInterleave(const Image* src, ImageView* dst);
+
+// 宣告排列方式的區塊核心
+// IMAGE_INTERLEAVED 的核心直接處理交錯的視圖；
+// IMAGE_PLANAR 的核心一次處理一個單通道的平面，相鄰像素在記憶體中連續，可以用滿整個向量寬度
+typedef struct {
+    ImageLayout layout;     // 核心需要的排列方式
+    TileKernel run;         // 區塊核心（見 parallelTiles）
+    int haloX, haloY;       // 核心需要的鄰域大小
+} ImageKernel;
+
+// 以核心宣告的排列方式處理影像，並切成區塊以多執行緒處理
+// 需要平面格式時，先將 src 與 dst 拆成平面，逐一處理每個通道後再合併回 dst；
+// 與 parallelTiles 相同，核心沒有寫入的像素（鄰域不足的邊界）保持 dst 原本的內容
+// 成功傳回 0，記憶體不足時傳回 -1
+int imageApply(const ImageKernel* kernel, const ImageView* src, ImageView* dst, void* ctx);
+
+// 與 imageApply 相同，但依 border 補上影像外的鄰域後處理所有像素（包含邊界）
+// src 先複製到帶有核心 halo 的影像並填好鄰域，核心的內層迴圈不變；dst 的每個像素都會被寫入
+// border 為 NULL 或 BORDER_NONE 時等同 imageApply
+// 成功傳回 0，記憶體不足時傳回 -1
+int imageApplyBorder(const ImageKernel* kernel, const ImageView* src, ImageView* dst, const ImageBorder* border, void* ctx);
+
+#endif
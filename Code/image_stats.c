@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "image_stats.h"
+#include "thread_pool.h"
+#include "cpu_dispatch.h"
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
+#include "trace.h"
+
+typedef struct {
+    const ImageView* img;
+    int step;
+    int flags;
+    int rows;               // 取樣的行數
+    int bandRows;           // 每個行區段的取樣行數
+    ImageStats* bands;      // 各行區段的結果，最後依序合併
+} StatsJob;
+
+// 累加一行中第 begin 個以後的取樣像素（總和與最小 / 最大值）
+static void rowSumMinMax(const uint8_t* row, int begin, int count, int step, int channels, ImageStats* s) {
+    for (int i = begin; i < count; i++) {
+        const uint8_t* p = row + (size_t)i * step * channels;
+        for (int c = 0; c < channels; c++) {
+            s->sum[c] += p[c];
+            if (p[c] < s->min[c]) s->min[c] = p[c];
+            if (p[c] > s->max[c]) s->max[c] = p[c];
+        }
+    }
+}
+
+// 累加一行取樣像素的直方圖
+static void rowHistogram(const uint8_t* row, int count, int step, int channels, ImageStats* s) {
+    for (int i = 0; i < count; i++) {
+        const uint8_t* p = row + (size_t)i * step * channels;
+        for (int c = 0; c < channels; c++) s->histogram[c][p[c]]++;
+    }
+}
+
+#if defined(CPU_X86)
+#define STATS_VECTOR_BYTES 32
+#include "stats_lanes.h"
+#undef STATS_VECTOR_BYTES
+#define STATS_VECTOR_BYTES 16
+#include "stats_lanes.h"
+#undef STATS_VECTOR_BYTES
+#endif
+
+static void statsTask(int band, void* ctx) {
+    StatsJob* job = (StatsJob*)ctx;
+    const ImageView* img = job->img;
+    ImageStats* s = &job->bands[band];
+    int ch = img->channels;
+    int count = (img->width + job->step - 1) / job->step; // 每行的取樣像素數
+    int yBegin = band * job->bandRows;
+    int yEnd = yBegin + job->bandRows < job->rows ? yBegin + job->bandRows : job->rows;
+
+    memset(s, 0, sizeof(*s));
+    memset(s->min, 255, sizeof(s->min));
+    s->count = (uint64_t)count * (yEnd - yBegin);
+
+#if defined(CPU_X86)
+    // 連續的像素（不取樣時）以向量處理
+    if (job->step == 1 && (job->flags & (STATS_SUM | STATS_MINMAX))) {
+        CpuLevel level = cpuLevel();
+        if (level >= CPU_AVX2) {
+            statsRowsAVX2(job, yBegin, yEnd, s);
+            return;
+        }
+        if (level >= CPU_SSE2) {
+            statsRowsSSE2(job, yBegin, yEnd, s);
+            return;
+        }
+    }
+#endif
+
+    for (int y = yBegin; y < yEnd; y++) {
+        const uint8_t* row = imageRow(img, y * job->step);
+        if (job->flags & STATS_HISTOGRAM) rowHistogram(row, count, job->step, ch, s);
+        if (job->flags & (STATS_SUM | STATS_MINMAX)) rowSumMinMax(row, 0, count, job->step, ch, s);
+    }
+}
+
+int imageStats(const ImageView* img, int step, int flags, ImageStats* stats) {
+    if (img->channels < 1 || img->channels > STATS_MAX_CHANNELS || step < 1) {
+        fprintf(stderr, "不支援的通道數或取樣間隔。\n");
+        return -1;
+    }
+
+    TRACE_BEGIN(span, "stats");
+    // 以取樣後的行切成行區段，每個執行緒平均分到數個區段
+    int rows = (img->height + step - 1) / step;
+    int bandCount = threadPoolThreads() * 4;
+    StatsJob job = { img, step, flags, rows, (rows + bandCount - 1) / bandCount, NULL };
+    if (job.bandRows < 1) job.bandRows = 1;
+    bandCount = (rows + job.bandRows - 1) / job.bandRows;
+    if (bandCount > 1) job.bands = (ImageStats*)malloc(bandCount * sizeof(ImageStats));
+    if (!job.bands) { // 只有一個區段或記憶體不足時，直接累加到結果中
+        job.bands = stats;
+        job.bandRows = rows;
+        bandCount = rows > 0 ? 1 : 0;
+    }
+    if (bandCount > 0) parallelFor(bandCount, statsTask, &job);
+
+    if (job.bands != stats) {
+        memset(stats, 0, sizeof(*stats));
+        memset(stats->min, 255, sizeof(stats->min));
+        for (int b = 0; b < bandCount; b++) {
+            const ImageStats* s = &job.bands[b];
+            stats->count += s->count;
+            for (int c = 0; c < img->channels; c++) {
+                stats->sum[c] += s->sum[c];
+                if (s->min[c] < stats->min[c]) stats->min[c] = s->min[c];
+                if (s->max[c] > stats->max[c]) stats->max[c] = s->max[c];
+                if (flags & STATS_HISTOGRAM) {
+                    for (int v = 0; v < 256; v++) stats->histogram[c][v] += s->histogram[c][v];
+                }
+            }
+        }
+        free(job.bands);
+    } else if (bandCount == 0) {
+        memset(stats, 0, sizeof(*stats));
+    }
+
+    stats->channels = img->channels;
+    if (!(flags & STATS_MINMAX) || stats->count == 0) {
+        memset(stats->min, 0, sizeof(stats->min));
+        memset(stats->max, 0, sizeof(stats->max));
+    }
+    if (!(flags & STATS_SUM)) memset(stats->sum, 0, sizeof(stats->sum));
+    TRACE_END(span, (uint64_t)stats->count * img->channels, (uint64_t)stats->count);
+    return 0;
+}
+
+double imageStatsMean(const ImageStats* stats, int channel) {
+    return stats->count ? (double)stats->sum[channel] / stats->count : 0.0;
+}
+
+int imageStatsPercentile(const ImageStats* stats, int channel, double percent) {
+    if (stats->count == 0) return -1;
+    if (percent < 0) percent = 0;
+    if (percent > 100) percent = 100;
+    uint64_t rank = (uint64_t)(percent / 100.0 * (double)(stats->count - 1));
+    uint64_t seen = 0;
+    for (int v = 0; v < 256; v++) {
+        seen += stats->histogram[channel][v];
+        if (seen > rank) return v;
+    }
+    return 255;
+}
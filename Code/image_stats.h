@@ -0,0 +1,41 @@
+#ifndef IMAGE_STATS_H
+#define IMAGE_STATS_H
+
+#include <stdint.h>
+#include "bmp_io.h"
+
+#define STATS_MAX_CHANNELS 4
+
+// imageStats 要計算的統計量，可以用 | 組合
+enum {
+    STATS_SUM = 1,          // 各通道的總和
+    STATS_MINMAX = 2,       // 各通道的最小值與最大值
+    STATS_HISTOGRAM = 4     // 各通道的 256 階直方圖（百分位數需要）
+};
+
+// 影像統計結果，所有累加器都是 64 位元，極大的影像也不會溢位
+typedef struct {
+    int channels;                                       // 通道數（與影像相同）
+    uint64_t count;                                     // 統計的像素數
+    uint64_t sum[STATS_MAX_CHANNELS];                   // 各通道總和
+    uint8_t min[STATS_MAX_CHANNELS];                    // 各通道最小值
+    uint8_t max[STATS_MAX_CHANNELS];                    // 各通道最大值
+    uint64_t histogram[STATS_MAX_CHANNELS][256];        // 各通道直方圖
+} ImageStats;
+
+// 一次讀過影像，計算 flags 指定的統計量
+// 影像切成行區段以多執行緒處理，總和與最小 / 最大值以 SIMD 累加，直方圖逐像素累加；
+// 結果與執行緒數無關
+// step: 取樣間隔，1 表示統計所有像素，大於 1 時只統計 x、y 都是 step 倍數的像素，可用於快速估計
+// 沒有要求的統計量內容為 0；成功傳回 0，通道數超過 STATS_MAX_CHANNELS 或 step 小於 1 時傳回 -1
+int imageStats(const ImageView* img, int step, int flags, ImageStats* stats);
+
+// 通道的平均值（需要 STATS_SUM）；沒有統計到像素時傳回 0
+double imageStatsMean(const ImageStats* stats, int channel);
+
+// 通道的百分位數（需要 STATS_HISTOGRAM），percent 介於 0 ~ 100
+// 將統計到的值由小到大排序後，傳回第 percent / 100 * (count - 1) 個值（0 為最小值、100 為最大值）
+// 沒有統計到像素時傳回 -1
+int imageStatsPercentile(const ImageStats* stats, int channel, double percent);
+
+#endif
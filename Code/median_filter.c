@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "median_filter.h"
+#include "image.h"
+#include "cpu_dispatch.h"
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
+#include "trace.h"
+
+// ======= 排序網路（radius = 1, 2） =======
+
+// 9 個元素求中位數的排序網路（19 次比較交換），中位數位於第 4 個元素
+#define MEDIAN9_NETWORK(SORT) \
+    SORT(1, 2) SORT(4, 5) SORT(7, 8) \
+    SORT(0, 1) SORT(3, 4) SORT(6, 7) \
+    SORT(1, 2) SORT(4, 5) SORT(7, 8) \
+    SORT(0, 3) SORT(5, 8) SORT(4, 7) \
+    SORT(3, 6) SORT(1, 4) SORT(2, 5) \
+    SORT(4, 7) SORT(4, 2) SORT(6, 4) \
+    SORT(4, 2)
+
+// 比較交換：較小值放在 a，較大值放在 b（以 min/max 實作，沒有分支）
+#define SORT_SCALAR(a, b) { int lo = p[a] < p[b] ? p[a] : p[b]; p[b] = p[a] < p[b] ? p[b] : p[a]; p[a] = lo; }
+
+#define NETWORK_SIZE 32 // 5x5 窗口的 25 個元素補齊為 2 的冪次
+
+// 只保留會影響中位數的比較交換，由 Batcher 奇偶合併排序網路裁剪而來
+typedef struct {
+    int count;                   // 比較交換的數量
+    uint8_t pairs[256][2];       // 比較交換的兩個位置
+    int padLow;                  // 以 0 填補的位置數（排在最前面）
+    int target;                  // 中位數所在的位置
+} MedianNetwork;
+
+// 建立 n 個元素的中位數網路（n <= NETWORK_SIZE）
+static void buildMedianNetwork(int n, MedianNetwork* net) {
+    int size = NETWORK_SIZE;
+    uint8_t all[512][2];
+    int total = 0;
+
+    // Batcher 奇偶合併排序網路
+    for (int p = 1; p < size; p <<= 1) {
+        for (int k = p; k >= 1; k >>= 1) {
+            for (int j = k % p; j + k < size; j += 2 * k) {
+                for (int i = 0; i < k && i + j + k < size; i++) {
+                    if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+                        all[total][0] = (uint8_t)(i + j);
+                        all[total][1] = (uint8_t)(i + j + k);
+                        total++;
+                    }
+                }
+            }
+        }
+    }
+
+    // 補齊的位置一半填 0、一半填 255，中位數的位置因此往後移 padLow 格
+    net->padLow = (size - n) / 2;
+    net->target = net->padLow + n / 2;
+
+    // 由輸出往回追蹤，只保留與中位數位置有關的比較交換
+    int needed[NETWORK_SIZE] = { 0 };
+    int keep[512] = { 0 };
+    needed[net->target] = 1;
+    for (int c = total - 1; c >= 0; c--) {
+        if (needed[all[c][0]] || needed[all[c][1]]) {
+            keep[c] = 1;
+            needed[all[c][0]] = needed[all[c][1]] = 1;
+        }
+    }
+    // 補齊的 0 一定留在較小的一側、255 一定留在較大的一側，與它們比較的交換不會改變任何值
+    int isMin[NETWORK_SIZE] = { 0 }, isMax[NETWORK_SIZE] = { 0 };
+    for (int k = 0; k < net->padLow; k++) isMin[k] = 1;
+    for (int k = net->padLow + n; k < size; k++) isMax[k] = 1;
+    net->count = 0;
+    for (int c = 0; c < total; c++) {
+        int a = all[c][0], b = all[c][1];
+        if (isMin[a] || isMax[b]) continue;
+        int aMin = isMin[a] || isMin[b], bMax = isMax[a] || isMax[b];
+        isMin[b] = isMin[a] && isMin[b];
+        isMax[a] = isMax[a] && isMax[b];
+        isMin[a] = aMin;
+        isMax[b] = bMax;
+        if (keep[c]) {
+            net->pairs[net->count][0] = all[c][0];
+            net->pairs[net->count][1] = all[c][1];
+            net->count++;
+        }
+    }
+}
+
+#if defined(CPU_X86)
+#define MEDIAN_BYTES 64
+#include "median_lanes.h"
+#undef MEDIAN_BYTES
+#define MEDIAN_BYTES 32
+#include "median_lanes.h"
+#undef MEDIAN_BYTES
+#define MEDIAN_BYTES 16
+#include "median_lanes.h"
+#undef MEDIAN_BYTES
+#endif
+
+// 使用排序網路的中值濾波（radius = 1 或 2）
+static void medianNetwork(const ImageView* src, ImageView* dst, int radius) {
+    int ch = src->channels;
+    int n = 2 * radius + 1;
+    int taps = n * n;
+    int x0 = radius * ch;                   // 每行第一個處理的位元組
+    int x1 = (src->width - radius) * ch;    // 每行最後一個處理的位元組之後
+    MedianNetwork net = { 0 };
+    if (radius == 2) buildMedianNetwork(taps, &net);
+    int pad = net.padLow; // 窗口元素直接載入補齊後的位置
+
+    for (int y = radius; y < src->height - radius; y++) {
+        const uint8_t* rows[2 * MEDIAN_MAX_RADIUS + 1];
+        for (int ky = 0; ky < n; ky++) {
+            rows[ky] = imageRow(src, y + ky - radius);
+        }
+        uint8_t* out = imageRow(dst, y);
+        int i = x0;
+
+#if defined(CPU_X86)
+        CpuLevel level = cpuLevel();
+        if (level >= CPU_AVX512) {
+            i = medianRowAVX512(rows, out, i, x1, radius, ch, &net);
+        } else if (level >= CPU_AVX2) {
+            i = medianRowAVX2(rows, out, i, x1, radius, ch, &net);
+        } else if (level >= CPU_SSE2) {
+            i = medianRowSSE2(rows, out, i, x1, radius, ch, &net);
+        }
+#endif
+        // 剩餘的位元組（或不使用向量指令時）逐一處理
+        for (; i < x1; i++) {
+            int p[NETWORK_SIZE];
+            for (int ky = 0; ky < n; ky++) {
+                for (int kx = 0; kx < n; kx++) {
+                    p[pad + ky * n + kx] = rows[ky][i + (kx - radius) * ch];
+                }
+            }
+            if (radius == 1) {
+                MEDIAN9_NETWORK(SORT_SCALAR)
+                out[i] = (uint8_t)p[4];
+            } else {
+                for (int k = 0; k < net.padLow; k++) p[k] = 0;
+                for (int k = net.padLow + taps; k < NETWORK_SIZE; k++) p[k] = 255;
+                for (int c = 0; c < net.count; c++) {
+                    int a = net.pairs[c][0], b = net.pairs[c][1];
+                    SORT_SCALAR(a, b)
+                }
+                out[i] = (uint8_t)p[net.target];
+            }
+        }
+    }
+}
+
+// ======= 滑動直方圖（radius >= 3） =======
+
+// 將一個欄直方圖的 count 個區間加入（sign = 1）或移出（sign = -1）核心直方圖
+static inline void histogramAccumulate(uint16_t* hist, const uint16_t* col, int count, int sign) {
+    if (sign > 0) {
+        for (int i = 0; i < count; i++) hist[i] += col[i];
+    } else {
+        for (int i = 0; i < count; i++) hist[i] -= col[i];
+    }
+}
+
+// 每一欄維護一個涵蓋 2r+1 行的欄直方圖；往下移一行時每欄只需加入一個值並移出一個值，
+// 往右移一格時核心的粗略直方圖（16 區間）只需加入一個欄直方圖並移出一個。
+// 細部直方圖（256 區間）只在中位數落入某個粗略區間時才更新該區間的 16 項，
+// 並記錄每個區間最後更新的位置，之後再用到時補上期間移入與移出的欄，計算量與半徑無關
+static void medianHistogram(const ImageView* src, ImageView* dst, int radius) {
+    int width = src->width;
+    int height = src->height;
+    int ch = src->channels;
+    int n = 2 * radius + 1;
+    int half = n * n / 2;
+
+    uint16_t* colFine = (uint16_t*)malloc((size_t)width * 256 * sizeof(uint16_t));
+    uint16_t* colCoarse = (uint16_t*)malloc((size_t)width * 16 * sizeof(uint16_t));
+    if (!colFine || !colCoarse) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        free(colFine);
+        free(colCoarse);
+        return;
+    }
+
+    for (int c = 0; c < ch; c++) { // 每個通道分別處理，欄直方圖的記憶體可以重複使用
+        memset(colFine, 0, (size_t)width * 256 * sizeof(uint16_t));
+        memset(colCoarse, 0, (size_t)width * 16 * sizeof(uint16_t));
+
+        // 欄直方圖初始化為第 0 ~ 2r 行
+        for (int y = 0; y < n; y++) {
+            const uint8_t* row = imageRow(src, y);
+            for (int x = 0; x < width; x++) {
+                uint8_t v = row[x * ch + c];
+                colFine[x * 256 + v]++;
+                colCoarse[x * 16 + (v >> 4)]++;
+            }
+        }
+
+        for (int y = radius; y < height - radius; y++) {
+            if (y > radius) {
+                // 移出第 y - r - 1 行、加入第 y + r 行
+                const uint8_t* oldRow = imageRow(src, y - radius - 1);
+                const uint8_t* newRow = imageRow(src, y + radius);
+                for (int x = 0; x < width; x++) {
+                    uint8_t vOld = oldRow[x * ch + c];
+                    uint8_t vNew = newRow[x * ch + c];
+                    colFine[x * 256 + vOld]--;
+                    colCoarse[x * 16 + (vOld >> 4)]--;
+                    colFine[x * 256 + vNew]++;
+                    colCoarse[x * 16 + (vNew >> 4)]++;
+                }
+            }
+
+            uint16_t fine[256];
+            uint16_t coarse[16] = { 0 };
+            int updated[16]; // 每個細部區間對應的核心中心位置；-1 表示尚未計算
+            for (int b = 0; b < 16; b++) updated[b] = -1;
+            for (int x = 0; x < n; x++) {
+                histogramAccumulate(coarse, &colCoarse[x * 16], 16, 1);
+            }
+
+            uint8_t* out = imageRow(dst, y);
+            for (int x = radius; x < width - radius; x++) {
+                if (x > radius) {
+                    histogramAccumulate(coarse, &colCoarse[(x + radius) * 16], 16, 1);
+                    histogramAccumulate(coarse, &colCoarse[(x - radius - 1) * 16], 16, -1);
+                }
+
+                // 由粗略直方圖找出中位數所在的區間
+                int sum = 0, b = 0;
+                while (sum + coarse[b] <= half) {
+                    sum += coarse[b];
+                    b++;
+                }
+
+                // 將該區間的細部直方圖更新到目前位置：落後太多時直接重新累加 2r+1 欄
+                uint16_t* segment = &fine[b * 16];
+                int last = updated[b];
+                if (last < 0 || 2 * (x - last) > n) {
+                    memset(segment, 0, 16 * sizeof(uint16_t));
+                    for (int k = x - radius; k <= x + radius; k++) {
+                        histogramAccumulate(segment, &colFine[k * 256 + b * 16], 16, 1);
+                    }
+                } else {
+                    for (int k = last + 1; k <= x; k++) {
+                        histogramAccumulate(segment, &colFine[(k + radius) * 256 + b * 16], 16, 1);
+                        histogramAccumulate(segment, &colFine[(k - radius - 1) * 256 + b * 16], 16, -1);
+                    }
+                }
+                updated[b] = x;
+
+                int v = 0;
+                while (sum + segment[v] <= half) {
+                    sum += segment[v];
+                    v++;
+                }
+                out[x * ch + c] = (uint8_t)(b * 16 + v);
+            }
+        }
+    }
+
+    free(colFine);
+    free(colCoarse);
+}
+
+// 處理一個區塊（或整張影像）的內部像素
+static void medianTile(const ImageView* src, ImageView* dst, void* ctx) {
+    int radius = *(const int*)ctx;
+    if (src->width < 2 * radius + 1 || src->height < 2 * radius + 1) return; // 沒有可處理的內部像素
+
+    if (radius <= 2) {
+        medianNetwork(src, dst, radius);
+    } else {
+        medianHistogram(src, dst, radius);
+    }
+}
+
+TileOutput medianFilterOutput(int* radius, ImageView* dst) {
+    if (*radius < 1) *radius = 1;
+    if (*radius > MEDIAN_MAX_RADIUS) *radius = MEDIAN_MAX_RADIUS;
+    TileOutput output = { medianTile, radius, dst, *radius, *radius };
+    return output;
+}
+
+int medianFilterBorder(const ImageView* src, ImageView* dst, int radius, const ImageBorder* border) {
+    if (radius < 1) radius = 1;
+    if (radius > MEDIAN_MAX_RADIUS) radius = MEDIAN_MAX_RADIUS;
+    // 排序網路與滑動直方圖都以 channels 個位元組的間隔取鄰居，交錯排列的效率與平面相同，不必轉換
+    TRACE_BEGIN(span, "median");
+    ImageKernel kernel = { IMAGE_INTERLEAVED, medianTile, radius, radius };
+    int result = imageApplyBorder(&kernel, src, dst, border, &radius);
+    TRACE_END(span, 2 * (uint64_t)src->width * src->height * src->channels, (uint64_t)src->width * src->height);
+    return result;
+}
+
+int medianFilter(const ImageView* src, ImageView* dst, int radius) {
+    return medianFilterBorder(src, dst, radius, NULL);
+}
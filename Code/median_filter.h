@@ -0,0 +1,26 @@
+#ifndef MEDIAN_FILTER_H
+#define MEDIAN_FILTER_H
+
+#include "bmp_io.h"
+#include "image.h"
+
+#define MEDIAN_MAX_RADIUS 127 // 窗口內像素數須能以 16 位元計數：(2 * 127 + 1)^2 < 65536
+
+// 中值濾波器，窗口大小為 (2 * radius + 1) x (2 * radius + 1)，每個通道分別處理
+// 與作業 2 相同，只處理距離邊界至少 radius 的像素，其餘像素保持 dst 原本的內容
+// radius 為 1、2 時使用無分支的排序網路（以 SIMD 一次處理 16 個位元組），
+// radius >= 3 時使用滑動直方圖（Perreault & Hébert），每像素的計算量與半徑無關
+// 影像切成區塊後以多執行緒處理，結果與單執行緒相同；src 與 dst 不可指向同一塊記憶體
+// 成功傳回 0，記憶體不足時傳回 -1
+int medianFilter(const ImageView* src, ImageView* dst, int radius);
+
+// 與 medianFilter 相同，但依 border 補上影像外的鄰域後處理所有像素（包含邊界），見 imageApplyBorder
+// border 為 NULL 或 BORDER_NONE 時等同 medianFilter
+// 成功傳回 0，記憶體不足時傳回 -1
+int medianFilterBorder(const ImageView* src, ImageView* dst, int radius, const ImageBorder* border);
+
+// 多輸出處理（parallelTilesFanOut）中的一個中值濾波輸出，結果與 medianFilter 相同
+// radius 會先限制在 1 ~ MEDIAN_MAX_RADIUS 之間，在處理完成前須保持有效
+TileOutput medianFilterOutput(int* radius, ImageView* dst);
+
+#endif
@@ -0,0 +1,73 @@
+// 排序網路中值濾波的向量版本，由 median_filter.c 引入三次，MEDIAN_BYTES 指定向量寬度：
+// 16（SSE2，medianRowSSE2）、32（AVX2，medianRowAVX2）或 64（AVX-512BW，medianRowAVX512）
+
+#if MEDIAN_BYTES == 64
+#define MV_TARGET TARGET_AVX512
+#define MedianVec __m512i
+#define mvLoad(p) _mm512_loadu_si512((const void*)(p))
+#define mvStore(p, v) _mm512_storeu_si512((void*)(p), v)
+#define mvMin _mm512_min_epu8
+#define mvMax _mm512_max_epu8
+#define mvSet1 _mm512_set1_epi8
+#define medianRowVector medianRowAVX512
+#elif MEDIAN_BYTES == 32
+#define MV_TARGET TARGET_AVX2
+#define MedianVec __m256i
+#define mvLoad(p) _mm256_loadu_si256((const __m256i*)(p))
+#define mvStore(p, v) _mm256_storeu_si256((__m256i*)(p), v)
+#define mvMin _mm256_min_epu8
+#define mvMax _mm256_max_epu8
+#define mvSet1 _mm256_set1_epi8
+#define medianRowVector medianRowAVX2
+#else
+#define MV_TARGET TARGET_SSE2
+#define MedianVec __m128i
+#define mvLoad(p) _mm_loadu_si128((const __m128i*)(p))
+#define mvStore(p, v) _mm_storeu_si128((__m128i*)(p), v)
+#define mvMin _mm_min_epu8
+#define mvMax _mm_max_epu8
+#define mvSet1 _mm_set1_epi8
+#define medianRowVector medianRowSSE2
+#endif
+
+#define SORT_VECTOR(a, b) { MedianVec lo = mvMin(v[a], v[b]); v[b] = mvMax(v[a], v[b]); v[a] = lo; }
+
+// 從第 i 個位元組開始一次處理 MEDIAN_BYTES 個位元組；鄰居位於相差 ch 個位元組的位置，因此各通道自然分開處理
+// 傳回處理到的位置，剩下不足一個向量的位元組由呼叫者逐一處理
+MV_TARGET static int medianRowVector(const uint8_t* const* rows, uint8_t* out, int i, int x1, int radius, int ch, const MedianNetwork* net) {
+    int n = 2 * radius + 1;
+    int taps = n * n;
+    int pad = net->padLow;
+    for (; i + MEDIAN_BYTES <= x1; i += MEDIAN_BYTES) {
+        MedianVec v[NETWORK_SIZE];
+        for (int ky = 0; ky < n; ky++) {
+            for (int kx = 0; kx < n; kx++) {
+                v[pad + ky * n + kx] = mvLoad(rows[ky] + i + (kx - radius) * ch);
+            }
+        }
+        if (radius == 1) {
+            MEDIAN9_NETWORK(SORT_VECTOR)
+            mvStore(out + i, v[4]);
+        } else {
+            // 前 padLow 格填 0，最後幾格填 255
+            for (int k = 0; k < net->padLow; k++) v[k] = mvSet1(0);
+            for (int k = net->padLow + taps; k < NETWORK_SIZE; k++) v[k] = mvSet1((char)0xFF);
+            for (int c = 0; c < net->count; c++) {
+                int a = net->pairs[c][0], b = net->pairs[c][1];
+                SORT_VECTOR(a, b)
+            }
+            mvStore(out + i, v[net->target]);
+        }
+    }
+    return i;
+}
+
+#undef MV_TARGET
+#undef MedianVec
+#undef mvLoad
+#undef mvStore
+#undef mvMin
+#undef mvMax
+#undef mvSet1
+#undef medianRowVector
+#undef SORT_VECTOR
@@ -0,0 +1,473 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include "nlm_filter.h"
+#include "image.h"
+#include "frame_pool.h"
+#include "thread_pool.h"
+#include "cpu_dispatch.h"
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
+#include "trace.h"
+
+// 純量與向量版本的權重以相同的運算順序求出，關閉乘加合併才能讓各等級的輸出逐位元相同
+#pragma GCC optimize("fp-contract=off")
+
+#define NLM_TILE_ROWS 64        // 每個工作處理的區塊大小：累加值與平方差影像約 300 KB，整個搜尋窗口走完前都留在 L2
+#define NLM_TILE_COLUMNS 256
+#define NLM_MAX_EXPONENT 100.0f // 權重 2^-t 的 t 上限，再大的 t 權重已可忽略，指數也不會超出 float 的範圍
+
+// 2^-t = 2^-n * e^-u（n 為 t 的整數部分，u = (t - n) * ln 2 < 0.7），e^-u 以 6 次泰勒多項式近似，相對誤差小於 2e-5
+static const float LN2 = 0.69314718f;
+static const float EXP_C6 = 1.0f / 720.0f;
+static const float EXP_C5 = -1.0f / 120.0f;
+static const float EXP_C4 = 1.0f / 24.0f;
+static const float EXP_C3 = -1.0f / 6.0f;
+static const float EXP_C2 = 0.5f;
+static const float EXP_C1 = -1.0f;
+static const float EXP_C0 = 1.0f;
+
+typedef struct {
+    const ImageView* src;
+    ImageView* dst;
+    const Image* work;          // 四周補上 S + f 個像素的平面影像（亮度模式只有亮度一個平面）
+    int lumaOnly;
+    int patchRadius;
+    int searchRadius;
+    float scale;                // 區塊的平方差總和 D 對應的權重為 2^-t，t = D * scale - offset（限制在 0 ~ NLM_MAX_EXPONENT）
+    float offset;
+    int tilesX;
+    atomic_int failed;          // 任一工作記憶體分配失敗時設為 1
+} NlmJob;
+
+// 一個區塊的暫存空間；位移只在區塊內走訪，平方差影像涵蓋區塊加上四周 f 個像素
+typedef struct {
+    uint32_t* diff;             // 目前位移的平方差（各平面相加），(rows + 2f) 行 x (columns + 2f) 欄
+    uint32_t* column;           // 平方差的欄總和（區塊的 2f + 1 行）
+    uint32_t* prefix;           // 欄總和的水平前綴和，prefix[0] = 0，多一個元素
+    uint32_t* zero;             // 全為 0 的一行
+    float* weightSum;           // 每個輸出像素的權重總和
+    float* valueSum[IMAGE_MAX_CHANNELS]; // 每個平面的加權總和
+} NlmScratch;
+
+static inline uint8_t roundPixel(float v) {
+    if (v <= 0.0f) return 0;
+    if (v >= 255.0f) return 255;
+    return (uint8_t)(v + 0.5f);
+}
+
+static inline uint8_t clampPixel(int v) {
+    return v < 0 ? 0 : (v > 255 ? 255 : (uint8_t)v);
+}
+
+// BGR 像素的亮度（BT.601 權重，8 位元定點）
+static inline uint8_t lumaOf(const uint8_t* p) {
+    return (uint8_t)((29 * p[0] + 150 * p[1] + 77 * p[2] + 128) >> 8);
+}
+
+#if defined(CPU_X86)
+// ---- 平方差：各平面的 (a - b)^2 相加，差的平方最大 255^2，以 16 位元無號數相乘不會溢位 ----
+
+TARGET_SSE2 static int diffRowSSE2(const uint8_t* const* a, const uint8_t* const* b, int planes, uint32_t* out, int i, int end) {
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= end; i += 16) {
+        __m128i acc[4] = { zero, zero, zero, zero };
+        for (int c = 0; c < planes; c++) {
+            __m128i va = _mm_loadu_si128((const __m128i*)(a[c] + i));
+            __m128i vb = _mm_loadu_si128((const __m128i*)(b[c] + i));
+            __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+            __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+            lo = _mm_mullo_epi16(lo, lo);
+            hi = _mm_mullo_epi16(hi, hi);
+            acc[0] = _mm_add_epi32(acc[0], _mm_unpacklo_epi16(lo, zero));
+            acc[1] = _mm_add_epi32(acc[1], _mm_unpackhi_epi16(lo, zero));
+            acc[2] = _mm_add_epi32(acc[2], _mm_unpacklo_epi16(hi, zero));
+            acc[3] = _mm_add_epi32(acc[3], _mm_unpackhi_epi16(hi, zero));
+        }
+        for (int k = 0; k < 4; k++) _mm_storeu_si128((__m128i*)(out + i + 4 * k), acc[k]);
+    }
+    return i;
+}
+
+TARGET_AVX2 static int diffRowAVX2(const uint8_t* const* a, const uint8_t* const* b, int planes, uint32_t* out, int i, int end) {
+    for (; i + 16 <= end; i += 16) {
+        __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+        for (int c = 0; c < planes; c++) {
+            __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(a[c] + i)));
+            __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(b[c] + i)));
+            __m256i d = _mm256_sub_epi16(va, vb);
+            d = _mm256_mullo_epi16(d, d);
+            acc0 = _mm256_add_epi32(acc0, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(d)));
+            acc1 = _mm256_add_epi32(acc1, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(d, 1)));
+        }
+        _mm256_storeu_si256((__m256i*)(out + i), acc0);
+        _mm256_storeu_si256((__m256i*)(out + i + 8), acc1);
+    }
+    return i;
+}
+#endif
+
+static void diffRow(const uint8_t* const* a, const uint8_t* const* b, int planes, uint32_t* out, int count) {
+    int i = 0;
+#if defined(CPU_X86)
+    CpuLevel level = cpuLevel();
+    if (level >= CPU_AVX2) {
+        i = diffRowAVX2(a, b, planes, out, i, count);
+    } else if (level >= CPU_SSE2) {
+        i = diffRowSSE2(a, b, planes, out, i, count);
+    }
+#endif
+    for (; i < count; i++) {
+        uint32_t sum = 0;
+        for (int c = 0; c < planes; c++) {
+            int d = a[c][i] - b[c][i];
+            sum += (uint32_t)(d * d);
+        }
+        out[i] = sum;
+    }
+}
+
+#if defined(CPU_X86)
+// ---- 欄總和加入一行並移出一行，再求水平前綴和（無號數模 2^32，相減後即為正確的區塊總和） ----
+
+TARGET_SSE2 static int columnPrefixSSE2(uint32_t* column, const uint32_t* add, const uint32_t* remove, uint32_t* prefix, int i, int end) {
+    __m128i carry = _mm_setzero_si128();
+    for (; i + 4 <= end; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(column + i));
+        v = _mm_add_epi32(v, _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(add + i)), _mm_loadu_si128((const __m128i*)(remove + i))));
+        _mm_storeu_si128((__m128i*)(column + i), v);
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+        v = _mm_add_epi32(v, carry);
+        _mm_storeu_si128((__m128i*)(prefix + 1 + i), v);
+        carry = _mm_shuffle_epi32(v, 0xFF);
+    }
+    return i;
+}
+
+TARGET_AVX2 static int columnPrefixAVX2(uint32_t* column, const uint32_t* add, const uint32_t* remove, uint32_t* prefix, int i, int end) {
+    __m256i carry = _mm256_setzero_si256(), last = _mm256_set1_epi32(7);
+    for (; i + 8 <= end; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(column + i));
+        v = _mm256_add_epi32(v, _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(add + i)), _mm256_loadu_si256((const __m256i*)(remove + i))));
+        _mm256_storeu_si256((__m256i*)(column + i), v);
+        // 兩個 128 位元的半邊各自求前綴和，再把低半邊的總和加到高半邊
+        v = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+        v = _mm256_add_epi32(v, _mm256_slli_si256(v, 8));
+        v = _mm256_add_epi32(v, _mm256_shuffle_epi32(_mm256_permute2x128_si256(v, v, 0x08), 0xFF));
+        v = _mm256_add_epi32(v, carry);
+        _mm256_storeu_si256((__m256i*)(prefix + 1 + i), v);
+        carry = _mm256_permutevar8x32_epi32(v, last);
+    }
+    return i;
+}
+#endif
+
+// prefix 為 NULL 時只更新欄總和
+static void columnPrefix(uint32_t* column, const uint32_t* add, const uint32_t* remove, uint32_t* prefix, int count) {
+    int i = 0;
+    if (prefix) {
+        prefix[0] = 0;
+#if defined(CPU_X86)
+        CpuLevel level = cpuLevel();
+        if (level >= CPU_AVX2) {
+            i = columnPrefixAVX2(column, add, remove, prefix, i, count);
+        } else if (level >= CPU_SSE2) {
+            i = columnPrefixSSE2(column, add, remove, prefix, i, count);
+        }
+#endif
+    }
+    for (; i < count; i++) {
+        column[i] += add[i] - remove[i];
+        if (prefix) prefix[i + 1] = prefix[i] + column[i];
+    }
+}
+
+// 一行的權重：區塊總和 D = prefix[x + span] - prefix[x]，權重 2^-t 累加到 weightSum，
+// 乘上位移後的像素值累加到各平面的 valueSum
+typedef struct {
+    const uint32_t* prefix;
+    int span;                   // 區塊寬度 2f + 1
+    float scale, offset;
+    int planes;
+    const uint8_t* values[IMAGE_MAX_CHANNELS]; // 各平面位移後的像素
+    float* weightSum;
+    float* valueSum[IMAGE_MAX_CHANNELS];
+} WeightRow;
+
+#if defined(CPU_X86)
+TARGET_SSE2 static int weightRowSSE2(const WeightRow* g, int i, int end) {
+    __m128 scale = _mm_set1_ps(g->scale), offset = _mm_set1_ps(g->offset), maxExponent = _mm_set1_ps(NLM_MAX_EXPONENT);
+    __m128 ln2 = _mm_set1_ps(LN2);
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= end; i += 4) {
+        __m128i d = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(g->prefix + i + g->span)), _mm_loadu_si128((const __m128i*)(g->prefix + i)));
+        __m128 t = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(d), scale), offset);
+        t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), maxExponent);
+        __m128i n = _mm_cvttps_epi32(t);
+        __m128 u = _mm_mul_ps(_mm_sub_ps(t, _mm_cvtepi32_ps(n)), ln2);
+        __m128 p = _mm_set1_ps(EXP_C6);
+        p = _mm_add_ps(_mm_mul_ps(p, u), _mm_set1_ps(EXP_C5));
+        p = _mm_add_ps(_mm_mul_ps(p, u), _mm_set1_ps(EXP_C4));
+        p = _mm_add_ps(_mm_mul_ps(p, u), _mm_set1_ps(EXP_C3));
+        p = _mm_add_ps(_mm_mul_ps(p, u), _mm_set1_ps(EXP_C2));
+        p = _mm_add_ps(_mm_mul_ps(p, u), _mm_set1_ps(EXP_C1));
+        p = _mm_add_ps(_mm_mul_ps(p, u), _mm_set1_ps(EXP_C0));
+        __m128 w = _mm_castsi128_ps(_mm_sub_epi32(_mm_castps_si128(p), _mm_slli_epi32(n, 23)));
+        _mm_storeu_ps(g->weightSum + i, _mm_add_ps(_mm_loadu_ps(g->weightSum + i), w));
+        for (int c = 0; c < g->planes; c++) {
+            int32_t packed;
+            memcpy(&packed, g->values[c] + i, 4);
+            __m128i bytes = _mm_cvtsi32_si128(packed);
+            __m128 v = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero));
+            _mm_storeu_ps(g->valueSum[c] + i, _mm_add_ps(_mm_loadu_ps(g->valueSum[c] + i), _mm_mul_ps(w, v)));
+        }
+    }
+    return i;
+}
+
+TARGET_AVX2 static int weightRowAVX2(const WeightRow* g, int i, int end) {
+    __m256 scale = _mm256_set1_ps(g->scale), offset = _mm256_set1_ps(g->offset), maxExponent = _mm256_set1_ps(NLM_MAX_EXPONENT);
+    __m256 ln2 = _mm256_set1_ps(LN2);
+    for (; i + 8 <= end; i += 8) {
+        __m256i d = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(g->prefix + i + g->span)), _mm256_loadu_si256((const __m256i*)(g->prefix + i)));
+        __m256 t = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(d), scale), offset);
+        t = _mm256_min_ps(_mm256_max_ps(t, _mm256_setzero_ps()), maxExponent);
+        __m256i n = _mm256_cvttps_epi32(t);
+        __m256 u = _mm256_mul_ps(_mm256_sub_ps(t, _mm256_cvtepi32_ps(n)), ln2);
+        __m256 p = _mm256_set1_ps(EXP_C6);
+        p = _mm256_add_ps(_mm256_mul_ps(p, u), _mm256_set1_ps(EXP_C5));
+        p = _mm256_add_ps(_mm256_mul_ps(p, u), _mm256_set1_ps(EXP_C4));
+        p = _mm256_add_ps(_mm256_mul_ps(p, u), _mm256_set1_ps(EXP_C3));
+        p = _mm256_add_ps(_mm256_mul_ps(p, u), _mm256_set1_ps(EXP_C2));
+        p = _mm256_add_ps(_mm256_mul_ps(p, u), _mm256_set1_ps(EXP_C1));
+        p = _mm256_add_ps(_mm256_mul_ps(p, u), _mm256_set1_ps(EXP_C0));
+        __m256 w = _mm256_castsi256_ps(_mm256_sub_epi32(_mm256_castps_si256(p), _mm256_slli_epi32(n, 23)));
+        _mm256_storeu_ps(g->weightSum + i, _mm256_add_ps(_mm256_loadu_ps(g->weightSum + i), w));
+        for (int c = 0; c < g->planes; c++) {
+            __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(g->values[c] + i))));
+            _mm256_storeu_ps(g->valueSum[c] + i, _mm256_add_ps(_mm256_loadu_ps(g->valueSum[c] + i), _mm256_mul_ps(w, v)));
+        }
+    }
+    return i;
+}
+#endif
+
+static void weightRow(const WeightRow* g, int count) {
+    int i = 0;
+#if defined(CPU_X86)
+    CpuLevel level = cpuLevel();
+    if (level >= CPU_AVX2) {
+        i = weightRowAVX2(g, i, count);
+    } else if (level >= CPU_SSE2) {
+        i = weightRowSSE2(g, i, count);
+    }
+#endif
+    for (; i < count; i++) {
+        int32_t d = (int32_t)(g->prefix[i + g->span] - g->prefix[i]);
+        float t = (float)d * g->scale - g->offset;
+        t = t > 0.0f ? t : 0.0f;
+        t = t < NLM_MAX_EXPONENT ? t : NLM_MAX_EXPONENT;
+        int32_t n = (int32_t)t;
+        float u = (t - (float)n) * LN2;
+        float p = EXP_C6;
+        p = p * u + EXP_C5;
+        p = p * u + EXP_C4;
+        p = p * u + EXP_C3;
+        p = p * u + EXP_C2;
+        p = p * u + EXP_C1;
+        p = p * u + EXP_C0;
+        uint32_t bits;
+        memcpy(&bits, &p, sizeof(bits));
+        bits -= (uint32_t)n << 23;
+        float w;
+        memcpy(&w, &bits, sizeof(w));
+        g->weightSum[i] += w;
+        for (int c = 0; c < g->planes; c++) g->valueSum[c][i] += w * g->values[c][i];
+    }
+}
+
+// 工作影像第 c 個平面 (x, y) 的位址（x、y 可以落在四周補上的鄰域內）
+static inline const uint8_t* workPixel(const Image* work, int c, int x, int y) {
+    return work->planes[c] + (ptrdiff_t)y * work->stride + x;
+}
+
+// 寫出一個區塊的結果：加權平均；亮度模式把亮度的變化加到每個色彩通道
+static void writeTile(const NlmJob* job, const NlmScratch* s, int x0, int y0, int columns, int rows) {
+    int ch = job->src->channels;
+    for (int y = 0; y < rows; y++) {
+        const uint8_t* in = imageRow(job->src, y0 + y) + (size_t)x0 * ch;
+        uint8_t* out = imageRow(job->dst, y0 + y) + (size_t)x0 * ch;
+        const float* weight = s->weightSum + (size_t)y * columns;
+        if (job->lumaOnly) {
+            const uint8_t* luma = workPixel(job->work, 0, x0, y0 + y);
+            const float* value = s->valueSum[0] + (size_t)y * columns;
+            for (int x = 0; x < columns; x++) {
+                int delta = roundPixel(value[x] / weight[x]) - luma[x];
+                for (int c = 0; c < 3; c++) out[x * ch + c] = clampPixel(in[x * ch + c] + delta);
+                if (ch == 4) out[x * ch + 3] = in[x * ch + 3];
+            }
+            continue;
+        }
+        for (int c = 0; c < ch; c++) {
+            const float* value = s->valueSum[c] + (size_t)y * columns;
+            for (int x = 0; x < columns; x++) out[x * ch + c] = roundPixel(value[x] / weight[x]);
+        }
+    }
+}
+
+// 處理一個區塊：依序走過搜尋窗口的每個位移，求出平方差影像、區塊距離與權重並累加
+static void nlmTileTask(int tile, void* ctx) {
+    NlmJob* job = (NlmJob*)ctx;
+    int f = job->patchRadius;
+    int S = job->searchRadius;
+    int planes = job->lumaOnly ? 1 : job->src->channels;
+    int x0 = (tile % job->tilesX) * NLM_TILE_COLUMNS;
+    int y0 = (tile / job->tilesX) * NLM_TILE_ROWS;
+    int columns = job->src->width - x0 < NLM_TILE_COLUMNS ? job->src->width - x0 : NLM_TILE_COLUMNS;
+    int rows = job->src->height - y0 < NLM_TILE_ROWS ? job->src->height - y0 : NLM_TILE_ROWS;
+    int diffColumns = columns + 2 * f;
+    int diffRows = rows + 2 * f;
+
+    size_t pixels = (size_t)rows * columns;
+    size_t bytes = ((size_t)diffRows * diffColumns + 3 * (size_t)diffColumns + 1) * sizeof(uint32_t) +
+                   (planes + 1) * pixels * sizeof(float);
+    uint8_t* buffer = (uint8_t*)framePoolAcquire(framePoolShared(), bytes, IMAGE_ALIGN);
+    if (!buffer) {
+        atomic_store(&job->failed, 1);
+        return;
+    }
+    NlmScratch s;
+    s.weightSum = (float*)buffer;
+    for (int c = 0; c < planes; c++) s.valueSum[c] = s.weightSum + (c + 1) * pixels;
+    s.diff = (uint32_t*)(s.weightSum + (planes + 1) * pixels);
+    s.column = s.diff + (size_t)diffRows * diffColumns;
+    s.zero = s.column + diffColumns;
+    s.prefix = s.zero + diffColumns;
+    memset(s.weightSum, 0, (planes + 1) * pixels * sizeof(float));
+    memset(s.zero, 0, diffColumns * sizeof(uint32_t));
+
+    WeightRow g;
+    g.prefix = s.prefix;
+    g.span = 2 * f + 1;
+    g.scale = job->scale;
+    g.offset = job->offset;
+    g.planes = planes;
+    for (int dy = -S; dy <= S; dy++) {
+        for (int dx = -S; dx <= S; dx++) {
+            // 區塊與四周 f 個像素的平方差
+            for (int r = 0; r < diffRows; r++) {
+                const uint8_t* a[IMAGE_MAX_CHANNELS];
+                const uint8_t* b[IMAGE_MAX_CHANNELS];
+                for (int c = 0; c < planes; c++) {
+                    a[c] = workPixel(job->work, c, x0 - f, y0 - f + r);
+                    b[c] = workPixel(job->work, c, x0 - f + dx, y0 - f + r + dy);
+                }
+                diffRow(a, b, planes, s.diff + (size_t)r * diffColumns, diffColumns);
+            }
+            // 欄總和涵蓋平方差的第 y ~ y + 2f 行（對應輸出第 y 行上下各 f 行）
+            memset(s.column, 0, diffColumns * sizeof(uint32_t));
+            for (int r = 0; r < 2 * f; r++) columnPrefix(s.column, s.diff + (size_t)r * diffColumns, s.zero, NULL, diffColumns);
+            for (int y = 0; y < rows; y++) {
+                const uint32_t* remove = y > 0 ? s.diff + (size_t)(y - 1) * diffColumns : s.zero;
+                columnPrefix(s.column, s.diff + (size_t)(y + 2 * f) * diffColumns, remove, s.prefix, diffColumns);
+                for (int c = 0; c < planes; c++) {
+                    g.values[c] = workPixel(job->work, c, x0 + dx, y0 + y + dy);
+                    g.valueSum[c] = s.valueSum[c] + (size_t)y * columns;
+                }
+                g.weightSum = s.weightSum + (size_t)y * columns;
+                weightRow(&g, columns);
+            }
+        }
+    }
+
+    writeTile(job, &s, x0, y0, columns, rows);
+    framePoolRelease(framePoolShared(), buffer);
+}
+
+typedef struct {
+    const ImageView* src;
+    const Image* work;
+    int bandHeight;
+} LumaJob;
+
+static void lumaTask(int band, void* ctx) {
+    LumaJob* job = (LumaJob*)ctx;
+    int ch = job->src->channels;
+    int yEnd = (band + 1) * job->bandHeight < job->src->height ? (band + 1) * job->bandHeight : job->src->height;
+    for (int y = band * job->bandHeight; y < yEnd; y++) {
+        const uint8_t* in = imageRow(job->src, y);
+        uint8_t* out = job->work->planes[0] + (ptrdiff_t)y * job->work->stride;
+        for (int x = 0; x < job->src->width; x++) out[x] = lumaOf(in + x * ch);
+    }
+}
+
+// 建立四周補上 pad 個像素的平面工作影像：亮度模式為亮度平面，否則為各通道拆開的平面
+static int createWork(const ImageView* src, int lumaOnly, int pad, Image* work) {
+    if (imageCreatePadded(work, src->width, src->height, lumaOnly ? 1 : src->channels, IMAGE_PLANAR, pad, pad) != 0) return -1;
+    if (lumaOnly) {
+        int bands = threadPoolThreads() * 4;
+        LumaJob job = { src, work, (src->height + bands - 1) / bands };
+        parallelFor((src->height + job.bandHeight - 1) / job.bandHeight, lumaTask, &job);
+    } else {
+        imageDeinterleave(src, work);
+    }
+    ImageBorder border = { BORDER_REPLICATE, 0 };
+    imageFillBorder(work, &border);
+    return 0;
+}
+
+int nlmFilter(const ImageView* src, ImageView* dst, const NlmParams* params) {
+    int f = params->patchRadius, S = params->searchRadius;
+    if (f < 0 || f > NLM_MAX_PATCH_RADIUS || S < 1 || S > NLM_MAX_SEARCH_RADIUS) {
+        fprintf(stderr, "非局部平均的區塊半徑須介於 0 與 %d 之間，搜尋半徑須介於 1 與 %d 之間。\n", NLM_MAX_PATCH_RADIUS, NLM_MAX_SEARCH_RADIUS);
+        return -1;
+    }
+    if (!(params->h > 0.0 && params->h <= NLM_MAX_STRENGTH) || !(params->sigma >= 0.0 && params->sigma <= NLM_MAX_STRENGTH)) {
+        fprintf(stderr, "非局部平均的 h 須大於 0，h 與 sigma 須介於 0 與 %g 之間。\n", NLM_MAX_STRENGTH);
+        return -1;
+    }
+    if (params->lumaOnly && src->channels < 3) {
+        fprintf(stderr, "亮度模式需要至少 3 個通道。\n");
+        return -1;
+    }
+    if (src->width <= 0 || src->height <= 0) return 0;
+
+    TRACE_BEGIN(span, "nlm");
+    NlmJob job;
+    job.src = src;
+    job.dst = dst;
+    job.lumaOnly = params->lumaOnly != 0;
+    job.patchRadius = f;
+    job.searchRadius = S;
+    // d² = D / (區塊像素數 * 平面數)，t = max(d² - 2 * sigma², 0) / (h² * ln 2)
+    double h2 = params->h * params->h * log(2.0);
+    int planes = job.lumaOnly ? 1 : src->channels;
+    job.scale = (float)(1.0 / ((double)(2 * f + 1) * (2 * f + 1) * planes * h2));
+    job.offset = (float)(2.0 * params->sigma * params->sigma / h2);
+    if (!isfinite(job.scale) || !isfinite(job.offset)) { // h 極小時 1 / h² 超出 float 的範圍，t 會變成 NaN
+        fprintf(stderr, "非局部平均的 h 太小。\n");
+        return -1;
+    }
+    job.tilesX = (src->width + NLM_TILE_COLUMNS - 1) / NLM_TILE_COLUMNS;
+    int tilesY = (src->height + NLM_TILE_ROWS - 1) / NLM_TILE_ROWS;
+
+    Image work;
+    if (createWork(src, job.lumaOnly, S + f, &work) != 0) {
+        TRACE_END(span, 0, 0);
+        return -1;
+    }
+    job.work = &work;
+    atomic_init(&job.failed, 0);
+    parallelFor(job.tilesX * tilesY, nlmTileTask, &job);
+    imageFree(&work);
+    TRACE_END(span, 2 * (uint64_t)src->width * src->height * src->channels, (uint64_t)src->width * src->height);
+    if (atomic_load(&job.failed)) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        return -1;
+    }
+    return 0;
+}
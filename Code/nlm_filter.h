@@ -0,0 +1,28 @@
+#ifndef NLM_FILTER_H
+#define NLM_FILTER_H
+
+#include "bmp_io.h"
+
+#define NLM_MAX_PATCH_RADIUS 15     // 區塊距離以 32 位元無號整數累加，(2f + 1)^2 * 4 * 255^2 須放得進去
+#define NLM_MAX_SEARCH_RADIUS 32
+#define NLM_MAX_STRENGTH 255.0      // h 與 sigma 的上限（8 位元亮度的範圍）
+
+// 非局部平均（non-local means）去雜訊：每個像素取搜尋窗口內所有像素的加權平均，
+// 權重由兩者周圍 (2f + 1) x (2f + 1) 區塊的平均平方差 d² 決定：w = exp(-max(d² - 2 * sigma², 0) / h²)
+// 同一個位移 (dx, dy) 對所有像素的區塊距離以平方差影像的積分（欄總和加上水平前綴和）相減求出，
+// 每像素的計算量與區塊大小無關，只與搜尋窗口的位移數 (2S + 1)^2 成正比
+typedef struct {
+    double sigma;       // 雜訊的標準差（8 位元亮度，0 ~ NLM_MAX_STRENGTH），區塊距離先減去 2 * sigma²（0 表示不減）
+    double h;           // 濾波強度（8 位元亮度，0 < h <= NLM_MAX_STRENGTH）：d² 比 2 * sigma² 大 h² 時權重降為 1 / e
+    int patchRadius;    // 區塊半徑 f（0 ~ NLM_MAX_PATCH_RADIUS）
+    int searchRadius;   // 搜尋窗口半徑 S（1 ~ NLM_MAX_SEARCH_RADIUS）
+    int lumaOnly;       // 非 0 時只以亮度計算距離並只平滑亮度，每個通道加上相同的亮度變化，色度不變（需要至少 3 個通道）
+} NlmParams;
+
+// 以非局部平均處理 src，所有像素（包含邊界）都會寫入，影像外的像素以重複邊緣像素補上
+// 影像切成固定大小的區塊以多執行緒處理，每個區塊依序走過整個搜尋窗口，累加值留在快取中；
+// 結果與執行緒數及 SIMD 等級無關；src 與 dst 可以相同
+// 成功傳回 0，參數不合法或記憶體不足時傳回 -1
+int nlmFilter(const ImageView* src, ImageView* dst, const NlmParams* params);
+
+#endif
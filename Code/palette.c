@@ -0,0 +1,383 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "palette.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+#define CELL_SHIFT (8 - PALETTE_CELL_BITS)
+#define CELL_SIDE (1 << PALETTE_CELL_BITS)
+
+// 顏色所在的格子：R 在最高位、B 在最低位，格子座標的第 0、1、2 軸分別為 B、G、R
+static inline int colorCell(int b, int g, int r) {
+    return ((r >> CELL_SHIFT) << (2 * PALETTE_CELL_BITS)) | ((g >> CELL_SHIFT) << PALETTE_CELL_BITS) | (b >> CELL_SHIFT);
+}
+
+static inline int clampColor(int v) {
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+// ======= 顏色直方圖 =======
+
+typedef struct {
+    const ImageView* img;
+    int bandHeight;
+    uint32_t* bands;    // 每個區段 4 * PALETTE_CELLS 項：像素數，以及 B、G、R 被捨去的低位元總和
+} HistogramJob;
+
+static void histogramTask(int band, void* ctx) {
+    HistogramJob* job = (HistogramJob*)ctx;
+    const ImageView* img = job->img;
+    uint32_t* count = job->bands + (size_t)band * 4 * PALETTE_CELLS;
+    uint32_t* low = count + PALETTE_CELLS;
+    int mask = (1 << CELL_SHIFT) - 1;
+    int yEnd = (band + 1) * job->bandHeight < img->height ? (band + 1) * job->bandHeight : img->height;
+
+    memset(count, 0, 4 * PALETTE_CELLS * sizeof(uint32_t));
+    for (int y = band * job->bandHeight; y < yEnd; y++) {
+        const uint8_t* p = imageRow(img, y);
+        for (int x = 0; x < img->width; x++, p += img->channels) {
+            int cell = colorCell(p[0], p[1], p[2]);
+            count[cell]++;
+            // 格子內的高位元由格子座標決定，只需累加低位元，32 位元不會溢位
+            low[cell * 3] += p[0] & mask;
+            low[cell * 3 + 1] += p[1] & mask;
+            low[cell * 3 + 2] += p[2] & mask;
+        }
+    }
+}
+
+int colorHistogramBuild(const ImageView* img, ColorHistogram* hist) {
+    memset(hist, 0, sizeof(*hist));
+    if (img->channels != 3 && img->channels != 4) {
+        fprintf(stderr, "調色盤量化只支援 3 或 4 通道的影像。\n");
+        return -1;
+    }
+
+    // 每個執行緒一個區段，各自累加到獨立的直方圖後再合併
+    int bandCount = threadPoolThreads();
+    HistogramJob job = { img, (img->height + bandCount - 1) / bandCount, NULL };
+    bandCount = (img->height + job.bandHeight - 1) / job.bandHeight;
+    job.bands = (uint32_t*)malloc((size_t)bandCount * 4 * PALETTE_CELLS * sizeof(uint32_t));
+    hist->count = (uint64_t*)calloc(PALETTE_CELLS, sizeof(uint64_t));
+    hist->sum = (uint64_t*)calloc(3 * PALETTE_CELLS, sizeof(uint64_t));
+    if (!job.bands || !hist->count || !hist->sum) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        free(job.bands);
+        colorHistogramFree(hist);
+        return -1;
+    }
+    TRACE_BEGIN(span, "histogram");
+    parallelFor(bandCount, histogramTask, &job);
+
+    for (int b = 0; b < bandCount; b++) {
+        const uint32_t* count = job.bands + (size_t)b * 4 * PALETTE_CELLS;
+        const uint32_t* low = count + PALETTE_CELLS;
+        for (int cell = 0; cell < PALETTE_CELLS; cell++) {
+            if (!count[cell]) continue;
+            hist->count[cell] += count[cell];
+            for (int c = 0; c < 3; c++) {
+                uint64_t base = (uint64_t)((cell >> (c * PALETTE_CELL_BITS)) & (CELL_SIDE - 1)) << CELL_SHIFT;
+                hist->sum[cell * 3 + c] += base * count[cell] + low[cell * 3 + c];
+            }
+        }
+    }
+    free(job.bands);
+    TRACE_END(span, (uint64_t)img->width * img->height * img->channels, (uint64_t)img->width * img->height);
+    return 0;
+}
+
+void colorHistogramFree(ColorHistogram* hist) {
+    free(hist->count);
+    free(hist->sum);
+    memset(hist, 0, sizeof(*hist));
+}
+
+// ======= Median cut =======
+
+// 顏色盒：格子座標的範圍（含兩端）
+typedef struct {
+    int lo[3], hi[3];
+    uint64_t count;
+} ColorBox;
+
+#define CELL_AT(b, g, r) (((r) << (2 * PALETTE_CELL_BITS)) | ((g) << PALETTE_CELL_BITS) | (b))
+
+// 把盒子縮到實際有像素的範圍並重新計算像素數
+static void shrinkBox(const ColorHistogram* hist, ColorBox* box) {
+    int lo[3] = { CELL_SIDE, CELL_SIDE, CELL_SIDE }, hi[3] = { -1, -1, -1 };
+    box->count = 0;
+    for (int r = box->lo[2]; r <= box->hi[2]; r++) {
+        for (int g = box->lo[1]; g <= box->hi[1]; g++) {
+            for (int b = box->lo[0]; b <= box->hi[0]; b++) {
+                uint64_t n = hist->count[CELL_AT(b, g, r)];
+                if (!n) continue;
+                box->count += n;
+                int v[3] = { b, g, r };
+                for (int c = 0; c < 3; c++) {
+                    if (v[c] < lo[c]) lo[c] = v[c];
+                    if (v[c] > hi[c]) hi[c] = v[c];
+                }
+            }
+        }
+    }
+    if (box->count) {
+        memcpy(box->lo, lo, sizeof(lo));
+        memcpy(box->hi, hi, sizeof(hi));
+    }
+}
+
+static int longestAxis(const ColorBox* box) {
+    int axis = 0;
+    for (int c = 1; c < 3; c++) {
+        if (box->hi[c] - box->lo[c] > box->hi[axis] - box->lo[axis]) axis = c;
+    }
+    return axis;
+}
+
+// 沿最長的軸在像素數的中位數處切開 box，後半部存入 other
+static void splitBox(const ColorHistogram* hist, ColorBox* box, ColorBox* other) {
+    int axis = longestAxis(box);
+    uint64_t projection[CELL_SIDE] = { 0 };
+    for (int r = box->lo[2]; r <= box->hi[2]; r++) {
+        for (int g = box->lo[1]; g <= box->hi[1]; g++) {
+            for (int b = box->lo[0]; b <= box->hi[0]; b++) {
+                int v[3] = { b, g, r };
+                projection[v[axis]] += hist->count[CELL_AT(b, g, r)];
+            }
+        }
+    }
+
+    // 切點至少保留一層在後半部
+    int cut = box->lo[axis];
+    uint64_t seen = projection[cut];
+    while (cut + 1 < box->hi[axis] && seen * 2 < box->count) seen += projection[++cut];
+
+    *other = *box;
+    box->hi[axis] = cut;
+    other->lo[axis] = cut + 1;
+    shrinkBox(hist, box);
+    shrinkBox(hist, other);
+}
+
+void paletteMedianCut(const ColorHistogram* hist, int colors, Palette* pal) {
+    ColorBox boxes[PALETTE_MAX_COLORS];
+    int boxCount = 1;
+    if (colors > PALETTE_MAX_COLORS) colors = PALETTE_MAX_COLORS;
+    if (colors < 1) colors = 1;
+
+    for (int c = 0; c < 3; c++) {
+        boxes[0].lo[c] = 0;
+        boxes[0].hi[c] = CELL_SIDE - 1;
+    }
+    shrinkBox(hist, &boxes[0]);
+
+    while (boxCount < colors) {
+        // 選出像素數與最長邊乘積最大、且還能切開的盒子
+        int best = -1;
+        uint64_t bestScore = 0;
+        for (int i = 0; i < boxCount; i++) {
+            int axis = longestAxis(&boxes[i]);
+            uint64_t score = boxes[i].count * (uint64_t)(boxes[i].hi[axis] - boxes[i].lo[axis]);
+            if (score > bestScore) {
+                bestScore = score;
+                best = i;
+            }
+        }
+        if (best < 0) break;
+        splitBox(hist, &boxes[best], &boxes[boxCount++]);
+    }
+
+    // 每個盒子取其中像素的平均色
+    pal->size = 0;
+    for (int i = 0; i < boxCount; i++) {
+        const ColorBox* box = &boxes[i];
+        uint64_t sum[3] = { 0, 0, 0 };
+        for (int r = box->lo[2]; r <= box->hi[2]; r++) {
+            for (int g = box->lo[1]; g <= box->hi[1]; g++) {
+                for (int b = box->lo[0]; b <= box->hi[0]; b++) {
+                    int cell = CELL_AT(b, g, r);
+                    for (int c = 0; c < 3; c++) sum[c] += hist->sum[cell * 3 + c];
+                }
+            }
+        }
+        for (int c = 0; c < 3; c++) {
+            pal->colors[pal->size][c] = box->count ? (uint8_t)((sum[c] + box->count / 2) / box->count) : 0;
+        }
+        pal->size++;
+    }
+}
+
+void paletteStore(const Palette* pal, uint8_t* entries) {
+    for (int i = 0; i < pal->size; i++) {
+        entries[i * 4] = pal->colors[i][0];
+        entries[i * 4 + 1] = pal->colors[i][1];
+        entries[i * 4 + 2] = pal->colors[i][2];
+        entries[i * 4 + 3] = 0;
+    }
+}
+
+// ======= 對照表 =======
+
+// 計算 R 座標為 r 的一層格子
+static void mapTask(int r, void* ctx) {
+    PaletteMap* map = (PaletteMap*)ctx;
+    const Palette* pal = &map->palette;
+    int half = 1 << CELL_SHIFT >> 1;
+    for (int g = 0; g < CELL_SIDE; g++) {
+        for (int b = 0; b < CELL_SIDE; b++) {
+            int v[3] = { (b << CELL_SHIFT) + half, (g << CELL_SHIFT) + half, (r << CELL_SHIFT) + half };
+            int best = 0, bestDist = 1 << 30;
+            for (int i = 0; i < pal->size; i++) {
+                int d0 = v[0] - pal->colors[i][0], d1 = v[1] - pal->colors[i][1], d2 = v[2] - pal->colors[i][2];
+                int dist = d0 * d0 + d1 * d1 + d2 * d2;
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = i;
+                }
+            }
+            map->index[CELL_AT(b, g, r)] = (uint8_t)best;
+        }
+    }
+}
+
+void paletteMapBuild(const Palette* pal, PaletteMap* map) {
+    map->palette = *pal;
+    parallelFor(CELL_SIDE, mapTask, map);
+}
+
+// ======= 量化 =======
+
+int ditherParse(const char* name, DitherMode* mode) {
+    if (strcmp(name, "none") == 0) {
+        *mode = DITHER_NONE;
+    } else if (strcmp(name, "ordered") == 0) {
+        *mode = DITHER_ORDERED;
+    } else if (strcmp(name, "diffusion") == 0) {
+        *mode = DITHER_DIFFUSION;
+    } else {
+        fprintf(stderr, "未知的抖動方式：%s。\n", name);
+        return -1;
+    }
+    return 0;
+}
+
+// 8x8 Bayer 矩陣（0 ~ 63）
+static const uint8_t bayer[8][8] = {
+    {  0, 32,  8, 40,  2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44,  4, 36, 14, 46,  6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    {  3, 35, 11, 43,  1, 33,  9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47,  7, 39, 13, 45,  5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 },
+};
+
+int paletteQuantizerInit(PaletteQuantizer* q, const PaletteMap* map, DitherMode dither, int bitCount, int width) {
+    memset(q, 0, sizeof(*q));
+    if ((bitCount != 4 && bitCount != 8) || map->palette.size > (1 << bitCount) || width <= 0) {
+        fprintf(stderr, "調色盤的顏色數超過輸出位元深度。\n");
+        return -1;
+    }
+    q->map = map;
+    q->dither = dither;
+    q->bitCount = bitCount;
+    q->width = width;
+    // 有序抖動的幅度約為調色盤在每個通道上的顏色間距
+    q->strength = (int)(255.0 / cbrt((double)map->palette.size) + 0.5);
+    if (dither == DITHER_DIFFUSION) {
+        // 兩行誤差，每行左右各多一個像素，邊界不需要特別判斷
+        q->error = (int*)calloc((size_t)2 * (width + 2) * 3, sizeof(int));
+        if (!q->error) {
+            fprintf(stderr, "記憶體分配失敗。\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void paletteQuantizerFree(PaletteQuantizer* q) {
+    free(q->error);
+    memset(q, 0, sizeof(*q));
+}
+
+static inline void putIndex(uint8_t* row, int x, int index, int bitCount) {
+    if (bitCount == 8) {
+        row[x] = (uint8_t)index;
+    } else if (x & 1) {
+        row[x >> 1] |= (uint8_t)index;
+    } else {
+        row[x >> 1] = (uint8_t)(index << 4);
+    }
+}
+
+// 量化一行（不抖動或有序抖動），row 為這一行在整張影像中的行號
+static void quantizeRow(const PaletteQuantizer* q, const uint8_t* src, uint8_t* dst, int channels, int row) {
+    const uint8_t* index = q->map->index;
+    if (q->dither == DITHER_NONE) {
+        for (int x = 0; x < q->width; x++, src += channels) {
+            putIndex(dst, x, index[colorCell(src[0], src[1], src[2])], q->bitCount);
+        }
+        return;
+    }
+    int offset[8];
+    for (int i = 0; i < 8; i++) offset[i] = ((bayer[row & 7][i] * 2 + 1 - 64) * q->strength) / 128;
+    for (int x = 0; x < q->width; x++, src += channels) {
+        int d = offset[x & 7];
+        int cell = colorCell(clampColor(src[0] + d), clampColor(src[1] + d), clampColor(src[2] + d));
+        putIndex(dst, x, index[cell], q->bitCount);
+    }
+}
+
+typedef struct {
+    const PaletteQuantizer* q;
+    const ImageView* src;
+} QuantizeJob;
+
+static void quantizeTile(const ImageView* src, ImageView* dst, void* ctx) {
+    QuantizeJob* job = (QuantizeJob*)ctx;
+    int first = (int)((src->data - job->src->data) / src->stride);
+    for (int y = 0; y < src->height; y++) {
+        quantizeRow(job->q, imageRow(src, y), imageRow(dst, y), src->channels, job->q->row + first + y);
+    }
+}
+
+// Floyd-Steinberg：右方 7/16、左下 3/16、下方 5/16、右下 1/16
+static void diffuseRow(PaletteQuantizer* q, const uint8_t* src, uint8_t* dst, int channels) {
+    const Palette* pal = &q->map->palette;
+    int* cur = q->error + (size_t)(q->row & 1) * (q->width + 2) * 3;
+    int* next = q->error + (size_t)(~q->row & 1) * (q->width + 2) * 3;
+    memset(next, 0, (size_t)(q->width + 2) * 3 * sizeof(int));
+    for (int x = 0; x < q->width; x++, src += channels) {
+        int* e = cur + (x + 1) * 3;
+        int v[3];
+        for (int c = 0; c < 3; c++) v[c] = clampColor(src[c] + ((e[c] + 8) >> 4));
+        int index = q->map->index[colorCell(v[0], v[1], v[2])];
+        putIndex(dst, x, index, q->bitCount);
+        for (int c = 0; c < 3; c++) {
+            int err = v[c] - pal->colors[index][c];
+            e[3 + c] += err * 7;
+            next[x * 3 + c] += err * 3;
+            next[(x + 1) * 3 + c] += err * 5;
+            next[(x + 2) * 3 + c] += err;
+        }
+    }
+}
+
+void paletteQuantizeRows(PaletteQuantizer* q, const ImageView* src, ImageView* dst) {
+    TRACE_BEGIN(span, "palette");
+    if (q->dither == DITHER_DIFFUSION) {
+        for (int y = 0; y < src->height; y++) {
+            diffuseRow(q, imageRow(src, y), imageRow(dst, y), src->channels);
+            q->row++;
+        }
+    } else {
+        QuantizeJob job = { q, src };
+        parallelRows(src, dst, quantizeTile, &job);
+        q->row += src->height;
+    }
+    TRACE_END(span, (uint64_t)src->width * src->height * src->channels + (uint64_t)dst->height * dst->stride,
+              (uint64_t)src->width * src->height);
+}
@@ -0,0 +1,82 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <stdint.h>
+#include "bmp_io.h"
+
+#define PALETTE_MAX_COLORS 256
+#define PALETTE_CELL_BITS 5                                     // 顏色直方圖與對照表每個通道保留的位元數
+#define PALETTE_CELLS (1 << (3 * PALETTE_CELL_BITS))            // 32 x 32 x 32 個顏色格子
+
+// 調色盤
+typedef struct {
+    int size;                                   // 顏色數
+    uint8_t colors[PALETTE_MAX_COLORS][3];      // 各顏色的 B、G、R
+} Palette;
+
+// 顏色直方圖：每個通道取高 5 位元，把 RGB 空間分成 32768 個格子，記錄落在每個格子的像素數與顏色總和
+// 同一張直方圖可以建立不同大小的調色盤，輸入只需要讀一次
+typedef struct {
+    uint64_t* count;    // 各格子的像素數
+    uint64_t* sum;      // 各格子的 B、G、R 總和（每個格子 3 項）
+} ColorHistogram;
+
+// 統計影像（3 或 4 通道，只使用 B、G、R）的顏色直方圖，各行區段以多執行緒統計
+// 成功傳回 0，通道數不合法或記憶體不足時傳回 -1
+int colorHistogramBuild(const ImageView* img, ColorHistogram* hist);
+
+// 釋放直方圖
+void colorHistogramFree(ColorHistogram* hist);
+
+// 以 median cut 建立最多 colors 個顏色的調色盤
+// 反覆選出像素數與最長邊乘積最大的顏色盒，沿最長的軸在像素數的中位數處切開，每個盒子取其中像素的平均色
+// 影像中的顏色不足 colors 種時，調色盤的顏色數會較少
+void paletteMedianCut(const ColorHistogram* hist, int colors, Palette* pal);
+
+// 將調色盤寫成 BMP 的調色盤項目（B、G、R、0）
+void paletteStore(const Palette* pal, uint8_t* entries);
+
+// 顏色到調色盤索引的對照表：每個格子事先找好最接近格子中心的顏色，量化每個像素只需查表一次
+typedef struct {
+    Palette palette;
+    uint8_t index[PALETTE_CELLS];
+} PaletteMap;
+
+// 建立對照表（各格子平行計算）
+void paletteMapBuild(const Palette* pal, PaletteMap* map);
+
+// 抖動方式
+typedef enum {
+    DITHER_NONE,        // 不抖動，直接取對照表中的顏色
+    DITHER_ORDERED,     // 8x8 Bayer 有序抖動，各行互不相依，可平行處理
+    DITHER_DIFFUSION    // Floyd-Steinberg 誤差擴散，品質最好，但必須逐行依序處理
+} DitherMode;
+
+// 由名稱（none、ordered、diffusion）取得抖動方式
+// 成功傳回 0，名稱不正確時傳回 -1
+int ditherParse(const char* name, DitherMode* mode);
+
+// 量化器：把 BGR / BGRA 像素轉成 4 或 8 位元的調色盤索引
+// 可以分成多次、每次處理接續的數行（例如與其他輸出一起逐條帶處理），誤差擴散與有序抖動的圖樣會跨越呼叫延續
+typedef struct {
+    const PaletteMap* map;
+    DitherMode dither;
+    int bitCount;       // 輸出的每像素位元數（4 或 8）
+    int width;          // 每行像素數
+    int row;            // 下一次呼叫的第一行在整張影像中的行號
+    int strength;       // 有序抖動的幅度
+    int* error;         // 誤差擴散：目前這一行與下一行累積的誤差（乘上 16）
+} PaletteQuantizer;
+
+// 初始化量化器；bitCount 為 4 時調色盤最多 16 色
+// 成功傳回 0，參數不合法或記憶體不足時傳回 -1
+int paletteQuantizerInit(PaletteQuantizer* q, const PaletteMap* map, DitherMode dither, int bitCount, int width);
+
+// 量化 src 的各行並寫入 dst（bmpCreate 建立的 4 / 8 位元視圖，或其子視圖），src 的寬度須與初始化時相同
+// 不抖動與有序抖動時各行區段以多執行緒處理，誤差擴散時依序處理；結果都與執行緒數無關
+void paletteQuantizeRows(PaletteQuantizer* q, const ImageView* src, ImageView* dst);
+
+// 釋放量化器
+void paletteQuantizerFree(PaletteQuantizer* q);
+
+#endif
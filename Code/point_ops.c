@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "point_ops.h"
+#include "thread_pool.h"
+#include "cpu_dispatch.h"
+#if defined(CPU_X86)
+#include <immintrin.h>
+#endif
+#include "trace.h"
+
+// 將數值限制在 [0, 255]
+static inline uint8_t clampByte(int v) {
+    return (v > 255) ? 255 : (v < 0) ? 0 : v;
+}
+
+void lutIdentity(PointLUT* lut) {
+    for (int c = 0; c < 4; c++) {
+        for (int i = 0; i < 256; i++) {
+            lut->table[c][i] = (uint8_t)i;
+        }
+    }
+}
+
+// 每個點運算都作用在目前的表值上，因此連續呼叫即為函數合成
+void lutGamma(PointLUT* lut, float gamma) {
+    uint8_t map[256];
+    for (int i = 0; i < 256; i++) {
+        map[i] = (uint8_t)(255 * pow(i / 255.0, gamma)); // 與逐像素計算的結果相同
+    }
+    for (int c = 0; c < 4; c++) {
+        for (int i = 0; i < 256; i++) {
+            lut->table[c][i] = map[lut->table[c][i]];
+        }
+    }
+}
+
+void lutQuantize(PointLUT* lut, int bits) {
+    int levels = 1 << bits;  // 計算級別數，例：6 位元有 64 級
+    int step = 256 / levels; // 每個級別的步長
+    for (int c = 0; c < 4; c++) {
+        for (int i = 0; i < 256; i++) {
+            lut->table[c][i] = (lut->table[c][i] / step) * step;
+        }
+    }
+}
+
+void lutScale(PointLUT* lut, double bFactor, double gFactor, double rFactor) {
+    double factors[3] = { bFactor, gFactor, rFactor };
+    for (int c = 0; c < 3; c++) {
+        for (int i = 0; i < 256; i++) {
+            lut->table[c][i] = clampByte((int)(lut->table[c][i] * factors[c]));
+        }
+    }
+}
+
+void lutOffset(PointLUT* lut, int bOffset, int gOffset, int rOffset) {
+    int offsets[3] = { bOffset, gOffset, rOffset };
+    for (int c = 0; c < 3; c++) {
+        for (int i = 0; i < 256; i++) {
+            lut->table[c][i] = clampByte(lut->table[c][i] + offsets[c]);
+        }
+    }
+}
+
+// 檢查前 channels 張表是否相同；相同時可以把整行當作位元組串處理
+static int lutIsUniform(const PointLUT* lut, int channels) {
+    for (int c = 1; c < channels; c++) {
+        if (memcmp(lut->table[0], lut->table[c], 256) != 0) return 0;
+    }
+    return 1;
+}
+
+#if defined(CPU_X86)
+// 64 個位元組同時查表：vpermi2b 一次查 128 項，再依最高位元選擇前半或後半張表
+TARGET_AVX512 static inline __m512i lookup512(const __m512i t[4], __m512i x) {
+    __m512i lo = _mm512_permutex2var_epi8(t[0], x, t[1]);
+    __m512i hi = _mm512_permutex2var_epi8(t[2], x, t[3]);
+    return _mm512_mask_blend_epi8(_mm512_movepi8_mask(x), lo, hi);
+}
+
+TARGET_AVX512 static inline void loadTable512(const uint8_t* table, __m512i t[4]) {
+    for (int k = 0; k < 4; k++) {
+        t[k] = _mm512_loadu_si512((const void*)(table + 64 * k));
+    }
+}
+
+// 以下的向量版本處理前面整數個向量，傳回處理到的位置，剩下的由呼叫者逐一查表
+TARGET_AVX512 static int applyUniformAVX512(const uint8_t* table, const uint8_t* src, uint8_t* dst, int n) {
+    int i = 0;
+    __m512i t[4];
+    loadTable512(table, t);
+    for (; i + 64 <= n; i += 64) {
+        __m512i x = _mm512_loadu_si512((const void*)(src + i));
+        _mm512_storeu_si512((void*)(dst + i), lookup512(t, x));
+    }
+    return i;
+}
+
+// 256 項的表拆成 16 張 16 項的子表，以 vpshufb 查低 4 位元，再依高 4 位元選出對應子表的結果
+TARGET_AVX2 static int applyUniformAVX2(const uint8_t* table, const uint8_t* src, uint8_t* dst, int n) {
+    int i = 0;
+    __m256i sub[16];
+    for (int k = 0; k < 16; k++) {
+        sub[k] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(table + 16 * k)));
+    }
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i lo = _mm256_and_si256(x, nibble);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble);
+        __m256i result = _mm256_setzero_si256();
+        for (int k = 0; k < 16; k++) {
+            __m256i hit = _mm256_cmpeq_epi8(hi, _mm256_set1_epi8((char)k));
+            result = _mm256_or_si256(result, _mm256_and_si256(hit, _mm256_shuffle_epi8(sub[k], lo)));
+        }
+        _mm256_storeu_si256((__m256i*)(dst + i), result);
+    }
+    return i;
+}
+
+// channels 個向量（64 * channels 位元組）為一組，組內每個位元組所屬的通道固定，
+// 分別以各通道的表查表後用遮罩合併；傳回處理到的像素
+TARGET_AVX512 static int applyPerChannelAVX512(const PointLUT* lut, const uint8_t* src, uint8_t* dst, int width, int channels) {
+    int x = 0;
+    __m512i t[4][4];
+    __mmask64 masks[4][4];
+    for (int c = 0; c < channels; c++) {
+        loadTable512(lut->table[c], t[c]);
+    }
+    for (int v = 0; v < channels; v++) {
+        for (int c = 0; c < channels; c++) {
+            __mmask64 m = 0;
+            for (int l = 0; l < 64; l++) {
+                if ((v * 64 + l) % channels == c) m |= (__mmask64)1 << l;
+            }
+            masks[v][c] = m;
+        }
+    }
+    for (; x + 64 <= width; x += 64) {
+        for (int v = 0; v < channels; v++) {
+            int offset = x * channels + v * 64;
+            __m512i in = _mm512_loadu_si512((const void*)(src + offset));
+            __m512i out = lookup512(t[0], in);
+            for (int c = 1; c < channels; c++) {
+                out = _mm512_mask_blend_epi8(masks[v][c], out, lookup512(t[c], in));
+            }
+            _mm512_storeu_si512((void*)(dst + offset), out);
+        }
+    }
+    return x;
+}
+#endif
+
+// 所有位元組使用同一張表
+// 只有 AVX2 以上有向量版本：128 位元的 nibble 查表每 16 個位元組要 16 次比較與 pshufb，比純量查表還慢
+static void applyUniform(const uint8_t* table, const uint8_t* src, uint8_t* dst, int n) {
+    int i = 0;
+#if defined(CPU_X86)
+    CpuLevel level = cpuLevel();
+    if (level >= CPU_AVX512) {
+        i = applyUniformAVX512(table, src, dst, n);
+    } else if (level >= CPU_AVX2) {
+        i = applyUniformAVX2(table, src, dst, n);
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = table[src[i]];
+    }
+}
+
+// 每個通道使用各自的表（交錯排列的 BGR / BGRA 像素）
+static void applyPerChannel(const PointLUT* lut, const uint8_t* src, uint8_t* dst, int width, int channels) {
+    int x = 0;
+#if defined(CPU_X86)
+    if (cpuLevel() >= CPU_AVX512) x = applyPerChannelAVX512(lut, src, dst, width, channels);
+#endif
+    const uint8_t* tb = lut->table[0];
+    const uint8_t* tg = lut->table[1];
+    const uint8_t* tr = lut->table[2];
+    const uint8_t* ta = lut->table[3];
+    src += x * channels;
+    dst += x * channels;
+    if (channels == 4) {
+        for (; x < width; x++, src += 4, dst += 4) {
+            dst[0] = tb[src[0]];
+            dst[1] = tg[src[1]];
+            dst[2] = tr[src[2]];
+            dst[3] = ta[src[3]];
+        }
+    } else {
+        for (; x < width; x++, src += 3, dst += 3) {
+            dst[0] = tb[src[0]];
+            dst[1] = tg[src[1]];
+            dst[2] = tr[src[2]];
+        }
+    }
+}
+
+void lutApplyRow(const PointLUT* lut, const uint8_t* src, uint8_t* dst, int width, int channels) {
+    if (channels == 1 || lutIsUniform(lut, channels)) {
+        applyUniform(lut->table[0], src, dst, width * channels);
+    } else {
+        applyPerChannel(lut, src, dst, width, channels);
+    }
+}
+
+// 對一個行區段（或整張影像）套用查找表
+static void lutTile(const ImageView* src, ImageView* dst, void* ctx) {
+    const PointLUT* lut = (const PointLUT*)ctx;
+    int uniform = lutIsUniform(lut, src->channels);
+    int rowBytes = src->width * src->channels;
+    for (int y = 0; y < src->height; y++) {
+        if (uniform) {
+            applyUniform(lut->table[0], imageRow(src, y), imageRow(dst, y), rowBytes);
+        } else {
+            applyPerChannel(lut, imageRow(src, y), imageRow(dst, y), src->width, src->channels);
+        }
+    }
+}
+
+void lutApply(const PointLUT* lut, const ImageView* src, ImageView* dst) {
+    TRACE_BEGIN(span, "lut");
+    parallelRows(src, dst, lutTile, (void*)lut);
+    TRACE_END(span, 2 * (uint64_t)src->width * src->height * src->channels, (uint64_t)src->width * src->height);
+}
+
+typedef struct {
+    const PointLUT* luts;
+    int count;
+    const ImageView* src;
+    ImageView* dsts;
+    int bandHeight;
+} LutFanOutJob;
+
+static void lutFanOutTask(int band, void* ctx) {
+    LutFanOutJob* job = (LutFanOutJob*)ctx;
+    const ImageView* src = job->src;
+    int yEnd = (band + 1) * job->bandHeight < src->height ? (band + 1) * job->bandHeight : src->height;
+    for (int y = band * job->bandHeight; y < yEnd; y++) {
+        const uint8_t* row = imageRow(src, y);
+        for (int k = 0; k < job->count; k++) {
+            lutApplyRow(&job->luts[k], row, imageRow(&job->dsts[k], y), src->width, src->channels);
+        }
+    }
+}
+
+void lutApplyFanOut(const PointLUT* luts, int count, const ImageView* src, ImageView* dsts) {
+    TRACE_BEGIN(span, "lut.fan-out");
+    int bands = threadPoolThreads() * 4;
+    LutFanOutJob job = { luts, count, src, dsts, (src->height + bands - 1) / bands };
+    if (job.bandHeight < 1) job.bandHeight = 1;
+    parallelFor((src->height + job.bandHeight - 1) / job.bandHeight, lutFanOutTask, &job);
+    TRACE_END(span, (uint64_t)(count + 1) * src->width * src->height * src->channels, (uint64_t)src->width * src->height);
+}
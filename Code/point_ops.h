@@ -0,0 +1,42 @@
+#ifndef POINT_OPS_H
+#define POINT_OPS_H
+
+#include <stdint.h>
+#include "bmp_io.h"
+
+// 點運算查找表：8 位元輸入映射到 8 位元輸出，每個通道（B, G, R, A）各一張 256 項的表
+// 以 lutIdentity 初始化後，依序呼叫 lutGamma / lutScale 等函式即可將多個點運算合成為一張表
+typedef struct {
+    uint8_t table[4][256];
+} PointLUT;
+
+// 初始化為恆等映射
+void lutIdentity(PointLUT* lut);
+
+// 伽瑪校正：255 * (v / 255)^gamma（作用於 B, G, R, A）
+void lutGamma(PointLUT* lut, float gamma);
+
+// 量化為 bits 位元：(v / step) * step（作用於 B, G, R, A）
+void lutQuantize(PointLUT* lut, int bits);
+
+// 各通道乘上係數後截斷並限制在 [0, 255]（白平衡使用）
+void lutScale(PointLUT* lut, double bFactor, double gFactor, double rFactor);
+
+// 各通道加上偏移量並限制在 [0, 255]（暖色 / 冷色調整使用）
+void lutOffset(PointLUT* lut, int bOffset, int gOffset, int rOffset);
+
+// 對一行像素套用查找表
+// src, dst: 輸入與輸出像素（可以相同）
+// width: 像素數
+// channels: 每像素位元組數；為 1 時所有位元組都使用第 0 張表
+void lutApplyRow(const PointLUT* lut, const uint8_t* src, uint8_t* dst, int width, int channels);
+
+// 對整張影像套用查找表（src 與 dst 可以相同），各行區段以多執行緒處理
+void lutApply(const PointLUT* lut, const ImageView* src, ImageView* dst);
+
+// 以一次走訪套用 count 張查找表，例如同時產生多個 gamma 值的結果：
+// src 的每一行只從記憶體讀入一次，留在快取中依序查表寫入 dsts[0] ~ dsts[count - 1]
+// dsts 的大小與通道數須與 src 相同，結果與分別呼叫 lutApply 相同；各行區段以多執行緒處理
+void lutApplyFanOut(const PointLUT* luts, int count, const ImageView* src, ImageView* dsts);
+
+#endif
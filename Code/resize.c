@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "resize.h"
+#include "image.h"
+#include "trace.h"
+
+#define WEIGHT_BITS 14                          // 權重的小數位數
+#define WEIGHT_ONE (1 << WEIGHT_BITS)
+#define WEIGHT_ROUND (1 << (WEIGHT_BITS - 1))
+
+// 一個方向的縮放係數：第 i 個輸出是輸入 start[i] 起 count[i] 個值以 weights[i * taps] 起的權重加權
+typedef struct {
+    int taps;           // 每個輸出最多使用的輸入數
+    int* start;
+    int* count;
+    int16_t* weights;   // Q14 定點數，每個輸出的權重總和恰為 WEIGHT_ONE
+} ResizeCoeffs;
+
+static double sinc(double x) {
+    if (x == 0.0) return 1.0;
+    x *= 3.14159265358979323846;
+    return sin(x) / x;
+}
+
+// 濾波器在 x 的值（x 以輸入像素為單位，放大時的距離）
+static double filterWeight(ResizeFilter filter, double x) {
+    switch (filter) {
+    case RESIZE_BILINEAR: x = fabs(x); return x < 1.0 ? 1.0 - x : 0.0;
+    case RESIZE_AREA: return x > -0.5 && x <= 0.5 ? 1.0 : 0.0;
+    case RESIZE_LANCZOS3: return x > -3.0 && x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+    default: return 0.0;
+    }
+}
+
+// 濾波器的半徑
+static double filterSupport(ResizeFilter filter) {
+    switch (filter) {
+    case RESIZE_BILINEAR: return 1.0;
+    case RESIZE_AREA: return 0.5;
+    case RESIZE_LANCZOS3: return 3.0;
+    default: return 0.5;
+    }
+}
+
+static void freeCoeffs(ResizeCoeffs* c) {
+    free(c->start);
+    free(c->count);
+    free(c->weights);
+}
+
+// 計算 inSize 個輸入縮放成 outSize 個輸出的係數
+// 輸出像素 i 的中心對應到輸入座標 (i + 0.5) * scale，縮小時濾波器的範圍乘上 scale
+static int computeCoeffs(int inSize, int outSize, ResizeFilter filter, ResizeCoeffs* c) {
+    double scale = (double)inSize / outSize;
+    double filterScale = scale > 1.0 ? scale : 1.0;
+    double support = filterSupport(filter) * filterScale;
+    c->taps = filter == RESIZE_NEAREST ? 1 : (int)ceil(support) * 2 + 1;
+    c->start = (int*)malloc(outSize * sizeof(int));
+    c->count = (int*)malloc(outSize * sizeof(int));
+    c->weights = (int16_t*)calloc((size_t)outSize * c->taps, sizeof(int16_t));
+    double* w = (double*)malloc(c->taps * sizeof(double));
+    if (!c->start || !c->count || !c->weights || !w) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        freeCoeffs(c);
+        free(w);
+        return -1;
+    }
+
+    for (int i = 0; i < outSize; i++) {
+        int16_t* q = c->weights + (size_t)i * c->taps;
+        double center = (i + 0.5) * scale;
+        int lo = (int)(center - support + 0.5);
+        int hi = (int)(center + support + 0.5);
+        if (lo < 0) lo = 0;
+        if (hi > inSize) hi = inSize;
+        if (hi - lo > c->taps) hi = lo + c->taps;
+
+        double total = 0.0;
+        if (filter != RESIZE_NEAREST) {
+            for (int k = 0; k < hi - lo; k++) {
+                w[k] = filterWeight(filter, (lo + k - center + 0.5) / filterScale);
+                total += w[k];
+            }
+            // 去掉兩端權重為 0 的輸入
+            while (hi > lo && w[hi - lo - 1] == 0.0) hi--;
+            while (hi > lo && w[0] == 0.0) {
+                memmove(w, w + 1, (hi - lo - 1) * sizeof(double));
+                lo++;
+            }
+        }
+        if (filter == RESIZE_NEAREST || total <= 0.0 || hi <= lo) {
+            // 最近鄰（或濾波器範圍內沒有輸入）：直接取中心所在的輸入
+            lo = (int)center;
+            if (lo >= inSize) lo = inSize - 1;
+            c->start[i] = lo;
+            c->count[i] = 1;
+            q[0] = WEIGHT_ONE;
+            continue;
+        }
+
+        // 轉成 Q14：以累積和捨入（q[k] 為前 k + 1 項與前 k 項之和各自捨入後的差），總和恰為 WEIGHT_ONE，平坦的區域縮放後不變
+        // 每個權重的誤差都小於 1，大倍率縮小時權重只有幾個單位，捨入誤差也不會集中到單一輸入上
+        double partial = 0.0;
+        int prev = 0;
+        for (int k = 0; k < hi - lo; k++) {
+            partial += w[k];
+            int next = k == hi - lo - 1 ? WEIGHT_ONE : (int)lround(partial / total * WEIGHT_ONE);
+            q[k] = (int16_t)(next - prev);
+            prev = next;
+        }
+        c->start[i] = lo;
+        c->count[i] = hi - lo;
+    }
+    free(w);
+    return 0;
+}
+
+static inline uint8_t clampPixel(int v) {
+    return v < 0 ? 0 : (v > 255 ? 255 : (uint8_t)v);
+}
+
+#if defined(__SSE2__)
+// 兩個權重組成 pmaddwd 的一對係數
+static inline __m128i weightPair(int16_t w0, int16_t w1) {
+    return _mm_set1_epi32((int)((uint16_t)w0 | ((uint32_t)(uint16_t)w1 << 16)));
+}
+
+static inline __m128i loadPixel(const uint8_t* p) {
+    int v;
+    memcpy(&v, p, sizeof(v));
+    return _mm_unpacklo_epi8(_mm_cvtsi32_si128(v), _mm_setzero_si128());
+}
+#endif
+
+// 水平縮放一行
+static void horizontalRow(const uint8_t* in, int inWidth, uint8_t* out, int outWidth, int ch, const ResizeCoeffs* cx) {
+    for (int x = 0; x < outWidth; x++) {
+        const uint8_t* p = in + (size_t)cx->start[x] * ch;
+        const int16_t* w = cx->weights + (size_t)x * cx->taps;
+        int n = cx->count[x];
+#if defined(__SSE2__)
+        // 一個像素讀成 4 個位元組（3 通道時多讀到下一個像素），最右邊的輸出改用純量避免讀出行尾
+        if ((ch == 4 || (ch == 3 && cx->start[x] + n < inWidth))) {
+            __m128i acc = _mm_set1_epi32(WEIGHT_ROUND);
+            int k = 0;
+            for (; k + 1 < n; k += 2) {
+                __m128i ab = _mm_unpacklo_epi16(loadPixel(p + k * ch), loadPixel(p + (k + 1) * ch));
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(ab, weightPair(w[k], w[k + 1])));
+            }
+            if (k < n) {
+                __m128i a = _mm_unpacklo_epi16(loadPixel(p + k * ch), _mm_setzero_si128());
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(a, weightPair(w[k], 0)));
+            }
+            acc = _mm_srai_epi32(acc, WEIGHT_BITS);
+            acc = _mm_packs_epi32(acc, acc);
+            int v = _mm_cvtsi128_si32(_mm_packus_epi16(acc, acc));
+            memcpy(out + (size_t)x * ch, &v, ch);
+            continue;
+        }
+#else
+        (void)inWidth;
+#endif
+        for (int c = 0; c < ch; c++) {
+            int sum = WEIGHT_ROUND;
+            for (int k = 0; k < n; k++) sum += w[k] * p[k * ch + c];
+            out[(size_t)x * ch + c] = clampPixel(sum >> WEIGHT_BITS);
+        }
+    }
+}
+
+// 垂直縮放一行：out 的每個位元組是 n 個輸入行同一位置的加權和
+static void verticalRow(const uint8_t* in, ptrdiff_t stride, int n, const int16_t* w, uint8_t* out, int bytes) {
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 8 <= bytes; i += 8) {
+        __m128i lo = _mm_set1_epi32(WEIGHT_ROUND), hi = lo;
+        const uint8_t* p = in + i;
+        int k = 0;
+        for (; k + 1 < n; k += 2, p += 2 * stride) {
+            __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128());
+            __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p + stride)), _mm_setzero_si128());
+            __m128i wp = weightPair(w[k], w[k + 1]);
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), wp));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), wp));
+        }
+        if (k < n) {
+            __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128());
+            __m128i wp = weightPair(w[k], 0);
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, _mm_setzero_si128()), wp));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, _mm_setzero_si128()), wp));
+        }
+        __m128i v = _mm_packs_epi32(_mm_srai_epi32(lo, WEIGHT_BITS), _mm_srai_epi32(hi, WEIGHT_BITS));
+        _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(v, v));
+    }
+#endif
+    for (; i < bytes; i++) {
+        int sum = WEIGHT_ROUND;
+        for (int k = 0; k < n; k++) sum += w[k] * in[k * stride + i];
+        out[i] = clampPixel(sum >> WEIGHT_BITS);
+    }
+}
+
+typedef struct {
+    const ImageView* src;
+    ImageView* dst;
+    ImageView tmp;          // 水平縮放後的中間結果，只包含垂直方向用到的輸入行
+    int tmpFirst;           // tmp 第 0 行對應的輸入行
+    ResizeCoeffs cx, cy;
+    int bandHeight;
+} ResizeJob;
+
+static void bandRange(const ResizeJob* job, int band, int height, int* yBegin, int* yEnd) {
+    *yBegin = band * job->bandHeight;
+    *yEnd = *yBegin + job->bandHeight < height ? *yBegin + job->bandHeight : height;
+}
+
+static void horizontalTask(int band, void* ctx) {
+    ResizeJob* job = (ResizeJob*)ctx;
+    int yBegin, yEnd;
+    bandRange(job, band, job->tmp.height, &yBegin, &yEnd);
+    for (int y = yBegin; y < yEnd; y++) {
+        horizontalRow(imageRow(job->src, job->tmpFirst + y), job->src->width,
+                      imageRow(&job->tmp, y), job->tmp.width, job->tmp.channels, &job->cx);
+    }
+}
+
+static void verticalTask(int band, void* ctx) {
+    ResizeJob* job = (ResizeJob*)ctx;
+    int yBegin, yEnd;
+    bandRange(job, band, job->dst->height, &yBegin, &yEnd);
+    for (int y = yBegin; y < yEnd; y++) {
+        verticalRow(imageRow(&job->tmp, job->cy.start[y] - job->tmpFirst), job->tmp.stride, job->cy.count[y],
+                    job->cy.weights + (size_t)y * job->cy.taps, imageRow(job->dst, y), job->dst->width * job->dst->channels);
+    }
+}
+
+static void nearestTask(int band, void* ctx) {
+    ResizeJob* job = (ResizeJob*)ctx;
+    int ch = job->dst->channels;
+    int yBegin, yEnd;
+    bandRange(job, band, job->dst->height, &yBegin, &yEnd);
+    for (int y = yBegin; y < yEnd; y++) {
+        const uint8_t* in = imageRow(job->src, job->cy.start[y]);
+        uint8_t* out = imageRow(job->dst, y);
+        for (int x = 0; x < job->dst->width; x++) {
+            const uint8_t* p = in + (size_t)job->cx.start[x] * ch;
+            for (int c = 0; c < ch; c++) out[(size_t)x * ch + c] = p[c];
+        }
+    }
+}
+
+// 以行區段平行執行
+static void runBands(ResizeJob* job, int height, void (*task)(int, void*)) {
+    int bands = threadPoolThreads() * 4;
+    job->bandHeight = (height + bands - 1) / bands;
+    if (job->bandHeight < 1) job->bandHeight = 1;
+    parallelFor((height + job->bandHeight - 1) / job->bandHeight, task, job);
+}
+
+int resizeImage(const ImageView* src, ImageView* dst, ResizeFilter filter) {
+    if (src->width <= 0 || src->height <= 0 || dst->width <= 0 || dst->height <= 0 || src->channels != dst->channels) {
+        fprintf(stderr, "縮放的影像尺寸或通道數不合法。\n");
+        return -1;
+    }
+
+    TRACE_BEGIN(span, "resize");
+    ResizeJob job;
+    memset(&job, 0, sizeof(job));
+    job.src = src;
+    job.dst = dst;
+    if (computeCoeffs(src->width, dst->width, filter, &job.cx) != 0) return -1;
+    if (computeCoeffs(src->height, dst->height, filter, &job.cy) != 0) {
+        freeCoeffs(&job.cx);
+        return -1;
+    }
+
+    int result = 0;
+    if (filter == RESIZE_NEAREST) {
+        runBands(&job, dst->height, nearestTask);
+    } else {
+        // 垂直方向用到的輸入行範圍（裁切或大幅縮小時不必水平縮放整張影像）
+        int first = src->height, last = 0;
+        for (int y = 0; y < dst->height; y++) {
+            if (job.cy.start[y] < first) first = job.cy.start[y];
+            if (job.cy.start[y] + job.cy.count[y] > last) last = job.cy.start[y] + job.cy.count[y];
+        }
+        job.tmpFirst = first;
+
+        Image tmp = { 0 };
+        if (src->width == dst->width) {
+            // 寬度不變時直接對輸入做垂直縮放
+            job.tmp = imageSubView(src, 0, first, src->width, last - first);
+        } else if (imageCreate(&tmp, dst->width, last - first, src->channels, IMAGE_INTERLEAVED) == 0) {
+            job.tmp = imageView(&tmp);
+            runBands(&job, job.tmp.height, horizontalTask);
+        } else {
+            result = -1;
+        }
+        if (result == 0) runBands(&job, dst->height, verticalTask);
+        imageFree(&tmp);
+    }
+
+    freeCoeffs(&job.cx);
+    freeCoeffs(&job.cy);
+    TRACE_END(span, ((uint64_t)src->width * src->height + (uint64_t)dst->width * dst->height) * src->channels,
+              (uint64_t)dst->width * dst->height);
+    return result;
+}
+
+int resizeParseFilter(const char* name, ResizeFilter* filter) {
+    static const struct { const char* name; ResizeFilter filter; } names[] = {
+        { "nearest", RESIZE_NEAREST },
+        { "bilinear", RESIZE_BILINEAR },
+        { "area", RESIZE_AREA },
+        { "lanczos", RESIZE_LANCZOS3 },
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i].name) == 0) {
+            *filter = names[i].filter;
+            return 0;
+        }
+    }
+    fprintf(stderr, "未知的縮放濾波器：%s。\n", name);
+    return -1;
+}
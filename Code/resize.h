@@ -0,0 +1,25 @@
+#ifndef RESIZE_H
+#define RESIZE_H
+
+#include "bmp_io.h"
+
+// 縮放使用的濾波器
+typedef enum {
+    RESIZE_NEAREST,     // 最近鄰
+    RESIZE_BILINEAR,    // 雙線性（三角形濾波器）
+    RESIZE_AREA,        // 面積平均（盒狀濾波器），縮小時每個輸出像素是其覆蓋範圍內輸入像素的平均
+    RESIZE_LANCZOS3     // Lanczos-3，縮小時最銳利，可能有輕微的振鈴
+} ResizeFilter;
+
+// 將 src 縮放成 dst 的大小（通道數須相同），src 與 dst 不可重疊
+// 先水平、再垂直做兩次一維濾波；每個輸出欄與輸出行的權重事先算成 Q14 定點數（總和恰為 1），
+// 兩個方向都以 SSE2 的 pmaddwd 一次累加兩個輸入，各行區段以多執行緒處理，結果與執行緒數無關
+// 縮小時濾波器的範圍隨縮小倍率放大，相當於先做抗鋸齒的低通濾波
+// 成功傳回 0，參數不合法或記憶體不足時傳回 -1
+int resizeImage(const ImageView* src, ImageView* dst, ResizeFilter filter);
+
+// 由名稱（nearest、bilinear、area、lanczos）取得濾波器
+// 成功傳回 0，名稱不正確時傳回 -1
+int resizeParseFilter(const char* name, ResizeFilter* filter);
+
+#endif
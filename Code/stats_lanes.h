@@ -0,0 +1,127 @@
+// 影像統計的向量版本，由 image_stats.c 引入兩次，STATS_VECTOR_BYTES 指定向量寬度：
+// 16（SSE2，statsRowsSSE2）或 32（AVX2，statsRowsAVX2）
+// 三個向量為一組（48 或 96 個位元組），是 1 ~ 4 通道的公倍數，每個位元組所屬的通道固定
+
+#if STATS_VECTOR_BYTES == 32
+#define SV_TARGET TARGET_AVX2
+#define StatsVec __m256i
+#define svLoad(p) _mm256_loadu_si256((const __m256i*)(p))
+#define svStore(p, v) _mm256_storeu_si256((__m256i*)(p), v)
+#define svMin _mm256_min_epu8
+#define svMax _mm256_max_epu8
+#define svAnd _mm256_and_si256
+#define svAdd64 _mm256_add_epi64
+#define svSad _mm256_sad_epu8
+#define svZero _mm256_setzero_si256
+#define svSet1 _mm256_set1_epi8
+#define sumMinMaxGroups sumMinMaxGroupsAVX2
+#define statsRows statsRowsAVX2
+#else
+#define SV_TARGET TARGET_SSE2
+#define StatsVec __m128i
+#define svLoad(p) _mm_loadu_si128((const __m128i*)(p))
+#define svStore(p, v) _mm_storeu_si128((__m128i*)(p), v)
+#define svMin _mm_min_epu8
+#define svMax _mm_max_epu8
+#define svAnd _mm_and_si128
+#define svAdd64 _mm_add_epi64
+#define svSad _mm_sad_epu8
+#define svZero _mm_setzero_si128
+#define svSet1 _mm_set1_epi8
+#define sumMinMaxGroups sumMinMaxGroupsSSE2
+#define statsRows statsRowsSSE2
+#endif
+
+#define SV_GROUP (3 * STATS_VECTOR_BYTES)   // 一組的位元組數
+
+// 累加一行中前 groups 組位元組：第 k 個向量的第 i 個位元組屬於通道 (STATS_VECTOR_BYTES * k + i) % ch，
+// 以遮罩挑出每個通道的位元組後用 psadbw 直接累加成 64 位元總和；最小 / 最大值逐位元組累積，最後再依通道合併
+SV_TARGET static inline __attribute__((always_inline)) void sumMinMaxGroups(const uint8_t* row, int groups, int ch, StatsVec masks[3][STATS_MAX_CHANNELS],
+                                                                            StatsVec* sums, StatsVec* mins, StatsVec* maxs) {
+    StatsVec m[3][STATS_MAX_CHANNELS], s[STATS_MAX_CHANNELS], lo[3], hi[3];
+    for (int k = 0; k < 3; k++) {
+        for (int c = 0; c < ch; c++) m[k][c] = masks[k][c];
+        lo[k] = mins[k];
+        hi[k] = maxs[k];
+    }
+    for (int c = 0; c < ch; c++) s[c] = sums[c];
+    for (int g = 0; g < groups; g++) {
+        const uint8_t* p = row + (size_t)g * SV_GROUP;
+#pragma GCC unroll 3
+        for (int k = 0; k < 3; k++) {
+            StatsVec v = svLoad(p + k * STATS_VECTOR_BYTES);
+            lo[k] = svMin(lo[k], v);
+            hi[k] = svMax(hi[k], v);
+#pragma GCC unroll 4
+            for (int c = 0; c < ch; c++) {
+                s[c] = svAdd64(s[c], svSad(ch == 1 ? v : svAnd(v, m[k][c]), svZero()));
+            }
+        }
+    }
+    for (int k = 0; k < 3; k++) {
+        mins[k] = lo[k];
+        maxs[k] = hi[k];
+    }
+    for (int c = 0; c < ch; c++) sums[c] = s[c];
+}
+
+// 處理行區段 [yBegin, yEnd) 的連續像素（不取樣時）：總和與最小 / 最大值以向量累加，每行剩下的像素逐一處理
+SV_TARGET static void statsRows(const StatsJob* job, int yBegin, int yEnd, ImageStats* s) {
+    const ImageView* img = job->img;
+    int ch = img->channels;
+    StatsVec masks[3][STATS_MAX_CHANNELS];
+    StatsVec sums[STATS_MAX_CHANNELS], mins[3], maxs[3];
+    for (int k = 0; k < 3; k++) {
+        uint8_t lanes[STATS_MAX_CHANNELS][STATS_VECTOR_BYTES];
+        for (int c = 0; c < ch; c++) {
+            for (int i = 0; i < STATS_VECTOR_BYTES; i++) lanes[c][i] = (STATS_VECTOR_BYTES * k + i) % ch == c ? 0xFF : 0;
+            masks[k][c] = svLoad(lanes[c]);
+        }
+        mins[k] = svSet1((char)0xFF);
+        maxs[k] = svZero();
+    }
+    for (int c = 0; c < ch; c++) sums[c] = svZero();
+
+    int groups = img->width * ch / SV_GROUP;
+    for (int y = yBegin; y < yEnd; y++) {
+        const uint8_t* row = imageRow(img, y);
+        if (job->flags & STATS_HISTOGRAM) rowHistogram(row, img->width, 1, ch, s);
+        switch (ch) { // 通道數為常數時遮罩與累加器都能放在暫存器中
+        case 1: sumMinMaxGroups(row, groups, 1, masks, sums, mins, maxs); break;
+        case 2: sumMinMaxGroups(row, groups, 2, masks, sums, mins, maxs); break;
+        case 3: sumMinMaxGroups(row, groups, 3, masks, sums, mins, maxs); break;
+        default: sumMinMaxGroups(row, groups, 4, masks, sums, mins, maxs); break;
+        }
+        rowSumMinMax(row, groups * SV_GROUP / ch, img->width, 1, ch, s);
+    }
+
+    for (int c = 0; c < ch; c++) {
+        uint64_t lanes[STATS_VECTOR_BYTES / 8];
+        svStore(lanes, sums[c]);
+        for (int i = 0; i < STATS_VECTOR_BYTES / 8; i++) s->sum[c] += lanes[i];
+    }
+    uint8_t lo[SV_GROUP], hi[SV_GROUP];
+    for (int k = 0; k < 3; k++) {
+        svStore(lo + STATS_VECTOR_BYTES * k, mins[k]);
+        svStore(hi + STATS_VECTOR_BYTES * k, maxs[k]);
+    }
+    for (int i = 0; i < SV_GROUP; i++) {
+        if (lo[i] < s->min[i % ch]) s->min[i % ch] = lo[i];
+        if (hi[i] > s->max[i % ch]) s->max[i % ch] = hi[i];
+    }
+}
+
+#undef SV_TARGET
+#undef StatsVec
+#undef svLoad
+#undef svStore
+#undef svMin
+#undef svMax
+#undef svAnd
+#undef svAdd64
+#undef svSad
+#undef svZero
+#undef svSet1
+#undef sumMinMaxGroups
+#undef statsRows
+#undef SV_GROUP
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "bmp_io.h"
+#include "strip_stream.h"
+#include "trace.h"
+
+// 從指定位置讀取 n 個位元組，處理 pread 只讀到部分資料的情況
+static int readFully(int fd, uint8_t* buf, size_t n, off_t offset) {
+    while (n > 0) {
+        ssize_t got = pread(fd, buf, n, offset);
+        if (got <= 0) return -1;
+        buf += got;
+        n -= (size_t)got;
+        offset += got;
+    }
+    return 0;
+}
+
+// 將 n 個位元組寫到指定位置
+static int writeFully(int fd, const uint8_t* buf, size_t n, off_t offset) {
+    while (n > 0) {
+        ssize_t put = pwrite(fd, buf, n, offset);
+        if (put <= 0) return -1;
+        buf += put;
+        n -= (size_t)put;
+        offset += put;
+    }
+    return 0;
+}
+
+// 關閉已開啟的輸出並釋放緩衝區
+static void closeOutputs(int* outputs, uint8_t** outBufs, int count) {
+    for (int k = 0; k < count; k++) {
+        if (outputs[k] >= 0) close(outputs[k]);
+        free(outBufs[k]);
+    }
+    free(outputs);
+    free(outBufs);
+}
+
+// 以條帶方式處理整張圖像，每個條帶讀入後依序交給每個輸出的核心
+int streamBMPFanOut(const char* inputFile, const StripOptions* options, const StripOutput* outputs, int count) {
+    int input = open(inputFile, O_RDONLY);
+    if (input < 0) {
+        fprintf(stderr, "無法開啟輸入文件 %s。\n", inputFile);
+        return -1;
+    }
+
+    // 讀取並檢查 BMP 標頭
+    struct stat st;
+    BMPHeader header;
+    if (fstat(input, &st) != 0 || readFully(input, (uint8_t*)&header, sizeof(BMPHeader), 0) != 0 ||
+        bmpCheckHeader(&header, (uint64_t)st.st_size) != 0) {
+        fprintf(stderr, "輸入文件 %s 不是有效的 BMP 文件。\n", inputFile);
+        close(input);
+        return -1;
+    }
+
+    int width = header.width;
+    int height = header.height < 0 ? -header.height : header.height;
+    int channels = header.bitCount / 8;                  // bmpCheckHeader 只接受 24、32 位，每像素 3 或 4 個位元組
+    int rowBytes = width * channels;                     // 每行實際的像素位元組數
+    size_t rowSize = bmpRowSize(width, header.bitCount); // 每行包含填充的位元組數
+    int stripHeight = options->stripHeight > 0 ? options->stripHeight : 1;
+    int halo = options->halo > 0 ? options->halo : 0;
+
+    // 緩衝區只容納一個條帶加上上下的鄰域行；輸出緩衝區的填充位元組保持為 0
+    size_t capacity = (size_t)(stripHeight + 2 * halo) * rowSize;
+    uint8_t* inBuf = (uint8_t*)malloc(capacity);
+    int* files = (int*)malloc((size_t)count * sizeof(int));
+    uint8_t** outBufs = (uint8_t**)calloc((size_t)count, sizeof(uint8_t*));
+    if (!inBuf || !files || !outBufs) {
+        fprintf(stderr, "記憶體分配失敗。\n");
+        free(inBuf);
+        free(files);
+        free(outBufs);
+        close(input);
+        return -1;
+    }
+    for (int k = 0; k < count; k++) files[k] = -1;
+
+    // 建立輸出文件並寫入標頭，預先設定檔案大小後逐條帶寫入
+    BMPHeader outHeader;
+    bmpInitHeader(&outHeader, &header, width, height, header.bitCount);
+    for (int k = 0; k < count; k++) {
+        outBufs[k] = (uint8_t*)calloc(1, capacity);
+        if (!outBufs[k]) {
+            fprintf(stderr, "記憶體分配失敗。\n");
+            closeOutputs(files, outBufs, count);
+            free(inBuf);
+            close(input);
+            return -1;
+        }
+        files[k] = open(outputs[k].outputFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (files[k] < 0 || ftruncate(files[k], outHeader.fileSize) != 0 ||
+            writeFully(files[k], (const uint8_t*)&outHeader, sizeof(BMPHeader), 0) != 0) {
+            fprintf(stderr, "無法開啟輸出文件 %s。\n", outputs[k].outputFile);
+            closeOutputs(files, outBufs, count);
+            free(inBuf);
+            close(input);
+            return -1;
+        }
+    }
+
+    int status = 0;
+    int windowStart = 0; // 緩衝區第 0 行對應的影像行
+    int loaded = 0;      // 緩衝區中已載入的行數
+
+    for (int y0 = 0; y0 < height && status == 0; y0 += stripHeight) {
+        int y1 = (y0 + stripHeight < height) ? y0 + stripHeight : height;
+        int needStart = (y0 - halo > 0) ? y0 - halo : 0;
+        int needEnd = (y1 + halo < height) ? y1 + halo : height;
+
+        // 捨棄不再需要的行，將保留的鄰域行移到緩衝區前端
+        int drop = needStart - windowStart;
+        if (drop > 0) {
+            memmove(inBuf, inBuf + drop * rowSize, (loaded - drop) * rowSize);
+            loaded -= drop;
+            windowStart = needStart;
+        }
+
+        // 只讀入尚未載入的新行
+        int have = windowStart + loaded;
+        if (needEnd > have) {
+            TRACE_BEGIN(readSpan, "strip.read");
+            off_t offset = header.offsetData + (off_t)have * rowSize;
+            if (readFully(input, inBuf + loaded * rowSize, (needEnd - have) * rowSize, offset) != 0) {
+                fprintf(stderr, "讀取輸入文件 %s 失敗。\n", inputFile);
+                status = -1;
+                break;
+            }
+            TRACE_END(readSpan, (uint64_t)(needEnd - have) * rowSize, 0);
+            loaded = needEnd - windowStart;
+        }
+
+        for (int k = 0; k < count && status == 0; k++) {
+            // 複製原始像素（保留未處理的邊界像素），再套用核心
+            uint8_t* outBuf = outBufs[k];
+            TRACE_BEGIN(kernelSpan, "strip.kernel");
+            for (int r = 0; r < loaded; r++) {
+                memcpy(outBuf + r * rowSize, inBuf + r * rowSize, rowBytes);
+            }
+            outputs[k].kernel(inBuf, outBuf, width, loaded, (int)rowSize, channels, outputs[k].ctx);
+            TRACE_END(kernelSpan, 2 * (uint64_t)loaded * rowBytes, (uint64_t)loaded * width);
+
+            // 只寫出條帶本身的行，鄰域行由相鄰的條帶負責
+            const uint8_t* strip = outBuf + (size_t)(y0 - windowStart) * rowSize;
+            off_t offset = sizeof(BMPHeader) + (off_t)y0 * rowSize;
+            TRACE_BEGIN(writeSpan, "strip.write");
+            if (writeFully(files[k], strip, (size_t)(y1 - y0) * rowSize, offset) != 0) {
+                fprintf(stderr, "寫入輸出文件 %s 失敗。\n", outputs[k].outputFile);
+                status = -1;
+            }
+            TRACE_END(writeSpan, (uint64_t)(y1 - y0) * rowSize, 0);
+        }
+    }
+
+    free(inBuf);
+    closeOutputs(files, outBufs, count);
+    close(input);
+    return status;
+}
+
+int streamBMP(const char* inputFile, const char* outputFile, const StripOptions* options, StripKernel kernel, void* ctx) {
+    StripOutput output = { outputFile, kernel, ctx };
+    return streamBMPFanOut(inputFile, options, &output, 1);
+}
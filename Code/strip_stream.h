@@ -0,0 +1,41 @@
+#ifndef STRIP_STREAM_H
+#define STRIP_STREAM_H
+
+#include <stdint.h>
+
+// 條帶核心：對一個視窗內的像素進行處理
+// 視窗包含目前的條帶，以及上下各 halo 行的鄰域（在影像邊界處會少於 halo 行）
+// 與作業中的濾波器相同，核心只需處理視窗內距離邊界至少 halo 行的像素
+// input: 視窗的輸入像素
+// output: 視窗的輸出像素（呼叫前已複製為輸入內容）
+// width: 圖像寬度
+// rows: 視窗的行數
+// rowPadded: 每行的實際位元組數（包含填充）
+// channels: 每像素的位元組數（24 位為 3，32 位為 4）
+// ctx: 呼叫者傳入的參數
+typedef void (*StripKernel)(uint8_t* input, uint8_t* output, int width, int rows, int rowPadded, int channels, void* ctx);
+
+// 條帶串流的設定
+typedef struct {
+    int stripHeight;    // 每條帶輸出的行數
+    int halo;           // 核心在條帶上下各需要的鄰域行數（點運算為 0）
+} StripOptions;
+
+// 以固定高度的條帶串流處理 BMP 檔案，記憶體用量只與條帶高度有關，與圖像高度無關
+// 每次只讀入 stripHeight 行新資料，上一條帶尾端的 2 * halo 行保留在緩衝區中重複使用
+// 成功傳回 0，失敗傳回 -1
+int streamBMP(const char* inputFile, const char* outputFile, const StripOptions* options, StripKernel kernel, void* ctx);
+
+// 多輸出串流中的一個輸出
+typedef struct {
+    const char* outputFile;
+    StripKernel kernel;
+    void* ctx;
+} StripOutput;
+
+// 以同一次串流產生多個輸出：每個條帶只讀入一次，依序交給每個輸出的核心處理後寫入各自的文件
+// options->halo 須為所有核心需要的鄰域行數中的最大值
+// 成功傳回 0，失敗傳回 -1
+int streamBMPFanOut(const char* inputFile, const StripOptions* options, const StripOutput* outputs, int count);
+
+#endif
@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "thread_pool.h"
+#include "trace.h"
+
+#define TILE_BYTES (256 * 1024)    // 每個區塊（含鄰域）的目標大小，約為 L2 快取容量
+#define TILES_PER_THREAD 4         // 每個執行緒平均分到的區塊數，留給 work stealing 平衡負載的空間
+#define MIN_TILE_ROWS 16           // 區塊的最小行數，避免鄰域行的重複讀取比例太高
+
+// 每個執行緒尚未處理的項目範圍 [begin, end)，以一個 64 位元整數存放，
+// 本身從前端取、其他執行緒從後端偷，兩者都以 compare-and-swap 更新
+typedef struct {
+    _Atomic uint64_t range;
+    char padding[64 - sizeof(uint64_t)];    // 每個範圍獨佔一條快取線，避免偽共享
+} WorkRange;
+
+static inline uint64_t packRange(uint32_t begin, uint32_t end) {
+    return ((uint64_t)end << 32) | begin;
+}
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;            // 通知工作執行緒有新的工作
+    pthread_cond_t done;            // 通知呼叫者所有執行緒都已完成
+    pthread_mutex_t busy;           // 同一時間只允許一個平行迴圈使用執行緒池
+    pthread_t workers[THREAD_POOL_MAX_THREADS];
+    int created;                    // 已建立的工作執行緒數（不含呼叫者）
+    int threads;                    // 設定的執行緒數（包含呼叫者），0 表示尚未決定
+    unsigned long generation;       // 每發布一次工作加 1
+
+    // 目前的工作
+    ParallelTask task;
+    void* ctx;
+    int participants;
+    int finished;
+    WorkRange ranges[THREAD_POOL_MAX_THREADS];
+} pool = { .lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER, .done = PTHREAD_COND_INITIALIZER, .busy = PTHREAD_MUTEX_INITIALIZER };
+
+static __thread int insideParallel; // 目前的執行緒正在執行平行迴圈中的工作
+
+void threadPoolSetThreads(int threads) {
+    if (threads <= 0) {
+        const char* env = getenv("DIP_THREADS");
+        threads = env ? atoi(env) : 0;
+        if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads <= 0) threads = 1;
+    }
+    if (threads > THREAD_POOL_MAX_THREADS) threads = THREAD_POOL_MAX_THREADS;
+    pool.threads = threads;
+}
+
+int threadPoolThreads(void) {
+    if (pool.threads == 0) threadPoolSetThreads(0);
+    return pool.threads;
+}
+
+void threadPoolParseArgs(int argc, char* argv[]) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 || strcmp(argv[i], "-t") == 0) {
+            threadPoolSetThreads(atoi(argv[i + 1]));
+        }
+    }
+}
+
+// 從自己的範圍前端取一個項目；範圍已空時傳回 -1
+static int popFront(WorkRange* own) {
+    uint64_t r = atomic_load(&own->range);
+    while (1) {
+        uint32_t begin = (uint32_t)r, end = (uint32_t)(r >> 32);
+        if (begin >= end) return -1;
+        if (atomic_compare_exchange_weak(&own->range, &r, packRange(begin + 1, end))) return (int)begin;
+    }
+}
+
+// 從其他執行緒的範圍後端偷走一半（至少一個）項目，放入自己的範圍；沒有可偷的工作時傳回 0
+static int steal(int self, int participants) {
+    for (int k = 1; k < participants; k++) {
+        WorkRange* victim = &pool.ranges[(self + k) % participants];
+        uint64_t r = atomic_load(&victim->range);
+        while (1) {
+            uint32_t begin = (uint32_t)r, end = (uint32_t)(r >> 32);
+            if (begin >= end) break;
+            uint32_t half = (end - begin + 1) / 2;
+            if (atomic_compare_exchange_weak(&victim->range, &r, packRange(begin, end - half))) {
+                atomic_store(&pool.ranges[self].range, packRange(end - half, end));
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// 執行緒 self 處理自己的項目，做完後持續偷取其他執行緒的工作
+static void runWorker(int self) {
+    TRACE_BEGIN(span, "pool.worker");
+    insideParallel = 1;
+    do {
+        int index;
+        while ((index = popFront(&pool.ranges[self])) >= 0) {
+            pool.task(index, pool.ctx);
+        }
+    } while (steal(self, pool.participants));
+    insideParallel = 0;
+    TRACE_END(span, 0, 0);
+}
+
+static void* workerMain(void* arg) {
+    int self = (int)(intptr_t)arg;
+    unsigned long seen = 0;
+    pthread_mutex_lock(&pool.lock);
+    while (1) {
+        while (pool.generation == seen) pthread_cond_wait(&pool.wake, &pool.lock);
+        seen = pool.generation;
+        if (self >= pool.participants) continue; // 這次的工作不需要這個執行緒
+        pthread_mutex_unlock(&pool.lock);
+
+        runWorker(self);
+
+        pthread_mutex_lock(&pool.lock);
+        if (++pool.finished == pool.participants - 1) pthread_cond_signal(&pool.done);
+    }
+    return NULL;
+}
+
+void parallelFor(int count, ParallelTask task, void* ctx) {
+    int threads = threadPoolThreads();
+    if (threads > count) threads = count;
+    if (threads <= 1 || insideParallel || pthread_mutex_trylock(&pool.busy) != 0) {
+        for (int i = 0; i < count; i++) task(i, ctx);
+        return;
+    }
+
+    // 第 0 號由呼叫者自己擔任，其餘為工作執行緒（第一次使用時才建立）
+    pthread_mutex_lock(&pool.lock);
+    while (pool.created < threads - 1) {
+        if (pthread_create(&pool.workers[pool.created], NULL, workerMain, (void*)(intptr_t)(pool.created + 1)) != 0) {
+            break;
+        }
+        pthread_detach(pool.workers[pool.created]);
+        pool.created++;
+    }
+    if (threads > pool.created + 1) threads = pool.created + 1;
+
+    pool.task = task;
+    pool.ctx = ctx;
+    pool.participants = threads;
+    pool.finished = 0;
+    for (int t = 0; t < threads; t++) {
+        atomic_store(&pool.ranges[t].range, packRange((uint32_t)((int64_t)count * t / threads), (uint32_t)((int64_t)count * (t + 1) / threads)));
+    }
+    pool.generation++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    runWorker(0);
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.finished < pool.participants - 1) pthread_cond_wait(&pool.done, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+    pthread_mutex_unlock(&pool.busy);
+}
+
+// ======= 影像區塊 =======
+
+typedef struct {
+    const ImageView* src;
+    ImageView* dst;
+    int haloX, haloY;
+    int tileWidth, tileHeight;
+    int tileColumns;
+    TileKernel kernel;
+    void* ctx;
+} TileJob;
+
+static void tileTask(int index, void* ctx) {
+    TileJob* job = (TileJob*)ctx;
+    int x0 = (index % job->tileColumns) * job->tileWidth;
+    int y0 = (index / job->tileColumns) * job->tileHeight;
+    int x1 = x0 + job->tileWidth < job->src->width ? x0 + job->tileWidth : job->src->width;
+    int y1 = y0 + job->tileHeight < job->src->height ? y0 + job->tileHeight : job->src->height;
+
+    // 向外擴大 halo，在影像邊界處截斷
+    x0 = x0 - job->haloX > 0 ? x0 - job->haloX : 0;
+    y0 = y0 - job->haloY > 0 ? y0 - job->haloY : 0;
+    x1 = x1 + job->haloX < job->src->width ? x1 + job->haloX : job->src->width;
+    y1 = y1 + job->haloY < job->src->height ? y1 + job->haloY : job->src->height;
+
+    TRACE_BEGIN(span, "pool.tile");
+    ImageView src = imageSubView(job->src, x0, y0, x1 - x0, y1 - y0);
+    ImageView dst = imageSubView(job->dst, x0, y0, x1 - x0, y1 - y0);
+    job->kernel(&src, &dst, job->ctx);
+    TRACE_END(span, 2 * (uint64_t)src.width * src.height * src.channels, (uint64_t)src.width * src.height);
+}
+
+// 依快取大小與執行緒數決定區塊的寬高與欄數
+static void tileLayout(const ImageView* src, int haloX, int haloY, int threads, int* tileWidth, int* tileHeight, int* columns) {
+    int width = src->width, height = src->height, ch = src->channels;
+
+    // 整行（加上上下鄰域）放不進一個區塊時才把影像切成多欄，每欄至少是水平鄰域的 4 倍寬
+    int minRows = MIN_TILE_ROWS > 2 * haloY ? MIN_TILE_ROWS : 2 * haloY;
+    size_t bandBytes = (size_t)width * ch * (minRows + 2 * haloY);
+    int cols = (int)((bandBytes + TILE_BYTES - 1) / TILE_BYTES);
+    int minWidth = 64 > 4 * haloX ? 64 : 4 * haloX;
+    if (cols > width / minWidth) cols = width / minWidth;
+    if (cols < 1) cols = 1;
+    *columns = cols;
+    *tileWidth = (width + cols - 1) / cols;
+
+    // 區塊的行數：依快取大小決定，但要讓每個執行緒平均分到數個區塊
+    size_t tileRowBytes = (size_t)(*tileWidth + 2 * haloX) * ch;
+    int rows = (int)(TILE_BYTES / tileRowBytes) - 2 * haloY;
+    int rowsForBalance = (height * cols + threads * TILES_PER_THREAD - 1) / (threads * TILES_PER_THREAD);
+    if (rows > rowsForBalance) rows = rowsForBalance;
+    if (rows < minRows) rows = minRows;
+    *tileHeight = rows;
+}
+
+void parallelTiles(const ImageView* src, ImageView* dst, int haloX, int haloY, TileKernel kernel, void* ctx) {
+    int threads = threadPoolThreads();
+    if (threads <= 1 || insideParallel || src->width <= 0 || src->height <= 0) {
+        kernel(src, dst, ctx); // 單執行緒時直接處理整張影像
+        return;
+    }
+
+    int tileWidth, tileHeight, columns;
+    tileLayout(src, haloX, haloY, threads, &tileWidth, &tileHeight, &columns);
+    TileJob job = { src, dst, haloX, haloY, tileWidth, tileHeight, columns, kernel, ctx };
+    int tileRows = (src->height + tileHeight - 1) / tileHeight;
+    parallelFor(tileRows * columns, tileTask, &job);
+}
+
+typedef struct {
+    const ImageView* src;
+    const TileOutput* outputs;
+    int count;
+    int tileWidth, tileHeight;
+    int tileColumns;
+} FanOutTileJob;
+
+static void fanOutTileTask(int index, void* ctx) {
+    FanOutTileJob* job = (FanOutTileJob*)ctx;
+    const ImageView* image = job->src;
+    int cx0 = (index % job->tileColumns) * job->tileWidth;
+    int cy0 = (index / job->tileColumns) * job->tileHeight;
+    int cx1 = cx0 + job->tileWidth < image->width ? cx0 + job->tileWidth : image->width;
+    int cy1 = cy0 + job->tileHeight < image->height ? cy0 + job->tileHeight : image->height;
+
+    // 同一塊來源區域依序交給每個輸出，各自以自己的 halo 擴大，來源在快取中只需載入一次
+    TRACE_BEGIN(span, "pool.fan-out-tile");
+    for (int k = 0; k < job->count; k++) {
+        const TileOutput* out = &job->outputs[k];
+        int x0 = cx0 - out->haloX > 0 ? cx0 - out->haloX : 0;
+        int y0 = cy0 - out->haloY > 0 ? cy0 - out->haloY : 0;
+        int x1 = cx1 + out->haloX < image->width ? cx1 + out->haloX : image->width;
+        int y1 = cy1 + out->haloY < image->height ? cy1 + out->haloY : image->height;
+        ImageView src = imageSubView(image, x0, y0, x1 - x0, y1 - y0);
+        ImageView dst = imageSubView(out->dst, x0, y0, x1 - x0, y1 - y0);
+        out->kernel(&src, &dst, out->ctx);
+    }
+    TRACE_END(span, (uint64_t)(job->count + 1) * (cx1 - cx0) * (cy1 - cy0) * image->channels, (uint64_t)(cx1 - cx0) * (cy1 - cy0));
+}
+
+void parallelTilesFanOut(const ImageView* src, const TileOutput* outputs, int count) {
+    if (count <= 0 || src->width <= 0 || src->height <= 0) return;
+    if (insideParallel) {
+        for (int k = 0; k < count; k++) outputs[k].kernel(src, outputs[k].dst, outputs[k].ctx);
+        return;
+    }
+
+    // 以最大的 halo 決定區塊大小；單執行緒時也切成區塊，才能在來源還在快取中時算完所有輸出
+    int haloX = 0, haloY = 0;
+    for (int k = 0; k < count; k++) {
+        if (outputs[k].haloX > haloX) haloX = outputs[k].haloX;
+        if (outputs[k].haloY > haloY) haloY = outputs[k].haloY;
+    }
+    int tileWidth, tileHeight, columns;
+    tileLayout(src, haloX, haloY, threadPoolThreads(), &tileWidth, &tileHeight, &columns);
+    FanOutTileJob job = { src, outputs, count, tileWidth, tileHeight, columns };
+    int tileRows = (src->height + tileHeight - 1) / tileHeight;
+    parallelFor(tileRows * columns, fanOutTileTask, &job);
+}
+
+void parallelRows(const ImageView* src, ImageView* dst, TileKernel kernel, void* ctx) {
+    int threads = threadPoolThreads();
+    if (threads <= 1 || insideParallel || src->width <= 0 || src->height <= 0) {
+        kernel(src, dst, ctx);
+        return;
+    }
+
+    // 逐像素運算不需要鄰域，以整行為單位切成數個行區段即可
+    int bands = threads * TILES_PER_THREAD;
+    int bandHeight = (src->height + bands - 1) / bands;
+    TileJob job = { src, dst, 0, 0, src->width, bandHeight, 1, kernel, ctx };
+    parallelFor((src->height + bandHeight - 1) / bandHeight, tileTask, &job);
+}
@@ -0,0 +1,54 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "bmp_io.h"
+
+#define THREAD_POOL_MAX_THREADS 256
+
+// 設定平行處理使用的執行緒數；0 表示使用環境變數 DIP_THREADS，未設定時使用 CPU 核心數
+// 1 表示完全不建立執行緒，所有工作在呼叫者的執行緒上依序執行
+void threadPoolSetThreads(int threads);
+
+// 目前使用的執行緒數（包含呼叫者本身）
+int threadPoolThreads(void);
+
+// 解析命令列中的 --threads N（或 -t N），找到時設定執行緒數；其餘參數不受影響
+void threadPoolParseArgs(int argc, char* argv[]);
+
+// 平行迴圈的工作：處理第 index 個工作項目
+typedef void (*ParallelTask)(int index, void* ctx);
+
+// 平行執行 task(0) ~ task(count - 1)，全部完成後才返回
+// 每個執行緒先分到連續的一段項目，做完自己的部分後會從其他執行緒剩餘的範圍後半段取走工作（work stealing）
+// 在工作中再次呼叫（巢狀）或其他執行緒正在使用時，改在目前的執行緒上依序執行
+void parallelFor(int count, ParallelTask task, void* ctx);
+
+// 區塊核心：處理 src 的內部像素（距離視圖左右邊界至少 haloX、上下邊界至少 haloY）並寫入 dst 的相同位置
+// src 與 dst 是整張影像中同一塊區域的子視圖
+typedef void (*TileKernel)(const ImageView* src, ImageView* dst, void* ctx);
+
+// 將影像切成大小約為快取容量的區塊並平行處理
+// 每個區塊的視圖向外多包含 haloX / haloY 個像素的鄰域（在影像邊界處截斷），
+// 因此「只處理視圖內部」的濾波核心在每個區塊上的結果與處理整張影像時逐像素相同
+// haloX, haloY: 濾波器在水平、垂直方向需要的鄰域大小（點運算為 0）
+// src 與 dst 大小須相同；halo 為 0 時可以指向同一塊記憶體
+void parallelTiles(const ImageView* src, ImageView* dst, int haloX, int haloY, TileKernel kernel, void* ctx);
+
+// 多輸出區塊處理中的一個輸出：以 kernel 處理來源影像並寫入 dst（大小須與來源相同）
+typedef struct {
+    TileKernel kernel;
+    void* ctx;
+    ImageView* dst;
+    int haloX, haloY;       // 這個核心需要的鄰域大小
+} TileOutput;
+
+// 以同一次走訪計算多個輸出：每個區塊的來源載入快取後，依序交給每個輸出的核心處理，
+// 而不是對每個輸出各自掃過整張影像。區塊以最大的 halo 決定大小，每個核心的視圖只擴大自己的 halo，
+// 因此每個輸出與分別呼叫 parallelTiles 的結果逐像素相同
+// 單執行緒時同樣切成區塊處理；各輸出的 dst 不可與 src 或彼此指向同一塊記憶體
+void parallelTilesFanOut(const ImageView* src, const TileOutput* outputs, int count);
+
+// 依行平行處理：把影像切成多個行區段，對每個區段呼叫 kernel（不含鄰域，適合逐像素運算）
+void parallelRows(const ImageView* src, ImageView* dst, TileKernel kernel, void* ctx);
+
+#endif
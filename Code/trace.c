@@ -0,0 +1,182 @@
+#include "trace.h"
+
+#ifdef DIP_TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#define EVENTS_PER_CHUNK 4096  // 每次擴充緩衝區時增加的紀錄數
+#define MAX_STAGES 256          // 統計表最多的 (階段, 執行緒) 組合數
+
+typedef struct {
+    const char* name;
+    uint64_t start, duration;
+    uint64_t bytes, pixels;
+} TraceEvent;
+
+// 每個執行緒的紀錄，建立後串成鏈結串列，直到程式結束都不釋放
+typedef struct TraceBuffer {
+    int thread;                 // 依第一次記錄的順序編號
+    pthread_t owner;
+    int count, capacity;
+    TraceEvent* events;
+    struct TraceBuffer* next;
+} TraceBuffer;
+
+static struct {
+    pthread_once_t once;
+    pthread_mutex_t lock;
+    TraceBuffer* buffers;
+    int threads;
+    uint64_t epoch;             // 最早一筆紀錄的開始時間，輸出的時間以此為 0
+} trace = { PTHREAD_ONCE_INIT, PTHREAD_MUTEX_INITIALIZER, NULL, 0, UINT64_MAX };
+
+static __thread TraceBuffer* localBuffer;
+
+uint64_t traceNow(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+}
+
+// 每個 (階段, 執行緒) 的合計
+typedef struct {
+    const char* name;
+    int thread;
+    int count;
+    uint64_t duration, bytes, pixels;
+} StageTotal;
+
+static int compareTotals(const void* a, const void* b) {
+    const StageTotal* x = (const StageTotal*)a;
+    const StageTotal* y = (const StageTotal*)b;
+    int c = strcmp(x->name, y->name);
+    return c ? c : x->thread - y->thread;
+}
+
+static void writeJSON(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "無法寫入追蹤檔 %s。\n", path);
+        return;
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    const char* separator = "";
+    for (TraceBuffer* b = trace.buffers; b; b = b->next) {
+        // 結束時呼叫 exit 的執行緒即為主執行緒
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+                separator, b->thread, pthread_equal(b->owner, pthread_self()) ? "main" : "thread", b->thread);
+        separator = ",\n";
+        for (int i = 0; i < b->count; i++) {
+            const TraceEvent* e = &b->events[i];
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"dip\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                    "\"args\":{\"bytes\":%llu,\"pixels\":%llu}}",
+                    e->name, b->thread, (e->start - trace.epoch) / 1e3, e->duration / 1e3,
+                    (unsigned long long)e->bytes, (unsigned long long)e->pixels);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+}
+
+static void printSummary(const char* path) {
+    static StageTotal totals[MAX_STAGES];
+    int count = 0;
+    for (TraceBuffer* b = trace.buffers; b; b = b->next) {
+        for (int i = 0; i < b->count; i++) {
+            const TraceEvent* e = &b->events[i];
+            int k = 0;
+            while (k < count && (totals[k].thread != b->thread || strcmp(totals[k].name, e->name) != 0)) k++;
+            if (k == count) {
+                if (count == MAX_STAGES) continue;
+                memset(&totals[count], 0, sizeof(StageTotal));
+                totals[count].name = e->name;
+                totals[count].thread = b->thread;
+                count++;
+            }
+            totals[k].count++;
+            totals[k].duration += e->duration;
+            totals[k].bytes += e->bytes;
+            totals[k].pixels += e->pixels;
+        }
+    }
+    qsort(totals, count, sizeof(StageTotal), compareTotals);
+
+    fprintf(stderr, "\n%-20s %6s %7s %10s %10s %10s %10s %10s\n", "stage", "thread", "count", "total ms", "avg ms", "MB", "MB/s", "MP/s");
+    for (int k = 0; k < count; k++) {
+        const StageTotal* t = &totals[k];
+        double seconds = t->duration * 1e-9;
+        fprintf(stderr, "%-20s %6d %7d %10.3f %10.3f %10.2f ", t->name, t->thread, t->count,
+                seconds * 1e3, seconds * 1e3 / t->count, t->bytes / 1e6);
+        if (t->bytes && seconds > 0) {
+            fprintf(stderr, "%10.1f ", t->bytes / 1e6 / seconds);
+        } else {
+            fprintf(stderr, "%10s ", "-");
+        }
+        if (t->pixels && seconds > 0) {
+            fprintf(stderr, "%10.1f\n", t->pixels / 1e6 / seconds);
+        } else {
+            fprintf(stderr, "%10s\n", "-");
+        }
+    }
+    fprintf(stderr, "trace written to %s\n", path);
+}
+
+// 程式結束時輸出（此時執行緒池的工作執行緒都在等待工作，不會再寫入紀錄）
+static void traceExit(void) {
+    pthread_mutex_lock(&trace.lock);
+    for (TraceBuffer* b = trace.buffers; b; b = b->next) {
+        for (int i = 0; i < b->count; i++) {
+            if (b->events[i].start < trace.epoch) trace.epoch = b->events[i].start;
+        }
+    }
+    const char* path = getenv("DIP_TRACE_FILE");
+    if (!path || !*path) path = "trace.json";
+    writeJSON(path);
+    printSummary(path);
+    pthread_mutex_unlock(&trace.lock);
+}
+
+static void traceInit(void) {
+    atexit(traceExit);
+}
+
+void traceRecord(const char* name, uint64_t start, uint64_t bytes, uint64_t pixels) {
+    uint64_t end = traceNow();
+    pthread_once(&trace.once, traceInit);
+    TraceBuffer* b = localBuffer;
+    if (!b) {
+        b = (TraceBuffer*)calloc(1, sizeof(TraceBuffer));
+        if (!b) return;
+        pthread_mutex_lock(&trace.lock);
+        b->thread = trace.threads++;
+        b->owner = pthread_self();
+        b->next = trace.buffers;
+        trace.buffers = b;
+        pthread_mutex_unlock(&trace.lock);
+        localBuffer = b;
+    }
+    if (b->count == b->capacity) {
+        // 擴充時持有鎖，避免與結束時的輸出同時存取
+        pthread_mutex_lock(&trace.lock);
+        TraceEvent* events = (TraceEvent*)realloc(b->events, (b->capacity + EVENTS_PER_CHUNK) * sizeof(TraceEvent));
+        if (events) {
+            b->events = events;
+            b->capacity += EVENTS_PER_CHUNK;
+        }
+        pthread_mutex_unlock(&trace.lock);
+        if (!events) return;
+    }
+    TraceEvent* e = &b->events[b->count++];
+    e->name = name;
+    e->start = start;
+    e->duration = end - start;
+    e->bytes = bytes;
+    e->pixels = pixels;
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// 各階段的計時紀錄（讀寫、核心、執行緒池的區塊），以 -DDIP_TRACE 編譯時才會記錄
+// 沒有定義 DIP_TRACE 時所有巨集都展開為空，不會留下任何程式碼或函式呼叫
+//
+// 每個執行緒把紀錄寫入自己的緩衝區（不需要鎖），程式結束時寫出 Chrome / Perfetto 可開啟的 JSON
+// （檔名由環境變數 DIP_TRACE_FILE 指定，預設為 trace.json），並在 stderr 印出各階段的統計表
+//
+// 用法（span 為區域變數名稱，name 須為字串常數）：
+//     TRACE_BEGIN(span, "median");
+//     ...
+//     TRACE_END(span, 讀寫的位元組數, 處理的像素數);
+
+#ifdef DIP_TRACE
+
+typedef struct {
+    const char* name;
+    uint64_t start;     // 開始時間（奈秒）
+} TraceSpan;
+
+// 目前時間（奈秒，單調遞增）
+uint64_t traceNow(void);
+
+// 記錄一段從 start 到現在的區間
+void traceRecord(const char* name, uint64_t start, uint64_t bytes, uint64_t pixels);
+
+#define TRACE_BEGIN(span, name) TraceSpan span = { (name), traceNow() }
+#define TRACE_END(span, bytes, pixels) traceRecord((span).name, (span).start, (uint64_t)(bytes), (uint64_t)(pixels))
+
+#else
+
+#define TRACE_BEGIN(span, name) ((void)0)
+#define TRACE_END(span, bytes, pixels) ((void)0)
+
+#endif
+
+#endif